@@ -106,6 +106,35 @@
 #define ID_DAP_Vendor30                 0x9EU
 #define ID_DAP_Vendor31                 0x9FU
 
+// DAP Vendor Commands of this Debug Unit
+#define ID_DAP_TransferFaultConfigure   ID_DAP_Vendor1
+#define ID_DAP_TransferFaultStatus      ID_DAP_Vendor2
+#define ID_DAP_WaitConfigure            ID_DAP_Vendor3
+#define ID_DAP_WaitStatistics           ID_DAP_Vendor4
+#define ID_DAP_SWJ_ClockInfo            ID_DAP_Vendor5
+#define ID_DAP_LinkConfigure            ID_DAP_Vendor6
+#define ID_DAP_LinkStatus               ID_DAP_Vendor7
+#define ID_DAP_TargetTune               ID_DAP_Vendor8
+#define ID_DAP_SettingsRead             ID_DAP_Vendor9
+#define ID_DAP_SettingsWrite            ID_DAP_Vendor10
+#define ID_DAP_DownloadOpen             ID_DAP_Vendor11
+#define ID_DAP_DownloadData             ID_DAP_Vendor12
+#define ID_DAP_DownloadClose            ID_DAP_Vendor13
+#define ID_DAP_ReadRLE                  ID_DAP_Vendor14
+#define ID_DAP_ReadScatter              ID_DAP_Vendor15
+#define ID_DAP_SampleConfigure          ID_DAP_Vendor16
+#define ID_DAP_SampleRead               ID_DAP_Vendor17
+#define ID_DAP_EventConfigure           ID_DAP_Vendor18
+#define ID_DAP_EventRead                ID_DAP_Vendor19
+#define ID_DAP_CoreRead                 ID_DAP_Vendor20
+#define ID_DAP_CoreWrite                ID_DAP_Vendor21
+#define ID_DAP_CoreStep                 ID_DAP_Vendor22
+#define ID_DAP_RomDiscover              ID_DAP_Vendor23
+#define ID_DAP_ScriptLoad               ID_DAP_Vendor24
+#define ID_DAP_ScriptRun                ID_DAP_Vendor25
+#define ID_DAP_CaptureControl           ID_DAP_Vendor26
+#define ID_DAP_CaptureRead              ID_DAP_Vendor27
+
 #define ID_DAP_Invalid                  0xFFU
 
 // DAP Status Code
@@ -164,6 +193,11 @@
 #define DAP_TRANSFER_ERROR              (1U<<3)
 #define DAP_TRANSFER_MISMATCH           (1U<<4)
 
+// DAP Transfer Block FAULT Recovery Mode
+#define DAP_FAULT_RECOVERY_OFF          0U      // Abort Transfer Block on FAULT
+#define DAP_FAULT_RECOVERY_ABORT        1U      // Clear errors, retry word, then abort
+#define DAP_FAULT_RECOVERY_SKIP         2U      // Clear errors, retry word, then skip it
+
 // DAP SWO Trace Mode
 #define DAP_SWO_OFF                     0U
 #define DAP_SWO_UART                    1U
@@ -209,6 +243,53 @@
 #define DP_RESEND                       0x08U   // Resend (SW Read Only)
 #define DP_RDBUFF                       0x0CU   // Read Buffer (Read Only)
 
+// Debug Port ABORT Register bits
+#define DP_ABORT_STKCMPCLR              (1U<<1) // Clear STICKYCMP
+#define DP_ABORT_STKERRCLR              (1U<<2) // Clear STICKYERR
+#define DP_ABORT_WDERRCLR               (1U<<3) // Clear WDATAERR
+#define DP_ABORT_ORUNERRCLR             (1U<<4) // Clear STICKYORUN
+
+// Debug Port CTRL/STAT Register bits
+#define DP_CTRL_CDBGPWRUPREQ            (1U<<28) // Debug power-up request
+#define DP_CTRL_CDBGPWRUPACK            (1U<<29) // Debug power-up acknowledge
+#define DP_CTRL_CSYSPWRUPREQ            (1U<<30) // System power-up request
+#define DP_CTRL_CSYSPWRUPACK            (1U<<31) // System power-up acknowledge
+
+// MEM-AP Register Addresses
+#define AP_CSW                          0x00U   // Control & Status Word
+#define AP_TAR                          0x04U   // Transfer Address
+#define AP_DRW                          0x0CU   // Data Read/Write
+
+// Cortex-M Debug Registers
+#define DBG_HCSR                        0xE000EDF0U     // Debug Halting Control and Status
+#define DBG_CRSR                        0xE000EDF4U     // Debug Core Register Selector
+#define DBG_CRDR                        0xE000EDF8U     // Debug Core Register Data
+#define DBG_EMCR                        0xE000EDFCU     // Debug Exception and Monitor Control
+#define NVIC_AIRCR                      0xE000ED0CU     // Application Interrupt and Reset Control
+
+// DHCSR bits
+#define DBGKEY                          0xA05F0000U
+#define C_DEBUGEN                       (1U<<0)
+#define C_HALT                          (1U<<1)
+#define C_STEP                          (1U<<2)
+#define C_MASKINTS                      (1U<<3)
+#define S_REGRDY                        (1U<<16)
+#define S_HALT                          (1U<<17)
+#define S_SLEEP                         (1U<<18)
+#define S_LOCKUP                        (1U<<19)
+#define S_RETIRE_ST                     (1U<<24)
+#define S_RESET_ST                      (1U<<25)
+
+// DCRSR bits
+#define REGWnR                          (1U<<16)
+
+// DEMCR bits
+#define VC_CORERESET                    (1U<<0)
+
+// AIRCR bits
+#define VECTKEY                         0x05FA0000U
+#define SYSRESETREQ                     (1U<<2)
+
 // JTAG IR Codes
 #define JTAG_ABORT                      0x08U
 #define JTAG_DPACC                      0x0AU
@@ -249,6 +330,22 @@ typedef struct {
     uint8_t    turnaround;                      // Turnaround period
     uint8_t    data_phase;                      // Always generate Data Phase
   } swd_conf;
+  struct {                                      // Transfer Block FAULT Recovery
+    uint8_t    mode;                            // Recovery mode
+    uint8_t    retry;                           // Retries of a faulting word
+  } fault;
+  struct {                                      // WAIT Handling
+    uint8_t    adaptive;                        // Idle cycle backoff and per AP learning
+    uint8_t    padding;
+    uint16_t   backoff_max;                     // Maximum idle cycles between retries
+  } wait;
+  struct {                                      // Link Quality Clock Downshift
+    uint8_t    downshift;                       // Clock downshift enabled
+    uint8_t    errors;                          // Errors in window that halve the clock
+    uint16_t   window;                          // Window in transfers
+    uint16_t   clean;                           // Transfers without error that double the clock
+    uint32_t   clock_min;                       // Minimum SWJ clock in Hz
+  } link;
 #endif
 #if (DAP_JTAG != 0)
   struct {                                      // JTAG Device Chain
@@ -275,6 +372,7 @@ extern "C"
 // Functions
 extern void     SWJ_Sequence    (uint32_t count, const uint8_t *data);
 extern void     SWD_Sequence    (uint32_t info,  const uint8_t *swdo, uint8_t *swdi);
+extern void     SWD_Idle        (uint32_t count);
 extern void     JTAG_Sequence   (uint32_t info,  const uint8_t *tdi,  uint8_t *tdo);
 extern void     JTAG_IR         (uint32_t ir);
 extern uint32_t JTAG_ReadIDCode (void);
@@ -282,6 +380,44 @@ extern void     JTAG_WriteAbort (uint32_t data);
 extern uint8_t  JTAG_Transfer   (uint32_t request, uint32_t *data);
 extern uint8_t  SWD_Transfer    (uint32_t request, uint32_t *data);
 
+extern void     DAP_SWJ_SetClock (uint32_t clock);
+extern void     DAP_TuneConnect   (void);
+extern void     DAP_TuneDisconnect(void);
+extern uint32_t DAP_TuneClock     (uint32_t clock);
+extern void     DAP_TuneTransfer  (void);
+extern uint32_t DAP_TransferSelect(void);
+extern void     DAP_TransferSticky(uint32_t dhcsr);
+
+// MEM-AP 0 set up by the host, kept across probe side target accesses
+typedef struct {
+  uint32_t csw;                         // CSW of AP 0
+  uint32_t tar;                         // TAR of AP 0
+  uint32_t select;                      // SELECT the probe wrote since the save
+  uint32_t session;                     // Saved from a host session by Target_Begin
+} Target_Host_t;
+
+extern uint32_t Target_Connect   (uint32_t *dpidr);
+extern void     Target_Disconnect(void);
+extern uint32_t Target_ReadMem   (uint32_t address, uint32_t *data, uint32_t count);
+extern uint32_t Target_WriteMem  (uint32_t address, const uint32_t *data, uint32_t count);
+extern uint32_t Target_Read32    (uint32_t address, uint32_t *data);
+extern uint32_t Target_Write32   (uint32_t address, uint32_t data);
+extern uint32_t Target_Peek32    (uint32_t address, uint32_t *data);
+extern uint32_t Target_ReadEach  (uint32_t address, uint32_t count, void (*put)(uint32_t address, uint32_t value));
+extern uint32_t Target_Save      (Target_Host_t *host);
+extern void     Target_Restore   (const Target_Host_t *host);
+extern uint32_t Target_Begin     (Target_Host_t *host);
+extern void     Target_End       (const Target_Host_t *host);
+extern void     Target_Release   (void);
+extern uint32_t Target_ResetHalt (void);
+extern uint32_t Target_ResetRun  (void);
+extern uint32_t Target_ReadCore  (uint32_t reg, uint32_t *data);
+extern uint32_t Target_WriteCore (uint32_t reg, uint32_t data);
+extern uint32_t Target_ReadCoreSet (uint32_t mask, uint32_t *data);
+extern uint32_t Target_WriteCoreSet(uint32_t mask, const uint32_t *data);
+extern uint32_t Target_Step      (uint32_t maskints, uint32_t *dhcsr);
+
+extern void     Delayus         (uint32_t delay);
 extern void     Delayms         (uint32_t delay);
 
 extern uint32_t SWO_Transport      (const uint8_t *request, uint8_t *response);
@@ -316,12 +452,50 @@ extern uint32_t UART_Transfer  (const uint8_t *request, uint8_t *response);
 
 extern uint8_t  USB_COM_PORT_Activate (uint32_t cmd);
 
+extern uint32_t DAP_SWJ_ClockInfo                                  (uint8_t *response);
+extern uint32_t DAP_TargetTune             (const uint8_t *request, uint8_t *response);
+extern uint32_t DAP_LinkConfigure          (const uint8_t *request, uint8_t *response);
+extern uint32_t DAP_LinkStatus             (const uint8_t *request, uint8_t *response);
+extern uint32_t DAP_TransferFaultConfigure (const uint8_t *request, uint8_t *response);
+extern uint32_t DAP_TransferFaultStatus                            (uint8_t *response);
+extern uint32_t DAP_WaitConfigure          (const uint8_t *request, uint8_t *response);
+extern uint32_t DAP_WaitStatistics         (const uint8_t *request, uint8_t *response);
+extern uint32_t DAP_DownloadOpen           (const uint8_t *request, uint8_t *response);
+extern uint32_t DAP_DownloadData           (const uint8_t *request, uint8_t *response);
+extern uint32_t DAP_DownloadClose                                  (uint8_t *response);
+extern uint32_t DAP_ReadRLE                (const uint8_t *request, uint8_t *response);
+extern uint32_t DAP_ReadScatter            (const uint8_t *request, uint8_t *response);
+extern uint32_t DAP_ReadScatterBuffer      (const uint8_t *request, uint8_t *response, uint32_t size);
+extern uint32_t DAP_SampleConfigure        (const uint8_t *request, uint8_t *response);
+extern uint32_t DAP_SampleRead                                     (uint8_t *response);
+extern uint32_t DAP_SampleTask             (void);
+extern uint32_t DAP_EventConfigure         (const uint8_t *request, uint8_t *response);
+extern uint32_t DAP_EventRead              (const uint8_t *request, uint8_t *response);
+extern uint32_t DAP_EventTask              (void);
+extern uint32_t DAP_EventWait              (const uint8_t *request, uint32_t held);
+extern uint32_t DAP_CoreRead               (const uint8_t *request, uint8_t *response);
+extern uint32_t DAP_CoreWrite              (const uint8_t *request, uint8_t *response);
+extern uint32_t DAP_CoreStep               (const uint8_t *request, uint8_t *response);
+extern uint32_t DAP_RomDiscover            (const uint8_t *request, uint8_t *response);
+extern uint32_t DAP_ScriptLoad             (const uint8_t *request, uint8_t *response);
+extern uint32_t DAP_ScriptRun              (const uint8_t *request, uint8_t *response);
+extern uint32_t DAP_CaptureControl         (const uint8_t *request, uint8_t *response);
+extern uint32_t DAP_CaptureRead                                    (uint8_t *response);
+extern void     DAP_CaptureCommand         (const uint8_t *request, const uint8_t *response, uint32_t length, uint32_t start);
+
+extern uint32_t DAP_RequestSpace         (const uint8_t *request);
+extern uint32_t DAP_ResponseSpace        (const uint8_t *response);
 extern uint32_t DAP_ProcessVendorCommand (const uint8_t *request, uint8_t *response);
 extern uint32_t DAP_ProcessCommand       (const uint8_t *request, uint8_t *response);
 extern uint32_t DAP_ExecuteCommand       (const uint8_t *request, uint8_t *response);
 
 extern void     DAP_Setup (void);
 
+// Placement of time critical functions (SWD/JTAG I/O and command dispatch)
+#ifndef DAP_RAMFUNC
+#define DAP_RAMFUNC                     // Default: execute in place
+#endif
+
 // Configurable delay for clock generation
 #ifndef DELAY_SLOW_CYCLES
 #define DELAY_SLOW_CYCLES       3U      // Number of cycles for one iteration
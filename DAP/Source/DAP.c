@@ -43,6 +43,12 @@
 #error "Maximum Packet Count is 255!"
 #endif
 
+// Response bytes a command executed by DAP_ExecuteCommand is given at least:
+// Command ID and the longest fixed length response (Settings Read of a
+// 48 byte value). Commands with longer responses are bounded by the space
+// left in the packet.
+#define EXECUTE_RESPONSE_MIN            52U
+
 
 // Clock Macros
 #define MAX_SWJ_CLOCK(delay_cycles) \
@@ -56,14 +62,53 @@ volatile uint8_t    DAP_TransferAbort;  // Transfer Abort Flag
 static const char DAP_FW_Ver [] = DAP_FW_VER;
 
 
+// SWJ clock calibration
+//   SWCLK periods are kept in 1/16 CPU cycles. A period of 0 means that the
+//   clock has not been calibrated and the configured cycle counts are used.
+#define CLOCK_CAL_CYCLES        2048U   // SWCLK cycles timed per measurement
+#define CLOCK_CAL_DELAY         32U     // Delay difference of the slow measurements
+
+static struct {
+  uint32_t  fast;                       // Period with fast clock
+  uint32_t  base;                       // Period with clock_delay 0 (extrapolated)
+  uint32_t  step;                       // Period increment per clock_delay
+  uint32_t  clock;                      // Actual SWJ clock in Hz
+} ClockCal;
+
+
 // Common clock delay calculation routine
+//   Selects the fastest setting that does not exceed the requested clock,
+//   using the calibrated SWCLK periods when available.
 //   clock:    requested SWJ frequency in Hertz
 static void Set_Clock_Delay(uint32_t clock) {
   uint32_t delay;
+  uint32_t period;
+
+  if (ClockCal.step != 0U) {
+    period = (((CPU_CLOCK * 16U) - 1U) / clock) + 1U;
+    if (period <= ClockCal.fast) {
+      DAP_Data.fast_clock  = 1U;
+      DAP_Data.clock_delay = 1U;
+      period = ClockCal.fast;
+    } else {
+      DAP_Data.fast_clock  = 0U;
+
+      delay = 1U;
+      if (period > (ClockCal.base + ClockCal.step)) {
+        delay = ((period - ClockCal.base) + (ClockCal.step - 1U)) / ClockCal.step;
+      }
+
+      DAP_Data.clock_delay = delay;
+      period = ClockCal.base + (ClockCal.step * delay);
+    }
+    ClockCal.clock = (CPU_CLOCK * 16U) / period;
+    return;
+  }
 
   if (clock >= MAX_SWJ_CLOCK(DELAY_FAST_CYCLES)) {
     DAP_Data.fast_clock  = 1U;
     DAP_Data.clock_delay = 1U;
+    ClockCal.clock = MAX_SWJ_CLOCK(DELAY_FAST_CYCLES);
   } else {
     DAP_Data.fast_clock  = 0U;
 
@@ -76,9 +121,321 @@ static void Set_Clock_Delay(uint32_t clock) {
     }
 
     DAP_Data.clock_delay = delay;
+    ClockCal.clock = MAX_SWJ_CLOCK(DELAY_SLOW_CYCLES * delay);
+  }
+}
+
+
+#if (DAP_SWD != 0)
+
+// Measure SWCLK period
+//   The idle, SWD write, SWD read and SWJ sequence loops do different work
+//   per bit, the slowest of them gives the SWCLK period.
+//   fast:     fast clock flag
+//   delay:    clock delay
+//   return:   SWCLK period in 1/16 CPU cycles
+static uint32_t Measure_Clock_Period(uint32_t fast, uint32_t delay) {
+  uint8_t  bits[8];
+  uint32_t primask;
+  uint32_t start;
+  uint32_t elapsed;
+  uint32_t period;
+  uint32_t loop;
+  uint32_t n;
+
+  DAP_Data.fast_clock  = (uint8_t)fast;
+  DAP_Data.clock_delay = delay;
+  memset(bits, 0xFF, sizeof(bits));
+  period = 0U;
+
+  for (loop = 0U; loop < 4U; loop++) {
+    primask = __get_PRIMASK();
+    __disable_irq();
+    start = DELAY_TIMER_GET();
+    for (n = 0U; n < (CLOCK_CAL_CYCLES / 64U); n++) {
+      switch (loop) {
+        case 0U:
+          SWD_Idle(64U);
+          break;
+        case 1U:
+          SWD_Sequence(0U, bits, NULL);
+          break;
+        case 2U:
+          SWD_Sequence(SWD_SEQUENCE_DIN, NULL, bits);
+          break;
+        default:
+          SWJ_Sequence(64U, bits);
+          break;
+      }
+    }
+    elapsed = DELAY_TIMER_ELAPSED(start);
+    __set_PRIMASK(primask);
+
+    elapsed = (elapsed * (CPU_CLOCK / 1000000U) * 16U) / CLOCK_CAL_CYCLES;
+    if (elapsed > period) {
+      period = elapsed;
+    }
+  }
+
+  return (period);
+}
+
+
+// Calibrate SWJ clock
+//   The bit loops are run with the pins in HighZ mode and timed with the
+//   delay timer. The slow clock period is linear in clock_delay, so two
+//   measurements give the period for every delay.
+static void Calibrate_Clock(void) {
+  uint32_t fast;
+  uint32_t slow1;
+  uint32_t slow2;
+
+  ClockCal.step = 0U;
+
+  PORT_OFF();
+  fast  = Measure_Clock_Period(1U, 1U);
+  slow1 = Measure_Clock_Period(0U, 1U);
+  slow2 = Measure_Clock_Period(0U, 1U + CLOCK_CAL_DELAY);
+
+  if ((fast == 0U) || (slow2 <= slow1) || (slow1 < fast)) {
+    return;
+  }
+
+  ClockCal.fast = fast;
+  ClockCal.step = (slow2 - slow1) / CLOCK_CAL_DELAY;
+  ClockCal.base = slow1 - ClockCal.step;
+}
+
+#endif
+
+
+// Process SWJ Clock Info command and prepare response
+//   Reports the SWJ clock actually generated for the last requested clock.
+//   response: pointer to response data
+//   return:   number of bytes in response
+uint32_t DAP_SWJ_ClockInfo(uint8_t *response) {
+
+  *(response+0) = (ClockCal.step != 0U) ? 1U : 0U;
+  *(response+1) = (uint8_t)(ClockCal.clock >>  0);
+  *(response+2) = (uint8_t)(ClockCal.clock >>  8);
+  *(response+3) = (uint8_t)(ClockCal.clock >> 16);
+  *(response+4) = (uint8_t)(ClockCal.clock >> 24);
+  *(response+5) = DAP_Data.fast_clock;
+  *(response+6) = (uint8_t)(DAP_Data.clock_delay >>  0);
+  *(response+7) = (uint8_t)(DAP_Data.clock_delay >>  8);
+  *(response+8) = (uint8_t)(DAP_Data.clock_delay >> 16);
+  *(response+9) = (uint8_t)(DAP_Data.clock_delay >> 24);
+
+  return (10U);
+}
+
+
+#if (DAP_SWD != 0)
+
+// Link quality counters and SWJ clock downshift state
+static struct {
+  uint32_t  transfers;                  // Number of transfers
+  uint32_t  parity;                     // Parity errors
+  uint32_t  protocol;                   // Protocol errors (no valid ACK)
+  uint32_t  waits;                      // WAIT responses
+  uint32_t  faults;                     // FAULT responses
+  uint32_t  clock;                      // Current SWJ clock in Hz
+  uint32_t  clock_max;                  // SWJ clock requested by the host in Hz
+  uint16_t  downshifts;                 // Number of clock reductions
+  uint16_t  upshifts;                   // Number of clock increases
+  uint16_t  errors;                     // Errors in current window
+  uint16_t  window;                     // Transfers in current window
+  uint16_t  clean;                      // Transfers since last error
+} LinkQuality;
+
+
+// Reset link quality counters
+static void SWD_LinkReset(void) {
+  LinkQuality.transfers  = 0U;
+  LinkQuality.parity     = 0U;
+  LinkQuality.protocol   = 0U;
+  LinkQuality.waits      = 0U;
+  LinkQuality.faults     = 0U;
+  LinkQuality.downshifts = 0U;
+  LinkQuality.upshifts   = 0U;
+}
+
+
+// Set SWJ clock requested by the host
+//   clock:    SWJ frequency in Hertz
+static void SWD_LinkClock(uint32_t clock) {
+  LinkQuality.clock     = clock;
+  LinkQuality.clock_max = clock;
+  LinkQuality.errors = 0U;
+  LinkQuality.window = 0U;
+  LinkQuality.clean  = 0U;
+}
+
+
+// Update link quality counters after a transfer
+//   With clock downshift enabled the SWJ clock is halved after too many
+//   parity or protocol errors within the window, and doubled again up to
+//   the requested clock after a number of transfers without errors.
+//   response_value: ACK[2:0] or DAP_TRANSFER_ERROR on parity error
+//   waits:          number of WAIT responses
+DAP_RAMFUNC static void SWD_LinkUpdate(uint32_t response_value, uint32_t waits) {
+  uint32_t error;
+  uint32_t clock;
+
+  LinkQuality.transfers++;
+  LinkQuality.waits += waits;
+
+  error = 0U;
+  switch (response_value) {
+    case DAP_TRANSFER_OK:
+    case DAP_TRANSFER_WAIT:
+      break;
+    case DAP_TRANSFER_FAULT:
+      LinkQuality.faults++;
+      break;
+    case DAP_TRANSFER_ERROR:
+      LinkQuality.parity++;
+      error = 1U;
+      break;
+    default:
+      LinkQuality.protocol++;
+      error = 1U;
+      break;
+  }
+
+  if (DAP_Data.link.downshift == 0U) {
+    return;
+  }
+
+  LinkQuality.window++;
+  if (error != 0U) {
+    LinkQuality.errors++;
+    LinkQuality.clean = 0U;
+  } else if (LinkQuality.clean != 0xFFFFU) {
+    LinkQuality.clean++;
+  }
+
+  if (LinkQuality.errors >= DAP_Data.link.errors) {
+    // Too many errors: halve clock
+    clock = LinkQuality.clock / 2U;
+    if (clock < DAP_Data.link.clock_min) {
+      clock = DAP_Data.link.clock_min;
+    }
+    if (clock < LinkQuality.clock) {
+      LinkQuality.clock = clock;
+      LinkQuality.downshifts++;
+      Set_Clock_Delay(clock);
+    }
+    LinkQuality.errors = 0U;
+    LinkQuality.window = 0U;
+  } else if (LinkQuality.window >= DAP_Data.link.window) {
+    LinkQuality.errors = 0U;
+    LinkQuality.window = 0U;
+  }
+
+  if ((LinkQuality.clean >= DAP_Data.link.clean) &&
+      (LinkQuality.clock < LinkQuality.clock_max)) {
+    // Clean period: try faster clock
+    clock = LinkQuality.clock * 2U;
+    if ((clock > LinkQuality.clock_max) || (clock < LinkQuality.clock)) {
+      clock = LinkQuality.clock_max;
+    }
+    LinkQuality.clock = clock;
+    LinkQuality.upshifts++;
+    LinkQuality.clean = 0U;
+    Set_Clock_Delay(clock);
+  }
+}
+
+
+// Process Link Configure command and prepare response
+//   request:  pointer to request data
+//   response: pointer to response data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t DAP_LinkConfigure(const uint8_t *request, uint8_t *response) {
+  uint32_t clock_min;
+  uint16_t window;
+  uint16_t clean;
+
+  window    = (uint16_t) *(request+2) |
+              (uint16_t)(*(request+3) << 8);
+  clean     = (uint16_t) *(request+4) |
+              (uint16_t)(*(request+5) << 8);
+  clock_min = (uint32_t)(*(request+6) <<  0) |
+              (uint32_t)(*(request+7) <<  8) |
+              (uint32_t)(*(request+8) << 16) |
+              (uint32_t)(*(request+9) << 24);
+
+  // A zero clean period would undo every downshift right away
+  if ((*(request+1) == 0U) || (window == 0U) || (clean == 0U) || (clock_min == 0U)) {
+    *response = DAP_ERROR;
+    return ((10U << 16) | 1U);
+  }
+
+  DAP_Data.link.downshift = (*(request+0) != 0U) ? 1U : 0U;
+  DAP_Data.link.errors    =  *(request+1);
+  DAP_Data.link.window    = window;
+  DAP_Data.link.clean     = clean;
+  DAP_Data.link.clock_min = clock_min;
+
+  if ((DAP_Data.link.downshift == 0U) &&
+      (LinkQuality.clock != LinkQuality.clock_max)) {
+    // Restore requested clock
+    Set_Clock_Delay(LinkQuality.clock_max);
   }
+  SWD_LinkClock(LinkQuality.clock_max);
+
+  *response = DAP_OK;
+  return ((10U << 16) | 1U);
+}
+
+
+// Process Link Status command and prepare response
+//   request:  pointer to request data (bit 0: clear counters)
+//   response: pointer to response data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t DAP_LinkStatus(const uint8_t *request, uint8_t *response) {
+
+  *(response+0)  = (uint8_t)(LinkQuality.transfers  >>  0);
+  *(response+1)  = (uint8_t)(LinkQuality.transfers  >>  8);
+  *(response+2)  = (uint8_t)(LinkQuality.transfers  >> 16);
+  *(response+3)  = (uint8_t)(LinkQuality.transfers  >> 24);
+  *(response+4)  = (uint8_t)(LinkQuality.parity     >>  0);
+  *(response+5)  = (uint8_t)(LinkQuality.parity     >>  8);
+  *(response+6)  = (uint8_t)(LinkQuality.parity     >> 16);
+  *(response+7)  = (uint8_t)(LinkQuality.parity     >> 24);
+  *(response+8)  = (uint8_t)(LinkQuality.protocol   >>  0);
+  *(response+9)  = (uint8_t)(LinkQuality.protocol   >>  8);
+  *(response+10) = (uint8_t)(LinkQuality.protocol   >> 16);
+  *(response+11) = (uint8_t)(LinkQuality.protocol   >> 24);
+  *(response+12) = (uint8_t)(LinkQuality.waits      >>  0);
+  *(response+13) = (uint8_t)(LinkQuality.waits      >>  8);
+  *(response+14) = (uint8_t)(LinkQuality.waits      >> 16);
+  *(response+15) = (uint8_t)(LinkQuality.waits      >> 24);
+  *(response+16) = (uint8_t)(LinkQuality.faults     >>  0);
+  *(response+17) = (uint8_t)(LinkQuality.faults     >>  8);
+  *(response+18) = (uint8_t)(LinkQuality.faults     >> 16);
+  *(response+19) = (uint8_t)(LinkQuality.faults     >> 24);
+  *(response+20) = (uint8_t)(LinkQuality.clock      >>  0);
+  *(response+21) = (uint8_t)(LinkQuality.clock      >>  8);
+  *(response+22) = (uint8_t)(LinkQuality.clock      >> 16);
+  *(response+23) = (uint8_t)(LinkQuality.clock      >> 24);
+  *(response+24) = (uint8_t)(LinkQuality.downshifts >>  0);
+  *(response+25) = (uint8_t)(LinkQuality.downshifts >>  8);
+  *(response+26) = (uint8_t)(LinkQuality.upshifts   >>  0);
+  *(response+27) = (uint8_t)(LinkQuality.upshifts   >>  8);
+
+  if ((*request & 0x01U) != 0U) {
+    SWD_LinkReset();
+  }
+
+  return ((1U << 16) | 28U);
 }
 
+#endif
+
 
 // Get DAP Information
 //   id:      info identifier
@@ -182,11 +539,27 @@ static uint8_t DAP_Info(uint8_t id, uint8_t *info) {
 }
 
 
+// Delay for specified time
+//   Delays of at least one RTOS tick sleep on the delay timer, so the core
+//   idles instead of spinning; the wake-up is the timer compare match, not
+//   the next tick. Shorter delays and delays outside a thread busy-wait.
+//    delay:  delay time in us
+void Delayus(uint32_t delay) {
+  if (delay == 0U) {
+    return;
+  }
+  if ((delay >= DELAY_YIELD_THRESHOLD) && (DELAY_YIELD(delay) != 0U)) {
+    return;
+  }
+  delay *= ((CPU_CLOCK/1000000U) + (DELAY_SLOW_CYCLES-1U)) / DELAY_SLOW_CYCLES;
+  PIN_DELAY_SLOW(delay);
+}
+
+
 // Delay for specified time
 //    delay:  delay time in ms
 void Delayms(uint32_t delay) {
-  delay *= ((CPU_CLOCK/1000U) + (DELAY_SLOW_CYCLES-1U)) / DELAY_SLOW_CYCLES;
-  PIN_DELAY_SLOW(delay);
+  Delayus(delay * 1000U);
 }
 
 
@@ -200,9 +573,8 @@ static uint32_t DAP_Delay(const uint8_t *request, uint8_t *response) {
 
   delay  = (uint32_t)(*(request+0)) |
            (uint32_t)(*(request+1) << 8);
-  delay *= ((CPU_CLOCK/1000000U) + (DELAY_SLOW_CYCLES-1U)) / DELAY_SLOW_CYCLES;
 
-  PIN_DELAY_SLOW(delay);
+  Delayus(delay);
 
   *response = DAP_OK;
   return ((2U << 16) | 1U);
@@ -247,11 +619,18 @@ static uint32_t DAP_Connect(const uint8_t *request, uint8_t *response) {
     port = *request;
   }
 
+#if (DAP_SWD != 0)
+  // The host takes the port over from probe side polls
+  Target_Release();
+#endif
+
   switch (port) {
 #if (DAP_SWD != 0)
     case DAP_PORT_SWD:
       DAP_Data.debug_port = DAP_PORT_SWD;
       PORT_SWD_SETUP();
+      SWD_LinkReset();
+      DAP_TuneConnect();
       break;
 #endif
 #if (DAP_JTAG != 0)
@@ -277,6 +656,9 @@ static uint32_t DAP_Disconnect(uint8_t *response) {
 
   DAP_Data.debug_port = DAP_PORT_DISABLED;
   PORT_OFF();
+#if (DAP_SWD != 0)
+  DAP_TuneDisconnect();
+#endif
 
   *response = DAP_OK;
   return (1U);
@@ -338,19 +720,10 @@ static uint32_t DAP_SWJ_Pins(const uint8_t *request, uint8_t *response) {
   }
 
   if (wait != 0U) {
-#if (TIMESTAMP_CLOCK != 0U)
     if (wait > 3000000U) {
       wait = 3000000U;
     }
-#if (TIMESTAMP_CLOCK >= 1000000U)
-    wait *= TIMESTAMP_CLOCK / 1000000U;
-#else
-    wait /= 1000000U / TIMESTAMP_CLOCK;
-#endif
-#else
-    wait  = 1U;
-#endif
-    timestamp = TIMESTAMP_GET();
+    timestamp = DELAY_TIMER_GET();
     do {
       if ((select & (1U << DAP_SWJ_SWCLK_TCK)) != 0U) {
         if ((value >> DAP_SWJ_SWCLK_TCK) ^ PIN_SWCLK_TCK_IN()) {
@@ -378,7 +751,7 @@ static uint32_t DAP_SWJ_Pins(const uint8_t *request, uint8_t *response) {
         }
       }
       break;
-    } while ((TIMESTAMP_GET() - timestamp) < wait);
+    } while (DELAY_TIMER_ELAPSED(timestamp) < wait);
   }
 
   value = (PIN_SWCLK_TCK_IN() << DAP_SWJ_SWCLK_TCK) |
@@ -416,7 +789,13 @@ static uint32_t DAP_SWJ_Clock(const uint8_t *request, uint8_t *response) {
     return ((4U << 16) | 1U);
   }
 
+#if (DAP_SWD != 0)
+  clock = DAP_TuneClock(clock);
+#endif
   Set_Clock_Delay(clock);
+#if (DAP_SWD != 0)
+  SWD_LinkClock(clock);
+#endif
 
   *response = DAP_OK;
 #else
@@ -427,6 +806,18 @@ static uint32_t DAP_SWJ_Clock(const uint8_t *request, uint8_t *response) {
 }
 
 
+// Set SWJ clock as requested with the SWJ Clock command
+//   clock:    requested SWJ frequency in Hertz
+void DAP_SWJ_SetClock(uint32_t clock) {
+#if ((DAP_SWD != 0) || (DAP_JTAG != 0))
+  Set_Clock_Delay(clock);
+#if (DAP_SWD != 0)
+  SWD_LinkClock(clock);
+#endif
+#endif
+}
+
+
 // Process SWJ Sequence command and prepare response
 //   request:  pointer to request data
 //   response: pointer to response data
@@ -465,6 +856,7 @@ static uint32_t DAP_SWD_Configure(const uint8_t *request, uint8_t *response) {
   value = *request;
   DAP_Data.swd_conf.turnaround = (value & 0x03U) + 1U;
   DAP_Data.swd_conf.data_phase = (value & 0x04U) ? 1U : 0U;
+  DAP_TuneTransfer();
 
   *response = DAP_OK;
 #else
@@ -665,19 +1057,447 @@ static uint32_t DAP_TransferConfigure(const uint8_t *request, uint8_t *response)
                                   (uint16_t)(*(request+2) << 8);
   DAP_Data.transfer.match_retry = (uint16_t) *(request+3) |
                                   (uint16_t)(*(request+4) << 8);
+#if (DAP_SWD != 0)
+  DAP_TuneTransfer();
+#endif
 
   *response = DAP_OK;
   return ((5U << 16) | 1U);
 }
 
 
+#if (DAP_SWD != 0)
+
+// SWD Transfer operations decoded from a Transfer request, the transfer
+// request byte itself is read again from the request while executing
+//   bits [2:0]: operation
+//   bit     3:  read posted AP data from RDBUFF before the operation
+//   bit     4:  AP read is posted after the operation
+//   bit     5:  last write needs to be checked after the operation
+#define TRANSFER_OP_READ_DP             0U              // Read DP register
+#define TRANSFER_OP_READ_AP             1U              // Post AP read
+#define TRANSFER_OP_READ_NEXT           2U              // Read posted AP data and post next AP read
+#define TRANSFER_OP_READ_MATCH          3U              // Read register until value matches
+#define TRANSFER_OP_WRITE               4U              // Write DP/AP register
+#define TRANSFER_OP_MATCH_MASK          5U              // Write match mask
+#define TRANSFER_OP                     7U
+#define TRANSFER_OP_FLUSH               (1U << 3)
+#define TRANSFER_OP_POSTED              (1U << 4)
+#define TRANSFER_OP_CHECK               (1U << 5)
+
+static uint8_t TransferOps[255];
+
+
+// WAIT statistics and learned idle cycles per AP
+#define TRANSFER_WAIT_AP_CNT            4U      // Number of APs tracked
+
+typedef struct {
+  uint32_t  transfers;                          // Number of AP transfers
+  uint32_t  waits;                              // Number of WAIT responses
+  uint16_t  timeouts;                           // Transfers that ran out of retries
+  uint16_t  idle;                               // Learned idle cycles before access
+  uint8_t   apsel;                              // AP number
+  uint8_t   valid;                              // Entry in use
+  uint8_t   padding[2];
+} TransferWait_t;
+
+static struct {
+  TransferWait_t  ap[TRANSFER_WAIT_AP_CNT];     // Tracked APs
+  TransferWait_t *current;                      // AP selected by DP SELECT
+  uint32_t        select;                       // Value written to DP SELECT
+  uint8_t         apsel;                        // APSEL written to DP SELECT
+  uint8_t         next;                         // Next entry to replace
+} TransferWait;
+
+
+// Host DHCSR reads through MEM-AP 0
+//   A DHCSR read clears S_RESET_ST and S_RETIRE_ST. Probe side reads keep
+//   the bits here and the next DHCSR read of the host returns them, read
+//   through TAR and DRW or through the banked data registers over SWD.
+static struct {
+  uint32_t csw;                                 // CSW written by the host
+  uint32_t tar;                                 // TAR written by the host
+  uint32_t sticky;                              // Bits not yet seen by the host
+  uint32_t posted;                              // Posted AP read is a DHCSR read
+} TransferDhcsr;
+
+
+// Select WAIT statistics entry of the current AP
+//   return: pointer to entry
+DAP_RAMFUNC static TransferWait_t *SWD_TransferWaitAP(void) {
+  TransferWait_t *ap;
+  uint32_t n;
+
+  for (n = 0U; n < TRANSFER_WAIT_AP_CNT; n++) {
+    ap = &TransferWait.ap[n];
+    if ((ap->valid != 0U) && (ap->apsel == TransferWait.apsel)) {
+      return (ap);
+    }
+  }
+
+  ap = &TransferWait.ap[TransferWait.next];
+  TransferWait.next = (uint8_t)((TransferWait.next + 1U) % TRANSFER_WAIT_AP_CNT);
+  ap->transfers = 0U;
+  ap->waits     = 0U;
+  ap->timeouts  = 0U;
+  ap->idle      = 0U;
+  ap->apsel     = TransferWait.apsel;
+  ap->valid     = 1U;
+
+  return (ap);
+}
+
+
+// Get the value the host wrote to DP SELECT last
+//   Probe side accesses between host commands select AP 0 and restore
+//   SELECT with this value afterwards.
+//   return: SELECT value
+uint32_t DAP_TransferSelect(void) {
+  return (TransferWait.select);
+}
+
+
+// Keep DHCSR sticky bits of a probe side read for the host
+//   dhcsr: DHCSR value read by the probe
+void DAP_TransferSticky(uint32_t dhcsr) {
+  TransferDhcsr.sticky |= dhcsr & (S_RESET_ST | S_RETIRE_ST);
+}
+
+
+// Follow the MEM-AP 0 address of a host transfer and hand the kept DHCSR
+// sticky bits to the read returning DHCSR
+//   request: A[3:2] RnW APnDP
+//   data:    DATA[31:0], NULL for a posted read whose data is discarded
+DAP_RAMFUNC static void SWD_TransferDhcsr(uint32_t request, uint32_t *data) {
+  uint32_t address;
+  uint32_t bank;
+  uint32_t reg;
+
+  reg = request & (DAP_TRANSFER_A2 | DAP_TRANSFER_A3);
+  if ((request & DAP_TRANSFER_APnDP) == 0U) {
+    if ((request & DAP_TRANSFER_RnW) == 0U) {
+      return;
+    }
+    if (reg != DP_RDBUFF) {
+      return;
+    }
+  } else if ((request & DAP_TRANSFER_RnW) == 0U) {
+    // AP write, follow CSW and TAR of AP 0 bank 0
+    TransferDhcsr.posted = 0U;
+    if ((TransferWait.select & 0xFF0000F0U) == 0U) {
+      if (reg == AP_CSW) {
+        TransferDhcsr.csw = *data;
+      } else if (reg == AP_TAR) {
+        TransferDhcsr.tar = *data;
+      } else if ((reg == AP_DRW) && ((TransferDhcsr.csw & 0x30U) != 0U)) {
+        TransferDhcsr.tar += 1U << (TransferDhcsr.csw & 0x03U);
+      }
+    }
+    return;
+  }
+
+  // Read returning the posted AP read
+  if ((TransferDhcsr.posted != 0U) && (data != NULL)) {
+    *data |= TransferDhcsr.sticky;
+    TransferDhcsr.sticky = 0U;
+  }
+  TransferDhcsr.posted = 0U;
+  if ((request & DAP_TRANSFER_APnDP) == 0U) {
+    return;
+  }
+
+  // AP read posting the next value
+  bank = TransferWait.select & 0xFF0000F0U;
+  if (bank == 0x10U) {
+    address = (TransferDhcsr.tar & ~0x0FU) | reg;
+  } else if ((bank == 0U) && (reg == AP_DRW)) {
+    address = TransferDhcsr.tar;
+    if ((TransferDhcsr.csw & 0x30U) != 0U) {
+      TransferDhcsr.tar += 1U << (TransferDhcsr.csw & 0x03U);
+    }
+  } else {
+    return;
+  }
+  TransferDhcsr.posted = (address == DBG_HCSR) ? 1U : 0U;
+}
+
+
+// SWD Transfer with retries on WAIT response
+//   WAIT statistics are kept per AP. With adaptive WAIT handling an AP
+//   access also starts with the idle cycles learned for that AP and each
+//   WAIT is followed by idle cycles doubling up to the configured maximum
+//   before the request is retried.
+//   request: A[3:2] RnW APnDP
+//   data:    DATA[31:0]
+//   return:  ACK[2:0]
+DAP_RAMFUNC static uint32_t SWD_TransferRetry(uint32_t request, uint32_t *data) {
+  TransferWait_t *ap;
+  uint32_t response_value;
+  uint32_t adaptive;
+  uint32_t retry;
+  uint32_t backoff;
+  uint32_t idle;
+  uint32_t waits;
+
+  retry = DAP_Data.transfer.retry_count;
+  waits = 0U;
+  idle  = 0U;
+  ap    = NULL;
+  adaptive = 0U;
+
+  if ((request & DAP_TRANSFER_APnDP) != 0U) {
+    ap = TransferWait.current;
+    if (ap == NULL) {
+      ap = SWD_TransferWaitAP();
+      TransferWait.current = ap;
+    }
+    ap->transfers++;
+    adaptive = DAP_Data.wait.adaptive;
+    if (adaptive != 0U) {
+      idle = ap->idle;
+      if (idle != 0U) {
+        SWD_Idle(idle);
+      }
+    }
+  }
+
+  backoff = 1U;
+  for (;;) {
+    response_value = SWD_Transfer(request, data);
+    if (response_value != DAP_TRANSFER_WAIT) {
+      break;
+    }
+    waits++;
+    if ((retry-- == 0U) || DAP_TransferAbort) {
+      if (ap != NULL) {
+        ap->timeouts++;
+      }
+      break;
+    }
+    if (adaptive != 0U) {
+      SWD_Idle(backoff);
+      idle += backoff;
+      if (backoff < DAP_Data.wait.backoff_max) {
+        backoff <<= 1;
+      }
+    }
+  }
+
+  if (ap != NULL) {
+    ap->waits += waits;
+  }
+  if (adaptive != 0U) {
+    // Learn idle cycles: move towards the cycles needed, decay when not waiting
+    if (idle > DAP_Data.wait.backoff_max) {
+      idle = DAP_Data.wait.backoff_max;
+    }
+    if (waits == 0U) {
+      ap->idle = (uint16_t)((ap->idle * 7U) / 8U);
+    } else {
+      ap->idle = (uint16_t)(((ap->idle * 3U) + idle) / 4U);
+    }
+  }
+
+  if (response_value == DAP_TRANSFER_OK) {
+    if ((request & (DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | DAP_TRANSFER_A2 | DAP_TRANSFER_A3)) == DP_SELECT) {
+      // Track selected AP
+      TransferWait.select  = *data;
+      TransferWait.apsel   = (uint8_t)(*data >> 24);
+      TransferWait.current = NULL;
+    }
+    SWD_TransferDhcsr(request, data);
+  }
+  SWD_LinkUpdate(response_value, waits);
+  return (response_value);
+}
+
+
+// Process WAIT Configure command and prepare response
+//   request:  pointer to request data
+//   response: pointer to response data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t DAP_WaitConfigure(const uint8_t *request, uint8_t *response) {
+
+  DAP_Data.wait.adaptive    = (*(request+0) != 0U) ? 1U : 0U;
+  DAP_Data.wait.backoff_max = (uint16_t) *(request+1) |
+                              (uint16_t)(*(request+2) << 8);
+  if (DAP_Data.wait.backoff_max == 0U) {
+    DAP_Data.wait.backoff_max = 1U;
+  }
+
+  *response = DAP_OK;
+  return ((3U << 16) | 1U);
+}
+
+
+// Process WAIT Statistics command and prepare response
+//   Reports per tracked AP: APSEL, learned idle cycles, number of transfers,
+//   WAIT responses and transfers that ran out of retries.
+//   request:  pointer to request data (bit 0: clear statistics)
+//   response: pointer to response data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t DAP_WaitStatistics(const uint8_t *request, uint8_t *response) {
+  TransferWait_t *ap;
+  uint32_t num;
+  uint32_t n;
+
+  *response++ = TRANSFER_WAIT_AP_CNT;
+  num = 1U;
+
+  for (n = 0U; n < TRANSFER_WAIT_AP_CNT; n++) {
+    ap = &TransferWait.ap[n];
+    *response++ = ap->valid;
+    *response++ = ap->apsel;
+    *response++ = (uint8_t)(ap->idle      >>  0);
+    *response++ = (uint8_t)(ap->idle      >>  8);
+    *response++ = (uint8_t)(ap->transfers >>  0);
+    *response++ = (uint8_t)(ap->transfers >>  8);
+    *response++ = (uint8_t)(ap->transfers >> 16);
+    *response++ = (uint8_t)(ap->transfers >> 24);
+    *response++ = (uint8_t)(ap->waits     >>  0);
+    *response++ = (uint8_t)(ap->waits     >>  8);
+    *response++ = (uint8_t)(ap->waits     >> 16);
+    *response++ = (uint8_t)(ap->waits     >> 24);
+    *response++ = (uint8_t)(ap->timeouts  >>  0);
+    *response++ = (uint8_t)(ap->timeouts  >>  8);
+    num += 14U;
+    if ((*request & 0x01U) != 0U) {
+      // Clear statistics, keep learned idle cycles
+      ap->transfers = 0U;
+      ap->waits     = 0U;
+      ap->timeouts  = 0U;
+    }
+  }
+
+  return ((1U << 16) | num);
+}
+
+
+// Decode SWD Transfer requests into TransferOps
+//   Request and response sizes are checked against the space left in the
+//   packets, so that execution can neither read past the request nor overrun
+//   the response, also behind other commands of DAP_ExecuteCommand.
+//   request:      pointer to transfer requests (after DAP index and transfer count)
+//   count:        number of transfers
+//   request_max:  request bytes available for the transfers
+//   response_max: response bytes available for the transfer data
+//   return:       number of decoded transfers (lower 16 bits)
+//                 number of request bytes decoded (upper 16 bits)
+DAP_RAMFUNC static uint32_t DAP_SWD_TransferDecode(const uint8_t *request, uint32_t count,
+                                                   uint32_t request_max, uint32_t response_max) {
+  uint32_t request_count;
+  uint32_t request_last;
+  uint32_t request_value;
+  uint32_t response_count;
+  uint32_t post_read;
+  uint32_t check_write;
+  uint32_t op;
+  uint32_t n;
+
+  request_count  = 0U;
+  response_count = 0U;
+  post_read   = 0U;
+  check_write = 0U;
+
+  for (n = 0U; n < count; n++) {
+    if (request_count >= request_max) {
+      break;
+    }
+    request_last  = request_count;
+    request_value = *(request + request_count);
+    op = 0U;
+    if ((request_value & DAP_TRANSFER_RnW) != 0U) {
+      // Read register
+      if ((request_value & DAP_TRANSFER_MATCH_VALUE) != 0U) {
+        // Read with value match
+        if (post_read) {
+          op |= TRANSFER_OP_FLUSH;
+          response_count += 4U;
+          post_read = 0U;
+        }
+        op |= TRANSFER_OP_READ_MATCH;
+        request_count += 4U;
+      } else if ((request_value & DAP_TRANSFER_APnDP) != 0U) {
+        // Read AP register
+        if (post_read) {
+          op |= TRANSFER_OP_READ_NEXT;
+          response_count += 4U;
+        } else {
+          op |= TRANSFER_OP_READ_AP;
+          post_read = 1U;
+        }
+#if (TIMESTAMP_CLOCK != 0U)
+        if ((request_value & DAP_TRANSFER_TIMESTAMP) != 0U) {
+          response_count += 4U;
+        }
+#endif
+      } else {
+        // Read DP register
+        if (post_read) {
+          op |= TRANSFER_OP_FLUSH;
+          response_count += 4U;
+          post_read = 0U;
+        }
+        op |= TRANSFER_OP_READ_DP;
+        response_count += 4U;
+#if (TIMESTAMP_CLOCK != 0U)
+        if ((request_value & DAP_TRANSFER_TIMESTAMP) != 0U) {
+          response_count += 4U;
+        }
+#endif
+      }
+      check_write = 0U;
+    } else {
+      // Write register
+      if (post_read) {
+        op |= TRANSFER_OP_FLUSH;
+        response_count += 4U;
+        post_read = 0U;
+      }
+      if ((request_value & DAP_TRANSFER_MATCH_MASK) != 0U) {
+        op |= TRANSFER_OP_MATCH_MASK;
+      } else {
+        op |= TRANSFER_OP_WRITE;
+#if (TIMESTAMP_CLOCK != 0U)
+        if ((request_value & DAP_TRANSFER_TIMESTAMP) != 0U) {
+          response_count += 4U;
+        }
+#endif
+        check_write = 1U;
+      }
+      request_count += 4U;
+    }
+    request_count++;
+    if (post_read) {
+      op |= TRANSFER_OP_POSTED;
+    }
+    if (check_write) {
+      op |= TRANSFER_OP_CHECK;
+    }
+    // Posted read data is stored by a later operation or after the last one
+    if ((request_count > request_max) ||
+        ((response_count + (post_read ? 4U : 0U)) > response_max)) {
+      // The request length covers the transfers that fit
+      request_count = request_last;
+      break;
+    }
+    TransferOps[n] = (uint8_t)op;
+  }
+
+  return ((request_count << 16) | n);
+}
+
+
 // Process SWD Transfer command and prepare response
+//   The request is decoded and validated first, then executed by a loop over
+//   the decoded operations.
 //   request:  pointer to request data
 //   response: pointer to response data
 //   return:   number of bytes in response (lower 16 bits)
 //             number of bytes in request (upper 16 bits)
-#if (DAP_SWD != 0)
-static uint32_t DAP_SWD_Transfer(const uint8_t *request, uint8_t *response) {
+DAP_RAMFUNC static uint32_t DAP_SWD_Transfer(const uint8_t *request, uint8_t *response) {
   const
   uint8_t  *request_head;
   uint32_t  request_count;
@@ -685,12 +1505,12 @@ static uint32_t DAP_SWD_Transfer(const uint8_t *request, uint8_t *response) {
   uint8_t  *response_head;
   uint32_t  response_count;
   uint32_t  response_value;
-  uint32_t  post_read;
-  uint32_t  check_write;
   uint32_t  match_value;
   uint32_t  match_retry;
-  uint32_t  retry;
   uint32_t  data;
+  uint32_t  num;
+  uint32_t  op;
+  uint32_t  n;
 #if (TIMESTAMP_CLOCK != 0U)
   uint32_t  timestamp;
 #endif
@@ -704,78 +1524,114 @@ static uint32_t DAP_SWD_Transfer(const uint8_t *request, uint8_t *response) {
 
   DAP_TransferAbort = 0U;
 
-  post_read   = 0U;
-  check_write = 0U;
-
   request++;            // Ignore DAP index
 
   request_count = *request++;
 
-  while (request_count != 0) {
-    request_count--;
+  num = DAP_SWD_TransferDecode(request, request_count,
+                               DAP_RequestSpace(request), DAP_ResponseSpace(response));
+  if ((num & 0xFFFFU) != request_count) {
+    // Request does not fit into the packet
+    request += num >> 16;
+    response_value = DAP_TRANSFER_ERROR;
+    goto end;
+  }
+
+  op = 0U;
+  for (n = 0U; n < request_count; n++) {
+    op = TransferOps[n];
     request_value = *request++;
-    if ((request_value & DAP_TRANSFER_RnW) != 0U) {
-      // Read register
-      if (post_read) {
-        // Read was posted before
-        retry = DAP_Data.transfer.retry_count;
-        if ((request_value & (DAP_TRANSFER_APnDP | DAP_TRANSFER_MATCH_VALUE)) == DAP_TRANSFER_APnDP) {
-          // Read previous AP data and post next AP read
-          do {
-            response_value = SWD_Transfer(request_value, &data);
-          } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
-        } else {
-          // Read previous AP data
-          do {
-            response_value = SWD_Transfer(DP_RDBUFF | DAP_TRANSFER_RnW, &data);
-          } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
-          post_read = 0U;
-        }
+    if ((op & TRANSFER_OP_FLUSH) != 0U) {
+      // Read previous AP data
+      response_value = SWD_TransferRetry(DP_RDBUFF | DAP_TRANSFER_RnW, &data);
+      if (response_value != DAP_TRANSFER_OK) {
+        break;
+      }
+      // Store previous AP data
+      *response++ = (uint8_t) data;
+      *response++ = (uint8_t)(data >>  8);
+      *response++ = (uint8_t)(data >> 16);
+      *response++ = (uint8_t)(data >> 24);
+    }
+    switch (op & TRANSFER_OP) {
+      case TRANSFER_OP_READ_DP:
+        // Read DP register
+        response_value = SWD_TransferRetry(request_value, &data);
         if (response_value != DAP_TRANSFER_OK) {
           break;
         }
-        // Store previous AP data
+#if (TIMESTAMP_CLOCK != 0U)
+        // Store Timestamp
+        if ((request_value & DAP_TRANSFER_TIMESTAMP) != 0U) {
+          timestamp = DAP_Data.timestamp;
+          *response++ = (uint8_t) timestamp;
+          *response++ = (uint8_t)(timestamp >>  8);
+          *response++ = (uint8_t)(timestamp >> 16);
+          *response++ = (uint8_t)(timestamp >> 24);
+        }
+#endif
+        // Store data
         *response++ = (uint8_t) data;
         *response++ = (uint8_t)(data >>  8);
         *response++ = (uint8_t)(data >> 16);
         *response++ = (uint8_t)(data >> 24);
+        break;
+      case TRANSFER_OP_READ_AP:
+        // Post AP read
+        response_value = SWD_TransferRetry(request_value, NULL);
+        if (response_value != DAP_TRANSFER_OK) {
+          break;
+        }
 #if (TIMESTAMP_CLOCK != 0U)
-        if (post_read) {
-          // Store Timestamp of next AP read
-          if ((request_value & DAP_TRANSFER_TIMESTAMP) != 0U) {
-            timestamp = DAP_Data.timestamp;
-            *response++ = (uint8_t) timestamp;
-            *response++ = (uint8_t)(timestamp >>  8);
-            *response++ = (uint8_t)(timestamp >> 16);
-            *response++ = (uint8_t)(timestamp >> 24);
-          }
+        // Store Timestamp
+        if ((request_value & DAP_TRANSFER_TIMESTAMP) != 0U) {
+          timestamp = DAP_Data.timestamp;
+          *response++ = (uint8_t) timestamp;
+          *response++ = (uint8_t)(timestamp >>  8);
+          *response++ = (uint8_t)(timestamp >> 16);
+          *response++ = (uint8_t)(timestamp >> 24);
+        }
+#endif
+        break;
+      case TRANSFER_OP_READ_NEXT:
+        // Read previous AP data and post next AP read
+        response_value = SWD_TransferRetry(request_value, &data);
+        if (response_value != DAP_TRANSFER_OK) {
+          break;
+        }
+        // Store previous AP data
+        *response++ = (uint8_t) data;
+        *response++ = (uint8_t)(data >>  8);
+        *response++ = (uint8_t)(data >> 16);
+        *response++ = (uint8_t)(data >> 24);
+#if (TIMESTAMP_CLOCK != 0U)
+        // Store Timestamp of next AP read
+        if ((request_value & DAP_TRANSFER_TIMESTAMP) != 0U) {
+          timestamp = DAP_Data.timestamp;
+          *response++ = (uint8_t) timestamp;
+          *response++ = (uint8_t)(timestamp >>  8);
+          *response++ = (uint8_t)(timestamp >> 16);
+          *response++ = (uint8_t)(timestamp >> 24);
         }
 #endif
-      }
-      if ((request_value & DAP_TRANSFER_MATCH_VALUE) != 0U) {
+        break;
+      case TRANSFER_OP_READ_MATCH:
         // Read with value match
         match_value = (uint32_t)(*(request+0) <<  0) |
                       (uint32_t)(*(request+1) <<  8) |
                       (uint32_t)(*(request+2) << 16) |
                       (uint32_t)(*(request+3) << 24);
-        request += 4;
         match_retry = DAP_Data.transfer.match_retry;
         if ((request_value & DAP_TRANSFER_APnDP) != 0U) {
           // Post AP read
-          retry = DAP_Data.transfer.retry_count;
-          do {
-            response_value = SWD_Transfer(request_value, NULL);
-          } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
+          response_value = SWD_TransferRetry(request_value, NULL);
           if (response_value != DAP_TRANSFER_OK) {
             break;
           }
         }
         do {
           // Read register until its value matches or retry counter expires
-          retry = DAP_Data.transfer.retry_count;
-          do {
-            response_value = SWD_Transfer(request_value, &data);
-          } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
+          response_value = SWD_TransferRetry(request_value, &data);
           if (response_value != DAP_TRANSFER_OK) {
             break;
           }
@@ -783,94 +1639,14 @@ static uint32_t DAP_SWD_Transfer(const uint8_t *request, uint8_t *response) {
         if ((data & DAP_Data.transfer.match_mask) != match_value) {
           response_value |= DAP_TRANSFER_MISMATCH;
         }
-        if (response_value != DAP_TRANSFER_OK) {
-          break;
-        }
-      } else {
-        // Normal read
-        retry = DAP_Data.transfer.retry_count;
-        if ((request_value & DAP_TRANSFER_APnDP) != 0U) {
-          // Read AP register
-          if (post_read == 0U) {
-            // Post AP read
-            do {
-              response_value = SWD_Transfer(request_value, NULL);
-            } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
-            if (response_value != DAP_TRANSFER_OK) {
-              break;
-            }
-#if (TIMESTAMP_CLOCK != 0U)
-            // Store Timestamp
-            if ((request_value & DAP_TRANSFER_TIMESTAMP) != 0U) {
-              timestamp = DAP_Data.timestamp;
-              *response++ = (uint8_t) timestamp;
-              *response++ = (uint8_t)(timestamp >>  8);
-              *response++ = (uint8_t)(timestamp >> 16);
-              *response++ = (uint8_t)(timestamp >> 24);
-            }
-#endif
-            post_read = 1U;
-          }
-        } else {
-          // Read DP register
-          do {
-            response_value = SWD_Transfer(request_value, &data);
-          } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
-          if (response_value != DAP_TRANSFER_OK) {
-            break;
-          }
-#if (TIMESTAMP_CLOCK != 0U)
-          // Store Timestamp
-          if ((request_value & DAP_TRANSFER_TIMESTAMP) != 0U) {
-            timestamp = DAP_Data.timestamp;
-            *response++ = (uint8_t) timestamp;
-            *response++ = (uint8_t)(timestamp >>  8);
-            *response++ = (uint8_t)(timestamp >> 16);
-            *response++ = (uint8_t)(timestamp >> 24);
-          }
-#endif
-          // Store data
-          *response++ = (uint8_t) data;
-          *response++ = (uint8_t)(data >>  8);
-          *response++ = (uint8_t)(data >> 16);
-          *response++ = (uint8_t)(data >> 24);
-        }
-      }
-      check_write = 0U;
-    } else {
-      // Write register
-      if (post_read) {
-        // Read previous data
-        retry = DAP_Data.transfer.retry_count;
-        do {
-          response_value = SWD_Transfer(DP_RDBUFF | DAP_TRANSFER_RnW, &data);
-        } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
-        if (response_value != DAP_TRANSFER_OK) {
-          break;
-        }
-        // Store previous data
-        *response++ = (uint8_t) data;
-        *response++ = (uint8_t)(data >>  8);
-        *response++ = (uint8_t)(data >> 16);
-        *response++ = (uint8_t)(data >> 24);
-        post_read = 0U;
-      }
-      // Load data
-      data = (uint32_t)(*(request+0) <<  0) |
-             (uint32_t)(*(request+1) <<  8) |
-             (uint32_t)(*(request+2) << 16) |
-             (uint32_t)(*(request+3) << 24);
-      request += 4;
-      if ((request_value & DAP_TRANSFER_MATCH_MASK) != 0U) {
-        // Write match mask
-        DAP_Data.transfer.match_mask = data;
-        response_value = DAP_TRANSFER_OK;
-      } else {
+        break;
+      case TRANSFER_OP_WRITE:
         // Write DP/AP register
-        retry = DAP_Data.transfer.retry_count;
-        do {
-          response_value = SWD_Transfer(request_value, &data);
-        } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
+        data = (uint32_t)(*(request+0) <<  0) |
+               (uint32_t)(*(request+1) <<  8) |
+               (uint32_t)(*(request+2) << 16) |
+               (uint32_t)(*(request+3) << 24);
+        response_value = SWD_TransferRetry(request_value, &data);
         if (response_value != DAP_TRANSFER_OK) {
           break;
         }
@@ -884,8 +1660,23 @@ static uint32_t DAP_SWD_Transfer(const uint8_t *request, uint8_t *response) {
           *response++ = (uint8_t)(timestamp >> 24);
         }
 #endif
-        check_write = 1U;
-      }
+        break;
+      case TRANSFER_OP_MATCH_MASK:
+        // Write match mask
+        DAP_Data.transfer.match_mask = (uint32_t)(*(request+0) <<  0) |
+                                       (uint32_t)(*(request+1) <<  8) |
+                                       (uint32_t)(*(request+2) << 16) |
+                                       (uint32_t)(*(request+3) << 24);
+        response_value = DAP_TRANSFER_OK;
+        break;
+      default:
+        break;
+    }
+    if (response_value != DAP_TRANSFER_OK) {
+      break;
+    }
+    if ((request_value & (DAP_TRANSFER_RnW | DAP_TRANSFER_MATCH_VALUE)) != DAP_TRANSFER_RnW) {
+      request += 4;     // Write data or match value
     }
     response_count++;
     if (DAP_TransferAbort) {
@@ -893,46 +1684,26 @@ static uint32_t DAP_SWD_Transfer(const uint8_t *request, uint8_t *response) {
     }
   }
 
-  while (request_count != 0) {
-    // Process canceled requests
-    request_count--;
-    request_value = *request++;
-    if ((request_value & DAP_TRANSFER_RnW) != 0U) {
-      // Read register
-      if ((request_value & DAP_TRANSFER_MATCH_VALUE) != 0U) {
-        // Read with value match
-        request += 4;
-      }
-    } else {
-      // Write register
-      request += 4;
-    }
-  }
-
   if (response_value == DAP_TRANSFER_OK) {
-    if (post_read) {
+    if ((op & TRANSFER_OP_POSTED) != 0U) {
       // Read previous data
-      retry = DAP_Data.transfer.retry_count;
-      do {
-        response_value = SWD_Transfer(DP_RDBUFF | DAP_TRANSFER_RnW, &data);
-      } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
-      if (response_value != DAP_TRANSFER_OK) {
-        goto end;
+      response_value = SWD_TransferRetry(DP_RDBUFF | DAP_TRANSFER_RnW, &data);
+      if (response_value == DAP_TRANSFER_OK) {
+        // Store previous data
+        *response++ = (uint8_t) data;
+        *response++ = (uint8_t)(data >>  8);
+        *response++ = (uint8_t)(data >> 16);
+        *response++ = (uint8_t)(data >> 24);
       }
-      // Store previous data
-      *response++ = (uint8_t) data;
-      *response++ = (uint8_t)(data >>  8);
-      *response++ = (uint8_t)(data >> 16);
-      *response++ = (uint8_t)(data >> 24);
-    } else if (check_write) {
+    } else if ((op & TRANSFER_OP_CHECK) != 0U) {
       // Check last write
-      retry = DAP_Data.transfer.retry_count;
-      do {
-        response_value = SWD_Transfer(DP_RDBUFF | DAP_TRANSFER_RnW, NULL);
-      } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
+      response_value = SWD_TransferRetry(DP_RDBUFF | DAP_TRANSFER_RnW, NULL);
     }
   }
 
+  // Skip canceled requests
+  request = request_head + 2U + (num >> 16);
+
 end:
   *(response_head+0) = (uint8_t)response_count;
   *(response_head+1) = (uint8_t)response_value;
@@ -1286,18 +2057,147 @@ static uint32_t DAP_Transfer(const uint8_t *request, uint8_t *response) {
 }
 
 
+#if (DAP_SWD != 0)
+
+// Transfer Block FAULT recovery actions
+#define TRANSFER_FAULT_ABORT            0U      // Abort the block
+#define TRANSFER_FAULT_RETRY            1U      // Continue at the faulting word
+#define TRANSFER_FAULT_SKIP             2U      // Continue after the faulting word
+
+// Transfer Block FAULT recovery state of the last block
+static struct {
+  uint32_t  tar;                                // TAR at start of block
+  uint32_t  inc;                                // TAR increment per transfer
+  uint32_t  ctrl_stat;                          // CTRL/STAT at first FAULT
+  uint16_t  count;                              // Number of FAULT responses
+  uint16_t  first;                              // Index of first faulting word
+  uint16_t  last;                               // Index of last faulting word
+  uint8_t   retry;                              // Retries of last faulting word
+  uint8_t   resume;                             // Block can be resumed by reloading TAR
+} TransferFault;
+
+
+// Clear the FAULT recovery state of the last block
+static void SWD_TransferFaultClear(void) {
+  TransferFault.ctrl_stat = 0U;
+  TransferFault.count  = 0U;
+  TransferFault.first  = 0U;
+  TransferFault.last   = 0U;
+  TransferFault.retry  = 0U;
+  TransferFault.resume = 0U;
+}
+
+
+// Prepare FAULT recovery for a Transfer Block
+//   Blocks accessing MEM-AP DRW can be resumed after a FAULT, CSW and TAR
+//   are read so that TAR can be reloaded for any word of the block.
+//   request: transfer request of the block
+//   return:  ACK[2:0]
+static uint32_t SWD_TransferFaultStart(uint32_t request) {
+  uint32_t response_value;
+  uint32_t csw;
+
+  SWD_TransferFaultClear();
+
+  if ((request & (DAP_TRANSFER_APnDP | DAP_TRANSFER_A2 | DAP_TRANSFER_A3)) !=
+      (DAP_TRANSFER_APnDP | AP_DRW)) {
+    return (DAP_TRANSFER_OK);
+  }
+
+  response_value = SWD_TransferRetry(DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | AP_CSW, NULL);
+  if (response_value != DAP_TRANSFER_OK) {
+    return (response_value);
+  }
+  response_value = SWD_TransferRetry(DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | AP_TAR, &csw);
+  if (response_value != DAP_TRANSFER_OK) {
+    return (response_value);
+  }
+  response_value = SWD_TransferRetry(DP_RDBUFF | DAP_TRANSFER_RnW, &TransferFault.tar);
+  if (response_value != DAP_TRANSFER_OK) {
+    return (response_value);
+  }
+
+  switch ((csw >> 4) & 0x03U) {
+    case 0U:                                    // Auto-increment off
+      TransferFault.inc = 0U;
+      break;
+    case 1U:                                    // Increment single by size
+      TransferFault.inc = 1U << (csw & 0x07U);
+      break;
+    default:                                    // Increment packed
+      TransferFault.inc = 4U;
+      break;
+  }
+  TransferFault.resume = 1U;
+
+  return (DAP_TRANSFER_OK);
+}
+
+
+// Handle FAULT response inside a Transfer Block
+//   The fault is recorded, sticky errors are cleared and TAR is reloaded so
+//   that the block continues at the faulting word or after it.
+//   index:  index of the faulting word
+//   return: TRANSFER_FAULT_ABORT, TRANSFER_FAULT_RETRY or TRANSFER_FAULT_SKIP
+static uint32_t SWD_TransferFault(uint32_t index) {
+  uint32_t response_value;
+  uint32_t action;
+  uint32_t data;
+
+  if (TransferFault.count == 0U) {
+    TransferFault.first = (uint16_t)index;
+    (void)SWD_TransferRetry(DP_CTRL_STAT | DAP_TRANSFER_RnW, &TransferFault.ctrl_stat);
+  } else if (index != TransferFault.last) {
+    TransferFault.retry = 0U;
+  }
+  TransferFault.last = (uint16_t)index;
+  if (TransferFault.count != 0xFFFFU) {
+    TransferFault.count++;
+  }
+
+  // Clear sticky errors
+  data = DP_ABORT_STKCMPCLR | DP_ABORT_STKERRCLR | DP_ABORT_WDERRCLR | DP_ABORT_ORUNERRCLR;
+  response_value = SWD_TransferRetry(DP_ABORT, &data);
+  if ((response_value != DAP_TRANSFER_OK) || (TransferFault.resume == 0U)) {
+    return (TRANSFER_FAULT_ABORT);
+  }
+
+  if (TransferFault.retry < DAP_Data.fault.retry) {
+    TransferFault.retry++;
+    action = TRANSFER_FAULT_RETRY;
+  } else if (DAP_Data.fault.mode == DAP_FAULT_RECOVERY_SKIP) {
+    action = TRANSFER_FAULT_SKIP;
+    index++;
+  } else {
+    return (TRANSFER_FAULT_ABORT);
+  }
+
+  // Reload TAR
+  data = TransferFault.tar + (TransferFault.inc * index);
+  response_value = SWD_TransferRetry(DAP_TRANSFER_APnDP | AP_TAR, &data);
+  if (response_value != DAP_TRANSFER_OK) {
+    return (TRANSFER_FAULT_ABORT);
+  }
+
+  return (action);
+}
+
+
 // Process SWD Transfer Block command and prepare response
+//   With FAULT recovery enabled a FAULT does not end the block immediately:
+//   the faulting word is retried and then skipped (read as 0) or the block
+//   is aborted, see DAP_TransferFaultStatus for details of the last block.
 //   request:  pointer to request data
 //   response: pointer to response data
 //   return:   number of bytes in response
-#if (DAP_SWD != 0)
-static uint32_t DAP_SWD_TransferBlock(const uint8_t *request, uint8_t *response) {
+DAP_RAMFUNC static uint32_t DAP_SWD_TransferBlock(const uint8_t *request, uint8_t *response) {
   uint32_t  request_count;
   uint32_t  request_value;
   uint32_t  response_count;
   uint32_t  response_value;
   uint8_t  *response_head;
-  uint32_t  retry;
+  uint32_t  posted;
+  uint32_t  index;
   uint32_t  data;
 
   response_count = 0U;
@@ -1317,30 +2217,49 @@ static uint32_t DAP_SWD_TransferBlock(const uint8_t *request, uint8_t *response)
   }
 
   request_value = *request++;
+
+  if (DAP_Data.fault.mode != DAP_FAULT_RECOVERY_OFF) {
+    response_value = SWD_TransferFaultStart(request_value);
+    if (response_value != DAP_TRANSFER_OK) {
+      goto end;
+    }
+  }
+
   if ((request_value & DAP_TRANSFER_RnW) != 0U) {
     // Read register block
-    if ((request_value & DAP_TRANSFER_APnDP) != 0U) {
-      // Post AP read
-      retry = DAP_Data.transfer.retry_count;
-      do {
-        response_value = SWD_Transfer(request_value, NULL);
-      } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
-      if (response_value != DAP_TRANSFER_OK) {
-        goto end;
+    posted = 0U;
+    while (response_count < request_count) {
+      response_value = DAP_TRANSFER_OK;
+      if (((request_value & DAP_TRANSFER_APnDP) != 0U) && (posted == 0U)) {
+        // Post AP read
+        response_value = SWD_TransferRetry(request_value, NULL);
+        posted = 1U;
       }
-    }
-    while (request_count--) {
-      // Read DP/AP register
-      if ((request_count == 0U) && ((request_value & DAP_TRANSFER_APnDP) != 0U)) {
-        // Last AP read
-        request_value = DP_RDBUFF | DAP_TRANSFER_RnW;
+      if (response_value == DAP_TRANSFER_OK) {
+        // Read DP/AP register
+        if ((response_count == (request_count - 1U)) && ((request_value & DAP_TRANSFER_APnDP) != 0U)) {
+          // Last AP read
+          response_value = SWD_TransferRetry(DP_RDBUFF | DAP_TRANSFER_RnW, &data);
+        } else {
+          response_value = SWD_TransferRetry(request_value, &data);
+        }
       }
-      retry = DAP_Data.transfer.retry_count;
-      do {
-        response_value = SWD_Transfer(request_value, &data);
-      } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
       if (response_value != DAP_TRANSFER_OK) {
-        goto end;
+        if ((response_value != DAP_TRANSFER_FAULT) || (DAP_Data.fault.mode == DAP_FAULT_RECOVERY_OFF)) {
+          goto end;
+        }
+        // Word at response_count has faulted
+        posted = 0U;
+        switch (SWD_TransferFault(response_count)) {
+          case TRANSFER_FAULT_RETRY:
+            continue;
+          case TRANSFER_FAULT_SKIP:
+            data = 0U;
+            response_value = DAP_TRANSFER_OK;
+            break;
+          default:
+            goto end;
+        }
       }
       // Store data
       *response++ = (uint8_t) data;
@@ -1351,28 +2270,42 @@ static uint32_t DAP_SWD_TransferBlock(const uint8_t *request, uint8_t *response)
     }
   } else {
     // Write register block
-    while (request_count--) {
-      // Load data
-      data = (uint32_t)(*(request+0) <<  0) |
-             (uint32_t)(*(request+1) <<  8) |
-             (uint32_t)(*(request+2) << 16) |
-             (uint32_t)(*(request+3) << 24);
-      request += 4;
-      // Write DP/AP register
-      retry = DAP_Data.transfer.retry_count;
-      do {
-        response_value = SWD_Transfer(request_value, &data);
-      } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
-      if (response_value != DAP_TRANSFER_OK) {
-        goto end;
+    for (;;) {
+      while (response_count < request_count) {
+        // Load data
+        data = (uint32_t)(*(request + (response_count * 4U) + 0U) <<  0) |
+               (uint32_t)(*(request + (response_count * 4U) + 1U) <<  8) |
+               (uint32_t)(*(request + (response_count * 4U) + 2U) << 16) |
+               (uint32_t)(*(request + (response_count * 4U) + 3U) << 24);
+        // Write DP/AP register
+        response_value = SWD_TransferRetry(request_value, &data);
+        if (response_value != DAP_TRANSFER_OK) {
+          break;
+        }
+        response_count++;
       }
-      response_count++;
+      if (response_value == DAP_TRANSFER_OK) {
+        // Check last write
+        response_value = SWD_TransferRetry(DP_RDBUFF | DAP_TRANSFER_RnW, NULL);
+      }
+      if ((response_value != DAP_TRANSFER_FAULT) || (DAP_Data.fault.mode == DAP_FAULT_RECOVERY_OFF)) {
+        break;
+      }
+      // Writes are buffered, the last accepted word has faulted
+      index = (response_count != 0U) ? (response_count - 1U) : 0U;
+      switch (SWD_TransferFault(index)) {
+        case TRANSFER_FAULT_RETRY:
+          response_count = index;
+          break;
+        case TRANSFER_FAULT_SKIP:
+          response_count = index + 1U;
+          break;
+        default:
+          response_count = index;
+          goto end;
+      }
+      response_value = DAP_TRANSFER_OK;
     }
-    // Check last write
-    retry = DAP_Data.transfer.retry_count;
-    do {
-      response_value = SWD_Transfer(DP_RDBUFF | DAP_TRANSFER_RnW, NULL);
-    } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
   }
 
 end:
@@ -1382,6 +2315,55 @@ end:
 
   return ((uint32_t)(response - response_head));
 }
+
+
+// Process Transfer Fault Configure command and prepare response
+//   Turning FAULT recovery off clears the status of the last block, blocks
+//   run without recovery do not report to DAP_TransferFaultStatus.
+//   request:  pointer to request data
+//   response: pointer to response data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t DAP_TransferFaultConfigure(const uint8_t *request, uint8_t *response) {
+  uint8_t mode;
+
+  mode = *(request+0);
+  if (mode <= DAP_FAULT_RECOVERY_SKIP) {
+    DAP_Data.fault.mode  = mode;
+    DAP_Data.fault.retry = *(request+1);
+    if (mode == DAP_FAULT_RECOVERY_OFF) {
+      SWD_TransferFaultClear();
+    }
+    *response = DAP_OK;
+  } else {
+    *response = DAP_ERROR;
+  }
+
+  return ((2U << 16) | 1U);
+}
+
+
+// Process Transfer Fault Status command and prepare response
+//   Reports the FAULT recovery of the last Transfer Block: number of FAULT
+//   responses, index of the first and last faulting word and CTRL/STAT
+//   read at the first FAULT.
+//   response: pointer to response data
+//   return:   number of bytes in response
+uint32_t DAP_TransferFaultStatus(uint8_t *response) {
+
+  *(response+0) = (uint8_t)(TransferFault.count >>  0);
+  *(response+1) = (uint8_t)(TransferFault.count >>  8);
+  *(response+2) = (uint8_t)(TransferFault.first >>  0);
+  *(response+3) = (uint8_t)(TransferFault.first >>  8);
+  *(response+4) = (uint8_t)(TransferFault.last  >>  0);
+  *(response+5) = (uint8_t)(TransferFault.last  >>  8);
+  *(response+6) = (uint8_t)(TransferFault.ctrl_stat >>  0);
+  *(response+7) = (uint8_t)(TransferFault.ctrl_stat >>  8);
+  *(response+8) = (uint8_t)(TransferFault.ctrl_stat >> 16);
+  *(response+9) = (uint8_t)(TransferFault.ctrl_stat >> 24);
+
+  return (10U);
+}
 #endif
 
 
@@ -1634,6 +2616,30 @@ __WEAK uint32_t DAP_ProcessVendorCommand(const uint8_t *request, uint8_t *respon
 }
 
 
+// Ends of the request and response packets of the command being processed
+static const uint8_t *RequestEnd;
+static const uint8_t *ResponseEnd;
+static uint8_t        Executing;    // Set while DAP_ExecuteCommand runs commands
+
+
+// Number of request bytes left in the packet
+//   Commands run by DAP_ExecuteCommand start inside the packet, so the
+//   packet size does not bound them.
+//   request:  pointer to request data
+//   return:   number of bytes from request to the end of the packet
+DAP_RAMFUNC uint32_t DAP_RequestSpace(const uint8_t *request) {
+  return ((request < RequestEnd) ? (uint32_t)(RequestEnd - request) : 0U);
+}
+
+
+// Number of response bytes left in the packet
+//   response: pointer to response data
+//   return:   number of bytes from response to the end of the packet
+DAP_RAMFUNC uint32_t DAP_ResponseSpace(const uint8_t *response) {
+  return ((response < ResponseEnd) ? (uint32_t)(ResponseEnd - response) : 0U);
+}
+
+
 // Process DAP command request and prepare response
 //   request:  pointer to request data
 //   response: pointer to response data
@@ -1642,6 +2648,11 @@ __WEAK uint32_t DAP_ProcessVendorCommand(const uint8_t *request, uint8_t *respon
 uint32_t DAP_ProcessCommand(const uint8_t *request, uint8_t *response) {
   uint32_t num;
 
+  if (Executing == 0U) {
+    RequestEnd  = request  + DAP_PACKET_SIZE;
+    ResponseEnd = response + DAP_PACKET_SIZE;
+  }
+
   if ((*request >= ID_DAP_Vendor0) && (*request <= ID_DAP_Vendor31)) {
     return DAP_ProcessVendorCommand(request, response);
   }
@@ -1766,24 +2777,36 @@ uint32_t DAP_ProcessCommand(const uint8_t *request, uint8_t *response) {
 
 
 // Execute DAP command (process request and prepare response)
+//   Commands stop early when less than EXECUTE_RESPONSE_MIN bytes are left
+//   in the response, the response reports the number of commands executed.
 //   request:  pointer to request data
 //   response: pointer to response data
 //   return:   number of bytes in response (lower 16 bits)
 //             number of bytes in request (upper 16 bits)
 uint32_t DAP_ExecuteCommand(const uint8_t *request, uint8_t *response) {
-  uint32_t cnt, num, n;
+  uint32_t cnt, num, n, done;
+  uint8_t *count;
 
   if (*request == ID_DAP_ExecuteCommands) {
+    RequestEnd  = request  + DAP_PACKET_SIZE;
+    ResponseEnd = response + DAP_PACKET_SIZE;
+    Executing   = 1U;
     *response++ = *request++;
     cnt = *request++;
+    count = response;
     *response++ = (uint8_t)cnt;
     num = (2U << 16) | 2U;
-    while (cnt--) {
+    for (done = 0U; done < cnt; done++) {
+      if ((DAP_ResponseSpace(response) < EXECUTE_RESPONSE_MIN) || (DAP_RequestSpace(request) == 0U)) {
+        break;
+      }
       n = DAP_ProcessCommand(request, response);
       num += n;
       request  += (uint16_t)(n >> 16);
       response += (uint16_t) n;
     }
+    *count = (uint8_t)done;
+    Executing = 0U;
     return (num);
   }
 
@@ -1793,6 +2816,7 @@ uint32_t DAP_ExecuteCommand(const uint8_t *request, uint8_t *response) {
 
 // Setup DAP
 void DAP_Setup(void) {
+  uint32_t clock;
 
   // Default settings
   DAP_Data.debug_port  = 0U;
@@ -1803,13 +2827,36 @@ void DAP_Setup(void) {
 #if (DAP_SWD != 0)
   DAP_Data.swd_conf.turnaround  = 1U;
   DAP_Data.swd_conf.data_phase  = 0U;
+  DAP_Data.fault.mode  = DAP_FAULT_RECOVERY_OFF;
+  DAP_Data.fault.retry = 0U;
+  DAP_Data.wait.adaptive    = DAP_WAIT_ADAPTIVE;
+  DAP_Data.wait.backoff_max = DAP_WAIT_BACKOFF_MAX;
+  DAP_Data.link.downshift = 0U;
+  DAP_Data.link.errors    = 4U;
+  DAP_Data.link.window    = 256U;
+  DAP_Data.link.clean     = 4096U;
+  DAP_Data.link.clock_min = 100000U;
 #endif
 #if (DAP_JTAG != 0)
   DAP_Data.jtag_dev.count = 0U;
 #endif
 
+#if (DAP_SWD != 0)
+  // Measures the SWCLK periods used by Set_Clock_Delay.
+  Calibrate_Clock();
+#endif
+
+  // Stored default clock overrides the compiled-in one.
+  if ((DAP_SETTING_LOAD(DAP_SETTING_SWJ_CLOCK, &clock, sizeof(clock)) != sizeof(clock)) ||
+      (clock == 0U)) {
+    clock = DAP_DEFAULT_SWJ_CLOCK;
+  }
+
   // Sets DAP_Data.fast_clock and DAP_Data.clock_delay.
-  Set_Clock_Delay(DAP_DEFAULT_SWJ_CLOCK);
+  Set_Clock_Delay(clock);
+#if (DAP_SWD != 0)
+  SWD_LinkClock(clock);
+#endif
 
   DAP_SETUP();  // Device specific setup
 }
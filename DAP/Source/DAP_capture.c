@@ -0,0 +1,247 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the License); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ----------------------------------------------------------------------
+ *
+ * Project:      CMSIS-DAP Source
+ * Title:        DAP_capture.c Command Capture
+ *
+ *---------------------------------------------------------------------------*/
+
+#include "DAP_config.h"
+#include "DAP.h"
+
+#if (DAP_CAPTURE_BUFFER_SIZE != 0U)
+
+// Capture Control modes
+#define CAPTURE_STOP            0U
+#define CAPTURE_START           1U      // Clears the buffer and the counters
+#define CAPTURE_STATUS          2U
+
+// Record: time in us since the start (4 bytes), processing time in us
+// (2 bytes), request length (2 bytes), response length (2 bytes), response
+// CRC-32 (4 bytes), request
+#define CAPTURE_HEADER_SIZE     14U
+#define CAPTURE_DURATION_MAX    0xFFFFU
+
+// Capture Read response header: status, dropped (2 bytes), bytes (2 bytes)
+#define CAPTURE_READ_HEADER     5U
+
+#define CAPTURE_COUNTER_MAX     0xFFFFU
+
+// Kept off the USB thread stack
+static struct {
+  uint32_t active;              // Capturing
+  uint32_t time;                // us since the start
+  uint32_t timer;               // Timer value of time
+  uint32_t head;                // Next byte written
+  uint32_t tail;                // Next byte read
+  uint32_t used;                // Bytes queued
+  uint32_t records;             // Records captured since the start
+  uint32_t dropped;             // Records lost to a full buffer
+  uint8_t  buffer[DAP_CAPTURE_BUFFER_SIZE];
+} Capture;
+
+
+// CRC-32 (IEEE 802.3) of a response
+static uint32_t Capture_Crc(const uint8_t *data, uint32_t length) {
+  uint32_t crc;
+  uint32_t n;
+
+  crc = 0xFFFFFFFFU;
+  while (length--) {
+    crc ^= *data++;
+    for (n = 0U; n < 8U; n++) {
+      crc = (crc & 1U) ? ((crc >> 1) ^ 0xEDB88320U) : (crc >> 1);
+    }
+  }
+
+  return (~crc);
+}
+
+
+// Append bytes to the ring buffer
+static void Capture_Put(const uint8_t *data, uint32_t count) {
+  while (count--) {
+    Capture.buffer[Capture.head] = *data++;
+    if (++Capture.head == DAP_CAPTURE_BUFFER_SIZE) {
+      Capture.head = 0U;
+    }
+  }
+}
+
+
+// Put a 16-bit value into data
+static void Capture_Put16(uint8_t *data, uint32_t value) {
+  *(data+0) = (uint8_t)(value >> 0);
+  *(data+1) = (uint8_t)(value >> 8);
+}
+
+
+// Put a 32-bit value into data
+static void Capture_Put32(uint8_t *data, uint32_t value) {
+  *(data+0) = (uint8_t)(value >>  0);
+  *(data+1) = (uint8_t)(value >>  8);
+  *(data+2) = (uint8_t)(value >> 16);
+  *(data+3) = (uint8_t)(value >> 24);
+}
+
+
+// Record a processed command
+//   Called by the transport after DAP_ProcessCommand. The capture commands
+//   themselves are not recorded, a record that does not fit into the buffer
+//   is dropped. Gaps between commands longer than the hardware timer range
+//   are shortened.
+//   request:  pointer to request data
+//   response: pointer to response data
+//   length:   return value of DAP_ProcessCommand
+//   start:    timer value before the command was processed
+void DAP_CaptureCommand(const uint8_t *request, const uint8_t *response, uint32_t length, uint32_t start) {
+  uint8_t  header[CAPTURE_HEADER_SIZE];
+  uint32_t duration;
+  uint32_t timer;
+
+  if ((Capture.active == 0U) ||
+      (*request == ID_DAP_CaptureControl) || (*request == ID_DAP_CaptureRead)) {
+    return;
+  }
+
+  timer    = hw_timer_now();
+  duration = (timer - start) & HW_TIMER_MASK;
+  Capture.time += (start - Capture.timer) & HW_TIMER_MASK;
+  Capture.timer = start;
+
+  if ((DAP_CAPTURE_BUFFER_SIZE - Capture.used) < (CAPTURE_HEADER_SIZE + (length >> 16))) {
+    if (Capture.dropped < CAPTURE_COUNTER_MAX) {
+      Capture.dropped++;
+    }
+    return;
+  }
+
+  Capture_Put32(header + 0, Capture.time);
+  Capture_Put16(header + 4, (duration < CAPTURE_DURATION_MAX) ? duration : CAPTURE_DURATION_MAX);
+  Capture_Put16(header + 6, length >> 16);
+  Capture_Put16(header + 8, length & 0xFFFFU);
+  Capture_Put32(header + 10, Capture_Crc(response, length & 0xFFFFU));
+  Capture_Put(header, CAPTURE_HEADER_SIZE);
+  Capture_Put(request, length >> 16);
+  Capture.used += CAPTURE_HEADER_SIZE + (length >> 16);
+  Capture.records++;
+}
+
+
+// Process Capture Control command and prepare response
+//   Starts or stops recording of the commands the probe processes. Starting
+//   discards queued records and clears the counters.
+//   request:  pointer to request data
+//             mode: 0 = stop, 1 = start, 2 = status only
+//   response: pointer to response data
+//             status, records since the start (2 bytes), bytes queued
+//             (2 bytes), buffer size (2 bytes), records dropped (2 bytes)
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t DAP_CaptureControl(const uint8_t *request, uint8_t *response) {
+
+  switch (*request) {
+    case CAPTURE_STOP:
+      Capture.active = 0U;
+      break;
+    case CAPTURE_START:
+      Capture.head    = 0U;
+      Capture.tail    = 0U;
+      Capture.used    = 0U;
+      Capture.records = 0U;
+      Capture.dropped = 0U;
+      Capture.time    = 0U;
+      Capture.timer   = hw_timer_now();
+      Capture.active  = 1U;
+      break;
+    case CAPTURE_STATUS:
+      break;
+    default:
+      *response = DAP_ERROR;
+      return ((1U << 16) | 1U);
+  }
+
+  *(response+0) = DAP_OK;
+  Capture_Put16(response + 1, (Capture.records < CAPTURE_COUNTER_MAX) ? Capture.records : CAPTURE_COUNTER_MAX);
+  Capture_Put16(response + 3, Capture.used);
+  Capture_Put16(response + 5, DAP_CAPTURE_BUFFER_SIZE);
+  Capture_Put16(response + 7, Capture.dropped);
+
+  return ((1U << 16) | 9U);
+}
+
+
+// Process Capture Read command and prepare response
+//   Drains the queued records as a byte stream, records may be split across
+//   responses. The dropped counter reports records lost since the last
+//   Capture Read and is cleared. Records queued before the capture stopped
+//   can still be drained.
+//   response: pointer to response data
+//             status (DAP_ERROR when stopped), dropped (2 bytes), number
+//             of bytes (2 bytes), bytes
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t DAP_CaptureRead(uint8_t *response) {
+  uint32_t count;
+  uint32_t n;
+
+  *(response+0) = (Capture.active != 0U) ? DAP_OK : DAP_ERROR;
+  Capture_Put16(response + 1, Capture.dropped);
+  Capture.dropped = 0U;
+
+  count = DAP_ResponseSpace(response) - CAPTURE_READ_HEADER;
+  if (count > Capture.used) {
+    count = Capture.used;
+  }
+  for (n = 0U; n < count; n++) {
+    *(response + CAPTURE_READ_HEADER + n) = Capture.buffer[Capture.tail];
+    if (++Capture.tail == DAP_CAPTURE_BUFFER_SIZE) {
+      Capture.tail = 0U;
+    }
+  }
+  Capture.used -= count;
+  Capture_Put16(response + 3, count);
+
+  return (CAPTURE_READ_HEADER + count);
+}
+
+#else
+
+// Capture compiled out: nothing is recorded
+void DAP_CaptureCommand(const uint8_t *request, const uint8_t *response, uint32_t length, uint32_t start) {
+  (void)request;
+  (void)response;
+  (void)length;
+  (void)start;
+}
+
+
+// Process Capture Control command: not supported without a buffer
+uint32_t DAP_CaptureControl(const uint8_t *request, uint8_t *response) {
+  (void)request;
+  *response = DAP_ERROR;
+  return ((1U << 16) | 1U);
+}
+
+
+// Process Capture Read command: not supported without a buffer
+uint32_t DAP_CaptureRead(uint8_t *response) {
+  *response = DAP_ERROR;
+  return (1U);
+}
+
+#endif
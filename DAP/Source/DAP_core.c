@@ -0,0 +1,198 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the License); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ----------------------------------------------------------------------
+ *
+ * Project:      CMSIS-DAP Source
+ * Title:        DAP_core.c Core Register Sets and Single Step
+ *
+ *---------------------------------------------------------------------------*/
+
+#include "DAP_config.h"
+#include "DAP.h"
+
+#if (DAP_SWD != 0)
+
+// Registers of a Core Step snapshot, in response order
+#define CORE_REG_SP             13U
+#define CORE_REG_PC             15U     // DebugReturnAddress
+#define CORE_REG_XPSR           16U
+#define CORE_STEP_SNAPSHOT      ((1U << CORE_REG_SP) | (1U << CORE_REG_PC) | (1U << CORE_REG_XPSR))
+
+// Core Step flags
+#define CORE_STEP_MASKINTS      (1U<<0) // Step with interrupts masked
+
+// Kept off the USB thread stack
+static uint32_t values[32];
+
+
+// Get a word from request data
+static uint32_t Core_GetWord(const uint8_t *data) {
+  return ((uint32_t)(*(data+0) <<  0) |
+          (uint32_t)(*(data+1) <<  8) |
+          (uint32_t)(*(data+2) << 16) |
+          (uint32_t)(*(data+3) << 24));
+}
+
+
+// Put words into response data
+static void Core_PutWords(uint8_t *data, const uint32_t *words, uint32_t count) {
+  uint32_t n;
+
+  for (n = 0U; n < count; n++) {
+    *(data+0) = (uint8_t)(words[n] >>  0);
+    *(data+1) = (uint8_t)(words[n] >>  8);
+    *(data+2) = (uint8_t)(words[n] >> 16);
+    *(data+3) = (uint8_t)(words[n] >> 24);
+    data += 4;
+  }
+}
+
+
+// Number of registers selected by a mask
+static uint32_t Core_Count(uint32_t mask) {
+  uint32_t count;
+
+  for (count = 0U; mask != 0U; count++) {
+    mask &= mask - 1U;
+  }
+  return (count);
+}
+
+
+// Process Core Read command and prepare response
+//   Reads the selected core registers of the halted core, the probe polls
+//   S_REGRDY. SELECT, CSW and TAR are left as the host set them up.
+//   request:  pointer to request data
+//             register mask (4 bytes), bit n selects DCRSR selector n
+//   response: pointer to response data
+//             status, register values in selector order
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t DAP_CoreRead(const uint8_t *request, uint8_t *response) {
+  uint32_t mask;
+  uint32_t count;
+
+  mask  = Core_GetWord(request);
+  count = Core_Count(mask);
+
+  if ((count == 0U) || ((1U + (4U * count)) > DAP_ResponseSpace(response)) ||
+      (DAP_Data.debug_port != DAP_PORT_SWD) ||
+      (Target_ReadCoreSet(mask, values) != DAP_TRANSFER_OK)) {
+    *response = DAP_ERROR;
+    return ((4U << 16) | 1U);
+  }
+
+  *response = DAP_OK;
+  Core_PutWords(response + 1, values, count);
+
+  return ((4U << 16) | (1U + (4U * count)));
+}
+
+
+// Process Core Write command and prepare response
+//   Writes the selected core registers of the halted core, lowest selector
+//   first. SELECT, CSW and TAR are left as for Core Read.
+//   request:  pointer to request data
+//             register mask (4 bytes), register values in selector order
+//   response: pointer to response data
+//             status
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t DAP_CoreWrite(const uint8_t *request, uint8_t *response) {
+  uint32_t mask;
+  uint32_t count;
+  uint32_t n;
+
+  mask  = Core_GetWord(request);
+  count = Core_Count(mask);
+
+  *response = DAP_OK;
+  if ((count == 0U) || ((4U + (4U * count)) > DAP_RequestSpace(request)) ||
+      (DAP_Data.debug_port != DAP_PORT_SWD)) {
+    *response = DAP_ERROR;
+    return ((4U << 16) | 1U);
+  }
+
+  for (n = 0U; n < count; n++) {
+    values[n] = Core_GetWord(request + 4U + (4U * n));
+  }
+  if (Target_WriteCoreSet(mask, values) != DAP_TRANSFER_OK) {
+    *response = DAP_ERROR;
+  }
+
+  return (((4U + (4U * count)) << 16) | 1U);
+}
+
+
+// Process Core Step command and prepare response
+//   Executes one instruction of the halted core and returns the state after
+//   it, so that a debugger steps with one round trip. SELECT, CSW and TAR
+//   are left as for Core Read.
+//   request:  pointer to request data
+//             flags (bit 0: step with interrupts masked),
+//             register mask (4 bytes) of further registers
+//   response: pointer to response data
+//             status, DHCSR (4 bytes), PC, xPSR, SP (4 bytes each),
+//             registers of the mask in selector order
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t DAP_CoreStep(const uint8_t *request, uint8_t *response) {
+  uint32_t snapshot[4];
+  uint32_t mask;
+  uint32_t count;
+  uint32_t reg;
+  uint32_t n;
+  uint32_t k;
+
+  mask  = Core_GetWord(request + 1);
+  count = Core_Count(mask);
+
+  *response = DAP_ERROR;
+  if (((1U + (4U * (4U + count))) > DAP_ResponseSpace(response)) ||
+      (DAP_Data.debug_port != DAP_PORT_SWD) ||
+      (Target_Step(*request & CORE_STEP_MASKINTS, &snapshot[0]) != DAP_TRANSFER_OK) ||
+      (Target_ReadCoreSet(mask | CORE_STEP_SNAPSHOT, values) != DAP_TRANSFER_OK)) {
+    return ((5U << 16) | 1U);
+  }
+
+  // Pick PC, xPSR and SP out, keep the registers of the mask in place
+  k = 0U;
+  n = 0U;
+  for (reg = 0U; reg < 32U; reg++) {
+    if (((mask | CORE_STEP_SNAPSHOT) & (1U << reg)) == 0U) {
+      continue;
+    }
+    if (reg == CORE_REG_PC) {
+      snapshot[1] = values[n];
+    } else if (reg == CORE_REG_XPSR) {
+      snapshot[2] = values[n];
+    } else if (reg == CORE_REG_SP) {
+      snapshot[3] = values[n];
+    }
+    if ((mask & (1U << reg)) != 0U) {
+      values[k++] = values[n];
+    }
+    n++;
+  }
+
+  *response = DAP_OK;
+  Core_PutWords(response + 1, snapshot, 4U);
+  Core_PutWords(response + 17, values, count);
+
+  return ((5U << 16) | (1U + (4U * (4U + count))));
+}
+
+#endif
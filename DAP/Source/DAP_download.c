@@ -0,0 +1,338 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the License); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ----------------------------------------------------------------------
+ *
+ * Project:      CMSIS-DAP Source
+ * Title:        DAP_download.c Compressed Download
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <string.h>
+#include "DAP_config.h"
+#include "DAP.h"
+
+#if (DAP_SWD != 0)
+
+// Download modes
+#define DOWNLOAD_MEMORY         0U      // Write target memory
+#define DOWNLOAD_FLASH          1U      // Erase and program target flash pages
+#define DOWNLOAD_DISCARD        2U      // Decode only, for decoder benchmarks
+#define DOWNLOAD_RAW            0x80U   // Data is not compressed
+
+// Output is written to the target in blocks of one flash page
+#define DOWNLOAD_BLOCK          TARGET_FLASH_PAGE_SIZE
+
+#define DOWNLOAD_WINDOW_SIZE    (1U << DAP_DOWNLOAD_WINDOW)
+#define DOWNLOAD_COUNT_MAX      8U      // Largest lookahead in bits
+
+// Decoder
+//   The data is a heatshrink stream: a 1 tag bit is followed by an 8 bit
+//   literal, a 0 tag bit by a back reference of window_bits (offset - 1)
+//   and count_bits (count - 1), all MSB first.
+static struct {
+  uint8_t  active;
+  uint8_t  mode;
+  uint8_t  window_bits;
+  uint8_t  count_bits;
+  uint8_t  error;
+  uint32_t address;             // Target address of the output block
+  uint32_t fill;                // Bytes in the output block
+  uint32_t total;               // Bytes decoded
+  uint32_t bits;                // Input bits not yet decoded, right aligned
+  uint32_t bit_count;
+  uint32_t head;                // Window write position
+  uint32_t decode_time;         // us spent decoding
+  uint32_t write_time;          // us spent writing the target
+  union {
+    uint32_t word[DOWNLOAD_BLOCK / 4U];
+    uint8_t  byte[DOWNLOAD_BLOCK];
+  } block;
+  uint8_t  window[DOWNLOAD_WINDOW_SIZE];
+} Download;
+
+
+// Write the output block to the target
+//   Trailing bytes of a partial word keep the target memory contents, flash
+//   blocks are padded with erased bytes.
+static void Download_Flush(void) {
+  uint32_t words;
+  uint32_t data;
+  uint32_t mask;
+  uint32_t time;
+
+  if (Download.fill == 0U) {
+    return;
+  }
+  time  = hw_timer_now();
+  words = (Download.fill + 3U) / 4U;
+
+  if (Download.error == 0U) {
+    switch (Download.mode & ~DOWNLOAD_RAW) {
+      case DOWNLOAD_MEMORY:
+        if (Download.fill & 3U) {
+          if (Target_Read32(Download.address + ((words - 1U) * 4U), &data) != DAP_TRANSFER_OK) {
+            Download.error = 1U;
+            break;
+          }
+          mask = (1U << ((Download.fill & 3U) * 8U)) - 1U;
+          Download.block.word[words - 1U] = (Download.block.word[words - 1U] & mask) | (data & ~mask);
+        }
+        if (Target_WriteMem(Download.address, Download.block.word, words) != DAP_TRANSFER_OK) {
+          Download.error = 1U;
+        }
+        break;
+      case DOWNLOAD_FLASH:
+        if ((Download.address + (words * 4U)) > (TARGET_FLASH_START + TARGET_FLASH_SIZE)) {
+          Download.error = 1U;
+          break;
+        }
+        if ((TARGET_FLASH_ERASE(Download.address) == 0U) ||
+            (TARGET_FLASH_PROGRAM(Download.address, Download.block.word, words) == 0U)) {
+          Download.error = 1U;
+        }
+        memset(Download.block.byte, 0xFF, DOWNLOAD_BLOCK);
+        break;
+      default:
+        break;
+    }
+  }
+
+  Download.address += DOWNLOAD_BLOCK;
+  Download.fill     = 0U;
+  Download.write_time += hw_timer_elapsed(time);
+}
+
+
+// Output one decoded byte
+__STATIC_FORCEINLINE void Download_Output(uint32_t value) {
+  Download.window[Download.head] = (uint8_t)value;
+  Download.head = (Download.head + 1U) & (DOWNLOAD_WINDOW_SIZE - 1U);
+  Download.block.byte[Download.fill++] = (uint8_t)value;
+  Download.total++;
+  if (Download.fill == DOWNLOAD_BLOCK) {
+    Download_Flush();
+  }
+}
+
+
+// Take bits from the input
+//   count:  number of bits, not more than bit_count
+//   return: bits, MSB first
+__STATIC_FORCEINLINE uint32_t Download_Bits(uint32_t count) {
+  Download.bit_count -= count;
+  return ((Download.bits >> Download.bit_count) & ((1U << count) - 1U));
+}
+
+
+// Decode one input byte
+//   Tags whose operand is not complete yet stay in the bit buffer.
+DAP_RAMFUNC static void Download_Decode(uint32_t value) {
+  uint32_t offset;
+  uint32_t count;
+  uint32_t index;
+
+  Download.bits       = (Download.bits << 8) | value;
+  Download.bit_count += 8U;
+
+  while (Download.bit_count != 0U) {
+    if ((Download.bits >> (Download.bit_count - 1U)) & 1U) {
+      if (Download.bit_count < 9U) {
+        break;
+      }
+      (void)Download_Bits(1U);
+      Download_Output(Download_Bits(8U));
+    } else {
+      if (Download.bit_count < (1U + Download.window_bits + Download.count_bits)) {
+        break;
+      }
+      (void)Download_Bits(1U);
+      offset = Download_Bits(Download.window_bits) + 1U;
+      count  = Download_Bits(Download.count_bits)  + 1U;
+      index  = Download.head - offset;
+      while (count--) {
+        Download_Output(Download.window[index & (DOWNLOAD_WINDOW_SIZE - 1U)]);
+        index++;
+      }
+    }
+  }
+}
+
+
+// End the current download
+//   The target stays connected and, after a flash download, halted: the
+//   download is part of the host session, the host decides how it goes on.
+static void Download_End(void) {
+  Download_Flush();
+  if ((Download.mode & ~DOWNLOAD_RAW) == DOWNLOAD_FLASH) {
+    TARGET_FLASH_END();
+  }
+  Download.active = 0U;
+}
+
+
+// Process Download Open command and prepare response
+//   Starts a download, a download still open is ended first. Memory
+//   downloads connect and leave the Debug Port connected, the host has to
+//   set up SELECT, CSW and TAR again afterwards. Flash downloads start at a
+//   page, reset and halt the target when opened and leave it halted when
+//   closed, the host resets it into the new image.
+//   request:  pointer to request data
+//             mode, address, window bits, count bits
+//   response: pointer to response data
+//             status, largest window bits
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t DAP_DownloadOpen(const uint8_t *request, uint8_t *response) {
+  uint32_t mode;
+  uint32_t address;
+  uint32_t window_bits;
+  uint32_t count_bits;
+  uint32_t status;
+
+  mode        = *request;
+  address     = (uint32_t)(*(request+1) <<  0) |
+                (uint32_t)(*(request+2) <<  8) |
+                (uint32_t)(*(request+3) << 16) |
+                (uint32_t)(*(request+4) << 24);
+  window_bits = *(request+5);
+  count_bits  = *(request+6);
+
+  if (Download.active) {
+    Download_End();
+  }
+
+  status = DAP_ERROR;
+  if (((mode & DOWNLOAD_RAW) == 0U) &&
+      ((window_bits < 4U) || (window_bits > DAP_DOWNLOAD_WINDOW) ||
+       (count_bits  < 3U) || (count_bits  > DOWNLOAD_COUNT_MAX)  ||
+       (count_bits >= window_bits))) {
+    // Parameters the decoder cannot follow
+  } else if (address & 3U) {
+    // Target access is word wise
+  } else {
+    switch (mode & ~DOWNLOAD_RAW) {
+      case DOWNLOAD_MEMORY:
+        if (Target_Connect(NULL) == DAP_TRANSFER_OK) {
+          status = DAP_OK;
+        }
+        break;
+      case DOWNLOAD_FLASH:
+        if (((address & (DOWNLOAD_BLOCK - 1U)) == 0U) &&
+            (address >= TARGET_FLASH_START) &&
+            (address <  (TARGET_FLASH_START + TARGET_FLASH_SIZE)) &&
+            (TARGET_FLASH_INIT() != 0U)) {
+          status = DAP_OK;
+        }
+        break;
+      case DOWNLOAD_DISCARD:
+        status = DAP_OK;
+        break;
+      default:
+        break;
+    }
+  }
+
+  if (status == DAP_OK) {
+    memset(&Download, 0, sizeof(Download));
+    memset(Download.block.byte, 0xFF, DOWNLOAD_BLOCK);
+    Download.active      = 1U;
+    Download.mode        = (uint8_t)mode;
+    Download.window_bits = (uint8_t)window_bits;
+    Download.count_bits  = (uint8_t)count_bits;
+    Download.address     = address;
+  }
+
+  *(response+0) = (uint8_t)status;
+  *(response+1) = DAP_DOWNLOAD_WINDOW;
+
+  return ((7U << 16) | 2U);
+}
+
+
+// Process Download Data command and prepare response
+//   request:  pointer to request data
+//             count (2 bytes), data (count bytes)
+//   response: pointer to response data
+//             status, bytes output so far (4 bytes)
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t DAP_DownloadData(const uint8_t *request, uint8_t *response) {
+  uint32_t count;
+  uint32_t write_time;
+  uint32_t time;
+  uint32_t n;
+
+  count = (uint32_t)(*(request+0) << 0) |
+          (uint32_t)(*(request+1) << 8);
+  n = DAP_RequestSpace(request);
+  if ((2U + count) > n) {
+    count = (n > 2U) ? (n - 2U) : 0U;
+  }
+
+  if (Download.active && (Download.error == 0U)) {
+    time       = hw_timer_now();
+    write_time = Download.write_time;
+    if (Download.mode & DOWNLOAD_RAW) {
+      for (n = 0U; n < count; n++) {
+        Download_Output(*(request + 2U + n));
+      }
+    } else {
+      for (n = 0U; n < count; n++) {
+        Download_Decode(*(request + 2U + n));
+      }
+    }
+    Download.decode_time += hw_timer_elapsed(time) - (Download.write_time - write_time);
+  }
+
+  *(response+0) = (Download.active && (Download.error == 0U)) ? DAP_OK : DAP_ERROR;
+  *(response+1) = (uint8_t)(Download.total >>  0);
+  *(response+2) = (uint8_t)(Download.total >>  8);
+  *(response+3) = (uint8_t)(Download.total >> 16);
+  *(response+4) = (uint8_t)(Download.total >> 24);
+
+  return (((2U + count) << 16) | 5U);
+}
+
+
+// Process Download Close command and prepare response
+//   Writes the last block and ends the download.
+//   response: pointer to response data
+//             status, bytes output, decode time in us, target write time in us
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t DAP_DownloadClose(uint8_t *response) {
+  uint32_t status;
+  uint32_t n;
+
+  status = DAP_ERROR;
+  if (Download.active) {
+    Download_End();
+    if (Download.error == 0U) {
+      status = DAP_OK;
+    }
+  }
+
+  *(response+0) = (uint8_t)status;
+  for (n = 0U; n < 4U; n++) {
+    *(response+1+n) = (uint8_t)(Download.total       >> (n * 8U));
+    *(response+5+n) = (uint8_t)(Download.decode_time >> (n * 8U));
+    *(response+9+n) = (uint8_t)(Download.write_time  >> (n * 8U));
+  }
+
+  return (13U);
+}
+
+#endif
@@ -0,0 +1,257 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the License); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ----------------------------------------------------------------------
+ *
+ * Project:      CMSIS-DAP Source
+ * Title:        DAP_event.c Target State Change Events
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <string.h>
+#include "DAP_config.h"
+#include "DAP.h"
+
+#if (DAP_SWD != 0)
+
+// Events, also used as the event mask of Event Configure
+#define EVENT_HALT              (1U<<0) // S_HALT set
+#define EVENT_RUN               (1U<<1) // S_HALT cleared
+#define EVENT_RESET             (1U<<2) // S_RESET_ST, core reset since the last poll
+#define EVENT_LOCKUP            (1U<<3) // S_LOCKUP set
+#define EVENT_ALL               (EVENT_HALT | EVENT_RUN | EVENT_RESET | EVENT_LOCKUP)
+
+// DHCSR poll period limits
+#define EVENT_PERIOD_MIN        500U    // us
+#define EVENT_PERIOD_MAX        1000000U
+
+// Longest time an Event Read is held, below the hardware timer wrap
+#define EVENT_TIMEOUT_MAX       10000U  // ms
+
+// Record: timestamp in us since Event Configure (4 bytes), DHCSR (4 bytes), events
+#define EVENT_RECORD_SIZE       9U
+#define EVENT_QUEUE_SIZE        8U
+
+// Event Read response header: status, lost (2 bytes), records
+#define EVENT_HEADER_SIZE       4U
+
+#define EVENT_COUNTER_MAX       0xFFFFU
+
+static struct {
+  uint32_t period;              // us, 0 when not polling
+  uint32_t time;                // us since Event Configure
+  uint32_t timer;               // Timer value of time
+  uint32_t next;                // Time of the next poll
+  uint32_t dhcsr;               // DHCSR read by the last poll
+  uint32_t mask;                // Events reported
+  uint32_t head;                // Next record written
+  uint32_t count;               // Records queued
+  uint32_t lost;                // Events lost to a full queue
+  uint8_t  queue[EVENT_QUEUE_SIZE][EVENT_RECORD_SIZE];
+} Event;
+
+
+// Put a word into the response
+static void Event_PutWord(uint8_t *data, uint32_t value) {
+  *(data+0) = (uint8_t)(value >>  0);
+  *(data+1) = (uint8_t)(value >>  8);
+  *(data+2) = (uint8_t)(value >> 16);
+  *(data+3) = (uint8_t)(value >> 24);
+}
+
+
+// Process Event Configure command and prepare response
+//   Starts polling DHCSR on the probe, a period of 0 stops. The DHCSR read
+//   at the start is the reference for the first poll and does not report
+//   events. Starting again discards queued events.
+//   request:  pointer to request data
+//             period in us (4 bytes), event mask
+//   response: pointer to response data
+//             status, DHCSR (4 bytes)
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t DAP_EventConfigure(const uint8_t *request, uint8_t *response) {
+  uint32_t period;
+  uint32_t mask;
+  uint32_t dhcsr;
+
+  period = (uint32_t)(*(request+0) <<  0) |
+           (uint32_t)(*(request+1) <<  8) |
+           (uint32_t)(*(request+2) << 16) |
+           (uint32_t)(*(request+3) << 24);
+  mask   = *(request+4);
+
+  Event.period = 0U;
+  dhcsr = 0U;
+  *(response+0) = DAP_OK;
+
+  if (period != 0U) {
+    if ((period < EVENT_PERIOD_MIN) || (period > EVENT_PERIOD_MAX) ||
+        ((mask & EVENT_ALL) == 0U) || ((mask & ~EVENT_ALL) != 0U) ||
+        (DAP_Data.debug_port != DAP_PORT_SWD) ||
+        (Target_Peek32(DBG_HCSR, &dhcsr) != DAP_TRANSFER_OK)) {
+      *(response+0) = DAP_ERROR;
+    } else {
+      Event.dhcsr  = dhcsr;
+      Event.mask   = mask;
+      Event.head   = 0U;
+      Event.count  = 0U;
+      Event.lost   = 0U;
+      Event.time   = 0U;
+      Event.timer  = hw_timer_now();
+      Event.next   = period;
+      Event.period = period;
+    }
+  }
+  Event_PutWord(response + 1, dhcsr);
+
+  return ((5U << 16) | 5U);
+}
+
+
+// Process Event Read command and prepare response
+//   Drains queued events, oldest first. The bulk transport holds the
+//   command until an event is queued or the timeout passes, see
+//   DAP_EventWait, other transports answer right away.
+//   request:  pointer to request data
+//             timeout in ms (2 bytes)
+//   response: pointer to response data
+//             status (DAP_ERROR when not polling), events lost (2 bytes),
+//             number of records, records: timestamp (4 bytes),
+//             DHCSR (4 bytes), events
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t DAP_EventRead(const uint8_t *request, uint8_t *response) {
+  uint8_t *data;
+  uint8_t *end;
+  uint32_t tail;
+  uint32_t n;
+
+  (void)request;
+
+  *(response+0) = (Event.period != 0U) ? DAP_OK : DAP_ERROR;
+  *(response+1) = (uint8_t)(Event.lost >> 0);
+  *(response+2) = (uint8_t)(Event.lost >> 8);
+  Event.lost = 0U;
+
+  data = response + EVENT_HEADER_SIZE;
+  end  = response + DAP_ResponseSpace(response);
+  tail = (Event.head + EVENT_QUEUE_SIZE - Event.count) % EVENT_QUEUE_SIZE;
+  for (n = 0U; (n < Event.count) && ((data + EVENT_RECORD_SIZE) <= end); n++) {
+    memcpy(data, Event.queue[tail], EVENT_RECORD_SIZE);
+    data += EVENT_RECORD_SIZE;
+    tail = (tail + 1U) % EVENT_QUEUE_SIZE;
+  }
+  Event.count -= n;
+  *(response+3) = (uint8_t)n;
+
+  return ((2U << 16) | (uint32_t)(data - response));
+}
+
+
+// Time an Event Read may still be held by the transport
+//   A host waiting for the target to halt sends one Event Read with a
+//   timeout and blocks on the response instead of polling DHCSR itself.
+//   The transport holds the command while this returns non-zero, polls
+//   DAP_EventTask meanwhile and processes the command as soon as another
+//   command arrives.
+//   request: pointer to the command, starting with the command ID
+//   held:    us the command has been held
+//   return:  us it may be held further, 0 to process it now
+uint32_t DAP_EventWait(const uint8_t *request, uint32_t held) {
+  uint32_t timeout;
+
+  if ((*request != ID_DAP_EventRead) || (Event.period == 0U) || (Event.count != 0U)) {
+    return (0U);
+  }
+
+  timeout = (uint32_t)(*(request+1) << 0) |
+            (uint32_t)(*(request+2) << 8);
+  if (timeout > EVENT_TIMEOUT_MAX) {
+    timeout = EVENT_TIMEOUT_MAX;
+  }
+  timeout *= 1000U;
+
+  return ((held < timeout) ? (timeout - held) : 0U);
+}
+
+
+// Poll DHCSR when due and queue state changes
+//   Called from the thread that processes DAP commands, between commands.
+//   The poll leaves SELECT, CSW and TAR as the host set them up. Polls are
+//   skipped while the Debug Port is not connected, a failed poll keeps the
+//   last DHCSR as reference. S_RESET_ST and S_RETIRE_ST cleared by a poll
+//   are still returned by the next DHCSR read of the host.
+//   return: us until the next poll, 0 when not polling
+uint32_t DAP_EventTask(void) {
+  uint8_t *record;
+  uint32_t timer;
+  uint32_t dhcsr;
+  uint32_t events;
+
+  if (Event.period == 0U) {
+    return (0U);
+  }
+
+  // Extend the timer to 32 bits, called at least once per period
+  timer = hw_timer_now();
+  Event.time += (timer - Event.timer) & HW_TIMER_MASK;
+  Event.timer = timer;
+
+  if ((int32_t)(Event.time - Event.next) < 0) {
+    return (Event.next - Event.time);
+  }
+  Event.next = Event.time + Event.period;
+
+  if ((DAP_Data.debug_port != DAP_PORT_SWD) ||
+      (Target_Peek32(DBG_HCSR, &dhcsr) != DAP_TRANSFER_OK)) {
+    return (Event.period);
+  }
+
+  events = 0U;
+  if ((dhcsr & ~Event.dhcsr & S_HALT) != 0U) {
+    events |= EVENT_HALT;
+  }
+  if ((~dhcsr & Event.dhcsr & S_HALT) != 0U) {
+    events |= EVENT_RUN;
+  }
+  if ((dhcsr & S_RESET_ST) != 0U) {
+    events |= EVENT_RESET;
+  }
+  if ((dhcsr & ~Event.dhcsr & S_LOCKUP) != 0U) {
+    events |= EVENT_LOCKUP;
+  }
+  Event.dhcsr = dhcsr;
+  events &= Event.mask;
+
+  if (events != 0U) {
+    if (Event.count == EVENT_QUEUE_SIZE) {
+      if (Event.lost != EVENT_COUNTER_MAX) {
+        Event.lost++;
+      }
+    } else {
+      record = Event.queue[Event.head];
+      Event_PutWord(record + 0, Event.time);
+      Event_PutWord(record + 4, dhcsr);
+      *(record+8) = (uint8_t)events;
+      Event.head = (Event.head + 1U) % EVENT_QUEUE_SIZE;
+      Event.count++;
+    }
+  }
+
+  return (Event.period);
+}
+
+#endif
@@ -0,0 +1,170 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the License); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ----------------------------------------------------------------------
+ *
+ * Project:      CMSIS-DAP Source
+ * Title:        DAP_rle.c Run-Length Encoded Memory Read
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <string.h>
+#include "DAP_config.h"
+#include "DAP.h"
+
+#if (DAP_SWD != 0)
+
+// Response data formats
+#define RLE_FORMAT_RAW          0U      // Words, little endian
+#define RLE_FORMAT_RLE          1U      // Tokens
+
+// RLE tokens
+//   0nnnnnnn: n + 1 words follow
+//   1nnnnnnn: the word that follows repeats n + 1 times
+#define RLE_RUN                 0x80U
+#define RLE_COUNT_MAX           128U
+
+// Largest growth of the response by one word: literal token and word
+#define RLE_WORD_MAX            5U
+
+// Words read from the target at a time
+#define RLE_READ_WORDS          16U
+
+
+// Put a word into the response
+static void RLE_PutWord(uint8_t *data, uint32_t value) {
+  *(data+0) = (uint8_t)(value >>  0);
+  *(data+1) = (uint8_t)(value >>  8);
+  *(data+2) = (uint8_t)(value >> 16);
+  *(data+3) = (uint8_t)(value >> 24);
+}
+
+
+// Process Read RLE command and prepare response
+//   Reads words from MEM-AP 0 with the probe side target access, repeated
+//   words are sent as runs. When no run occurs the words are sent raw.
+//   The Debug Port has to be powered up, the host has to set up SELECT,
+//   CSW and TAR again afterwards.
+//   request:  pointer to request data
+//             address, number of words (2 bytes)
+//   response: pointer to response data
+//             status, number of words read (2 bytes), format, data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t DAP_ReadRLE(const uint8_t *request, uint8_t *response) {
+  uint32_t buffer[RLE_READ_WORDS];
+  uint32_t address;
+  uint32_t count;
+  uint32_t words;
+  uint32_t value;
+  uint32_t runs;
+  uint32_t n;
+  uint32_t i;
+  uint8_t *data;
+  uint8_t *end;
+  uint8_t *token;               // Token of the last words, NULL at start
+  uint8_t *from;
+  uint8_t *to;
+
+  address = (uint32_t)(*(request+0) <<  0) |
+            (uint32_t)(*(request+1) <<  8) |
+            (uint32_t)(*(request+2) << 16) |
+            (uint32_t)(*(request+3) << 24);
+  count   = (uint32_t)(*(request+4) <<  0) |
+            (uint32_t)(*(request+5) <<  8);
+
+  *(response+0) = DAP_OK;
+  data  = response + 4;
+  end   = response + DAP_ResponseSpace(response);
+  token = NULL;
+  words = 0U;
+  runs  = 0U;
+  value = 0U;
+
+  if ((DAP_Data.debug_port != DAP_PORT_SWD) || (address & 3U)) {
+    *(response+0) = DAP_ERROR;
+    count = 0U;
+  }
+
+  while ((words < count) && ((data + RLE_WORD_MAX) <= end)) {
+    // Each word takes at least four bytes unless it repeats
+    n = (uint32_t)(end - data) / 4U;
+    if (n > RLE_READ_WORDS) {
+      n = RLE_READ_WORDS;
+    }
+    if (n > (count - words)) {
+      n = count - words;
+    }
+    if (Target_ReadMem(address + (words * 4U), buffer, n) != DAP_TRANSFER_OK) {
+      *(response+0) = DAP_ERROR;
+      break;
+    }
+
+    for (i = 0U; (i < n) && ((data + RLE_WORD_MAX) <= end); i++) {
+      if ((token != NULL) && (*token & RLE_RUN) && (buffer[i] == value) &&
+          ((*token & ~RLE_RUN) < (RLE_COUNT_MAX - 1U))) {
+        // Repeat the run
+        (*token)++;
+      } else if ((token != NULL) && ((*token & RLE_RUN) == 0U) && (buffer[i] == value)) {
+        // The last literal word starts a run
+        if (*token == 0U) {
+          data = token;
+        } else {
+          (*token)--;
+          data -= 4;
+        }
+        token  = data;
+        *data++ = RLE_RUN | 1U;
+        RLE_PutWord(data, value);
+        data  += 4;
+        runs++;
+      } else {
+        if ((token == NULL) || (*token & RLE_RUN) || (*token == (RLE_COUNT_MAX - 1U))) {
+          token   = data;
+          *data++ = 0U;
+        } else {
+          (*token)++;
+        }
+        value = buffer[i];
+        RLE_PutWord(data, value);
+        data += 4;
+      }
+      words++;
+    }
+  }
+
+  if (runs != 0U) {
+    *(response+3) = RLE_FORMAT_RLE;
+  } else {
+    // Only literal tokens, strip their headers
+    *(response+3) = RLE_FORMAT_RAW;
+    from = response + 4;
+    to   = response + 4;
+    while (from < data) {
+      n = ((uint32_t)*from + 1U) * 4U;
+      memmove(to, from + 1, n);
+      from += n + 1U;
+      to   += n;
+    }
+    data = to;
+  }
+
+  *(response+1) = (uint8_t)(words >> 0);
+  *(response+2) = (uint8_t)(words >> 8);
+
+  return ((6U << 16) | (uint32_t)(data - response));
+}
+
+#endif
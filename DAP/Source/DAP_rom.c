@@ -0,0 +1,564 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the License); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ----------------------------------------------------------------------
+ *
+ * Project:      CMSIS-DAP Source
+ * Title:        DAP_rom.c ROM Table Discovery
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <string.h>
+#include "DAP_config.h"
+#include "DAP.h"
+
+#if (DAP_SWD != 0)
+
+// MEM-AP identification registers, bank 0xF
+#define AP_BANK_ID              0xF0U
+#define AP_BASE                 0x08U
+#define AP_IDR                  0x0CU
+#define AP_IDR_MEM(idr)         ((((idr) >> 13) & 0x0FU) == 0x08U)
+
+// BASE: format [1], entry present [0], ROM table address [31:12]
+#define ROM_BASE_NONE(base)     (((base) == 0xFFFFFFFFU) || (((base) & 0x03U) == 0x02U))
+
+// Component registers, offsets from the component base
+#define ROM_DEVARCH             0xFBCU  // DEVARCH, DEVID2, DEVID1, DEVID, DEVTYPE
+#define ROM_DEVARCH_WORDS       5U
+#define ROM_PIDR4               0xFD0U  // PIDR4..PIDR7, PIDR0..PIDR3, CIDR0..CIDR3
+#define ROM_ID_WORDS            12U
+
+// Component classes
+#define ROM_CLASS_TABLE         0x1U    // ROM table
+#define ROM_CLASS_CORESIGHT     0x9U    // CoreSight component, ROM table by DEVARCH
+#define ROM_CLASS_NONE          0xFFU   // Component IDs not readable
+#define ROM_DEVARCH_TABLE       0x47700AF7U     // ARM, present, ROM table
+#define ROM_DEVARCH_MASK        0xFFF0FFFFU     // Without revision
+
+// ROM table entries: offset [31:12], present [0]
+#define ROM_ENTRIES_CLASS1      960U
+#define ROM_ENTRIES_CLASS9      512U
+#define ROM_ENTRY_PRESENT       (1U<<0)
+#define ROM_ENTRY_OFFSET        0xFFFFF000U
+#define ROM_CHUNK_WORDS         16U     // Entries read at a time, within a TAR block
+
+// Nested ROM tables followed at most
+#define ROM_DEPTH_MAX           8U
+
+// Component record: address (4 bytes), PIDR0..PIDR4 (low byte each), class,
+// depth, DEVTYPE, DEVARCH (4 bytes)
+#define ROM_RECORD_SIZE         16U
+
+// Rom Discover request flags
+#define ROM_REQUEST_REFRESH     (1U<<0) // Walk again, ignore the cache
+
+// Rom Discover response flags, also kept per cache entry
+#define ROM_CACHED              (1U<<0) // Page taken from the cache
+#define ROM_TRUNCATED           (1U<<1) // Walk stopped at ROM_COMPONENTS_MAX
+#define ROM_PARTIAL             (1U<<2) // Cache holds the first records only
+
+// Components listed at most, bounds the time of a walk
+#define ROM_COMPONENTS_MAX      1024U
+
+// Rom Discover response header: status, flags, components (2 bytes), records
+#define ROM_HEADER_SIZE         5U
+
+// Cache entry offset of a walk that is not cached
+#define ROM_ENTRY_NONE          0xFFFFFFFFU
+
+// Cache entry, followed by its component records
+typedef struct {
+  uint32_t dpidr;               // Key: DPIDR, AP IDR, BASE and limits
+  uint32_t apidr;
+  uint32_t base;
+  uint32_t limits;              // Depth [23:16], entries per table [15:0]
+  uint16_t count;               // Component records cached
+  uint16_t total;               // Components found by the walk
+  uint8_t  flags;               // ROM_TRUNCATED, ROM_PARTIAL
+  uint8_t  reserved[3];
+} RomEntry_t;
+
+// Kept off the USB thread stack
+static struct {
+  uint32_t used;                        // Bytes of the cache in use
+  uint32_t entry;                       // Offset of the entry being walked, ROM_ENTRY_NONE
+  uint8_t *out;                         // Records of the page requested
+  uint32_t first;                       // First record of the page
+  uint32_t space;                       // Records that fit into the response
+  uint32_t total;                       // Components found by the walk
+  uint32_t flags;                       // ROM_TRUNCATED, ROM_PARTIAL
+  uint32_t table[ROM_DEPTH_MAX];        // ROM tables being walked, innermost last
+  uint16_t index[ROM_DEPTH_MAX];        // Next entry of each table
+  uint16_t limit[ROM_DEPTH_MAX];        // Entries of each table
+  uint32_t chunk;                       // Address of the entries buffered
+  uint32_t entries[ROM_CHUNK_WORDS];
+  uint32_t cache[DAP_ROM_CACHE_SIZE / 4U];
+} Rom;
+
+
+// SWD Transfer with retries on WAIT response
+//   request: A[3:2] RnW APnDP
+//   data:    DATA[31:0]
+//   return:  ACK[2:0]
+static uint32_t Rom_Transfer(uint32_t request, uint32_t *data) {
+  uint32_t response_value;
+  uint32_t retry;
+
+  retry = DAP_Data.transfer.retry_count;
+  do {
+    response_value = SWD_Transfer(request, data);
+  } while ((response_value == DAP_TRANSFER_WAIT) && retry--);
+
+  return (response_value);
+}
+
+
+// Clear the sticky error flags after a FAULT response
+static void Rom_Clear(void) {
+  uint32_t data;
+
+  data = DP_ABORT_STKCMPCLR | DP_ABORT_STKERRCLR | DP_ABORT_WDERRCLR | DP_ABORT_ORUNERRCLR;
+  (void)Rom_Transfer(DP_ABORT, &data);
+}
+
+
+// Read a block of words from the selected MEM-AP
+//   The block must not cross a TAR auto-increment boundary.
+//   address: address of the block
+//   data:    pointer to words read
+//   count:   number of words
+//   return:  DAP_TRANSFER_OK or error ACK
+static uint32_t Rom_Read(uint32_t address, uint32_t *data, uint32_t count) {
+  uint32_t response_value;
+  uint32_t n;
+
+  response_value = Rom_Transfer(DAP_TRANSFER_APnDP | AP_TAR, &address);
+  if (response_value == DAP_TRANSFER_OK) {
+    response_value = Rom_Transfer(DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | AP_DRW, NULL);
+  }
+  for (n = 0U; (n < count) && (response_value == DAP_TRANSFER_OK); n++) {
+    if (n == (count - 1U)) {
+      response_value = Rom_Transfer(DP_RDBUFF | DAP_TRANSFER_RnW, &data[n]);
+    } else {
+      response_value = Rom_Transfer(DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | AP_DRW, &data[n]);
+    }
+  }
+
+  return (response_value);
+}
+
+
+// Read IDR and BASE of an AP
+//   apsel:  AP number
+//   apidr:  pointer to AP IDR
+//   base:   pointer to BASE
+//   return: DAP_TRANSFER_OK or error ACK
+static uint32_t Rom_Ident(uint32_t apsel, uint32_t *apidr, uint32_t *base) {
+  uint32_t response_value;
+  uint32_t data;
+
+  data = (apsel << 24) | AP_BANK_ID;
+  response_value = Rom_Transfer(DP_SELECT, &data);
+  if (response_value == DAP_TRANSFER_OK) {
+    response_value = Rom_Transfer(DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | AP_BASE, NULL);
+  }
+  if (response_value == DAP_TRANSFER_OK) {
+    response_value = Rom_Transfer(DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | AP_IDR, base);
+  }
+  if (response_value == DAP_TRANSFER_OK) {
+    response_value = Rom_Transfer(DP_RDBUFF | DAP_TRANSFER_RnW, apidr);
+  }
+
+  return (response_value);
+}
+
+
+// Set up a MEM-AP for the walk
+//   Selects the AP, register bank 0, with CSW set to 32-bit access and
+//   auto-increment single.
+//   apsel:  AP number
+//   return: DAP_TRANSFER_OK or error ACK
+static uint32_t Rom_Setup(uint32_t apsel) {
+  uint32_t response_value;
+  uint32_t data;
+
+  data = apsel << 24;
+  response_value = Rom_Transfer(DP_SELECT, &data);
+  if (response_value == DAP_TRANSFER_OK) {
+    response_value = Rom_Transfer(DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | AP_CSW, NULL);
+  }
+  if (response_value == DAP_TRANSFER_OK) {
+    response_value = Rom_Transfer(DP_RDBUFF | DAP_TRANSFER_RnW, &data);
+  }
+  if (response_value == DAP_TRANSFER_OK) {
+    data = (data & ~0x37U) | 0x12U;
+    response_value = Rom_Transfer(DAP_TRANSFER_APnDP | AP_CSW, &data);
+  }
+
+  return (response_value);
+}
+
+
+// Get a cache entry
+static RomEntry_t *Rom_Entry(uint32_t offset) {
+  return ((RomEntry_t *)((uint8_t *)Rom.cache + offset));
+}
+
+
+// Size of a cache entry in bytes
+static uint32_t Rom_EntrySize(uint32_t offset) {
+  return (sizeof(RomEntry_t) + (Rom_Entry(offset)->count * ROM_RECORD_SIZE));
+}
+
+
+// Remove a cache entry, the entries behind it move up
+static void Rom_Remove(uint32_t offset) {
+  uint32_t size;
+
+  size = Rom_EntrySize(offset);
+  memmove((uint8_t *)Rom.cache + offset, (uint8_t *)Rom.cache + offset + size, Rom.used - offset - size);
+  Rom.used -= size;
+}
+
+
+// Find the cache entry of an AP
+//   return: offset of the entry, Rom.used when not cached
+static uint32_t Rom_Find(uint32_t dpidr, uint32_t apidr, uint32_t base) {
+  RomEntry_t *entry;
+  uint32_t offset;
+
+  for (offset = 0U; offset < Rom.used; offset += Rom_EntrySize(offset)) {
+    entry = Rom_Entry(offset);
+    if ((entry->dpidr == dpidr) && (entry->apidr == apidr) && (entry->base == base)) {
+      break;
+    }
+  }
+
+  return (offset);
+}
+
+
+// Pass a component record to the page requested and to the entry being walked
+//   The cache keeps the first records of the list, evicting the oldest
+//   entries to make room; a list that fills the cache on its own is cached
+//   in part and walked again for the pages behind.
+//   record: component record
+static void Rom_Record(const uint8_t *record) {
+  if ((Rom.total >= Rom.first) && ((Rom.total - Rom.first) < Rom.space)) {
+    memcpy(Rom.out + ((Rom.total - Rom.first) * ROM_RECORD_SIZE), record, ROM_RECORD_SIZE);
+  }
+  Rom.total++;
+
+  if ((Rom.entry == ROM_ENTRY_NONE) || (Rom.flags & ROM_PARTIAL)) {
+    return;
+  }
+  while ((Rom.used + ROM_RECORD_SIZE) > sizeof(Rom.cache)) {
+    if (Rom.entry == 0U) {
+      Rom.flags |= ROM_PARTIAL;
+      return;
+    }
+    Rom.entry -= Rom_EntrySize(0U);
+    Rom_Remove(0U);
+  }
+  memcpy((uint8_t *)Rom.cache + Rom.used, record, ROM_RECORD_SIZE);
+  Rom.used += ROM_RECORD_SIZE;
+  Rom_Entry(Rom.entry)->count++;
+}
+
+
+// Add a component to the list
+//   address: component base address
+//   depth:   ROM tables above the component
+//   entries: pointer to number of entries, when the component is a ROM table
+//   return:  DAP_TRANSFER_OK, DAP_TRANSFER_ERROR when ROM_COMPONENTS_MAX
+//            components are listed or error ACK
+static uint32_t Rom_Component(uint32_t address, uint32_t depth, uint32_t *entries) {
+  uint32_t id[ROM_ID_WORDS];
+  uint32_t arch[ROM_DEVARCH_WORDS];
+  uint32_t response_value;
+  uint8_t  record[ROM_RECORD_SIZE];
+  uint32_t class;
+  uint32_t n;
+
+  *entries = 0U;
+  if (Rom.total == ROM_COMPONENTS_MAX) {
+    Rom.flags |= ROM_TRUNCATED;
+    return (DAP_TRANSFER_ERROR);
+  }
+
+  memset(arch, 0, sizeof(arch));
+  class = ROM_CLASS_NONE;
+  response_value = Rom_Read(address + ROM_PIDR4, id, ROM_ID_WORDS);
+  if ((response_value == DAP_TRANSFER_OK) &&
+      ((id[8] & 0xFFU) == 0x0DU) && ((id[9] & 0x0FU) == 0x00U) &&
+      ((id[10] & 0xFFU) == 0x05U) && ((id[11] & 0xFFU) == 0xB1U)) {
+    class = (id[9] >> 4) & 0x0FU;
+    if (class == ROM_CLASS_CORESIGHT) {
+      response_value = Rom_Read(address + ROM_DEVARCH, arch, ROM_DEVARCH_WORDS);
+    }
+  }
+  if (response_value == DAP_TRANSFER_FAULT) {
+    Rom_Clear();
+    class = ROM_CLASS_NONE;
+  } else if (response_value != DAP_TRANSFER_OK) {
+    return (response_value);
+  }
+
+  // Class 0x9 ROM tables with 64-bit entries (DEVID.FORMAT) are not walked
+  if (class == ROM_CLASS_TABLE) {
+    *entries = ROM_ENTRIES_CLASS1;
+  } else if ((class == ROM_CLASS_CORESIGHT) &&
+             ((arch[0] & ROM_DEVARCH_MASK) == ROM_DEVARCH_TABLE) && ((arch[3] & 0x0FU) == 0U)) {
+    *entries = ROM_ENTRIES_CLASS9;
+  }
+
+  *(record+0) = (uint8_t)(address >>  0);
+  *(record+1) = (uint8_t)(address >>  8);
+  *(record+2) = (uint8_t)(address >> 16);
+  *(record+3) = (uint8_t)(address >> 24);
+  for (n = 0U; n < 4U; n++) {
+    *(record + 4U + n) = (class == ROM_CLASS_NONE) ? 0U : (uint8_t)id[4U + n];
+  }
+  *(record+8)  = (class == ROM_CLASS_NONE) ? 0U : (uint8_t)id[0];
+  *(record+9)  = (uint8_t)class;
+  *(record+10) = (uint8_t)depth;
+  *(record+11) = (uint8_t)arch[4];
+  *(record+12) = (uint8_t)(arch[0] >>  0);
+  *(record+13) = (uint8_t)(arch[0] >>  8);
+  *(record+14) = (uint8_t)(arch[0] >> 16);
+  *(record+15) = (uint8_t)(arch[0] >> 24);
+  Rom_Record(record);
+
+  return (DAP_TRANSFER_OK);
+}
+
+
+// Walk the ROM tables of the selected MEM-AP into a new cache entry
+//   Tables are walked depth first with an explicit stack, entries are read
+//   in chunks. A table that faults is left, a table already being walked
+//   is not entered again.
+//   base:    ROM table address
+//   depth:   ROM tables followed at most
+//   entries: entries read per table at most, 0 = all
+//   return:  DAP_TRANSFER_OK or error ACK
+static uint32_t Rom_Walk(uint32_t base, uint32_t depth, uint32_t entries) {
+  uint32_t response_value;
+  uint32_t address;
+  uint32_t value;
+  uint32_t limit;
+  uint32_t sp;
+  uint32_t n;
+
+  Rom.chunk = 1U;                       // Nothing buffered
+  response_value = Rom_Component(base, 0U, &limit);
+  sp = 0U;
+  if ((limit != 0U) && (depth != 0U)) {
+    Rom.table[0] = base;
+    Rom.index[0] = 0U;
+    Rom.limit[0] = (uint16_t)(((entries != 0U) && (entries < limit)) ? entries : limit);
+    sp = 1U;
+  }
+
+  while ((sp != 0U) && (response_value == DAP_TRANSFER_OK)) {
+    n = sp - 1U;
+    if (Rom.index[n] == Rom.limit[n]) {
+      sp--;
+      continue;
+    }
+    address = Rom.table[n] + (Rom.index[n] * 4U);
+    if ((address & ~((ROM_CHUNK_WORDS * 4U) - 1U)) != Rom.chunk) {
+      Rom.chunk = address & ~((ROM_CHUNK_WORDS * 4U) - 1U);
+      response_value = Rom_Read(Rom.chunk, Rom.entries, ROM_CHUNK_WORDS);
+      if (response_value == DAP_TRANSFER_FAULT) {
+        Rom_Clear();
+        Rom.chunk = 1U;
+        response_value = DAP_TRANSFER_OK;
+        sp--;
+        continue;
+      }
+      if (response_value != DAP_TRANSFER_OK) {
+        break;
+      }
+    }
+    value = Rom.entries[(address / 4U) % ROM_CHUNK_WORDS];
+    Rom.index[n]++;
+    if (value == 0U) {
+      Rom.index[n] = Rom.limit[n];      // End of table
+      continue;
+    }
+    if ((value & ROM_ENTRY_PRESENT) == 0U) {
+      continue;
+    }
+
+    address = Rom.table[n] + (value & ROM_ENTRY_OFFSET);
+    response_value = Rom_Component(address, sp, &limit);
+    if ((response_value != DAP_TRANSFER_OK) || (limit == 0U) ||
+        (sp == depth) || (sp == ROM_DEPTH_MAX)) {
+      continue;
+    }
+    for (n = 0U; (n < sp) && (Rom.table[n] != address); n++);
+    if (n == sp) {
+      Rom.table[sp] = address;
+      Rom.index[sp] = 0U;
+      Rom.limit[sp] = (uint16_t)(((entries != 0U) && (entries < limit)) ? entries : limit);
+      sp++;
+    }
+  }
+
+  return (response_value);
+}
+
+
+// Process Rom Discover command and prepare response
+//   Walks the ROM tables of a MEM-AP on the probe and returns the components
+//   found, records are passed to the response while the walk goes on. The
+//   list is cached by DPIDR, AP IDR and BASE, so further requests for the
+//   same AP, including the following pages of the list, only read these
+//   three registers. Pages behind a list cached in part are walked again.
+//   Only ROM tables with 32-bit entries are walked. The host has to set up
+//   SELECT, CSW and TAR again afterwards.
+//   request:  pointer to request data
+//             AP number, ROM tables followed at most, entries per table at
+//             most (2 bytes, 0 = all), first record (2 bytes), flags:
+//             bit 0 = walk again
+//   response: pointer to response data
+//             status, flags: bit 0 = cached, bit 1 = truncated, bit 2 =
+//             cached in part, number of components (2 bytes), number of
+//             records, records: address (4 bytes), PIDR0..PIDR4, class,
+//             depth, DEVTYPE, DEVARCH (4 bytes)
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t DAP_RomDiscover(const uint8_t *request, uint8_t *response) {
+  RomEntry_t *entry;
+  uint32_t response_value;
+  uint32_t dpidr;
+  uint32_t apidr;
+  uint32_t base;
+  uint32_t limits;
+  uint32_t first;
+  uint32_t offset;
+  uint32_t space;
+  uint32_t n;
+
+  limits = ((uint32_t)*(request+1) << 16) |
+           (uint32_t)(*(request+2) << 0) |
+           (uint32_t)(*(request+3) << 8);
+  first  = (uint32_t)(*(request+4) << 0) |
+           (uint32_t)(*(request+5) << 8);
+
+  *(response+0) = DAP_ERROR;
+  *(response+1) = 0U;
+  *(response+2) = 0U;
+  *(response+3) = 0U;
+  *(response+4) = 0U;
+
+  // Records that fit behind the header, within the packet
+  space = DAP_ResponseSpace(response);
+  space = (space > ROM_HEADER_SIZE) ? ((space - ROM_HEADER_SIZE) / ROM_RECORD_SIZE) : 0U;
+  if (space > 255U) {
+    space = 255U;
+  }
+
+  if (DAP_Data.debug_port != DAP_PORT_SWD) {
+    return ((7U << 16) | ROM_HEADER_SIZE);
+  }
+  response_value = Rom_Transfer(DP_IDCODE | DAP_TRANSFER_RnW, &dpidr);
+  if (response_value == DAP_TRANSFER_OK) {
+    response_value = Rom_Ident(*request, &apidr, &base);
+  }
+  if ((response_value != DAP_TRANSFER_OK) || !AP_IDR_MEM(apidr)) {
+    return ((7U << 16) | ROM_HEADER_SIZE);
+  }
+
+  offset = Rom_Find(dpidr, apidr, base);
+  if ((offset != Rom.used) &&
+      ((Rom_Entry(offset)->limits != limits) || (*(request+6) & ROM_REQUEST_REFRESH))) {
+    Rom_Remove(offset);
+    offset = Rom.used;
+  }
+  if (offset != Rom.used) {
+    entry = Rom_Entry(offset);
+    n = (first < entry->total) ? (entry->total - first) : 0U;
+    if (n > space) {
+      n = space;
+    }
+    if ((first + n) <= entry->count) {
+      *(response+0) = DAP_OK;
+      *(response+1) = ROM_CACHED | entry->flags;
+      *(response+2) = (uint8_t)(entry->total >> 0);
+      *(response+3) = (uint8_t)(entry->total >> 8);
+      *(response+4) = (uint8_t)n;
+      memcpy(response + ROM_HEADER_SIZE,
+             (uint8_t *)Rom.cache + offset + sizeof(RomEntry_t) + (first * ROM_RECORD_SIZE),
+             n * ROM_RECORD_SIZE);
+      return ((7U << 16) | (ROM_HEADER_SIZE + (n * ROM_RECORD_SIZE)));
+    }
+    Rom.entry = ROM_ENTRY_NONE;
+    Rom.flags = entry->flags;
+  } else {
+    while ((Rom.used + sizeof(RomEntry_t)) > sizeof(Rom.cache)) {
+      Rom_Remove(0U);
+    }
+    Rom.entry = Rom.used;
+    entry = Rom_Entry(Rom.entry);
+    entry->dpidr  = dpidr;
+    entry->apidr  = apidr;
+    entry->base   = base;
+    entry->limits = limits;
+    entry->count  = 0U;
+    entry->total  = 0U;
+    entry->flags  = 0U;
+    Rom.used += sizeof(RomEntry_t);
+    Rom.flags = 0U;
+  }
+
+  Rom.out   = response + ROM_HEADER_SIZE;
+  Rom.first = first;
+  Rom.space = space;
+  Rom.total = 0U;
+  if (!ROM_BASE_NONE(base)) {
+    response_value = Rom_Setup(*request);
+  }
+  if ((response_value == DAP_TRANSFER_OK) && !ROM_BASE_NONE(base)) {
+    response_value = Rom_Walk(base & ROM_ENTRY_OFFSET, limits >> 16, limits & 0xFFFFU);
+  }
+  // A truncated walk lists what it found, other errors discard the walk
+  if ((response_value != DAP_TRANSFER_OK) && !(Rom.flags & ROM_TRUNCATED)) {
+    if (Rom.entry != ROM_ENTRY_NONE) {
+      Rom_Remove(Rom.entry);
+    }
+    return ((7U << 16) | ROM_HEADER_SIZE);
+  }
+  if (Rom.entry != ROM_ENTRY_NONE) {
+    entry = Rom_Entry(Rom.entry);
+    entry->total = (uint16_t)Rom.total;
+    entry->flags = (uint8_t)Rom.flags;
+  }
+
+  n = (first < Rom.total) ? (Rom.total - first) : 0U;
+  if (n > space) {
+    n = space;
+  }
+  *(response+0) = DAP_OK;
+  *(response+1) = (uint8_t)Rom.flags;
+  *(response+2) = (uint8_t)(Rom.total >> 0);
+  *(response+3) = (uint8_t)(Rom.total >> 8);
+  *(response+4) = (uint8_t)n;
+
+  return ((7U << 16) | (ROM_HEADER_SIZE + (n * ROM_RECORD_SIZE)));
+}
+
+#endif
@@ -0,0 +1,240 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the License); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ----------------------------------------------------------------------
+ *
+ * Project:      CMSIS-DAP Source
+ * Title:        DAP_sample.c Periodic Variable Sampling
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <string.h>
+#include "DAP_config.h"
+#include "DAP.h"
+
+#if (DAP_SWD != 0)
+
+// Sample set limits
+#define SAMPLE_ENTRY_SIZE       5U      // Address (4 bytes), size
+#define SAMPLE_ENTRIES_MAX      16U
+#define SAMPLE_PERIOD_MIN       100U    // us
+#define SAMPLE_PERIOD_MAX       1000000U
+
+// Sample Read response header: status, dropped, missed, failed (2 bytes each), records
+#define SAMPLE_HEADER_SIZE      8U
+
+// Record: timestamp in us since the start (4 bytes), data of the entries
+//   A record has to fit into a Sample Read response of its own packet and
+//   the ring buffer has to hold at least four. Sample Read run by
+//   DAP_ExecuteCommand returns the records that fit the space left.
+#define SAMPLE_TIME_SIZE        4U
+#define SAMPLE_RECORD_MAX       (DAP_PACKET_SIZE - 1U - SAMPLE_HEADER_SIZE)
+
+#define SAMPLE_COUNTER_MAX      0xFFFFU
+
+static struct {
+  uint32_t period;              // us, 0 when stopped
+  uint32_t time;                // us since the start
+  uint32_t timer;               // Timer value of time
+  uint32_t next;                // Time of the next sample
+  uint32_t record;              // Record size in bytes
+  uint32_t slots;               // Records the ring buffer holds
+  uint32_t head;                // Next record written
+  uint32_t tail;                // Next record read
+  uint32_t count;               // Records queued
+  uint32_t dropped;             // Samples lost to a full ring buffer
+  uint32_t missed;              // Periods passed without a sample
+  uint32_t failed;              // Samples lost to target access errors
+  uint8_t  set[1U + (SAMPLE_ENTRIES_MAX * SAMPLE_ENTRY_SIZE)];   // Read Scatter request
+  uint8_t  buffer[DAP_SAMPLE_BUFFER_SIZE];
+} Sample;
+
+
+// Count an event, saturating
+static void Sample_Count(uint32_t *counter, uint32_t n) {
+  *counter = ((SAMPLE_COUNTER_MAX - *counter) < n) ? SAMPLE_COUNTER_MAX : (*counter + n);
+}
+
+
+// Put a 16-bit counter into the response
+static void Sample_PutCounter(uint8_t *data, uint32_t value) {
+  *(data+0) = (uint8_t)(value >> 0);
+  *(data+1) = (uint8_t)(value >> 8);
+}
+
+
+// Process Sample Configure command and prepare response
+//   Starts sampling a set of variables with a fixed period, a period of 0
+//   stops. Starting again discards queued records and clears the counters.
+//   request:  pointer to request data
+//             period in us (4 bytes), number of entries,
+//             entries: address (4 bytes), size in bytes
+//   response: pointer to response data
+//             status, record size, records the ring buffer holds (2 bytes)
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t DAP_SampleConfigure(const uint8_t *request, uint8_t *response) {
+  uint32_t period;
+  uint32_t count;
+  uint32_t record;
+  uint32_t n;
+
+  period = (uint32_t)(*(request+0) <<  0) |
+           (uint32_t)(*(request+1) <<  8) |
+           (uint32_t)(*(request+2) << 16) |
+           (uint32_t)(*(request+3) << 24);
+  count  = *(request+4);
+
+  record = SAMPLE_TIME_SIZE;
+  for (n = 0U; (n < count) && (n < SAMPLE_ENTRIES_MAX); n++) {
+    if (*(request + 5U + (n * SAMPLE_ENTRY_SIZE) + 4U) == 0U) {
+      break;
+    }
+    record += *(request + 5U + (n * SAMPLE_ENTRY_SIZE) + 4U);
+  }
+
+  Sample.period = 0U;
+  *(response+0) = DAP_OK;
+  *(response+1) = 0U;
+  *(response+2) = 0U;
+  *(response+3) = 0U;
+
+  if (period != 0U) {
+    if ((period < SAMPLE_PERIOD_MIN) || (period > SAMPLE_PERIOD_MAX) ||
+        (count == 0U) || (n != count) ||
+        ((5U + (SAMPLE_ENTRY_SIZE * count)) > DAP_RequestSpace(request)) ||
+        (record > SAMPLE_RECORD_MAX) || (record > (DAP_SAMPLE_BUFFER_SIZE / 4U)) ||
+        (DAP_Data.debug_port != DAP_PORT_SWD)) {
+      *(response+0) = DAP_ERROR;
+    } else {
+      memcpy(Sample.set, request + 4, 1U + (count * SAMPLE_ENTRY_SIZE));
+      Sample.record  = record;
+      Sample.slots   = DAP_SAMPLE_BUFFER_SIZE / record;
+      Sample.head    = 0U;
+      Sample.tail    = 0U;
+      Sample.count   = 0U;
+      Sample.dropped = 0U;
+      Sample.missed  = 0U;
+      Sample.failed  = 0U;
+      Sample.time    = 0U;
+      Sample.timer   = hw_timer_now();
+      Sample.next    = 0U;
+      Sample.period  = period;
+      *(response+1) = (uint8_t)record;
+      Sample_PutCounter(response + 2, Sample.slots);
+    }
+  }
+
+  return (((5U + (SAMPLE_ENTRY_SIZE * count)) << 16) | 4U);
+}
+
+
+// Process Sample Read command and prepare response
+//   Drains queued records, as many as fit into the response. The counters
+//   report samples lost since the last Sample Read and are cleared. Records
+//   queued before sampling stopped can still be drained.
+//   response: pointer to response data
+//             status (DAP_ERROR when stopped), dropped (2 bytes),
+//             missed (2 bytes), failed (2 bytes), number of records,
+//             records: timestamp (4 bytes), data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t DAP_SampleRead(uint8_t *response) {
+  uint8_t *data;
+  uint8_t *end;
+  uint32_t n;
+
+  *(response+0) = (Sample.period != 0U) ? DAP_OK : DAP_ERROR;
+  Sample_PutCounter(response + 1, Sample.dropped);
+  Sample_PutCounter(response + 3, Sample.missed);
+  Sample_PutCounter(response + 5, Sample.failed);
+  Sample.dropped = 0U;
+  Sample.missed  = 0U;
+  Sample.failed  = 0U;
+
+  data = response + SAMPLE_HEADER_SIZE;
+  end  = response + DAP_ResponseSpace(response);
+  for (n = 0U; (n < Sample.count) && ((data + Sample.record) <= end); n++) {
+    memcpy(data, &Sample.buffer[Sample.tail * Sample.record], Sample.record);
+    data += Sample.record;
+    if (++Sample.tail == Sample.slots) {
+      Sample.tail = 0U;
+    }
+  }
+  Sample.count -= n;
+  *(response+7) = (uint8_t)n;
+
+  return ((uint32_t)(data - response));
+}
+
+
+// Take a sample when it is due
+//   Called from the thread that processes DAP commands, between commands.
+//   Samples are polled, not taken in a timer interrupt: a sample waits for
+//   the command being processed and for USB work, so the jitter depends on
+//   the USB traffic. The hardware timer paces the samples, a record holds
+//   the time it was actually taken, late samples keep the period grid and
+//   the periods passed over are counted as missed. Samples are read like
+//   Read Scatter does and leave SELECT, CSW and TAR as the host set them up.
+//   return: us until the next sample, 0 when not sampling
+uint32_t DAP_SampleTask(void) {
+  uint8_t *record;
+  uint32_t late;
+  uint32_t timer;
+
+  if (Sample.period == 0U) {
+    return (0U);
+  }
+
+  // Extend the timer to 32 bits, called at least once per period
+  timer = hw_timer_now();
+  Sample.time += (timer - Sample.timer) & HW_TIMER_MASK;
+  Sample.timer = timer;
+
+  if ((int32_t)(Sample.time - Sample.next) < 0) {
+    return (Sample.next - Sample.time);
+  }
+  late = (Sample.time - Sample.next) / Sample.period;
+  if (late != 0U) {
+    Sample_Count(&Sample.missed, late);
+  }
+  Sample.next += (late + 1U) * Sample.period;
+
+  if (Sample.count == Sample.slots) {
+    Sample_Count(&Sample.dropped, 1U);
+  } else if (DAP_Data.debug_port != DAP_PORT_SWD) {
+    Sample_Count(&Sample.failed, 1U);
+  } else {
+    // Read Scatter fills the record behind status and count, the timestamp overwrites them
+    record = &Sample.buffer[Sample.head * Sample.record];
+    if ((DAP_ReadScatterBuffer(Sample.set, record + 2, Sample.record - 2U) & 0xFFFFU) != (Sample.record - 2U) ||
+        (*(record+2) != DAP_OK)) {
+      Sample_Count(&Sample.failed, 1U);
+    } else {
+      *(record+0) = (uint8_t)(Sample.time >>  0);
+      *(record+1) = (uint8_t)(Sample.time >>  8);
+      *(record+2) = (uint8_t)(Sample.time >> 16);
+      *(record+3) = (uint8_t)(Sample.time >> 24);
+      if (++Sample.head == Sample.slots) {
+        Sample.head = 0U;
+      }
+      Sample.count++;
+    }
+  }
+
+  return (Sample.next - Sample.time);
+}
+
+#endif
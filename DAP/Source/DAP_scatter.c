@@ -0,0 +1,208 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the License); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ----------------------------------------------------------------------
+ *
+ * Project:      CMSIS-DAP Source
+ * Title:        DAP_scatter.c Scatter-Gather Memory Read
+ *
+ *---------------------------------------------------------------------------*/
+
+#include "DAP_config.h"
+#include "DAP.h"
+
+#if (DAP_SWD != 0)
+
+// Entries per request: address (4 bytes), size
+#define SCATTER_ENTRY_SIZE      5U
+#define SCATTER_ENTRIES_MAX     64U
+
+// Gap read through instead of starting a new burst, costs less than the
+// CSW and TAR writes, posted read and RDBUFF read of a new burst
+#define SCATTER_GAP_WORDS       4U
+
+// Gaps are only read below the peripheral region, reads there have no side effects
+#define SCATTER_GAP_LIMIT       0x40000000U
+
+// Kept off the USB thread stack
+static uint16_t offset[SCATTER_ENTRIES_MAX];    // Data offset in the response
+static uint8_t  order[SCATTER_ENTRIES_MAX];     // Entries sorted by address
+
+// Burst being read, for Scatter_Word
+static struct {
+  const uint8_t *request;       // Entries
+  uint8_t *data;                // Data of the entries in the response
+  uint32_t first;               // First entry in order not completely read
+  uint32_t last;                // Entry in order after the burst
+} Burst;
+
+
+// Get the address of an entry
+static uint32_t Scatter_Address(const uint8_t *entry) {
+  return ((uint32_t)(*(entry+0) <<  0) |
+          (uint32_t)(*(entry+1) <<  8) |
+          (uint32_t)(*(entry+2) << 16) |
+          (uint32_t)(*(entry+3) << 24));
+}
+
+
+// Put a word read into the entries it belongs to
+//   address: word address
+//   value:   word read
+static void Scatter_Word(uint32_t address, uint32_t value) {
+  const uint8_t *entry;
+  uint32_t start;
+  uint32_t end;
+  uint32_t from;
+  uint32_t i;
+  uint8_t  k;
+
+  for (i = Burst.first; i < Burst.last; i++) {
+    k     = order[i];
+    entry = Burst.request + (k * SCATTER_ENTRY_SIZE);
+    start = Scatter_Address(entry);
+    end   = start + *(entry+4);
+    if (start >= (address + 4U)) {
+      break;                    // Entries further on start later
+    }
+    if (end <= address) {
+      if (i == Burst.first) {
+        Burst.first++;
+      }
+      continue;
+    }
+    for (from = (start > address) ? start : address; (from < end) && (from < (address + 4U)); from++) {
+      *(Burst.data + offset[k] + (from - start)) = (uint8_t)(value >> (8U * (from - address)));
+    }
+  }
+}
+
+
+// Read Scatter into a buffer
+//   Reads a list of variables from MEM-AP 0 with the probe side target
+//   access. The entries are sorted by address, entries in the same or
+//   nearby words are merged into one auto-increment burst, TAR is written
+//   once per auto-increment block and the words go straight into the
+//   response. The Debug Port has to be powered up, SELECT, CSW and TAR are
+//   left as the host set them up.
+//   request:  pointer to request data
+//             number of entries, entries: address (4 bytes), size in bytes
+//   response: pointer to response data
+//             status, number of entries read, data of the entries in
+//             request order, packed
+//   size:     number of bytes the response may take
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t DAP_ReadScatterBuffer(const uint8_t *request, uint8_t *response, uint32_t size) {
+  Target_Host_t host;
+  const uint8_t *entry;
+  uint32_t count;
+  uint32_t total;
+  uint32_t start;
+  uint32_t end;
+  uint32_t first;
+  uint32_t last;
+  uint32_t address;
+  uint32_t response_value;
+  uint32_t n;
+  uint32_t i;
+
+  count = *request++;
+
+  *(response+0) = DAP_OK;
+  *(response+1) = 0U;
+
+  // Data offsets in request order, insertion sort by address
+  total = 0U;
+  for (n = 0U; (n < count) && (n < SCATTER_ENTRIES_MAX); n++) {
+    entry = request + (n * SCATTER_ENTRY_SIZE);
+    if (*(entry+4) == 0U) {
+      break;
+    }
+    offset[n] = (uint16_t)total;
+    total += *(entry+4);
+    address = Scatter_Address(entry);
+    for (i = n; (i != 0U) && (Scatter_Address(request + (order[i-1U] * SCATTER_ENTRY_SIZE)) > address); i--) {
+      order[i] = order[i-1U];
+    }
+    order[i] = (uint8_t)n;
+  }
+  if ((n != count) ||
+      ((2U + total) > size) ||
+      (DAP_Data.debug_port != DAP_PORT_SWD) ||
+      (Target_Save(&host) != DAP_TRANSFER_OK)) {
+    *(response+0) = DAP_ERROR;
+    return (((1U + (SCATTER_ENTRY_SIZE * count)) << 16) | 2U);
+  }
+
+  Burst.request  = request;
+  Burst.data     = response + 2;
+  response_value = DAP_TRANSFER_OK;
+  for (first = 0U; (first < count) && (response_value == DAP_TRANSFER_OK); first = last) {
+    // Burst: word range covering the entries from first to last - 1
+    entry = request + (order[first] * SCATTER_ENTRY_SIZE);
+    start = Scatter_Address(entry) & ~3U;
+    end   = (Scatter_Address(entry) + *(entry+4) + 3U) & ~3U;
+    for (last = first + 1U; last < count; last++) {
+      entry   = request + (order[last] * SCATTER_ENTRY_SIZE);
+      address = Scatter_Address(entry) & ~3U;
+      if ((address > end) &&
+          (((address - end) > (SCATTER_GAP_WORDS * 4U)) || (address >= SCATTER_GAP_LIMIT))) {
+        break;
+      }
+      address = (Scatter_Address(entry) + *(entry+4) + 3U) & ~3U;
+      if (address > end) {
+        end = address;
+      }
+    }
+
+    Burst.first = first;
+    Burst.last  = last;
+    response_value = Target_ReadEach(start, (end - start) / 4U, Scatter_Word);
+  }
+
+  Target_Restore(&host);
+  if (response_value != DAP_TRANSFER_OK) {
+    *(response+0) = DAP_ERROR;
+    return (((1U + (SCATTER_ENTRY_SIZE * count)) << 16) | 2U);
+  }
+
+  *(response+1) = (uint8_t)count;
+
+  return (((1U + (SCATTER_ENTRY_SIZE * count)) << 16) | (2U + total));
+}
+
+
+// Process Read Scatter command and prepare response
+//   request:  pointer to request data
+//             number of entries, entries: address (4 bytes), size in bytes
+//   response: pointer to response data
+//             status, number of entries read, data of the entries
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t DAP_ReadScatter(const uint8_t *request, uint8_t *response) {
+  uint32_t count;
+
+  count = *request;
+  if ((1U + (SCATTER_ENTRY_SIZE * count)) > DAP_RequestSpace(request)) {
+    *(response+0) = DAP_ERROR;
+    *(response+1) = 0U;
+    return (((1U + (SCATTER_ENTRY_SIZE * count)) << 16) | 2U);
+  }
+
+  return (DAP_ReadScatterBuffer(request, response, DAP_ResponseSpace(response)));
+}
+
+#endif
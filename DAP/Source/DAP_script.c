@@ -0,0 +1,463 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the License); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ----------------------------------------------------------------------
+ *
+ * Project:      CMSIS-DAP Source
+ * Title:        DAP_script.c Debug Sequence Scripts
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <string.h>
+#include "DAP_config.h"
+#include "DAP.h"
+
+#if (DAP_SWD != 0)
+
+// Instructions: opcode, operands
+//   d, s, a, b, c: register numbers, packed into nibbles of one byte
+//   A: DP/AP register A[3:2]
+//   off16: signed jump offset from the next instruction
+#define SCRIPT_OP_EXIT          0x00U   // EXIT imm8                 stop with exit code
+#define SCRIPT_OP_JMP           0x01U   // JMP off16
+#define SCRIPT_OP_DELAY         0x02U   // DELAY imm16               wait in us
+#define SCRIPT_OP_LINERESET     0x03U   // LINERESET                 SWD line reset
+#define SCRIPT_OP_RESET         0x04U   // RESET imm8                nRESET pin: 0 = low, 1 = high
+#define SCRIPT_OP_ALU           0x10U   // op d:s                    d = d op s
+#define SCRIPT_OP_ALUI          0x18U   // opI d, imm32              d = d op imm32
+#define SCRIPT_OP_DPR           0x20U   // DPR d:A
+#define SCRIPT_OP_DPW           0x21U   // DPW s:A
+#define SCRIPT_OP_APR           0x22U   // APR d:A                   read with RDBUFF
+#define SCRIPT_OP_APW           0x23U   // APW s:A
+#define SCRIPT_OP_RD32          0x24U   // RD32 d:a                  d = [a], MEM-AP 0
+#define SCRIPT_OP_WR32          0x25U   // WR32 s:a                  [a] = s, MEM-AP 0
+#define SCRIPT_OP_JEQ           0x30U   // JEQ a:b, off16
+#define SCRIPT_OP_JNE           0x31U   // JNE a:b, off16
+#define SCRIPT_OP_JLO           0x32U   // JLO a:b, off16            unsigned a < b
+#define SCRIPT_OP_JHS           0x33U   // JHS a:b, off16            unsigned a >= b
+#define SCRIPT_OP_LOOP          0x34U   // LOOP c:0, off16           c = c - 1, jump when not 0
+
+// ALU operations, low 3 bits of SCRIPT_OP_ALU and SCRIPT_OP_ALUI
+#define SCRIPT_ALU_MOV          0U
+#define SCRIPT_ALU_ADD          1U
+#define SCRIPT_ALU_SUB          2U
+#define SCRIPT_ALU_AND          3U
+#define SCRIPT_ALU_OR           4U
+#define SCRIPT_ALU_XOR          5U
+#define SCRIPT_ALU_LSL          6U
+#define SCRIPT_ALU_LSR          7U
+
+#define SCRIPT_REGS             8U
+#define SCRIPT_HI(byte)         ((uint32_t)(byte) >> 4)
+#define SCRIPT_LO(byte)         ((uint32_t)(byte) & 0x0FU)
+
+// Run limits
+#define SCRIPT_STEPS_MAX        1000000U        // Instructions per run
+#define SCRIPT_TIME_MAX         1000000U        // us per run
+
+// Script Load response: verified script instead of an instruction offset
+#define SCRIPT_VALID            0xFFFFU
+
+// Script Run stop reasons
+#define SCRIPT_STOP_EXIT        0U      // EXIT, exit code follows
+#define SCRIPT_STOP_INVALID     1U      // No verified script loaded
+#define SCRIPT_STOP_STEPS       2U      // Step budget used up
+#define SCRIPT_STOP_TIME        3U      // SCRIPT_TIME_MAX passed
+#define SCRIPT_STOP_TRANSFER    4U      // Target access failed, ACK follows
+#define SCRIPT_STOP_ABORT       5U      // Transfer Abort
+#define SCRIPT_STOP_REQUEST     6U      // Arguments do not fit the request, not run
+
+// Script Run response: status, stop reason, exit code, pc (2 bytes),
+// steps (4 bytes), registers (4 bytes each)
+#define SCRIPT_RESPONSE_SIZE    (9U + (4U * SCRIPT_REGS))
+
+// Kept off the USB thread stack
+static struct {
+  uint32_t size;                        // Bytes loaded
+  uint32_t valid;                       // Loaded script verified
+  uint32_t reg[SCRIPT_REGS];
+  uint8_t  start[DAP_SCRIPT_SIZE / 8U]; // Instruction start bitmap
+  uint8_t  code[DAP_SCRIPT_SIZE];
+} Script;
+
+
+// Length of an instruction
+//   op:     opcode
+//   return: length in bytes, 0 for an invalid opcode
+static uint32_t Script_Length(uint32_t op) {
+  uint32_t length;
+
+  if (op == SCRIPT_OP_LINERESET) {
+    length = 1U;
+  } else if ((op == SCRIPT_OP_EXIT) || (op == SCRIPT_OP_RESET) ||
+             ((op >= SCRIPT_OP_ALU) && (op < SCRIPT_OP_ALUI)) ||
+             ((op >= SCRIPT_OP_DPR) && (op <= SCRIPT_OP_WR32))) {
+    length = 2U;
+  } else if ((op == SCRIPT_OP_JMP) || (op == SCRIPT_OP_DELAY)) {
+    length = 3U;
+  } else if ((op >= SCRIPT_OP_JEQ) && (op <= SCRIPT_OP_LOOP)) {
+    length = 4U;
+  } else if ((op >= SCRIPT_OP_ALUI) && (op < (SCRIPT_OP_ALUI + 8U))) {
+    length = 6U;
+  } else {
+    length = 0U;
+  }
+
+  return (length);
+}
+
+
+// Get the jump target of an instruction
+//   pc:     instruction offset
+//   return: target offset, negative when out of range
+static int32_t Script_Target(uint32_t pc) {
+  const uint8_t *code;
+  uint32_t length;
+  int16_t  offset;
+
+  code   = &Script.code[pc];
+  length = Script_Length(*code);
+  offset = (int16_t)(*(code + length - 2U) | (*(code + length - 1U) << 8));
+
+  return ((int32_t)(pc + length) + offset);
+}
+
+
+// Verify the loaded script
+//   Every instruction has to be complete with valid register numbers, jumps
+//   have to land on instructions and the last instruction must not fall
+//   through to the end.
+//   return: offset of the first invalid instruction, SCRIPT_VALID when the
+//           script verifies
+static uint32_t Script_Verify(void) {
+  const uint8_t *code;
+  uint32_t length;
+  uint32_t last;
+  uint32_t pc;
+  uint32_t op;
+  int32_t  target;
+  uint32_t ok;
+
+  memset(Script.start, 0, sizeof(Script.start));
+  if (Script.size == 0U) {
+    return (0U);
+  }
+
+  last = 0U;
+  for (pc = 0U; pc < Script.size; pc += length) {
+    code   = &Script.code[pc];
+    op     = *code;
+    length = Script_Length(op);
+    if ((length == 0U) || ((pc + length) > Script.size)) {
+      return (pc);
+    }
+    if (op == SCRIPT_OP_RESET) {
+      ok = (*(code+1) <= 1U);
+    } else if ((op >= SCRIPT_OP_ALU) && (op < SCRIPT_OP_ALUI)) {
+      ok = (SCRIPT_HI(*(code+1)) < SCRIPT_REGS) && (SCRIPT_LO(*(code+1)) < SCRIPT_REGS);
+    } else if ((op >= SCRIPT_OP_ALUI) && (op < SCRIPT_OP_DPR)) {
+      ok = (*(code+1) < SCRIPT_REGS);
+    } else if ((op >= SCRIPT_OP_DPR) && (op <= SCRIPT_OP_APW)) {
+      ok = (SCRIPT_HI(*(code+1)) < SCRIPT_REGS) && (SCRIPT_LO(*(code+1)) < 4U);
+    } else if ((op == SCRIPT_OP_RD32) || (op == SCRIPT_OP_WR32) ||
+               ((op >= SCRIPT_OP_JEQ) && (op <= SCRIPT_OP_JHS))) {
+      ok = (SCRIPT_HI(*(code+1)) < SCRIPT_REGS) && (SCRIPT_LO(*(code+1)) < SCRIPT_REGS);
+    } else if (op == SCRIPT_OP_LOOP) {
+      ok = (SCRIPT_HI(*(code+1)) < SCRIPT_REGS) && (SCRIPT_LO(*(code+1)) == 0U);
+    } else {
+      ok = 1U;
+    }
+    if (ok == 0U) {
+      return (pc);
+    }
+    Script.start[pc / 8U] |= (uint8_t)(1U << (pc % 8U));
+    last = pc;
+  }
+  if ((Script.code[last] != SCRIPT_OP_EXIT) && (Script.code[last] != SCRIPT_OP_JMP)) {
+    return (last);
+  }
+
+  for (pc = 0U; pc < Script.size; pc += Script_Length(op)) {
+    op = Script.code[pc];
+    if ((op == SCRIPT_OP_JMP) || ((op >= SCRIPT_OP_JEQ) && (op <= SCRIPT_OP_LOOP))) {
+      target = Script_Target(pc);
+      if ((target < 0) || ((uint32_t)target >= Script.size) ||
+          ((Script.start[(uint32_t)target / 8U] & (1U << ((uint32_t)target % 8U))) == 0U)) {
+        return (pc);
+      }
+    }
+  }
+
+  return (SCRIPT_VALID);
+}
+
+
+// SWD Transfer with retries on WAIT response
+//   request: A[3:2] RnW APnDP
+//   data:    DATA[31:0]
+//   return:  ACK[2:0]
+static uint32_t Script_Transfer(uint32_t request, uint32_t *data) {
+  uint32_t response_value;
+  uint32_t retry;
+
+  retry = DAP_Data.transfer.retry_count;
+  do {
+    response_value = SWD_Transfer(request, data);
+  } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
+
+  return (response_value);
+}
+
+
+// Apply an ALU operation
+static uint32_t Script_Alu(uint32_t op, uint32_t a, uint32_t b) {
+  uint32_t result;
+
+  switch (op & 0x07U) {
+    case SCRIPT_ALU_MOV:
+      result = b;
+      break;
+    case SCRIPT_ALU_ADD:
+      result = a + b;
+      break;
+    case SCRIPT_ALU_SUB:
+      result = a - b;
+      break;
+    case SCRIPT_ALU_AND:
+      result = a & b;
+      break;
+    case SCRIPT_ALU_OR:
+      result = a | b;
+      break;
+    case SCRIPT_ALU_XOR:
+      result = a ^ b;
+      break;
+    case SCRIPT_ALU_LSL:
+      result = (b < 32U) ? (a << b) : 0U;
+      break;
+    default:
+      result = (b < 32U) ? (a >> b) : 0U;
+      break;
+  }
+
+  return (result);
+}
+
+
+// Process Script Load command and prepare response
+//   Loads a part of a script, a load at offset 0 starts a new script. The
+//   script loaded so far is verified after each load, it can only be run
+//   when it verifies.
+//   request:  pointer to request data
+//             offset (2 bytes), number of bytes (2 bytes), bytes
+//   response: pointer to response data
+//             status, offset of the first invalid instruction (2 bytes,
+//             0xFFFF when the script verifies)
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t DAP_ScriptLoad(const uint8_t *request, uint8_t *response) {
+  uint32_t offset;
+  uint32_t count;
+  uint32_t result;
+
+  offset = (uint32_t)(*(request+0) << 0) |
+           (uint32_t)(*(request+1) << 8);
+  count  = (uint32_t)(*(request+2) << 0) |
+           (uint32_t)(*(request+3) << 8);
+
+  *(response+0) = DAP_ERROR;
+  *(response+1) = 0U;
+  *(response+2) = 0U;
+
+  if ((4U + count) > DAP_RequestSpace(request)) {
+    Script.valid = 0U;
+    return ((4U << 16) | 3U);
+  }
+  if (((offset != 0U) && (offset != Script.size)) || ((offset + count) > DAP_SCRIPT_SIZE)) {
+    Script.valid = 0U;
+    return (((4U + count) << 16) | 3U);
+  }
+
+  memcpy(&Script.code[offset], request + 4, count);
+  Script.size  = offset + count;
+  result       = Script_Verify();
+  Script.valid = (result == SCRIPT_VALID) ? 1U : 0U;
+
+  *(response+0) = DAP_OK;
+  *(response+1) = (uint8_t)(result >> 0);
+  *(response+2) = (uint8_t)(result >> 8);
+
+  return (((4U + count) << 16) | 3U);
+}
+
+
+// Process Script Run command and prepare response
+//   Runs the loaded script with the registers set up from the request, the
+//   remaining registers are 0. A run is limited to the step budget and to
+//   SCRIPT_TIME_MAX. Memory accesses go through MEM-AP 0 like the other
+//   probe side accesses, so the host has to set up SELECT, CSW and TAR
+//   again afterwards.
+//   request:  pointer to request data
+//             step budget (4 bytes, 0 = SCRIPT_STEPS_MAX), number of
+//             arguments (up to 8, more is refused), arguments (4 bytes
+//             each) for r0 onwards
+//   response: pointer to response data
+//             status (DAP_OK on EXIT), stop reason, exit code or ACK,
+//             pc (2 bytes), steps (4 bytes), r0..r7 (4 bytes each)
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t DAP_ScriptRun(const uint8_t *request, uint8_t *response) {
+  static const uint8_t line_reset[8] = {
+    0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0x00U
+  };
+  const uint8_t *code;
+  uint32_t budget;
+  uint32_t count;
+  uint32_t steps;
+  uint32_t start;
+  uint32_t reason;
+  uint32_t result;
+  uint32_t ack;
+  uint32_t pc;
+  uint32_t op;
+  uint32_t data;
+  uint32_t *d;
+  uint32_t n;
+
+  budget = (uint32_t)(*(request+0) <<  0) |
+           (uint32_t)(*(request+1) <<  8) |
+           (uint32_t)(*(request+2) << 16) |
+           (uint32_t)(*(request+3) << 24);
+  count  = *(request+4);
+  if ((budget == 0U) || (budget > SCRIPT_STEPS_MAX)) {
+    budget = SCRIPT_STEPS_MAX;
+  }
+
+  memset(Script.reg, 0, sizeof(Script.reg));
+  reason = (Script.valid != 0U) ? SCRIPT_STOP_EXIT : SCRIPT_STOP_INVALID;
+  if ((count > SCRIPT_REGS) || ((5U + (4U * count)) > DAP_RequestSpace(request))) {
+    count  = 0U;
+    reason = SCRIPT_STOP_REQUEST;
+  }
+  for (n = 0U; n < count; n++) {
+    Script.reg[n] = (uint32_t)(*(request + 5U + (n * 4U) + 0U) <<  0) |
+                    (uint32_t)(*(request + 5U + (n * 4U) + 1U) <<  8) |
+                    (uint32_t)(*(request + 5U + (n * 4U) + 2U) << 16) |
+                    (uint32_t)(*(request + 5U + (n * 4U) + 3U) << 24);
+  }
+
+  DAP_TransferAbort = 0U;
+  result = 0U;
+  steps  = 0U;
+  pc     = 0U;
+  start  = DELAY_TIMER_GET();
+  while (reason == SCRIPT_STOP_EXIT) {
+    if (steps == budget) {
+      reason = SCRIPT_STOP_STEPS;
+      break;
+    }
+    if (DELAY_TIMER_ELAPSED(start) > SCRIPT_TIME_MAX) {
+      reason = SCRIPT_STOP_TIME;
+      break;
+    }
+    if (DAP_TransferAbort) {
+      reason = SCRIPT_STOP_ABORT;
+      break;
+    }
+    steps++;
+
+    code = &Script.code[pc];
+    op   = *code;
+    d    = &Script.reg[SCRIPT_HI(*(code+1)) % SCRIPT_REGS];
+    ack  = DAP_TRANSFER_OK;
+    if (op == SCRIPT_OP_EXIT) {
+      result = *(code+1);
+      break;
+    } else if (op == SCRIPT_OP_JMP) {
+      pc = (uint32_t)Script_Target(pc);
+      continue;
+    } else if (op == SCRIPT_OP_DELAY) {
+      Delayus((uint32_t)(*(code+1) | (*(code+2) << 8)));
+    } else if (op == SCRIPT_OP_LINERESET) {
+      SWJ_Sequence(64U, line_reset);
+    } else if (op == SCRIPT_OP_RESET) {
+      PIN_nRESET_OUT(*(code+1));
+    } else if (op < SCRIPT_OP_ALUI) {
+      *d = Script_Alu(op, *d, Script.reg[SCRIPT_LO(*(code+1))]);
+    } else if (op < SCRIPT_OP_DPR) {
+      d = &Script.reg[*(code+1)];
+      data = (uint32_t)(*(code+2) <<  0) |
+             (uint32_t)(*(code+3) <<  8) |
+             (uint32_t)(*(code+4) << 16) |
+             (uint32_t)(*(code+5) << 24);
+      *d = Script_Alu(op, *d, data);
+    } else if ((op < SCRIPT_OP_JEQ) && (DAP_Data.debug_port != DAP_PORT_SWD)) {
+      ack = DAP_TRANSFER_ERROR;
+    } else if (op == SCRIPT_OP_DPR) {
+      ack = Script_Transfer((SCRIPT_LO(*(code+1)) << 2) | DAP_TRANSFER_RnW, d);
+    } else if (op == SCRIPT_OP_DPW) {
+      ack = Script_Transfer(SCRIPT_LO(*(code+1)) << 2, d);
+    } else if (op == SCRIPT_OP_APR) {
+      ack = Script_Transfer((SCRIPT_LO(*(code+1)) << 2) | DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW, NULL);
+      if (ack == DAP_TRANSFER_OK) {
+        ack = Script_Transfer(DP_RDBUFF | DAP_TRANSFER_RnW, d);
+      }
+    } else if (op == SCRIPT_OP_APW) {
+      ack = Script_Transfer((SCRIPT_LO(*(code+1)) << 2) | DAP_TRANSFER_APnDP, d);
+    } else if (op == SCRIPT_OP_RD32) {
+      ack = Target_Read32(Script.reg[SCRIPT_LO(*(code+1))], d);
+    } else if (op == SCRIPT_OP_WR32) {
+      ack = Target_Write32(Script.reg[SCRIPT_LO(*(code+1))], *d);
+    }
+    if (ack != DAP_TRANSFER_OK) {
+      reason = SCRIPT_STOP_TRANSFER;
+      result = ack;
+      break;
+    }
+
+    if (op == SCRIPT_OP_LOOP) {
+      (*d)--;
+    }
+    if (((op == SCRIPT_OP_JEQ) && (*d == Script.reg[SCRIPT_LO(*(code+1))])) ||
+        ((op == SCRIPT_OP_JNE) && (*d != Script.reg[SCRIPT_LO(*(code+1))])) ||
+        ((op == SCRIPT_OP_JLO) && (*d <  Script.reg[SCRIPT_LO(*(code+1))])) ||
+        ((op == SCRIPT_OP_JHS) && (*d >= Script.reg[SCRIPT_LO(*(code+1))])) ||
+        ((op == SCRIPT_OP_LOOP) && (*d != 0U))) {
+      pc = (uint32_t)Script_Target(pc);
+    } else {
+      pc += Script_Length(op);
+    }
+  }
+
+  *(response+0) = (reason == SCRIPT_STOP_EXIT) ? DAP_OK : DAP_ERROR;
+  *(response+1) = (uint8_t)reason;
+  *(response+2) = (uint8_t)result;
+  *(response+3) = (uint8_t)(pc >> 0);
+  *(response+4) = (uint8_t)(pc >> 8);
+  *(response+5) = (uint8_t)(steps >>  0);
+  *(response+6) = (uint8_t)(steps >>  8);
+  *(response+7) = (uint8_t)(steps >> 16);
+  *(response+8) = (uint8_t)(steps >> 24);
+  for (n = 0U; n < SCRIPT_REGS; n++) {
+    *(response + 9U + (n * 4U) + 0U) = (uint8_t)(Script.reg[n] >>  0);
+    *(response + 9U + (n * 4U) + 1U) = (uint8_t)(Script.reg[n] >>  8);
+    *(response + 9U + (n * 4U) + 2U) = (uint8_t)(Script.reg[n] >> 16);
+    *(response + 9U + (n * 4U) + 3U) = (uint8_t)(Script.reg[n] >> 24);
+  }
+
+  return (((5U + (4U * count)) << 16) | SCRIPT_RESPONSE_SIZE);
+}
+
+#endif
@@ -0,0 +1,732 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the License); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ----------------------------------------------------------------------
+ *
+ * Project:      CMSIS-DAP Source
+ * Title:        DAP_target.c Probe Side Target Access
+ *
+ *---------------------------------------------------------------------------*/
+
+#include "DAP_config.h"
+#include "DAP.h"
+
+#if (DAP_SWD != 0)
+
+// MEM-AP CSW: 32-bit access, auto-increment single, privileged data access
+#define TARGET_CSW              0x23000012U
+
+// TAR auto-increment is only guaranteed within a 1 KB block
+#define TARGET_TAR_BLOCK        0x400U
+
+// Poll limits in transfers
+#define TARGET_POWERUP_POLLS    100U
+#define TARGET_HALT_POLLS       1000U
+#define TARGET_REGRDY_POLLS     100U
+
+// Banked data registers of AP 0 with TAR at DHCSR: SELECT and A[3:2]
+#define TARGET_BD_SELECT        0x00000010U     // AP 0, bank 1
+#define TARGET_BD_HCSR          0x00U           // BD0: DHCSR
+#define TARGET_BD_CRSR          0x04U           // BD1: DCRSR
+#define TARGET_BD_CRDR          0x08U           // BD2: DCRDR
+
+// CTRL/STAT: power-up acknowledges, sticky error flags
+#define TARGET_CTRL_POWERED     (DP_CTRL_CSYSPWRUPACK | DP_CTRL_CDBGPWRUPACK)
+#define TARGET_CTRL_STICKY      0x000000B2U     // WDATAERR, STICKYERR, STICKYCMP, STICKYORUN
+
+static uint8_t TargetProbe;             // Port connected by Target_Begin, no host session
+
+
+// SWD Transfer with retries on WAIT response
+//   request: A[3:2] RnW APnDP
+//   data:    DATA[31:0]
+//   return:  ACK[2:0]
+static uint32_t Target_Transfer(uint32_t request, uint32_t *data) {
+  uint32_t response_value;
+  uint32_t retry;
+
+  retry = DAP_Data.transfer.retry_count;
+  do {
+    response_value = SWD_Transfer(request, data);
+  } while ((response_value == DAP_TRANSFER_WAIT) && retry--);
+
+  return (response_value);
+}
+
+
+// Select AP 0 bank 0 and set CSW and TAR
+//   The host may have changed SELECT and CSW between probe side accesses.
+//   address: transfer address
+//   return:  DAP_TRANSFER_OK or error ACK
+static uint32_t Target_Address(uint32_t address) {
+  uint32_t response_value;
+  uint32_t data;
+
+  data = 0U;
+  response_value = Target_Transfer(DP_SELECT, &data);
+  if (response_value == DAP_TRANSFER_OK) {
+    data = TARGET_CSW;
+    response_value = Target_Transfer(DAP_TRANSFER_APnDP | AP_CSW, &data);
+  }
+  if (response_value == DAP_TRANSFER_OK) {
+    response_value = Target_Transfer(DAP_TRANSFER_APnDP | AP_TAR, &address);
+  }
+
+  return (response_value);
+}
+
+
+// Words up to the next TAR auto-increment boundary
+static uint32_t Target_Block(uint32_t address, uint32_t count) {
+  uint32_t n;
+
+  n = (TARGET_TAR_BLOCK - (address & (TARGET_TAR_BLOCK - 1U))) / 4U;
+  return ((count < n) ? count : n);
+}
+
+
+// Connect to the target over SWD and power up the debug domain
+//   JTAG-to-SWD switch, line reset, DPIDR read, sticky error clear and
+//   debug/system power-up request.
+//   dpidr:  pointer to DPIDR read from the target, may be NULL
+//   return: DAP_TRANSFER_OK or error ACK
+uint32_t Target_Connect(uint32_t *dpidr) {
+  static const uint8_t line_reset[8] = {
+    0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0x00U
+  };
+  static const uint8_t jtag_to_swd[2] = {
+    0x9EU, 0xE7U
+  };
+  uint32_t response_value;
+  uint32_t data;
+  uint32_t n;
+
+  DAP_Data.debug_port = DAP_PORT_SWD;
+  PORT_SWD_SETUP();
+  TargetProbe = 0U;
+
+  SWJ_Sequence(56U, line_reset);
+  SWJ_Sequence(16U, jtag_to_swd);
+  SWJ_Sequence(64U, line_reset);
+
+  response_value = Target_Transfer(DP_IDCODE | DAP_TRANSFER_RnW, &data);
+  if (response_value != DAP_TRANSFER_OK) {
+    return (response_value);
+  }
+  if (dpidr != NULL) {
+    *dpidr = data;
+  }
+
+  data = DP_ABORT_STKCMPCLR | DP_ABORT_STKERRCLR | DP_ABORT_WDERRCLR | DP_ABORT_ORUNERRCLR;
+  response_value = Target_Transfer(DP_ABORT, &data);
+  if (response_value != DAP_TRANSFER_OK) {
+    return (response_value);
+  }
+
+  data = DP_CTRL_CSYSPWRUPREQ | DP_CTRL_CDBGPWRUPREQ;
+  response_value = Target_Transfer(DP_CTRL_STAT, &data);
+  for (n = TARGET_POWERUP_POLLS; n && (response_value == DAP_TRANSFER_OK); n--) {
+    response_value = Target_Transfer(DP_CTRL_STAT | DAP_TRANSFER_RnW, &data);
+    if ((data & (DP_CTRL_CSYSPWRUPACK | DP_CTRL_CDBGPWRUPACK)) ==
+                (DP_CTRL_CSYSPWRUPACK | DP_CTRL_CDBGPWRUPACK)) {
+      return (response_value);
+    }
+  }
+
+  return ((response_value != DAP_TRANSFER_OK) ? response_value : DAP_TRANSFER_ERROR);
+}
+
+
+// Release the SWD pins
+void Target_Disconnect(void) {
+  DAP_Data.debug_port = DAP_PORT_DISABLED;
+  PORT_OFF();
+}
+
+
+// Read a block of words from target memory
+//   address: word aligned address
+//   data:    pointer to data read
+//   count:   number of words
+//   return:  DAP_TRANSFER_OK or error ACK
+uint32_t Target_ReadMem(uint32_t address, uint32_t *data, uint32_t count) {
+  uint32_t response_value;
+  uint32_t n;
+
+  response_value = DAP_TRANSFER_OK;
+  while (count && (response_value == DAP_TRANSFER_OK)) {
+    n = Target_Block(address, count);
+    address += n * 4U;
+    count   -= n;
+
+    // AP reads are posted: the first DRW read returns stale data
+    response_value = Target_Address(address - (n * 4U));
+    if (response_value == DAP_TRANSFER_OK) {
+      response_value = Target_Transfer(DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | AP_DRW, NULL);
+    }
+    for (; n && (response_value == DAP_TRANSFER_OK); n--) {
+      if (n == 1U) {
+        response_value = Target_Transfer(DP_RDBUFF | DAP_TRANSFER_RnW, data++);
+      } else {
+        response_value = Target_Transfer(DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | AP_DRW, data++);
+      }
+    }
+  }
+
+  return (response_value);
+}
+
+
+// Read words from target memory one by one
+//   For reads into places other than a word buffer: TAR is written once
+//   per auto-increment block and each word is passed on as it arrives.
+//   Bank 0 of AP 0 has to be selected, see Target_Save.
+//   address: word aligned address
+//   count:   number of words
+//   put:     called with the address and value of each word read
+//   return:  DAP_TRANSFER_OK or error ACK
+uint32_t Target_ReadEach(uint32_t address, uint32_t count, void (*put)(uint32_t address, uint32_t value)) {
+  uint32_t response_value;
+  uint32_t value;
+  uint32_t n;
+
+  value = TARGET_CSW;
+  response_value = Target_Transfer(DAP_TRANSFER_APnDP | AP_CSW, &value);
+  while (count && (response_value == DAP_TRANSFER_OK)) {
+    n = Target_Block(address, count);
+    count -= n;
+
+    // AP reads are posted: the first DRW read returns stale data
+    value = address;
+    response_value = Target_Transfer(DAP_TRANSFER_APnDP | AP_TAR, &value);
+    if (response_value == DAP_TRANSFER_OK) {
+      response_value = Target_Transfer(DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | AP_DRW, NULL);
+    }
+    for (; n && (response_value == DAP_TRANSFER_OK); n--) {
+      if (n == 1U) {
+        response_value = Target_Transfer(DP_RDBUFF | DAP_TRANSFER_RnW, &value);
+      } else {
+        response_value = Target_Transfer(DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | AP_DRW, &value);
+      }
+      if (response_value == DAP_TRANSFER_OK) {
+        put(address, value);
+      }
+      address += 4U;
+    }
+  }
+
+  return (response_value);
+}
+
+
+// Write a block of words to target memory
+//   address: word aligned address
+//   data:    pointer to data to write
+//   count:   number of words
+//   return:  DAP_TRANSFER_OK or error ACK
+uint32_t Target_WriteMem(uint32_t address, const uint32_t *data, uint32_t count) {
+  uint32_t response_value;
+  uint32_t value;
+  uint32_t n;
+
+  response_value = DAP_TRANSFER_OK;
+  while (count && (response_value == DAP_TRANSFER_OK)) {
+    n = Target_Block(address, count);
+    response_value = Target_Address(address);
+    address += n * 4U;
+    count   -= n;
+
+    for (; n && (response_value == DAP_TRANSFER_OK); n--) {
+      value = *data++;
+      response_value = Target_Transfer(DAP_TRANSFER_APnDP | AP_DRW, &value);
+    }
+  }
+
+  // Last write completes with the RDBUFF read
+  if (response_value == DAP_TRANSFER_OK) {
+    response_value = Target_Transfer(DP_RDBUFF | DAP_TRANSFER_RnW, NULL);
+  }
+
+  return (response_value);
+}
+
+
+// Read one word from target memory
+//   A DHCSR read keeps the sticky bits it clears for the host.
+uint32_t Target_Read32(uint32_t address, uint32_t *data) {
+  uint32_t response_value;
+
+  response_value = Target_ReadMem(address, data, 1U);
+  if ((response_value == DAP_TRANSFER_OK) && (address == DBG_HCSR)) {
+    DAP_TransferSticky(*data);
+  }
+  return (response_value);
+}
+
+
+// Write one word to target memory
+uint32_t Target_Write32(uint32_t address, uint32_t data) {
+  return (Target_WriteMem(address, &data, 1U));
+}
+
+
+// Save the MEM-AP set up of the host
+//   Selects bank 0 of AP 0 and reads CSW and TAR. Probe side accesses
+//   between Target_Save and Target_Restore are not noticed by a host
+//   caching SELECT, CSW or TAR.
+//   host:   pointer to saved state
+//   return: DAP_TRANSFER_OK or error ACK
+uint32_t Target_Save(Target_Host_t *host) {
+  uint32_t response_value;
+  uint32_t value;
+
+  host->select = 0U;
+  value = 0U;
+  response_value = Target_Transfer(DP_SELECT, &value);
+  if (response_value == DAP_TRANSFER_OK) {
+    response_value = Target_Transfer(DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | AP_CSW, NULL);
+  }
+  if (response_value == DAP_TRANSFER_OK) {
+    response_value = Target_Transfer(DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | AP_TAR, &host->csw);
+  }
+  if (response_value == DAP_TRANSFER_OK) {
+    response_value = Target_Transfer(DP_RDBUFF | DAP_TRANSFER_RnW, &host->tar);
+  }
+
+  return (response_value);
+}
+
+
+// Restore the MEM-AP set up of the host
+//   Writes back CSW and TAR of AP 0, SELECT gets the value the host wrote
+//   last. Done even after failed accesses.
+//   host:   pointer to state saved by Target_Save
+void Target_Restore(const Target_Host_t *host) {
+  uint32_t value;
+
+  if (host->select != 0U) {
+    value = 0U;
+    (void)Target_Transfer(DP_SELECT, &value);
+  }
+  value = host->csw;
+  (void)Target_Transfer(DAP_TRANSFER_APnDP | AP_CSW, &value);
+  value = host->tar;
+  (void)Target_Transfer(DAP_TRANSFER_APnDP | AP_TAR, &value);
+  value = DAP_TransferSelect();
+  if (value != 0U) {
+    (void)Target_Transfer(DP_SELECT, &value);
+  }
+}
+
+
+// Begin probe side accesses between host commands
+//   Without a host session the probe connects the port and keeps it for
+//   the following polls, until Target_Release or a host DAP_Connect. In a
+//   host session the MEM-AP set up of the host is saved, and nothing is
+//   done while the debug domain is powered down or a sticky error of the
+//   host is pending.
+//   host:   pointer to state for Target_End
+//   return: DAP_TRANSFER_OK or error ACK, Target_End is needed either way
+uint32_t Target_Begin(Target_Host_t *host) {
+  uint32_t response_value;
+  uint32_t value;
+
+  host->session = 0U;
+  if (DAP_Data.debug_port == DAP_PORT_DISABLED) {
+    response_value = Target_Connect(NULL);
+    if (response_value != DAP_TRANSFER_OK) {
+      Target_Disconnect();
+      return (response_value);
+    }
+    TargetProbe = 1U;
+    return (DAP_TRANSFER_OK);
+  }
+  if (DAP_Data.debug_port != DAP_PORT_SWD) {
+    return (DAP_TRANSFER_ERROR);
+  }
+  if (TargetProbe != 0U) {
+    return (DAP_TRANSFER_OK);
+  }
+
+  response_value = Target_Transfer(DP_CTRL_STAT | DAP_TRANSFER_RnW, &value);
+  if (response_value != DAP_TRANSFER_OK) {
+    return (response_value);
+  }
+  if (((value & TARGET_CTRL_POWERED) != TARGET_CTRL_POWERED) ||
+      ((value & TARGET_CTRL_STICKY) != 0U)) {
+    return (DAP_TRANSFER_ERROR);
+  }
+  host->session = 1U;
+  return (Target_Save(host));
+}
+
+
+// End probe side accesses between host commands
+//   In a host session the MEM-AP set up of the host is restored and sticky
+//   errors of the probe side accesses are cleared, the host does not see
+//   them. A probe connection is kept.
+//   host:   pointer to state saved by Target_Begin
+void Target_End(const Target_Host_t *host) {
+  uint32_t value;
+
+  if (host->session == 0U) {
+    return;
+  }
+  if ((Target_Transfer(DP_CTRL_STAT | DAP_TRANSFER_RnW, &value) == DAP_TRANSFER_OK) &&
+      ((value & TARGET_CTRL_STICKY) != 0U)) {
+    value = DP_ABORT_STKCMPCLR | DP_ABORT_STKERRCLR | DP_ABORT_WDERRCLR | DP_ABORT_ORUNERRCLR;
+    (void)Target_Transfer(DP_ABORT, &value);
+  }
+  Target_Restore(host);
+}
+
+
+// Release a port the probe connected for its accesses
+//   Called when the probe side polls stop and when a host or the probe
+//   itself takes the port over. A host session is left alone.
+void Target_Release(void) {
+  if ((TargetProbe != 0U) && (DAP_Data.debug_port == DAP_PORT_SWD)) {
+    Target_Disconnect();
+  }
+  TargetProbe = 0U;
+}
+
+
+// Read one word and leave the MEM-AP set up as the host had it
+//   For polls between host commands. A DHCSR read keeps the sticky bits
+//   it clears for the host.
+//   address: word address
+//   data:    pointer to word read
+//   return:  DAP_TRANSFER_OK or error ACK
+uint32_t Target_Peek32(uint32_t address, uint32_t *data) {
+  Target_Host_t host;
+  uint32_t response_value;
+  uint32_t value;
+
+  response_value = Target_Save(&host);
+  if (response_value != DAP_TRANSFER_OK) {
+    return (response_value);
+  }
+
+  value = TARGET_CSW;
+  response_value = Target_Transfer(DAP_TRANSFER_APnDP | AP_CSW, &value);
+  if (response_value == DAP_TRANSFER_OK) {
+    response_value = Target_Transfer(DAP_TRANSFER_APnDP | AP_TAR, &address);
+  }
+  if (response_value == DAP_TRANSFER_OK) {
+    response_value = Target_Transfer(DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | AP_DRW, NULL);
+  }
+  if (response_value == DAP_TRANSFER_OK) {
+    response_value = Target_Transfer(DP_RDBUFF | DAP_TRANSFER_RnW, data);
+  }
+  if ((response_value == DAP_TRANSFER_OK) && (address == DBG_HCSR)) {
+    DAP_TransferSticky(*data);
+  }
+
+  Target_Restore(&host);
+
+  return (response_value);
+}
+
+
+// Reset the target and halt it at the reset vector
+//   return: DAP_TRANSFER_OK or error ACK
+uint32_t Target_ResetHalt(void) {
+  uint32_t response_value;
+  uint32_t data;
+  uint32_t n;
+
+  response_value = Target_Write32(DBG_HCSR, DBGKEY | C_DEBUGEN | C_HALT);
+  if (response_value == DAP_TRANSFER_OK) {
+    response_value = Target_Write32(DBG_EMCR, VC_CORERESET);
+  }
+  if (response_value != DAP_TRANSFER_OK) {
+    return (response_value);
+  }
+
+  // No response to the reset request is expected
+  (void)Target_Write32(NVIC_AIRCR, VECTKEY | SYSRESETREQ);
+
+  // Reconnect when the reset took the Debug Port down as well
+  for (n = TARGET_HALT_POLLS; n; n--) {
+    response_value = Target_Read32(DBG_HCSR, &data);
+    if (response_value != DAP_TRANSFER_OK) {
+      (void)Target_Connect(NULL);
+    } else if (data & S_HALT) {
+      return (Target_Write32(DBG_EMCR, 0U));
+    }
+  }
+
+  return ((response_value != DAP_TRANSFER_OK) ? response_value : DAP_TRANSFER_ERROR);
+}
+
+
+// Reset the target and let it run
+//   return: DAP_TRANSFER_OK or error ACK
+uint32_t Target_ResetRun(void) {
+  uint32_t response_value;
+
+  response_value = Target_Write32(DBG_EMCR, 0U);
+  if (response_value == DAP_TRANSFER_OK) {
+    response_value = Target_Write32(DBG_HCSR, DBGKEY);
+  }
+  if (response_value == DAP_TRANSFER_OK) {
+    (void)Target_Write32(NVIC_AIRCR, VECTKEY | SYSRESETREQ);
+  }
+
+  return (response_value);
+}
+
+
+// Wait for a core register transfer to complete
+//   return: DAP_TRANSFER_OK or error ACK
+static uint32_t Target_CoreReady(void) {
+  uint32_t response_value;
+  uint32_t data;
+  uint32_t n;
+
+  for (n = TARGET_REGRDY_POLLS; n; n--) {
+    response_value = Target_Read32(DBG_HCSR, &data);
+    if ((response_value != DAP_TRANSFER_OK) || (data & S_REGRDY)) {
+      return (response_value);
+    }
+  }
+
+  return (DAP_TRANSFER_ERROR);
+}
+
+
+// Read a core register of the halted core
+//   reg:    DCRSR register selector
+//   data:   pointer to register value
+//   return: DAP_TRANSFER_OK or error ACK
+uint32_t Target_ReadCore(uint32_t reg, uint32_t *data) {
+  uint32_t response_value;
+
+  response_value = Target_Write32(DBG_CRSR, reg);
+  if (response_value == DAP_TRANSFER_OK) {
+    response_value = Target_CoreReady();
+  }
+  if (response_value == DAP_TRANSFER_OK) {
+    response_value = Target_Read32(DBG_CRDR, data);
+  }
+
+  return (response_value);
+}
+
+
+// Write a core register of the halted core
+//   reg:    DCRSR register selector
+//   data:   register value
+//   return: DAP_TRANSFER_OK or error ACK
+uint32_t Target_WriteCore(uint32_t reg, uint32_t data) {
+  uint32_t response_value;
+
+  response_value = Target_Write32(DBG_CRDR, data);
+  if (response_value == DAP_TRANSFER_OK) {
+    response_value = Target_Write32(DBG_CRSR, REGWnR | reg);
+  }
+  if (response_value == DAP_TRANSFER_OK) {
+    response_value = Target_CoreReady();
+  }
+
+  return (response_value);
+}
+
+// Read a banked data register
+//   bd:     A[3:2] of the register
+//   data:   pointer to register value
+//   return: DAP_TRANSFER_OK or error ACK
+static uint32_t Target_ReadBD(uint32_t bd, uint32_t *data) {
+  uint32_t response_value;
+
+  response_value = Target_Transfer(DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | bd, NULL);
+  if (response_value == DAP_TRANSFER_OK) {
+    response_value = Target_Transfer(DP_RDBUFF | DAP_TRANSFER_RnW, data);
+  }
+
+  return (response_value);
+}
+
+
+// Map DHCSR, DCRSR and DCRDR to the banked data registers of AP 0
+//   Saves the host set up first and leaves bank 1 of AP 0 selected, each
+//   debug register access is a single transfer after that. The caller
+//   restores the host set up with Target_Restore when host->select is set,
+//   also after a failure. Fails when the core is not halted.
+//   host:   pointer to saved state of the host
+//   dhcsr:  pointer to DHCSR
+//   return: DAP_TRANSFER_OK or error ACK
+static uint32_t Target_CoreBank(Target_Host_t *host, uint32_t *dhcsr) {
+  uint32_t response_value;
+  uint32_t data;
+
+  response_value = Target_Save(host);
+  if (response_value != DAP_TRANSFER_OK) {
+    return (response_value);
+  }
+  host->select = TARGET_BD_SELECT;
+
+  data = TARGET_CSW;
+  response_value = Target_Transfer(DAP_TRANSFER_APnDP | AP_CSW, &data);
+  if (response_value == DAP_TRANSFER_OK) {
+    data = DBG_HCSR;
+    response_value = Target_Transfer(DAP_TRANSFER_APnDP | AP_TAR, &data);
+  }
+  if (response_value == DAP_TRANSFER_OK) {
+    data = TARGET_BD_SELECT;
+    response_value = Target_Transfer(DP_SELECT, &data);
+  }
+  if (response_value == DAP_TRANSFER_OK) {
+    response_value = Target_ReadBD(TARGET_BD_HCSR, dhcsr);
+  }
+  if ((response_value == DAP_TRANSFER_OK) && ((*dhcsr & S_HALT) == 0U)) {
+    response_value = DAP_TRANSFER_ERROR;
+  }
+
+  return (response_value);
+}
+
+
+// Read a set of core registers of the halted core
+//   The DHCSR read that checks S_REGRDY posts the DCRDR read, a register
+//   takes four transfers when it is ready at the first check.
+//   mask:   DCRSR register selectors, bit n selects register n
+//   data:   pointer to register values, lowest selector first
+//   return: DAP_TRANSFER_OK or error ACK
+uint32_t Target_ReadCoreSet(uint32_t mask, uint32_t *data) {
+  Target_Host_t host;
+  uint32_t response_value;
+  uint32_t value;
+  uint32_t reg;
+  uint32_t n;
+
+  response_value = Target_CoreBank(&host, &value);
+  for (reg = 0U; (mask != 0U) && (response_value == DAP_TRANSFER_OK); reg++, mask >>= 1) {
+    if ((mask & 1U) == 0U) {
+      continue;
+    }
+    value = reg;
+    response_value = Target_Transfer(DAP_TRANSFER_APnDP | TARGET_BD_CRSR, &value);
+    for (n = TARGET_REGRDY_POLLS; response_value == DAP_TRANSFER_OK; n--) {
+      response_value = Target_Transfer(DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | TARGET_BD_HCSR, NULL);
+      if (response_value == DAP_TRANSFER_OK) {
+        response_value = Target_Transfer(DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | TARGET_BD_CRDR, &value);
+      }
+      if ((response_value == DAP_TRANSFER_OK) && ((value & S_REGRDY) != 0U)) {
+        response_value = Target_Transfer(DP_RDBUFF | DAP_TRANSFER_RnW, data++);
+        break;
+      }
+      if (n == 1U) {
+        response_value = DAP_TRANSFER_ERROR;
+      }
+    }
+  }
+
+  if (host.select != 0U) {
+    Target_Restore(&host);
+  }
+
+  return (response_value);
+}
+
+
+// Write a set of core registers of the halted core
+//   mask:   DCRSR register selectors, bit n selects register n
+//   data:   pointer to register values, lowest selector first
+//   return: DAP_TRANSFER_OK or error ACK
+uint32_t Target_WriteCoreSet(uint32_t mask, const uint32_t *data) {
+  Target_Host_t host;
+  uint32_t response_value;
+  uint32_t value;
+  uint32_t reg;
+  uint32_t n;
+
+  response_value = Target_CoreBank(&host, &value);
+  for (reg = 0U; (mask != 0U) && (response_value == DAP_TRANSFER_OK); reg++, mask >>= 1) {
+    if ((mask & 1U) == 0U) {
+      continue;
+    }
+    value = *data++;
+    response_value = Target_Transfer(DAP_TRANSFER_APnDP | TARGET_BD_CRDR, &value);
+    if (response_value == DAP_TRANSFER_OK) {
+      value = REGWnR | reg;
+      response_value = Target_Transfer(DAP_TRANSFER_APnDP | TARGET_BD_CRSR, &value);
+    }
+    for (n = TARGET_REGRDY_POLLS; response_value == DAP_TRANSFER_OK; n--) {
+      response_value = Target_ReadBD(TARGET_BD_HCSR, &value);
+      if ((response_value == DAP_TRANSFER_OK) && ((value & S_REGRDY) != 0U)) {
+        break;
+      }
+      if (n == 1U) {
+        response_value = DAP_TRANSFER_ERROR;
+      }
+    }
+  }
+
+  if (host.select != 0U) {
+    Target_Restore(&host);
+  }
+
+  return (response_value);
+}
+
+
+// Execute one instruction of the halted core
+//   With interrupts masked the step does not enter a pending handler,
+//   C_MASKINTS is set and cleared while the core is halted.
+//   maskints: step with interrupts masked
+//   dhcsr:    pointer to DHCSR after the step
+//   return:   DAP_TRANSFER_OK or error ACK
+uint32_t Target_Step(uint32_t maskints, uint32_t *dhcsr) {
+  Target_Host_t host;
+  uint32_t response_value;
+  uint32_t mask;
+  uint32_t data;
+  uint32_t n;
+
+  mask = (maskints != 0U) ? C_MASKINTS : 0U;
+
+  response_value = Target_CoreBank(&host, dhcsr);
+  if ((response_value == DAP_TRANSFER_OK) && (mask != 0U)) {
+    data = DBGKEY | C_DEBUGEN | C_HALT | mask;
+    response_value = Target_Transfer(DAP_TRANSFER_APnDP | TARGET_BD_HCSR, &data);
+  }
+  if (response_value == DAP_TRANSFER_OK) {
+    data = DBGKEY | C_DEBUGEN | mask | C_STEP;
+    response_value = Target_Transfer(DAP_TRANSFER_APnDP | TARGET_BD_HCSR, &data);
+  }
+  for (n = TARGET_HALT_POLLS; response_value == DAP_TRANSFER_OK; n--) {
+    response_value = Target_ReadBD(TARGET_BD_HCSR, dhcsr);
+    if ((response_value == DAP_TRANSFER_OK) && ((*dhcsr & S_HALT) != 0U)) {
+      break;
+    }
+    if (n == 1U) {
+      response_value = DAP_TRANSFER_ERROR;
+    }
+  }
+  if ((response_value == DAP_TRANSFER_OK) && (mask != 0U)) {
+    data = DBGKEY | C_DEBUGEN | C_HALT;
+    response_value = Target_Transfer(DAP_TRANSFER_APnDP | TARGET_BD_HCSR, &data);
+  }
+
+  if (host.select != 0U) {
+    Target_Restore(&host);
+  }
+
+  return (response_value);
+}
+
+#endif
@@ -0,0 +1,415 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the License); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ----------------------------------------------------------------------
+ *
+ * Project:      CMSIS-DAP Source
+ * Title:        DAP_tune.c Target Auto-Tuning
+ *
+ *---------------------------------------------------------------------------*/
+
+#include "DAP_config.h"
+#include "DAP.h"
+
+#if (DAP_SWD != 0)
+
+// Test settings
+#define TUNE_WORDS              64U     // Words read from the MEM-AP per pass
+#define TUNE_PASSES             2U      // Passes that have to match per setting
+#define TUNE_IDLE_MAX           32U     // Highest idle cycle count tried
+#define TUNE_WAIT_PERCENT       5U      // Acceptable WAIT responses per transfer in %
+
+// DPIDR version field
+#define DPIDR_VERSION(dpidr)    (((dpidr) >> 12) & 0x0FU)
+
+// Tuning data stored per target
+//   data[0]: SWJ clock in Hz
+//   data[1]: idle cycles [7:0], turnaround [9:8]
+#define TUNE_IDLE(data)         ((data) & 0xFFU)
+#define TUNE_TURNAROUND(data)   ((((data) >> 8) & 0x03U) + 1U)
+
+// Settings stored for the connected target, host settings are limited to them
+static struct {
+  uint32_t clock;                       // Highest SWJ clock in Hz, 0 = none stored
+  uint8_t  idle;                        // Lowest idle cycle count
+  uint8_t  turnaround;                  // Lowest turnaround
+} Tune;
+
+
+// SWD Transfer with retries on WAIT response
+//   request: A[3:2] RnW APnDP
+//   data:    DATA[31:0]
+//   waits:   pointer to WAIT response counter
+//   return:  ACK[2:0]
+static uint32_t Tune_Transfer(uint32_t request, uint32_t *data, uint32_t *waits) {
+  uint32_t response_value;
+  uint32_t retry;
+
+  retry = DAP_Data.transfer.retry_count;
+  do {
+    response_value = SWD_Transfer(request, data);
+    if (response_value != DAP_TRANSFER_WAIT) {
+      break;
+    }
+    (*waits)++;
+  } while (retry--);
+
+  return (response_value);
+}
+
+
+// Read TARGETID of a DPv2 Debug Port
+//   SELECT is restored to the value the host wrote last.
+//   dpidr:  DPIDR of the Debug Port
+//   return: TARGETID or 0 when not available
+static uint32_t Tune_TargetID(uint32_t dpidr) {
+  uint32_t targetid;
+  uint32_t select;
+  uint32_t waits;
+  uint32_t data;
+
+  if (DPIDR_VERSION(dpidr) < 2U) {
+    return (0U);
+  }
+
+  waits  = 0U;
+  select = DAP_TransferSelect();
+  data   = (select & ~0x0FU) | 2U;      // DPBANKSEL 2: TARGETID
+  if (Tune_Transfer(DP_SELECT, &data, &waits) != DAP_TRANSFER_OK) {
+    return (0U);
+  }
+  if (Tune_Transfer(DP_CTRL_STAT | DAP_TRANSFER_RnW, &targetid, &waits) != DAP_TRANSFER_OK) {
+    targetid = 0U;
+  }
+  (void)Tune_Transfer(DP_SELECT, &select, &waits);
+
+  return (targetid);
+}
+
+
+// Recover the SWD link after a failed pass
+//   Line reset, DPIDR read and clear of the sticky error flags.
+//   return: DAP_TRANSFER_OK or error ACK
+static uint32_t Tune_Recover(void) {
+  static const uint8_t line_reset[8] = {
+    0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0x00U
+  };
+  uint32_t response_value;
+  uint32_t waits;
+  uint32_t data;
+
+  SWJ_Sequence(64U, line_reset);
+
+  waits = 0U;
+  response_value = Tune_Transfer(DP_IDCODE | DAP_TRANSFER_RnW, &data, &waits);
+  if (response_value == DAP_TRANSFER_OK) {
+    data = DP_ABORT_STKCMPCLR | DP_ABORT_STKERRCLR | DP_ABORT_WDERRCLR | DP_ABORT_ORUNERRCLR;
+    response_value = Tune_Transfer(DP_ABORT, &data, &waits);
+  }
+
+  return (response_value);
+}
+
+
+// Read a block of words from a MEM-AP
+//   apsel:    AP number
+//   address:  address of the block
+//   checksum: pointer to checksum of the data read
+//   waits:    pointer to WAIT response counter
+//   return:   DAP_TRANSFER_OK or error ACK
+static uint32_t Tune_Pass(uint32_t apsel, uint32_t address, uint32_t *checksum, uint32_t *waits) {
+  uint32_t response_value;
+  uint32_t sum;
+  uint32_t data;
+  uint32_t n;
+
+  // Select AP, register bank 0
+  data = apsel << 24;
+  response_value = Tune_Transfer(DP_SELECT, &data, waits);
+  if (response_value != DAP_TRANSFER_OK) {
+    return (response_value);
+  }
+
+  // CSW: 32-bit access, auto-increment single
+  response_value = Tune_Transfer(DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | AP_CSW, NULL, waits);
+  if (response_value == DAP_TRANSFER_OK) {
+    response_value = Tune_Transfer(DP_RDBUFF | DAP_TRANSFER_RnW, &data, waits);
+  }
+  if (response_value != DAP_TRANSFER_OK) {
+    return (response_value);
+  }
+  data = (data & ~0x37U) | 0x12U;
+  response_value = Tune_Transfer(DAP_TRANSFER_APnDP | AP_CSW, &data, waits);
+  if (response_value != DAP_TRANSFER_OK) {
+    return (response_value);
+  }
+  data = address;
+  response_value = Tune_Transfer(DAP_TRANSFER_APnDP | AP_TAR, &data, waits);
+  if (response_value != DAP_TRANSFER_OK) {
+    return (response_value);
+  }
+
+  // Read block
+  response_value = Tune_Transfer(DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | AP_DRW, NULL, waits);
+  sum = 0U;
+  for (n = TUNE_WORDS; n && (response_value == DAP_TRANSFER_OK); n--) {
+    if (n == 1U) {
+      response_value = Tune_Transfer(DP_RDBUFF | DAP_TRANSFER_RnW, &data, waits);
+    } else {
+      response_value = Tune_Transfer(DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | AP_DRW, &data, waits);
+    }
+    sum = ((sum << 5) | (sum >> 27)) ^ data;
+  }
+
+  *checksum = sum;
+  return (response_value);
+}
+
+
+// Check that a setting reads the reference data reliably
+//   apsel:     AP number
+//   address:   address of the test block
+//   reference: checksum of the test block
+//   waits:     pointer to WAIT response counter
+//   return:    1 = all passes match, 0 = failed
+static uint32_t Tune_Check(uint32_t apsel, uint32_t address, uint32_t reference, uint32_t *waits) {
+  uint32_t checksum;
+  uint32_t n;
+
+  for (n = 0U; n < TUNE_PASSES; n++) {
+    if ((Tune_Pass(apsel, address, &checksum, waits) != DAP_TRANSFER_OK) ||
+        (checksum != reference)) {
+      (void)Tune_Recover();
+      return (0U);
+    }
+  }
+
+  return (1U);
+}
+
+
+// Put the tuning result into the response
+//   response: pointer to response data
+//   dpidr:    DPIDR of the target
+//   targetid: TARGETID of the target
+//   clock:    SWJ clock in Hz
+//   return:   number of bytes in response
+static uint32_t Tune_Response(uint8_t *response, uint32_t dpidr, uint32_t targetid, uint32_t clock) {
+
+  *(response+1)  = (uint8_t)(dpidr    >>  0);
+  *(response+2)  = (uint8_t)(dpidr    >>  8);
+  *(response+3)  = (uint8_t)(dpidr    >> 16);
+  *(response+4)  = (uint8_t)(dpidr    >> 24);
+  *(response+5)  = (uint8_t)(targetid >>  0);
+  *(response+6)  = (uint8_t)(targetid >>  8);
+  *(response+7)  = (uint8_t)(targetid >> 16);
+  *(response+8)  = (uint8_t)(targetid >> 24);
+  *(response+9)  = (uint8_t)(clock    >>  0);
+  *(response+10) = (uint8_t)(clock    >>  8);
+  *(response+11) = (uint8_t)(clock    >> 16);
+  *(response+12) = (uint8_t)(clock    >> 24);
+  *(response+13) = DAP_Data.transfer.idle_cycles;
+  *(response+14) = DAP_Data.swd_conf.turnaround;
+
+  return (15U);
+}
+
+
+// Process Target Tune command and prepare response
+//   Searches the highest SWJ clock that reads a MEM-AP block reliably and
+//   the lowest idle cycle count with an acceptable WAIT rate, then stores
+//   the result for the target and applies it like a connect does. When no
+//   idle cycle count is good enough nothing is stored and the lowest clock
+//   is left set. The Debug Port has to be powered up, the host has to set
+//   up CSW and TAR again afterwards.
+//   request:  pointer to request data
+//             AP number, test address, lowest and highest SWJ clock
+//   response: pointer to response data
+//             status, DPIDR, TARGETID, SWJ clock, idle cycles, turnaround
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t DAP_TargetTune(const uint8_t *request, uint8_t *response) {
+  uint32_t apsel;
+  uint32_t address;
+  uint32_t clock_min;
+  uint32_t clock_max;
+  uint32_t clock;
+  uint32_t idle;
+  uint32_t dpidr;
+  uint32_t targetid;
+  uint32_t reference;
+  uint32_t waits;
+  uint32_t data[TARGET_TUNE_WORDS];
+  uint32_t n;
+  uint8_t  idle_host;
+
+  apsel     = *request;
+  address   = (uint32_t)(*(request+1) <<  0) |
+              (uint32_t)(*(request+2) <<  8) |
+              (uint32_t)(*(request+3) << 16) |
+              (uint32_t)(*(request+4) << 24);
+  clock_min = (uint32_t)(*(request+5) <<  0) |
+              (uint32_t)(*(request+6) <<  8) |
+              (uint32_t)(*(request+7) << 16) |
+              (uint32_t)(*(request+8) << 24);
+  clock_max = (uint32_t)(*(request+9) <<  0) |
+              (uint32_t)(*(request+10) <<  8) |
+              (uint32_t)(*(request+11) << 16) |
+              (uint32_t)(*(request+12) << 24);
+
+  *response = DAP_ERROR;
+  for (n = 1U; n < 15U; n++) {
+    *(response+n) = 0U;
+  }
+
+  if ((DAP_Data.debug_port != DAP_PORT_SWD) ||
+      (clock_min == 0U) || (clock_max < clock_min)) {
+    return ((13U << 16) | 15U);
+  }
+
+  // Tuned again from scratch
+  Tune.clock = 0U;
+  idle_host  = DAP_Data.transfer.idle_cycles;
+
+  // Reference data at the lowest clock
+  DAP_SWJ_SetClock(clock_min);
+  waits = 0U;
+  if ((Tune_Recover() != DAP_TRANSFER_OK) ||
+      (Tune_Transfer(DP_IDCODE | DAP_TRANSFER_RnW, &dpidr, &waits) != DAP_TRANSFER_OK)) {
+    return ((13U << 16) | 15U);
+  }
+  targetid = Tune_TargetID(dpidr);
+  if (Tune_Pass(apsel, address, &reference, &waits) != DAP_TRANSFER_OK) {
+    (void)Tune_Recover();
+    return ((13U << 16) | 15U);
+  }
+
+  // Highest reliable clock, halving from the highest clock requested
+  for (clock = clock_max; clock > clock_min; clock /= 2U) {
+    DAP_SWJ_SetClock(clock);
+    if (Tune_Check(apsel, address, reference, &waits) != 0U) {
+      break;
+    }
+  }
+  if (clock <= clock_min) {
+    clock = clock_min;
+    DAP_SWJ_SetClock(clock);
+  }
+
+  // Lowest idle cycle count with acceptable WAIT rate
+  for (idle = 0U; idle < TUNE_IDLE_MAX; idle = (idle != 0U) ? (idle * 2U) : 1U) {
+    DAP_Data.transfer.idle_cycles = (uint8_t)idle;
+    waits = 0U;
+    if ((Tune_Check(apsel, address, reference, &waits) != 0U) &&
+        ((waits * 100U) <= (TUNE_PASSES * (TUNE_WORDS + 6U) * TUNE_WAIT_PERCENT))) {
+      break;
+    }
+  }
+  if (idle >= TUNE_IDLE_MAX) {
+    // No idle cycle count is good enough: nothing is stored, lowest clock
+    DAP_Data.transfer.idle_cycles = idle_host;
+    clock = clock_min;
+    DAP_SWJ_SetClock(clock);
+  } else {
+    DAP_Data.transfer.idle_cycles = (uint8_t)idle;
+    data[0] = clock;
+    data[1] = idle | ((uint32_t)(DAP_Data.swd_conf.turnaround - 1U) << 8);
+    if (TARGET_TUNE_SAVE(dpidr, targetid, data) != 0U) {
+      *response = DAP_OK;
+      Tune.clock      = clock;
+      Tune.idle       = (uint8_t)idle;
+      Tune.turnaround = DAP_Data.swd_conf.turnaround;
+    }
+  }
+
+  // Leave SELECT as the host wrote it last
+  data[0] = DAP_TransferSelect();
+  (void)Tune_Transfer(DP_SELECT, &data[0], &waits);
+
+  return ((13U << 16) | Tune_Response(response, dpidr, targetid, clock));
+}
+
+
+// Apply the settings stored for a target at connect
+//   Switches the Debug Port to SWD, reads DPIDR and TARGETID and loads the
+//   SWJ clock, idle cycles and turnaround stored for them by Target Tune.
+//   Until the next connect they are the limits for the settings the host
+//   configures: the SWJ clock is not set higher, idle cycles and
+//   turnaround not lower. Nothing is applied when the target does not
+//   answer or nothing is stored for it. SELECT is left as the host wrote
+//   it last.
+void DAP_TuneConnect(void) {
+  static const uint8_t jtag_to_swd[18] = {
+    0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU,    // Line reset
+    0x9EU, 0xE7U,                                       // JTAG to SWD
+    0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU,    // Line reset
+    0x00U, 0x00U                                        // Idle
+  };
+  uint32_t dpidr;
+  uint32_t targetid;
+  uint32_t waits;
+  uint32_t data[TARGET_TUNE_WORDS];
+
+  Tune.clock = 0U;
+
+  SWJ_Sequence(8U * sizeof(jtag_to_swd), jtag_to_swd);
+  waits = 0U;
+  if (Tune_Transfer(DP_IDCODE | DAP_TRANSFER_RnW, &dpidr, &waits) != DAP_TRANSFER_OK) {
+    return;
+  }
+  targetid = Tune_TargetID(dpidr);
+  if ((TARGET_TUNE_LOAD(dpidr, targetid, data) == 0U) || (data[0] == 0U)) {
+    return;
+  }
+
+  Tune.clock      = data[0];
+  Tune.idle       = (uint8_t)TUNE_IDLE(data[1]);
+  Tune.turnaround = (uint8_t)TUNE_TURNAROUND(data[1]);
+  DAP_SWJ_SetClock(Tune.clock);
+  DAP_TuneTransfer();
+}
+
+
+// Forget the settings of the disconnected target
+void DAP_TuneDisconnect(void) {
+  Tune.clock = 0U;
+}
+
+
+// Limit an SWJ clock requested by the host to the stored one
+//   clock:  requested SWJ clock in Hz
+//   return: SWJ clock to set in Hz
+uint32_t DAP_TuneClock(uint32_t clock) {
+  if ((Tune.clock != 0U) && (clock > Tune.clock)) {
+    clock = Tune.clock;
+  }
+  return (clock);
+}
+
+
+// Raise idle cycles and turnaround configured by the host to the stored ones
+void DAP_TuneTransfer(void) {
+  if (Tune.clock == 0U) {
+    return;
+  }
+  if (DAP_Data.transfer.idle_cycles < Tune.idle) {
+    DAP_Data.transfer.idle_cycles = Tune.idle;
+  }
+  if (DAP_Data.swd_conf.turnaround < Tune.turnaround) {
+    DAP_Data.swd_conf.turnaround = Tune.turnaround;
+  }
+}
+
+#endif
@@ -39,6 +39,63 @@ Vendor Commands. Copy this file to the project folder of the Debug Unit and add
 file to the MDK-ARM project under the file group Configuration.
 */
 
+// Process Settings Read command and prepare response
+//   Request:  key (4 bytes)
+//   Response: status, length, value (length bytes)
+//   request:  pointer to request data
+//   response: pointer to response data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+static uint32_t DAP_SettingsRead(const uint8_t *request, uint8_t *response) {
+  uint32_t key;
+  uint32_t len;
+
+  key = (uint32_t)(*(request+0) <<  0) |
+        (uint32_t)(*(request+1) <<  8) |
+        (uint32_t)(*(request+2) << 16) |
+        (uint32_t)(*(request+3) << 24);
+
+  len = DAP_SETTING_LOAD(key, response + 2, KV_VALUE_MAX);
+  if (len > KV_VALUE_MAX) {
+    len = KV_VALUE_MAX;
+  }
+
+  *(response+0) = (len != 0U) ? DAP_OK : DAP_ERROR;
+  *(response+1) = (uint8_t)len;
+
+  return ((4U << 16) | (2U + len));
+}
+
+// Process Settings Write command and prepare response
+//   Request:  key (4 bytes, bit 31 clear), length, value (length bytes), length 0 removes the setting
+//   Response: status
+//   request:  pointer to request data
+//   response: pointer to response data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+static uint32_t DAP_SettingsWrite(const uint8_t *request, uint8_t *response) {
+  uint32_t key;
+  uint32_t len;
+
+  key = (uint32_t)(*(request+0) <<  0) |
+        (uint32_t)(*(request+1) <<  8) |
+        (uint32_t)(*(request+2) << 16) |
+        (uint32_t)(*(request+3) << 24);
+  len = *(request+4);
+
+  // Keys of the target tuning records are not written by the host
+  if (((key & DAP_SETTING_RESERVED) != 0U) ||
+      (len > KV_VALUE_MAX) || ((len + 5U) > DAP_RequestSpace(request))) {
+    *response = DAP_ERROR;
+    return ((5U << 16) | 1U);
+  }
+
+  *response = DAP_SETTING_STORE(key, request + 5, len) ? DAP_OK : DAP_ERROR;
+
+  return (((5U + len) << 16) | 1U);
+}
+
+
 /** Process DAP Vendor Command and prepare Response Data
 \param request   pointer to request data
 \param response  pointer to response data
@@ -61,16 +118,96 @@ uint32_t DAP_ProcessVendorCommand(const uint8_t *request, uint8_t *response) {
 #endif
       break;
 
+#if (DAP_SWD != 0)
+    case ID_DAP_TransferFaultConfigure:
+      num += DAP_TransferFaultConfigure(request, response);
+      break;
+    case ID_DAP_TransferFaultStatus:
+      num += DAP_TransferFaultStatus(response);
+      break;
+    case ID_DAP_WaitConfigure:
+      num += DAP_WaitConfigure(request, response);
+      break;
+    case ID_DAP_WaitStatistics:
+      num += DAP_WaitStatistics(request, response);
+      break;
+#else
     case ID_DAP_Vendor1:  break;
     case ID_DAP_Vendor2:  break;
     case ID_DAP_Vendor3:  break;
     case ID_DAP_Vendor4:  break;
-    case ID_DAP_Vendor5:  break;
+#endif
+    case ID_DAP_SWJ_ClockInfo:
+      num += DAP_SWJ_ClockInfo(response);
+      break;
+#if (DAP_SWD != 0)
+    case ID_DAP_LinkConfigure:
+      num += DAP_LinkConfigure(request, response);
+      break;
+    case ID_DAP_LinkStatus:
+      num += DAP_LinkStatus(request, response);
+      break;
+    case ID_DAP_TargetTune:
+      num += DAP_TargetTune(request, response);
+      break;
+#else
     case ID_DAP_Vendor6:  break;
     case ID_DAP_Vendor7:  break;
     case ID_DAP_Vendor8:  break;
-    case ID_DAP_Vendor9:  break;
-    case ID_DAP_Vendor10: break;
+#endif
+    case ID_DAP_SettingsRead:
+      num += DAP_SettingsRead(request, response);
+      break;
+    case ID_DAP_SettingsWrite:
+      num += DAP_SettingsWrite(request, response);
+      break;
+#if (DAP_SWD != 0)
+    case ID_DAP_DownloadOpen:
+      num += DAP_DownloadOpen(request, response);
+      break;
+    case ID_DAP_DownloadData:
+      num += DAP_DownloadData(request, response);
+      break;
+    case ID_DAP_DownloadClose:
+      num += DAP_DownloadClose(response);
+      break;
+    case ID_DAP_ReadRLE:
+      num += DAP_ReadRLE(request, response);
+      break;
+    case ID_DAP_ReadScatter:
+      num += DAP_ReadScatter(request, response);
+      break;
+    case ID_DAP_SampleConfigure:
+      num += DAP_SampleConfigure(request, response);
+      break;
+    case ID_DAP_SampleRead:
+      num += DAP_SampleRead(response);
+      break;
+    case ID_DAP_EventConfigure:
+      num += DAP_EventConfigure(request, response);
+      break;
+    case ID_DAP_EventRead:
+      num += DAP_EventRead(request, response);
+      break;
+    case ID_DAP_CoreRead:
+      num += DAP_CoreRead(request, response);
+      break;
+    case ID_DAP_CoreWrite:
+      num += DAP_CoreWrite(request, response);
+      break;
+    case ID_DAP_CoreStep:
+      num += DAP_CoreStep(request, response);
+      break;
+    case ID_DAP_RomDiscover:
+      num += DAP_RomDiscover(request, response);
+      break;
+    case ID_DAP_ScriptLoad:
+      num += DAP_ScriptLoad(request, response);
+      break;
+    case ID_DAP_ScriptRun:
+      num += DAP_ScriptRun(request, response);
+      break;
+#else
     case ID_DAP_Vendor11: break;
     case ID_DAP_Vendor12: break;
     case ID_DAP_Vendor13: break;
@@ -86,8 +223,13 @@ uint32_t DAP_ProcessVendorCommand(const uint8_t *request, uint8_t *response) {
     case ID_DAP_Vendor23: break;
     case ID_DAP_Vendor24: break;
     case ID_DAP_Vendor25: break;
-    case ID_DAP_Vendor26: break;
-    case ID_DAP_Vendor27: break;
+#endif
+    case ID_DAP_CaptureControl:
+      num += DAP_CaptureControl(request, response);
+      break;
+    case ID_DAP_CaptureRead:
+      num += DAP_CaptureRead(response);
+      break;
     case ID_DAP_Vendor28: break;
     case ID_DAP_Vendor29: break;
     case ID_DAP_Vendor30: break;
@@ -71,41 +71,51 @@
 
 
 // Generate JTAG Sequence
+//   Sequence data is processed one 32-bit word per outer loop iteration.
 //   info:   sequence information
 //   tdi:    pointer to TDI generated data
 //   tdo:    pointer to TDO captured data
 //   return: none
-void JTAG_Sequence (uint32_t info, const uint8_t *tdi, uint8_t *tdo) {
-  uint32_t i_val;
-  uint32_t o_val;
-  uint32_t bit;
-  uint32_t n, k;
-
-  n = info & JTAG_SEQUENCE_TCK;
-  if (n == 0U) {
-    n = 64U;
-  }
-
-  if (info & JTAG_SEQUENCE_TMS) {
-    PIN_TMS_SET();
-  } else {
-    PIN_TMS_CLR();
-  }
-
-  while (n) {
-    i_val = *tdi++;
-    o_val = 0U;
-    for (k = 8U; k && n; k--, n--) {
-      JTAG_CYCLE_TDIO(i_val, bit);
-      i_val >>= 1;
-      o_val >>= 1;
-      o_val  |= bit << 7;
-    }
-    o_val >>= k;
-    if (info & JTAG_SEQUENCE_TDO) {
-      *tdo++ = (uint8_t)o_val;
-    }
-  }
+#define JTAG_SequenceFunction(speed)    /**/                                    \
+DAP_RAMFUNC static void JTAG_Sequence##speed (uint32_t info, const uint8_t *tdi, uint8_t *tdo) { \
+  uint32_t i_val;                                                               \
+  uint32_t o_val;                                                               \
+  uint32_t bit;                                                                 \
+  uint32_t n, k, m;                                                             \
+                                                                                \
+  n = info & JTAG_SEQUENCE_TCK;                                                 \
+  if (n == 0U) {                                                                \
+    n = 64U;                                                                    \
+  }                                                                             \
+                                                                                \
+  if (info & JTAG_SEQUENCE_TMS) {                                               \
+    PIN_TMS_SET();                                                              \
+  } else {                                                                      \
+    PIN_TMS_CLR();                                                              \
+  }                                                                             \
+                                                                                \
+  while (n) {                                                                   \
+    k = (n > 32U) ? 32U : n;            /* Bits in this word */                 \
+    n -= k;                                                                     \
+    i_val = 0U;                                                                 \
+    for (m = 0U; m < k; m += 8U) {                                              \
+      i_val |= (uint32_t)(*tdi++) << m;                                         \
+    }                                                                           \
+    o_val = 0U;                                                                 \
+    for (m = k; m; m--) {                                                       \
+      JTAG_CYCLE_TDIO(i_val, bit);                                              \
+      i_val >>= 1;                                                              \
+      o_val >>= 1;                                                              \
+      o_val  |= bit << 31;                                                      \
+    }                                                                           \
+    o_val >>= 32U - k;                                                          \
+    if (info & JTAG_SEQUENCE_TDO) {                                             \
+      for (m = 0U; m < k; m += 8U) {                                            \
+        *tdo++ = (uint8_t)o_val;                                                \
+        o_val >>= 8;                                                            \
+      }                                                                         \
+    }                                                                           \
+  }                                                                             \
 }
 
 
@@ -253,11 +263,13 @@ exit:
 
 #undef  PIN_DELAY
 #define PIN_DELAY() PIN_DELAY_FAST()
+JTAG_SequenceFunction(Fast)
 JTAG_IR_Function(Fast)
 JTAG_TransferFunction(Fast)
 
 #undef  PIN_DELAY
 #define PIN_DELAY() PIN_DELAY_SLOW(DAP_Data.clock_delay)
+JTAG_SequenceFunction(Slow)
 JTAG_IR_Function(Slow)
 JTAG_TransferFunction(Slow)
 
@@ -342,6 +354,20 @@ void JTAG_WriteAbort (uint32_t data) {
 }
 
 
+// Generate JTAG Sequence
+//   info:   sequence information
+//   tdi:    pointer to TDI generated data
+//   tdo:    pointer to TDO captured data
+//   return: none
+void JTAG_Sequence (uint32_t info, const uint8_t *tdi, uint8_t *tdo) {
+  if (DAP_Data.fast_clock) {
+    JTAG_SequenceFast(info, tdi, tdo);
+  } else {
+    JTAG_SequenceSlow(info, tdi, tdo);
+  }
+}
+
+
 // JTAG Set IR
 //   ir:     IR value
 //   return: none
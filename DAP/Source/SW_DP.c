@@ -58,75 +58,96 @@
 
 
 // Generate SWJ Sequence
+//   Sequence data is processed one 32-bit word per outer loop iteration.
 //   count:  sequence bit count
 //   data:   pointer to sequence bit data
 //   return: none
-#if ((DAP_SWD != 0) || (DAP_JTAG != 0))
-void SWJ_Sequence (uint32_t count, const uint8_t *data) {
-  uint32_t val;
-  uint32_t n;
-
-  val = 0U;
-  n = 0U;
-  while (count--) {
-    if (n == 0U) {
-      val = *data++;
-      n = 8U;
-    }
-    if (val & 1U) {
-      PIN_SWDIO_TMS_SET();
-    } else {
-      PIN_SWDIO_TMS_CLR();
-    }
-    SW_CLOCK_CYCLE();
-    val >>= 1;
-    n--;
-  }
+#define SWJ_SequenceFunction(speed)     /**/                                    \
+DAP_RAMFUNC static void SWJ_Sequence##speed (uint32_t count, const uint8_t *data) { \
+  uint32_t val;                                                                 \
+  uint32_t n, k;                                                                \
+                                                                                \
+  while (count) {                                                               \
+    n = (count > 32U) ? 32U : count;    /* Bits in this word */                 \
+    count -= n;                                                                 \
+    val = 0U;                                                                   \
+    for (k = 0U; k < n; k += 8U) {                                              \
+      val |= (uint32_t)(*data++) << k;                                          \
+    }                                                                           \
+    for (; n; n--) {                                                            \
+      if (val & 1U) {                                                           \
+        PIN_SWDIO_TMS_SET();                                                    \
+      } else {                                                                  \
+        PIN_SWDIO_TMS_CLR();                                                    \
+      }                                                                         \
+      SW_CLOCK_CYCLE();                                                         \
+      val >>= 1;                                                                \
+    }                                                                           \
+  }                                                                             \
 }
-#endif
 
 
 // Generate SWD Sequence
+//   Sequence data is processed one 32-bit word per outer loop iteration.
 //   info:   sequence information
 //   swdo:   pointer to SWDIO generated data
 //   swdi:   pointer to SWDIO captured data
 //   return: none
-#if (DAP_SWD != 0)
-void SWD_Sequence (uint32_t info, const uint8_t *swdo, uint8_t *swdi) {
-  uint32_t val;
-  uint32_t bit;
-  uint32_t n, k;
-
-  n = info & SWD_SEQUENCE_CLK;
-  if (n == 0U) {
-    n = 64U;
-  }
-
-  if (info & SWD_SEQUENCE_DIN) {
-    while (n) {
-      val = 0U;
-      for (k = 8U; k && n; k--, n--) {
-        SW_READ_BIT(bit);
-        val >>= 1;
-        val  |= bit << 7;
-      }
-      val >>= k;
-      *swdi++ = (uint8_t)val;
-    }
-  } else {
-    while (n) {
-      val = *swdo++;
-      for (k = 8U; k && n; k--, n--) {
-        SW_WRITE_BIT(val);
-        val >>= 1;
-      }
-    }
-  }
+#define SWD_SequenceFunction(speed)     /**/                                    \
+DAP_RAMFUNC static void SWD_Sequence##speed (uint32_t info, const uint8_t *swdo, uint8_t *swdi) { \
+  uint32_t val;                                                                 \
+  uint32_t bit;                                                                 \
+  uint32_t n, k, m;                                                             \
+                                                                                \
+  n = info & SWD_SEQUENCE_CLK;                                                  \
+  if (n == 0U) {                                                                \
+    n = 64U;                                                                    \
+  }                                                                             \
+                                                                                \
+  if (info & SWD_SEQUENCE_DIN) {                                                \
+    while (n) {                                                                 \
+      k = (n > 32U) ? 32U : n;          /* Bits in this word */                 \
+      n -= k;                                                                   \
+      val = 0U;                                                                 \
+      for (m = k; m; m--) {                                                     \
+        SW_READ_BIT(bit);                                                       \
+        val >>= 1;                                                              \
+        val  |= bit << 31;                                                      \
+      }                                                                         \
+      val >>= 32U - k;                                                          \
+      for (m = 0U; m < k; m += 8U) {                                            \
+        *swdi++ = (uint8_t)val;                                                 \
+        val >>= 8;                                                              \
+      }                                                                         \
+    }                                                                           \
+  } else {                                                                      \
+    while (n) {                                                                 \
+      k = (n > 32U) ? 32U : n;          /* Bits in this word */                 \
+      n -= k;                                                                   \
+      val = 0U;                                                                 \
+      for (m = 0U; m < k; m += 8U) {                                            \
+        val |= (uint32_t)(*swdo++) << m;                                        \
+      }                                                                         \
+      for (; k; k--) {                                                          \
+        SW_WRITE_BIT(val);                                                      \
+        val >>= 1;                                                              \
+      }                                                                         \
+    }                                                                           \
+  }                                                                             \
 }
-#endif
 
 
-#if (DAP_SWD != 0)
+// Generate SWD Idle cycles
+//   count:  number of idle cycles (SWDIO low)
+//   return: none
+#define SWD_IdleFunction(speed)         /**/                                    \
+DAP_RAMFUNC static void SWD_Idle##speed (uint32_t count) {                     \
+  PIN_SWDIO_OUT(0U);                                                            \
+  for (; count; count--) {                                                      \
+    SW_CLOCK_CYCLE();                                                           \
+  }                                                                             \
+  PIN_SWDIO_OUT(1U);                                                            \
+}
 
 
 // SWD Transfer I/O
@@ -134,7 +155,7 @@ void SWD_Sequence (uint32_t info, const uint8_t *swdo, uint8_t *swdi) {
 //   data:    DATA[31:0]
 //   return:  ACK[2:0]
 #define SWD_TransferFunction(speed)     /**/                                    \
-static uint8_t SWD_Transfer##speed (uint32_t request, uint32_t *data) {         \
+DAP_RAMFUNC static uint8_t SWD_Transfer##speed (uint32_t request, uint32_t *data) { \
   uint32_t ack;                                                                 \
   uint32_t bit;                                                                 \
   uint32_t val;                                                                 \
@@ -263,18 +284,76 @@ static uint8_t SWD_Transfer##speed (uint32_t request, uint32_t *data) {
 
 #undef  PIN_DELAY
 #define PIN_DELAY() PIN_DELAY_FAST()
+#if ((DAP_SWD != 0) || (DAP_JTAG != 0))
+SWJ_SequenceFunction(Fast)
+#endif
+#if (DAP_SWD != 0)
+SWD_SequenceFunction(Fast)
+SWD_IdleFunction(Fast)
 SWD_TransferFunction(Fast)
+#endif
 
 #undef  PIN_DELAY
 #define PIN_DELAY() PIN_DELAY_SLOW(DAP_Data.clock_delay)
+#if ((DAP_SWD != 0) || (DAP_JTAG != 0))
+SWJ_SequenceFunction(Slow)
+#endif
+#if (DAP_SWD != 0)
+SWD_SequenceFunction(Slow)
+SWD_IdleFunction(Slow)
 SWD_TransferFunction(Slow)
+#endif
+
+
+// Generate SWJ Sequence
+//   count:  sequence bit count
+//   data:   pointer to sequence bit data
+//   return: none
+#if ((DAP_SWD != 0) || (DAP_JTAG != 0))
+DAP_RAMFUNC void SWJ_Sequence (uint32_t count, const uint8_t *data) {
+  if (DAP_Data.fast_clock) {
+    SWJ_SequenceFast(count, data);
+  } else {
+    SWJ_SequenceSlow(count, data);
+  }
+}
+#endif
+
+
+#if (DAP_SWD != 0)
+
+
+// Generate SWD Sequence
+//   info:   sequence information
+//   swdo:   pointer to SWDIO generated data
+//   swdi:   pointer to SWDIO captured data
+//   return: none
+DAP_RAMFUNC void SWD_Sequence (uint32_t info, const uint8_t *swdo, uint8_t *swdi) {
+  if (DAP_Data.fast_clock) {
+    SWD_SequenceFast(info, swdo, swdi);
+  } else {
+    SWD_SequenceSlow(info, swdo, swdi);
+  }
+}
+
+
+// Generate SWD Idle cycles
+//   count:  number of idle cycles (SWDIO low)
+//   return: none
+DAP_RAMFUNC void SWD_Idle (uint32_t count) {
+  if (DAP_Data.fast_clock) {
+    SWD_IdleFast(count);
+  } else {
+    SWD_IdleSlow(count);
+  }
+}
 
 
 // SWD Transfer I/O
 //   request: A[3:2] RnW APnDP
 //   data:    DATA[31:0]
 //   return:  ACK[2:0]
-uint8_t  SWD_Transfer(uint32_t request, uint32_t *data) {
+DAP_RAMFUNC uint8_t SWD_Transfer(uint32_t request, uint32_t *data) {
   if (DAP_Data.fast_clock) {
     return SWD_TransferFast(request, data);
   } else {
@@ -29,6 +29,76 @@
 #define __DAP_CONFIG_H__
 
 #include "IO_Config.h"
+#include "hw_timer.h"
+#include "kv_store.h"
+#include "tune_store.h"
+#include "board_config.h"
+#include "target_flash.h"
+
+//**************************************************************************************************
+/**
+\defgroup DAP_Config_Settings_gr CMSIS-DAP Persistent Settings
+\ingroup DAP_ConfigIO_gr
+@{
+Access functions for the settings kept in the key/value store in data flash.
+
+Settings override compiled-in defaults and survive power cycles. They are written with the
+vendor command \ref ID_DAP_SettingsWrite. Keys with bit 31 set are reserved for the target
+tuning records.
+*/
+
+#define DAP_SETTING_RESERVED             0x80000000U ///< Key bit of the target tuning records.
+
+#define DAP_SETTING_SWJ_CLOCK            0x0001U ///< Default SWD/JTAG clock in Hz (4 bytes).
+#define DAP_SETTING_TARGET_DEVICE_VENDOR 0x0010U ///< Target Device Vendor string.
+#define DAP_SETTING_TARGET_DEVICE_NAME   0x0011U ///< Target Device Name string.
+#define DAP_SETTING_TARGET_BOARD_VENDOR 0x0012U ///< Target Board Vendor string.
+#define DAP_SETTING_TARGET_BOARD_NAME    0x0013U ///< Target Board Name string.
+
+/** Load a setting.
+\param key    setting key.
+\param value  pointer to buffer for the value.
+\param size   size of the buffer in bytes.
+\return length of the stored value or 0 (setting not stored).
+*/
+__STATIC_INLINE uint32_t DAP_SETTING_LOAD (uint32_t key, void *value, uint32_t size) {
+  int32_t len = kv_get(key, value, size);
+  return ((len > 0) ? (uint32_t)len : 0U);
+}
+
+/** Store a setting.
+\param key    setting key.
+\param value  pointer to the value, NULL to remove the setting.
+\param length length of the value in bytes (0 to remove the setting).
+\return 1 = setting has been stored.\n
+        0 = store failed.
+*/
+__STATIC_INLINE uint32_t DAP_SETTING_STORE (uint32_t key, const void *value, uint32_t length) {
+  if (length == 0U) {
+    return ((kv_delete(key) == 0) ? 1U : 0U);
+  }
+  return ((kv_set(key, value, length) == 0) ? 1U : 0U);
+}
+
+/** Load a string setting.
+\param key    setting key.
+\param str    pointer to buffer to store the string (max 60 characters).
+\return String length (including terminating NULL character) or 0 (no string).
+*/
+__STATIC_INLINE uint8_t DAP_SETTING_STRING (uint32_t key, char *str) {
+  uint32_t len = DAP_SETTING_LOAD(key, str, 59U);
+  if (len == 0U) {
+    return (0U);
+  }
+  if (len > 59U) {
+    len = 59U;
+  }
+  str[len] = 0;
+  return ((uint8_t)(len + 1U));
+}
+
+///@}
+
 
 //**************************************************************************************************
 /**
@@ -57,6 +127,17 @@ This information includes:
 /// required.
 #define IO_PORT_WRITE_CYCLES    2U              ///< I/O Cycles: 2=default, 1=Cortex-M0+ fast I/0.
 
+/// Placement of time critical functions.
+/// The NUC120 flash needs wait states at 48 MHz which makes the bit-bang loops jittery and slower
+/// than \ref MAX_SWJ_CLOCK predicts. Functions marked with DAP_RAMFUNC are linked into the
+/// .ramfunc section and copied to SRAM at startup, gcc_arm.ld limits the section to 2 KB.
+/// Their callees on the per transfer path are placed there as well or forced inline; clock
+/// changes and fault recovery run from flash. Defining DAP_RAMFUNC as
+/// __attribute__((noinline)) on the compiler command line keeps them in flash, for comparison.
+#ifndef DAP_RAMFUNC
+#define DAP_RAMFUNC             __attribute__((section(".ramfunc"), noinline))
+#endif
+
 /// Indicate that Serial Wire Debug (SWD) communication mode is available at the Debug Access Port.
 /// This information is returned by the command \ref DAP_Info as part of <b>Capabilities</b>.
 #define DAP_SWD                 1               ///< SWD Mode:  1 = available, 0 = not available.
@@ -76,8 +157,48 @@ This information includes:
 /// Default communication speed on the Debug Access Port for SWD and JTAG mode.
 /// Used to initialize the default SWD/JTAG clock frequency.
 /// The command \ref DAP_SWJ_Clock can be used to overwrite this default setting.
+/// A clock stored as \ref DAP_SETTING_SWJ_CLOCK replaces this value at startup.
 #define DAP_DEFAULT_SWJ_CLOCK   4000000U        ///< Default SWD/JTAG clock frequency in Hz.
 
+/// Default WAIT handling of SWD transfers.
+/// With adaptive WAIT handling idle cycles are inserted between retries after a WAIT response,
+/// doubling up to \ref DAP_WAIT_BACKOFF_MAX, and the idle cycles typically needed by each AP
+/// are learned and inserted before the next access to that AP.
+/// It is disabled by default so that SWD timing stays unchanged for hosts with their own WAIT
+/// handling. WAIT statistics per AP are kept either way, see ID_DAP_WaitStatistics.
+/// The vendor command ID_DAP_WaitConfigure can be used to overwrite these default settings.
+#define DAP_WAIT_ADAPTIVE       0U              ///< Adaptive WAIT handling: 1 = enabled, 0 = disabled.
+#define DAP_WAIT_BACKOFF_MAX    256U            ///< Maximum idle cycles between retries.
+
+/// Largest window of compressed downloads.
+/// Data sent with the vendor command ID_DAP_DownloadData may be compressed in heatshrink format
+/// with a window of up to 2^n bytes. The window buffer takes 2^n bytes of RAM.
+#define DAP_DOWNLOAD_WINDOW     8U              ///< Window size in bits: 4 .. 12.
+
+/// Ring buffer of periodic variable samples.
+/// Samples set up with the vendor command ID_DAP_SampleConfigure are queued as records of a
+/// timestamp and the variable data until the host drains them with ID_DAP_SampleRead.
+/// The buffer holds at least four records, so it limits a record to a quarter of its size.
+#define DAP_SAMPLE_BUFFER_SIZE  256U            ///< Ring buffer size in bytes.
+
+/// Cache of ROM table walks.
+/// Component lists returned by the vendor command ID_DAP_RomDiscover are kept per DPIDR, AP IDR
+/// and BASE, the oldest lists are evicted first. A list takes 24 bytes plus 16 bytes per component,
+/// so the default holds the first 14 components of one list; pages behind them are walked again.
+#define DAP_ROM_CACHE_SIZE      256U            ///< Cache size in bytes.
+
+/// Slot for debug sequence scripts.
+/// Bytecode loaded with the vendor command ID_DAP_ScriptLoad is verified and kept here until
+/// the next load, ID_DAP_ScriptRun runs it on the probe.
+#define DAP_SCRIPT_SIZE         256U            ///< Script size in bytes, multiple of 8.
+
+/// Ring buffer of captured commands.
+/// While started with the vendor command ID_DAP_CaptureControl, every processed command is recorded
+/// with its timing and response CRC until the host drains the records with ID_DAP_CaptureRead.
+/// A record takes 14 bytes plus the request. With a size of 0 capture is left out and both
+/// commands answer DAP_ERROR; set a size of a few hundred bytes or more to record sessions.
+#define DAP_CAPTURE_BUFFER_SIZE 0U              ///< Ring buffer size in bytes, up to 65535, 0 = disabled.
+
 /// Maximum Package Size for Command and Response data.
 /// This configuration settings is used to optimize the communication performance with the
 /// debugger and depends on the USB peripheral. Typical vales are 64 for Full-speed USB HID or WinUSB,
@@ -192,8 +313,7 @@ __STATIC_INLINE uint8_t DAP_GetTargetDeviceVendorString (char *str) {
   len = (uint8_t)(strlen(TargetDeviceVendor) + 1U);
   return (len);
 #else
-  (void)str;
-  return (0U);
+  return (DAP_SETTING_STRING(DAP_SETTING_TARGET_DEVICE_VENDOR, str));
 #endif
 }
 
@@ -209,8 +329,7 @@ __STATIC_INLINE uint8_t DAP_GetTargetDeviceNameString (char *str) {
   len = (uint8_t)(strlen(TargetDeviceName) + 1U);
   return (len);
 #else
-  (void)str;
-  return (0U);
+  return (DAP_SETTING_STRING(DAP_SETTING_TARGET_DEVICE_NAME, str));
 #endif
 }
 
@@ -226,8 +345,7 @@ __STATIC_INLINE uint8_t DAP_GetTargetBoardVendorString (char *str) {
   len = (uint8_t)(strlen(TargetBoardVendor) + 1U);
   return (len);
 #else
-  (void)str;
-  return (0U);
+  return (DAP_SETTING_STRING(DAP_SETTING_TARGET_BOARD_VENDOR, str));
 #endif
 }
 
@@ -243,8 +361,7 @@ __STATIC_INLINE uint8_t DAP_GetTargetBoardNameString (char *str) {
   len = (uint8_t)(strlen(TargetBoardName) + 1U);
   return (len);
 #else
-  (void)str;
-  return (0U);
+  return (DAP_SETTING_STRING(DAP_SETTING_TARGET_BOARD_NAME, str));
 #endif
 }
 
@@ -399,7 +516,8 @@ Configure the SWDIO DAP hardware I/O pin to output mode. This function is
 called prior \ref PIN_SWDIO_OUT function calls.
 */
 __STATIC_FORCEINLINE void     PIN_SWDIO_OUT_ENABLE  (void) {
-  GPIO_SetMode(SWD_DAT_GRP, (1 << SWD_DAT_BIT), GPIO_PMD_OUTPUT);
+  SWD_DAT_GRP->PMD = (SWD_DAT_GRP->PMD & ~(0x3UL << (SWD_DAT_BIT << 1))) |
+                     (GPIO_PMD_OUTPUT << (SWD_DAT_BIT << 1));
 }
 
 /** SWDIO I/O pin: Switch to Input mode (used in SWD mode only).
@@ -407,7 +525,8 @@ Configure the SWDIO DAP hardware I/O pin to input mode. This function is
 called prior \ref PIN_SWDIO_IN function calls.
 */
 __STATIC_FORCEINLINE void     PIN_SWDIO_OUT_DISABLE (void) {
-  GPIO_SetMode(SWD_DAT_GRP, (1 << SWD_DAT_BIT), GPIO_PMD_INPUT);
+  SWD_DAT_GRP->PMD = (SWD_DAT_GRP->PMD & ~(0x3UL << (SWD_DAT_BIT << 1))) |
+                     (GPIO_PMD_INPUT << (SWD_DAT_BIT << 1));
 }
 
 
@@ -528,7 +647,7 @@ default, the DWT timer is used.  The frequency of this timer is configured with
 /** Get timestamp of Test Domain Timer.
 \return Current timestamp value.
 */
-__STATIC_INLINE uint32_t TIMESTAMP_GET (void) {
+__STATIC_FORCEINLINE uint32_t TIMESTAMP_GET (void) {
   // return (DWT->CYCCNT);
   //return (DWT->CYCCNT) / (CPU_CLOCK / TIMESTAMP_CLOCK);
   return 0; // TODO: need implement a timer
@@ -537,6 +656,138 @@ __STATIC_INLINE uint32_t TIMESTAMP_GET (void) {
 ///@}
 
 
+//**************************************************************************************************
+/**
+\defgroup DAP_Config_Delay_gr CMSIS-DAP Delay Timer
+\ingroup DAP_ConfigIO_gr
+@{
+Access functions for the Delay Timer.
+
+The pin wait of \ref DAP_SWJ_Pins, the clock calibration and the time limit of scripts are
+timed with a free-running hardware timer. Delays of \ref Delayus of at least one ThreadX tick
+sleep the calling thread until a compare match of that timer instead of spinning; shorter
+delays remain busy-waits.
+*/
+
+/// Shortest delay in microseconds that \ref Delayus sleeps: one ThreadX tick at 100 Hz.
+#define DELAY_YIELD_THRESHOLD   10000U
+
+/** Get current value of the Delay Timer.
+\return Current timer value (use \ref DELAY_TIMER_ELAPSED to compute a difference).
+*/
+__STATIC_INLINE uint32_t DELAY_TIMER_GET (void) {
+  return hw_timer_now();
+}
+
+/** Get time elapsed on the Delay Timer.
+\param start timer value previously returned by \ref DELAY_TIMER_GET.
+\return Elapsed time in microseconds.
+*/
+__STATIC_INLINE uint32_t DELAY_TIMER_ELAPSED (uint32_t start) {
+  return hw_timer_elapsed(start);
+}
+
+/** Sleep the calling thread for the specified time.
+\param delay wait time in microseconds.
+\return 1 = wait has been performed, woken by the timer compare match or at the latest two
+            ticks after it.\n
+        0 = sleeping not possible (no thread context), caller has to busy-wait.
+*/
+__STATIC_INLINE uint32_t DELAY_YIELD (uint32_t delay) {
+  return hw_timer_sleep_us(delay);
+}
+
+///@}
+
+
+//**************************************************************************************************
+/**
+\defgroup DAP_Config_Tune_gr CMSIS-DAP Target Tuning Store
+\ingroup DAP_ConfigIO_gr
+@{
+Access functions for the persistent store of target tuning parameters.
+
+Transfer parameters found by the target auto-tuning are kept per target, keyed by DPIDR and
+TARGETID, and applied again when the host connects to the same target. The store keeps
+\ref TARGET_TUNE_WORDS data words per target.
+*/
+
+/// Number of data words stored per target.
+#define TARGET_TUNE_WORDS       TUNE_STORE_DATA_WORDS
+
+/** Load tuning parameters of a target.
+\param dpidr    DPIDR of the target.
+\param targetid TARGETID of the target (0 when not available).
+\param data     pointer to \ref TARGET_TUNE_WORDS data words.
+\return 1 = parameters have been loaded.\n
+        0 = no parameters stored for this target.
+*/
+__STATIC_INLINE uint32_t TARGET_TUNE_LOAD (uint32_t dpidr, uint32_t targetid, uint32_t *data) {
+  return tune_store_find(dpidr, targetid, data);
+}
+
+/** Store tuning parameters of a target.
+\param dpidr    DPIDR of the target.
+\param targetid TARGETID of the target (0 when not available).
+\param data     pointer to \ref TARGET_TUNE_WORDS data words.
+\return 1 = parameters have been stored.\n
+        0 = store failed.
+*/
+__STATIC_INLINE uint32_t TARGET_TUNE_SAVE (uint32_t dpidr, uint32_t targetid, const uint32_t *data) {
+  return tune_store_save(dpidr, targetid, data);
+}
+
+///@}
+
+
+//**************************************************************************************************
+/**
+\defgroup DAP_Config_TargetFlash_gr CMSIS-DAP Target Flash Programming
+\ingroup DAP_ConfigIO_gr
+@{
+Access functions for programming the target flash from the Debug Unit.
+
+Probe side downloads program the target flash pages between \ref TARGET_FLASH_START and
+\ref TARGET_FLASH_START + \ref TARGET_FLASH_SIZE in pages of \ref TARGET_FLASH_PAGE_SIZE bytes.
+*/
+
+/** Connect to the target, halt it and enable its flash controller.
+\return 1 = target flash is ready.\n
+        0 = connection or setup failed.
+*/
+__STATIC_INLINE uint32_t TARGET_FLASH_INIT (void) {
+  return ((target_flash_init() == 0) ? 1U : 0U);
+}
+
+/** Erase a target flash page.
+\param addr     page address.
+\return 1 = page has been erased.\n
+        0 = erase failed.
+*/
+__STATIC_INLINE uint32_t TARGET_FLASH_ERASE (uint32_t addr) {
+  return ((target_flash_erase(addr) == 0) ? 1U : 0U);
+}
+
+/** Program and verify erased target flash.
+\param addr     word aligned address.
+\param data     pointer to the words, words that are 0xFFFFFFFF are skipped.
+\param words    number of words.
+\return 1 = words have been programmed.\n
+        0 = programming or verify failed.
+*/
+__STATIC_INLINE uint32_t TARGET_FLASH_PROGRAM (uint32_t addr, const uint32_t *data, uint32_t words) {
+  return ((target_flash_program(addr, data, words) == 0) ? 1U : 0U);
+}
+
+/** Disable the flash controller, the target stays connected and halted for the host.
+*/
+__STATIC_INLINE void TARGET_FLASH_END (void) {
+  target_flash_end();
+}
+
+///@}
+
+
 //**************************************************************************************************
 /**
 \defgroup DAP_Config_Initialization_gr CMSIS-DAP Initialization
@@ -40,4 +40,8 @@
 #define OFF_BTN_GRP PB
 #define OFF_BTN_BIT 14
 
+#define MSC_EN_IO   PA1
+#define MSC_EN_GRP  PA
+#define MSC_EN_BIT  1
+
 #endif
@@ -10,4 +10,24 @@
 #define USB_VENDOR_STRING	"UWings"
 #define USB_PRODUCT_STRING	"CMSIS-DAP"
 
+/*
+ * Data flash at the end of APROM, holds the key/value settings store. Needs
+ * CONFIG0.DFEN = 0 and CONFIG1 = DATA_FLASH_BASE, gcc_arm.ld ends FLASH below it.
+ */
+#define DATA_FLASH_BASE		0x1F000
+#define DATA_FLASH_SIZE		0x1000
+
+/* Target APROM programmed through the MSC drive, NuMicro FMC over SWD */
+#define TARGET_FLASH_START	0x00000000
+#define TARGET_FLASH_SIZE	0x20000
+#define TARGET_FLASH_PAGE_SIZE	0x200
+
+/* Target SRAM, scanned for the RTT control block */
+#define TARGET_RAM_START	0x20000000
+#define TARGET_RAM_SIZE		0x4000
+
+/* Target SRAM holding MSC sectors written out of order while the target is halted */
+#define TARGET_STAGING_START	0x20000000
+#define TARGET_STAGING_SIZE	0x2000
+
 #endif
@@ -0,0 +1,9 @@
+# Fails the build when FILE is larger than LIMIT bytes:
+#   cmake -DFILE=<binary> -DLIMIT=<bytes> -P check_size.cmake
+
+file(SIZE ${FILE} size)
+math(EXPR free "${LIMIT} - ${size}")
+if(size GREATER LIMIT)
+  message(FATAL_ERROR "${FILE}: ${size} bytes, ${LIMIT} available")
+endif()
+message(STATUS "${FILE}: ${size} of ${LIMIT} bytes, ${free} free")
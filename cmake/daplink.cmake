@@ -5,6 +5,17 @@ set(DAPLINK_DIR ${CMAKE_SOURCE_DIR}/DAP)
 target_sources(daplink INTERFACE
 	${DAPLINK_DIR}/Source/DAP_vendor.c
 	${DAPLINK_DIR}/Source/DAP.c
+	${DAPLINK_DIR}/Source/DAP_tune.c
+	${DAPLINK_DIR}/Source/DAP_target.c
+	${DAPLINK_DIR}/Source/DAP_download.c
+	${DAPLINK_DIR}/Source/DAP_rle.c
+	${DAPLINK_DIR}/Source/DAP_scatter.c
+	${DAPLINK_DIR}/Source/DAP_sample.c
+	${DAPLINK_DIR}/Source/DAP_event.c
+	${DAPLINK_DIR}/Source/DAP_core.c
+	${DAPLINK_DIR}/Source/DAP_rom.c
+	${DAPLINK_DIR}/Source/DAP_script.c
+	${DAPLINK_DIR}/Source/DAP_capture.c
 	${DAPLINK_DIR}/Source/JTAG_DP.c
 	${DAPLINK_DIR}/Source/SW_DP.c
 	${DAPLINK_DIR}/Source/SWO.c
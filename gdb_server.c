@@ -0,0 +1,802 @@
+#include <string.h>
+#include "DAP_config.h"
+#include "DAP.h"
+#include "tusb.h"
+#include "gdb_server.h"
+
+/*
+ * GDB Remote Serial Protocol server on the CDC port.
+ *
+ * The CDC port is shared with the RTT bridge and semihosting, there are no
+ * endpoints left for a second one. A session starts when the first byte
+ * received after the port opened is a GDB '+', '$' or interrupt, any other
+ * first byte leaves the port to the terminal functions until it closes.
+ *
+ * Packets are received into one buffer and parsed in place: arguments are
+ * read straight from the payload, M and X data are decoded over itself and
+ * the reply is built into the same buffer behind the '$' once the request
+ * has been taken apart. A packet is only taken when the CDC buffer has room
+ * for the ack and the largest reply, so a reply never waits for space.
+ *
+ * The server holds the Debug Port from the first target access until the
+ * session ends. Breakpoints use the FPB, watchpoints the DWT. Memory is
+ * accessed in words, partial words are read, modified and written back.
+ */
+#define GDB_PACKET_SIZE     256U    /* Largest payload, advertised as PacketSize */
+#define GDB_BUFFER_SIZE     (GDB_PACKET_SIZE + 4U)
+#define GDB_INTERRUPT       0x03U
+
+#define POLL_MIN_US         200U
+#define POLL_MAX_US         10000U
+#define HALT_POLLS          100U
+
+#define CHUNK_SIZE          64U     /* Bytes per target access */
+#define CHUNK_WORDS         ((CHUNK_SIZE / 4U) + 1U)
+
+/* r0-r12, sp, lr, pc and xpsr, numbered like their DCRSR selectors */
+#define REG_COUNT           17U
+#define REG_MASK            ((1U << REG_COUNT) - 1U)
+#define REG_PC              15U
+
+#define SIGINT              2U
+#define SIGTRAP             5U
+
+/* Debug Fault Status */
+#define DBG_FSR             0xE000ED30U
+#define DFSR_DWTTRAP        (1U<<2)
+#define DFSR_ALL            0x1FU
+
+/* DEMCR: DWT and ITM enable */
+#define TRCENA              (1U<<24)
+
+/* Flash Patch and Breakpoint unit */
+#define FP_CTRL             0xE0002000U
+#define FP_COMP0            0xE0002008U
+#define FP_CTRL_KEY         (1U<<1)
+#define FP_CTRL_ENABLE      (1U<<0)
+#define FP_COMP_ENABLE      (1U<<0)
+#define FP_REPLACE_LOWER    (1U<<30)
+#define FP_REPLACE_UPPER    (2U<<30)
+#define FP_V1_LIMIT         0x20000000U     /* Revision 1 only covers the code region */
+#define FP_V1_ADDR          0x1FFFFFFCU
+
+/* Data Watchpoint and Trace unit, ARMv6-M and ARMv7-M layout */
+#define DWT_CTRL            0xE0001000U
+#define DWT_COMP0           0xE0001020U
+#define DWT_STRIDE          16U
+#define DWT_MASK            4U
+#define DWT_FUNCTION        8U
+#define DWT_MATCHED         (1U<<24)
+#define DWT_READ            5U
+#define DWT_WRITE           6U
+#define DWT_ACCESS          7U
+
+#define BP_MAX              8U
+#define WP_MAX              4U
+
+#define STATE_CLOSED        0U
+#define STATE_DETECT        1U      /* Port open, waiting for the first byte */
+#define STATE_TERMINAL      2U      /* Not a debugger, left to RTT and semihosting */
+#define STATE_ACTIVE        3U
+
+static const char hex_digits[] = "0123456789abcdef";
+
+static const char target_xml[] =
+    "<?xml version=\"1.0\"?>"
+    "<!DOCTYPE target SYSTEM \"gdb-target.dtd\">"
+    "<target><architecture>arm</architecture>"
+    "<feature name=\"org.gnu.gdb.arm.m-profile\">"
+    "<reg name=\"r0\" bitsize=\"32\"/><reg name=\"r1\" bitsize=\"32\"/>"
+    "<reg name=\"r2\" bitsize=\"32\"/><reg name=\"r3\" bitsize=\"32\"/>"
+    "<reg name=\"r4\" bitsize=\"32\"/><reg name=\"r5\" bitsize=\"32\"/>"
+    "<reg name=\"r6\" bitsize=\"32\"/><reg name=\"r7\" bitsize=\"32\"/>"
+    "<reg name=\"r8\" bitsize=\"32\"/><reg name=\"r9\" bitsize=\"32\"/>"
+    "<reg name=\"r10\" bitsize=\"32\"/><reg name=\"r11\" bitsize=\"32\"/>"
+    "<reg name=\"r12\" bitsize=\"32\"/>"
+    "<reg name=\"sp\" bitsize=\"32\" type=\"data_ptr\"/>"
+    "<reg name=\"lr\" bitsize=\"32\"/>"
+    "<reg name=\"pc\" bitsize=\"32\" type=\"code_ptr\"/>"
+    "<reg name=\"xpsr\" bitsize=\"32\"/>"
+    "</feature></target>";
+
+static struct {
+    uint32_t state;
+    uint32_t attached;      /* Debug Port connected by the server */
+    uint32_t running;       /* Core resumed, stop reply outstanding */
+    uint32_t interrupt;     /* Interrupt received while running */
+    uint32_t noack;
+    uint32_t len;           /* Bytes received into buf */
+    uint32_t fpb_rev;
+    uint32_t bp_count;
+    uint32_t bp[BP_MAX];    /* Comparator values, 0 when free */
+    uint32_t wp_count;
+    uint32_t wp_addr[WP_MAX];
+    uint32_t wp_func[WP_MAX];   /* DWT function, 0 when free */
+    uint32_t interval;
+    uint32_t last;
+} gdb;
+
+static uint8_t buf[GDB_BUFFER_SIZE];
+static uint8_t *out;        /* Reply write position in buf */
+
+/* Target memory chunk, or all registers for 'g' and 'G' */
+static uint32_t scratch[CHUNK_WORDS];
+
+static uint32_t hex_value(uint8_t c)
+{
+    if ((c >= '0') && (c <= '9'))
+        return c - '0';
+    if ((c >= 'a') && (c <= 'f'))
+        return c - 'a' + 10U;
+    if ((c >= 'A') && (c <= 'F'))
+        return c - 'A' + 10U;
+    return 16U;
+}
+
+/* Parses a big endian hex number and advances past it */
+static uint32_t get_hex(uint8_t **p)
+{
+    uint32_t value = 0U;
+    uint32_t digit;
+
+    while ((digit = hex_value(**p)) < 16U) {
+        value = (value << 4) | digit;
+        (*p)++;
+    }
+    return value;
+}
+
+/* Parses a register value, eight hex digits in target byte order */
+static uint32_t get_word(uint8_t **p)
+{
+    uint32_t value = 0U;
+    uint32_t n;
+
+    for (n = 0U; (n < 32U) && (hex_value((*p)[0]) < 16U) && (hex_value((*p)[1]) < 16U); n += 8U) {
+        value |= ((hex_value((*p)[0]) << 4) | hex_value((*p)[1])) << n;
+        *p += 2;
+    }
+    return value;
+}
+
+/* Decodes hex pairs over themselves, returns the bytes decoded */
+static uint32_t unhex(uint8_t *p, uint32_t length)
+{
+    uint32_t n;
+
+    for (n = 0U; (n < length) && (hex_value(p[2U * n]) < 16U) && (hex_value(p[(2U * n) + 1U]) < 16U); n++)
+        p[n] = (uint8_t)((hex_value(p[2U * n]) << 4) | hex_value(p[(2U * n) + 1U]));
+    return n;
+}
+
+/* Removes '}' escapes of binary data in place, returns the bytes decoded */
+static uint32_t unescape(uint8_t *p, const uint8_t *end, uint32_t length)
+{
+    const uint8_t *in = p;
+    uint32_t n;
+
+    for (n = 0U; (n < length) && (in < end); n++) {
+        if ((*in == '}') && ((in + 1) < end)) {
+            p[n] = in[1] ^ 0x20U;
+            in += 2;
+        } else {
+            p[n] = *in++;
+        }
+    }
+    return n;
+}
+
+static void put_str(const char *s)
+{
+    while (*s != '\0')
+        *out++ = (uint8_t)*s++;
+}
+
+static void put_byte(uint8_t value)
+{
+    *out++ = (uint8_t)hex_digits[value >> 4];
+    *out++ = (uint8_t)hex_digits[value & 0xFU];
+}
+
+static void put_word(uint32_t value)
+{
+    uint32_t n;
+
+    for (n = 0U; n < 4U; n++) {
+        put_byte((uint8_t)value);
+        value >>= 8;
+    }
+}
+
+static void put_error(uint8_t code)
+{
+    *out++ = 'E';
+    put_byte(code);
+}
+
+/* Frames the reply built behind buf[0] and queues it on the CDC port */
+static void send(void)
+{
+    uint8_t sum = 0U;
+    uint8_t *p;
+
+    buf[0] = '$';
+    for (p = &buf[1]; p < out; p++)
+        sum += *p;
+    *out++ = '#';
+    put_byte(sum);
+    tud_cdc_write(buf, (uint32_t)(out - buf));
+    tud_cdc_write_flush();
+}
+
+/* Halts the core and waits until it is in Debug state */
+static uint32_t halt(void)
+{
+    uint32_t value;
+    uint32_t n;
+
+    if (Target_Write32(DBG_HCSR, DBGKEY | C_DEBUGEN | C_HALT) != DAP_TRANSFER_OK)
+        return 0U;
+    for (n = HALT_POLLS; n; n--) {
+        if (Target_Read32(DBG_HCSR, &value) != DAP_TRANSFER_OK)
+            return 0U;
+        if (value & S_HALT)
+            return 1U;
+    }
+    return 0U;
+}
+
+/* Clears all comparators and takes the FPB and DWT sizes */
+static uint32_t reset_units(void)
+{
+    uint32_t value;
+    uint32_t n;
+
+    if ((Target_Read32(DBG_EMCR, &value) != DAP_TRANSFER_OK) ||
+        (Target_Write32(DBG_EMCR, value | TRCENA) != DAP_TRANSFER_OK) ||
+        (Target_Read32(FP_CTRL, &value) != DAP_TRANSFER_OK))
+        return 0U;
+    gdb.fpb_rev  = value >> 28;
+    gdb.bp_count = ((value >> 8) & 0x70U) | ((value >> 4) & 0x0FU);
+    if (gdb.bp_count > BP_MAX)
+        gdb.bp_count = BP_MAX;
+    if (Target_Read32(DWT_CTRL, &value) != DAP_TRANSFER_OK)
+        return 0U;
+    gdb.wp_count = value >> 28;
+    if (gdb.wp_count > WP_MAX)
+        gdb.wp_count = WP_MAX;
+
+    for (n = 0U; n < gdb.bp_count; n++) {
+        gdb.bp[n] = 0U;
+        if (Target_Write32(FP_COMP0 + (n * 4U), 0U) != DAP_TRANSFER_OK)
+            return 0U;
+    }
+    for (n = 0U; n < gdb.wp_count; n++) {
+        gdb.wp_func[n] = 0U;
+        if (Target_Write32(DWT_COMP0 + (n * DWT_STRIDE) + DWT_FUNCTION, 0U) != DAP_TRANSFER_OK)
+            return 0U;
+    }
+    return Target_Write32(FP_CTRL, FP_CTRL_KEY | FP_CTRL_ENABLE) == DAP_TRANSFER_OK;
+}
+
+/* Connects to the target on first use and halts it, returns 0 while a host session holds the port */
+static uint32_t attach(void)
+{
+    if (gdb.attached) {
+        if (DAP_Data.debug_port != DAP_PORT_DISABLED)
+            return 1U;
+        /* A host session has come and gone, it released the port */
+        gdb.attached = 0U;
+    } else {
+        /* Takes the port over from the RTT bridge and semihosting */
+        Target_Release();
+        if (DAP_Data.debug_port != DAP_PORT_DISABLED)
+            return 0U;
+    }
+
+    if ((Target_Connect(NULL) != DAP_TRANSFER_OK) || !halt() || !reset_units()) {
+        Target_Disconnect();
+        return 0U;
+    }
+    gdb.attached = 1U;
+    return 1U;
+}
+
+/* Removes all breakpoints and watchpoints, lets the core run and releases the port */
+static void detach(void)
+{
+    if (gdb.attached && (DAP_Data.debug_port != DAP_PORT_DISABLED)) {
+        (void)reset_units();
+        (void)Target_Write32(FP_CTRL, FP_CTRL_KEY);
+        (void)Target_Write32(DBG_HCSR, DBGKEY);
+        Target_Disconnect();
+    }
+    gdb.attached = 0U;
+    gdb.running  = 0U;
+}
+
+/* Resumes the core, a step runs with interrupts masked */
+static uint32_t resume(uint32_t step)
+{
+    uint32_t mask = step ? C_MASKINTS : 0U;
+
+    /* C_MASKINTS may only change while the core stays halted */
+    if ((Target_Write32(DBG_FSR, DFSR_ALL) != DAP_TRANSFER_OK) ||
+        (Target_Write32(DBG_HCSR, DBGKEY | C_DEBUGEN | C_HALT | mask) != DAP_TRANSFER_OK) ||
+        (Target_Write32(DBG_HCSR, DBGKEY | C_DEBUGEN | mask | (step ? C_STEP : 0U)) != DAP_TRANSFER_OK))
+        return 0U;
+    gdb.running   = 1U;
+    gdb.interrupt = 0U;
+    gdb.interval  = 0U;
+    return 1U;
+}
+
+/* Builds the stop reply, naming the watchpoint that triggered */
+static void put_stop(uint32_t signal)
+{
+    static const char *const kind[3] = { "rwatch:", "watch:", "awatch:" };
+    uint32_t value;
+    uint32_t n;
+
+    *out++ = 'T';
+    put_byte((uint8_t)signal);
+    if ((Target_Read32(DBG_FSR, &value) != DAP_TRANSFER_OK) || !(value & DFSR_DWTTRAP))
+        return;
+    for (n = 0U; n < gdb.wp_count; n++) {
+        /* Reading FUNCTION clears MATCHED */
+        if ((gdb.wp_func[n] != 0U) &&
+            (Target_Read32(DWT_COMP0 + (n * DWT_STRIDE) + DWT_FUNCTION, &value) == DAP_TRANSFER_OK) &&
+            (value & DWT_MATCHED)) {
+            put_str(kind[gdb.wp_func[n] - DWT_READ]);
+            for (value = 0U; value < 4U; value++)
+                put_byte((uint8_t)(gdb.wp_addr[n] >> (24U - (value * 8U))));
+            *out++ = ';';
+            break;
+        }
+    }
+}
+
+/* Reads target memory into the reply as hex, returns 0 when nothing could be read */
+static uint32_t put_mem(uint32_t addr, uint32_t length)
+{
+    uint8_t *start = out;
+    uint32_t offset;
+    uint32_t n;
+    uint8_t *data;
+
+    while (length != 0U) {
+        offset = addr & 3U;
+        n = CHUNK_SIZE - offset;
+        if (n > length)
+            n = length;
+        if (Target_ReadMem(addr - offset, scratch, (offset + n + 3U) / 4U) != DAP_TRANSFER_OK)
+            break;
+        for (data = (uint8_t *)scratch + offset; data < ((uint8_t *)scratch + offset + n); data++)
+            put_byte(*data);
+        addr   += n;
+        length -= n;
+    }
+    return out != start;
+}
+
+/* Writes bytes to target memory, keeping the other bytes of partial words */
+static uint32_t write_mem(uint32_t addr, const uint8_t *data, uint32_t length)
+{
+    uint32_t offset;
+    uint32_t words;
+    uint32_t n;
+
+    while (length != 0U) {
+        offset = addr & 3U;
+        n = CHUNK_SIZE - offset;
+        if (n > length)
+            n = length;
+        words = (offset + n + 3U) / 4U;
+        if (((offset != 0U) &&
+             (Target_Read32(addr - offset, &scratch[0]) != DAP_TRANSFER_OK)) ||
+            (((offset + n) & 3U) &&
+             (Target_Read32(addr - offset + ((words - 1U) * 4U), &scratch[words - 1U]) != DAP_TRANSFER_OK)))
+            return 0U;
+        memcpy((uint8_t *)scratch + offset, data, n);
+        if (Target_WriteMem(addr - offset, scratch, words) != DAP_TRANSFER_OK)
+            return 0U;
+        addr   += n;
+        data   += n;
+        length -= n;
+    }
+    return 1U;
+}
+
+/* FPB comparator value for a breakpoint, 0 when the FPB cannot reach the address */
+static uint32_t fpb_comp(uint32_t addr)
+{
+    if (gdb.fpb_rev != 0U)
+        return (addr & ~1U) | FP_COMP_ENABLE;
+    if (addr >= FP_V1_LIMIT)
+        return 0U;
+    return (addr & FP_V1_ADDR) | ((addr & 2U) ? FP_REPLACE_UPPER : FP_REPLACE_LOWER) | FP_COMP_ENABLE;
+}
+
+static uint32_t breakpoint(uint32_t insert, uint32_t addr)
+{
+    uint32_t comp = fpb_comp(addr);
+    uint32_t n;
+
+    if (comp == 0U)
+        return 0U;
+    for (n = 0U; n < gdb.bp_count; n++) {
+        if (gdb.bp[n] == (insert ? 0U : comp))
+            break;
+    }
+    if ((n == gdb.bp_count) ||
+        (Target_Write32(FP_COMP0 + (n * 4U), insert ? comp : 0U) != DAP_TRANSFER_OK))
+        return 0U;
+    gdb.bp[n] = insert ? comp : 0U;
+    return 1U;
+}
+
+static uint32_t watchpoint(uint32_t insert, uint32_t func, uint32_t addr, uint32_t length)
+{
+    uint32_t base = DWT_COMP0;
+    uint32_t mask;
+    uint32_t n;
+
+    for (n = 0U; n < gdb.wp_count; n++, base += DWT_STRIDE) {
+        if (insert ? (gdb.wp_func[n] == 0U) : ((gdb.wp_func[n] == func) && (gdb.wp_addr[n] == addr)))
+            break;
+    }
+    if (n == gdb.wp_count)
+        return 0U;
+    if (!insert) {
+        gdb.wp_func[n] = 0U;
+        return Target_Write32(base + DWT_FUNCTION, 0U) == DAP_TRANSFER_OK;
+    }
+
+    /* Smallest aligned power of two block covering the range */
+    if (length == 0U)
+        length = 1U;
+    for (mask = 0U; (mask < 31U) && ((addr >> mask) != ((addr + length - 1U) >> mask)); mask++) {
+    }
+    if ((Target_Write32(base, addr & ~((1U << mask) - 1U)) != DAP_TRANSFER_OK) ||
+        (Target_Write32(base + DWT_MASK, mask) != DAP_TRANSFER_OK) ||
+        (Target_Write32(base + DWT_FUNCTION, func) != DAP_TRANSFER_OK))
+        return 0U;
+    gdb.wp_addr[n] = addr;
+    gdb.wp_func[n] = func;
+    return 1U;
+}
+
+/* Handles general queries and settings, q and Q packets */
+static void query(uint8_t *p, uint32_t length)
+{
+    uint32_t offset;
+    uint32_t n;
+
+    if (strncmp((char *)p, "qSupported", 10) == 0) {
+        put_str("PacketSize=100;qXfer:features:read+;QStartNoAckMode+");
+    } else if (strcmp((char *)p, "QStartNoAckMode") == 0) {
+        put_str("OK");
+        gdb.noack = 1U;
+    } else if (strcmp((char *)p, "qAttached") == 0) {
+        *out++ = '1';
+    } else if (strncmp((char *)p, "qXfer:features:read:target.xml:", 31) == 0) {
+        p += 31;
+        offset = get_hex(&p);
+        p++;
+        n = get_hex(&p);
+        if (n > (GDB_PACKET_SIZE - 1U))
+            n = GDB_PACKET_SIZE - 1U;
+        if (offset >= (sizeof(target_xml) - 1U)) {
+            *out++ = 'l';
+        } else {
+            if (n >= (sizeof(target_xml) - 1U - offset)) {
+                n = sizeof(target_xml) - 1U - offset;
+                *out++ = 'l';
+            } else {
+                *out++ = 'm';
+            }
+            memcpy(out, &target_xml[offset], n);
+            out += n;
+        }
+    } else if (strncmp((char *)p, "qRcmd,", 6) == 0) {
+        /* monitor reset: reset the target and halt it at the reset vector */
+        n = unhex(p + 6, (length - 6U) / 2U);
+        if ((n != 5U) || (memcmp(p + 6, "reset", 5) != 0))
+            return;
+        if (attach() && (Target_ResetHalt() == DAP_TRANSFER_OK) && reset_units())
+            put_str("OK");
+        else
+            put_error(1U);
+    }
+}
+
+/* Handles a packet, the payload is NUL terminated, returns 0 when there is no reply yet */
+static uint32_t handle(uint8_t *p, uint32_t length)
+{
+    static const uint8_t watch_func[3] = { DWT_WRITE, DWT_READ, DWT_ACCESS };
+    const uint8_t *end = p + length;
+    uint32_t addr;
+    uint32_t value;
+    uint32_t n;
+    uint8_t cmd;
+
+    out = &buf[1];
+    cmd = *p++;
+    switch (cmd) {
+    case 'q':
+    case 'Q':
+        query(p - 1, length);
+        return 1U;
+    case '?':
+        if (!attach())
+            put_error(1U);
+        else
+            put_stop(SIGTRAP);
+        return 1U;
+    case 'H':
+        put_str("OK");
+        return 1U;
+    case 'D':
+        detach();
+        put_str("OK");
+        return 1U;
+    case 'k':
+        if (attach())
+            (void)Target_ResetRun();
+        detach();
+        return 0U;
+    default:
+        break;
+    }
+
+    /* Everything below accesses the target */
+    switch (cmd) {
+    case 'g':
+    case 'G':
+    case 'p':
+    case 'P':
+    case 'm':
+    case 'M':
+    case 'X':
+    case 'c':
+    case 's':
+    case 'Z':
+    case 'z':
+        if (!attach()) {
+            put_error(1U);
+            return 1U;
+        }
+        break;
+    default:
+        /* Not supported, empty reply */
+        return 1U;
+    }
+
+    switch (cmd) {
+    case 'g':
+        if (Target_ReadCoreSet(REG_MASK, scratch) != DAP_TRANSFER_OK) {
+            put_error(1U);
+            break;
+        }
+        for (n = 0U; n < REG_COUNT; n++)
+            put_word(scratch[n]);
+        break;
+    case 'G':
+        for (n = 0U; n < REG_COUNT; n++)
+            scratch[n] = get_word(&p);
+        if (Target_WriteCoreSet(REG_MASK, scratch) == DAP_TRANSFER_OK)
+            put_str("OK");
+        else
+            put_error(1U);
+        break;
+    case 'p':
+        n = get_hex(&p);
+        if ((n < REG_COUNT) && (Target_ReadCore(n, &value) == DAP_TRANSFER_OK))
+            put_word(value);
+        else
+            put_error(1U);
+        break;
+    case 'P':
+        n = get_hex(&p);
+        p++;
+        if ((n < REG_COUNT) && (Target_WriteCore(n, get_word(&p)) == DAP_TRANSFER_OK))
+            put_str("OK");
+        else
+            put_error(1U);
+        break;
+    case 'm':
+        addr = get_hex(&p);
+        p++;
+        n = get_hex(&p);
+        if (n > (GDB_PACKET_SIZE / 2U))
+            n = GDB_PACKET_SIZE / 2U;
+        if (!put_mem(addr, n))
+            put_error(1U);
+        break;
+    case 'M':
+    case 'X':
+        addr = get_hex(&p);
+        p++;
+        value = get_hex(&p);
+        if (*p++ != ':') {
+            put_error(1U);
+            break;
+        }
+        n = (cmd == 'M') ? unhex(p, value) : unescape(p, end, value);
+        if ((n == value) && write_mem(addr, p, n))
+            put_str("OK");
+        else
+            put_error(1U);
+        break;
+    case 'c':
+    case 's':
+        if ((*p != '\0') && (Target_WriteCore(REG_PC, get_hex(&p)) != DAP_TRANSFER_OK)) {
+            put_error(1U);
+            break;
+        }
+        if (!resume(cmd == 's')) {
+            put_error(1U);
+            break;
+        }
+        /* The stop reply follows once the core halts */
+        return 0U;
+    case 'Z':
+    case 'z':
+        n = *p++ - '0';
+        p++;
+        addr = get_hex(&p);
+        p++;
+        value = get_hex(&p);
+        if (n <= 1U) {
+            n = breakpoint(cmd == 'Z', addr);
+        } else if (n <= 4U) {
+            n = watchpoint(cmd == 'Z', watch_func[n - 2U], addr, value);
+        } else {
+            /* Unknown type, empty reply */
+            break;
+        }
+        if (n)
+            put_str("OK");
+        else
+            put_error(1U);
+        break;
+    default:
+        break;
+    }
+    return 1U;
+}
+
+/* Takes the next complete packet from the CDC port, returns its payload length or -1 */
+static int32_t receive(void)
+{
+    uint8_t *end;
+    uint32_t length;
+    uint32_t n;
+    uint8_t sum;
+
+    n = tud_cdc_available();
+    if (n > (GDB_BUFFER_SIZE - gdb.len))
+        n = GDB_BUFFER_SIZE - gdb.len;
+    if (n != 0U)
+        gdb.len += tud_cdc_read(&buf[gdb.len], n);
+
+    /* Acks and interrupts outside of packets */
+    for (n = 0U; (n < gdb.len) && (buf[n] != '$'); n++) {
+        if (buf[n] == GDB_INTERRUPT)
+            gdb.interrupt = 1U;
+    }
+    if (n != 0U) {
+        gdb.len -= n;
+        memmove(buf, &buf[n], gdb.len);
+    }
+
+    end = memchr(buf, '#', gdb.len);
+    if (end == NULL) {
+        if (gdb.len == GDB_BUFFER_SIZE)
+            gdb.len = 0U;   /* Too large, drop it */
+        return -1;
+    }
+    if ((end + 3) > &buf[gdb.len])
+        return -1;
+
+    /* gdb waits for the reply, anything behind the packet can only be an interrupt */
+    for (n = (uint32_t)(end + 3 - buf); n < gdb.len; n++) {
+        if (buf[n] == GDB_INTERRUPT)
+            gdb.interrupt = 1U;
+    }
+    gdb.len = 0U;
+
+    length = (uint32_t)(end - &buf[1]);
+    for (sum = 0U, n = 1U; n <= length; n++)
+        sum += buf[n];
+    if (sum != ((hex_value(end[1]) << 4) | hex_value(end[2]))) {
+        if (!gdb.noack)
+            (void)tud_cdc_write_char('-');
+        return -1;
+    }
+    if (!gdb.noack)
+        (void)tud_cdc_write_char('+');
+    *end = '\0';
+    return (int32_t)length;
+}
+
+/**
+ * @brief Run the GDB server.
+ *
+ * Handles received packets and polls a running core for its halt.
+ *
+ * @return Microseconds until the next poll, 0 when waiting for a packet only.
+ */
+uint32_t gdb_server_task(void)
+{
+    uint32_t elapsed;
+    uint32_t value;
+    int32_t length;
+    uint8_t first;
+
+    if (!tud_cdc_connected()) {
+        if (gdb.state == STATE_ACTIVE)
+            detach();
+        gdb.state = STATE_CLOSED;
+        return 0U;
+    }
+    if (gdb.state == STATE_CLOSED) {
+        gdb.state = STATE_DETECT;
+        gdb.len   = 0U;
+        gdb.noack = 0U;
+    }
+    if (gdb.state == STATE_DETECT) {
+        if (!tud_cdc_peek(&first))
+            return 0U;
+        gdb.state = ((first == '+') || (first == '$') || (first == GDB_INTERRUPT)) ?
+                    STATE_ACTIVE : STATE_TERMINAL;
+    }
+    if (gdb.state != STATE_ACTIVE)
+        return 0U;
+
+    /* Room for the ack and the largest reply */
+    while (!gdb.running && (tud_cdc_write_available() > GDB_BUFFER_SIZE) &&
+           ((length = receive()) >= 0)) {
+        if (handle(&buf[1], (uint32_t)length))
+            send();
+    }
+    if (!gdb.running)
+        return 0U;
+
+    elapsed = hw_timer_elapsed(gdb.last);
+    if ((elapsed < gdb.interval) && !(gdb.interrupt || (tud_cdc_available() != 0U)))
+        return gdb.interval - elapsed;
+    gdb.last = hw_timer_now();
+
+    /* Only an interrupt is expected while the core runs */
+    if (gdb.len < GDB_BUFFER_SIZE)
+        (void)receive();
+    if (!attach() ||
+        (gdb.interrupt && (Target_Write32(DBG_HCSR, DBGKEY | C_DEBUGEN | C_HALT) != DAP_TRANSFER_OK)) ||
+        (Target_Read32(DBG_HCSR, &value) != DAP_TRANSFER_OK)) {
+        gdb.interval = POLL_MAX_US;
+        return gdb.interval;
+    }
+    if ((value & S_HALT) && (tud_cdc_write_available() > GDB_BUFFER_SIZE)) {
+        gdb.running = 0U;
+        out = &buf[1];
+        put_stop(gdb.interrupt ? SIGINT : SIGTRAP);
+        gdb.interrupt = 0U;
+        send();
+        return 0U;
+    }
+    gdb.interval = (gdb.interval < POLL_MIN_US) ? POLL_MIN_US : (gdb.interval * 2U);
+    if (gdb.interval > POLL_MAX_US)
+        gdb.interval = POLL_MAX_US;
+    return gdb.interval;
+}
+
+/**
+ * @brief Check whether a debugger session owns the CDC port.
+ *
+ * @return 1 while the RTT bridge and semihosting have to keep off the port.
+ */
+uint32_t gdb_server_active(void)
+{
+    return gdb.state == STATE_ACTIVE;
+}
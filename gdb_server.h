@@ -0,0 +1,16 @@
+#ifndef _GDB_SERVER_H_
+#define _GDB_SERVER_H_
+
+#include <stdint.h>
+
+/*
+ * Serves a GDB remote session on the CDC port, call from the USB thread
+ * before the RTT bridge and semihosting. Returns the microseconds until the
+ * next poll is due, 0 when not polling.
+ */
+extern uint32_t gdb_server_task(void);
+
+/* Returns 1 while a GDB session owns the CDC port */
+extern uint32_t gdb_server_active(void);
+
+#endif
@@ -0,0 +1,93 @@
+#include "NUC100Series.h"
+#include "tx_api.h"
+#include "hw_timer.h"
+
+#define TIMER_MODE_CONTINUOUS   (3UL << TIMER_TCSR_MODE_Pos)
+#define TIMER_PRESCALE          ((__HXT / HW_TIMER_CLOCK) - 1U)
+
+/* Longest single compare interval, keeps the match well ahead of the counter */
+#define TIMER_MAX_SLEEP         (HW_TIMER_MASK / 2U)
+
+#define US_PER_TICK             (1000000U / TX_TIMER_TICKS_PER_SECOND)
+
+static TX_SEMAPHORE timer_sem;
+static uint8_t sleeping;
+
+/**
+ * @brief Start TIMER0 as the free-running microsecond time base.
+ *
+ * TIMER0 runs in continuous counting mode, so TDR keeps counting through
+ * compare matches and TCMPR can be re-armed for wake-ups without disturbing
+ * the time base. Must be called from tx_application_define() since it creates
+ * the semaphore used by hw_timer_sleep_us().
+ */
+void hw_timer_init(void)
+{
+    TIMER0->TCSR = TIMER_TCSR_CRST_Msk;
+    TIMER0->TCMPR = HW_TIMER_MASK;
+    TIMER0->TISR = TIMER_TISR_TIF_Msk;
+    TIMER0->TCSR = TIMER_TCSR_CEN_Msk | TIMER_MODE_CONTINUOUS |
+                   TIMER_TCSR_TDR_EN_Msk | TIMER_PRESCALE;
+
+    tx_semaphore_create(&timer_sem, "timer", 0);
+    NVIC_EnableIRQ(TMR0_IRQn);
+}
+
+void TMR0_IRQHandler(void)
+{
+    TIMER0->TCSR &= ~TIMER_TCSR_IE_Msk;
+    TIMER0->TISR = TIMER_TISR_TIF_Msk;
+    tx_semaphore_put(&timer_sem);
+}
+
+/**
+ * @brief Block the calling thread until the timer has advanced by us.
+ *
+ * The wake-up comes from a TIMER0 compare match, so the resolution is not
+ * limited by the 10 ms ThreadX tick. The semaphore timeout is only a safety
+ * net in case the match is missed. There is one compare channel, so only one
+ * thread can sleep at a time; a second caller gets 0 back.
+ *
+ * @return 1 when the wait has been performed, 0 when the caller is not a
+ *         thread (kernel not started or interrupt context) or another thread
+ *         is sleeping, and has to wait otherwise.
+ */
+uint32_t hw_timer_sleep_us(uint32_t us)
+{
+    TX_INTERRUPT_SAVE_AREA
+    uint32_t step;
+    uint32_t cmp;
+
+    if ((__get_IPSR() != 0U) || (tx_thread_identify() == TX_NULL))
+        return 0U;
+
+    TX_DISABLE
+    if (sleeping) {
+        TX_RESTORE
+        return 0U;
+    }
+    sleeping = 1U;
+    TX_RESTORE
+
+    while (us != 0U) {
+        step = (us > TIMER_MAX_SLEEP) ? TIMER_MAX_SLEEP : us;
+        us -= step;
+
+        /* TCMPR must not be 0 or 1 */
+        cmp = (TIMER0->TDR + step) & HW_TIMER_MASK;
+        if (cmp < 2U)
+            cmp = 2U;
+
+        while (tx_semaphore_get(&timer_sem, TX_NO_WAIT) == TX_SUCCESS) {
+        }
+        TIMER0->TCMPR = cmp;
+        TIMER0->TISR = TIMER_TISR_TIF_Msk;
+        TIMER0->TCSR |= TIMER_TCSR_IE_Msk;
+
+        tx_semaphore_get(&timer_sem, (step / US_PER_TICK) + 2U);
+        TIMER0->TCSR &= ~TIMER_TCSR_IE_Msk;
+    }
+
+    sleeping = 0U;
+    return 1U;
+}
@@ -0,0 +1,29 @@
+#ifndef _HW_TIMER_H_
+#define _HW_TIMER_H_
+
+#include <stdint.h>
+#include "NUC100Series.h"
+
+/* TIMER0 free-runs at 1 MHz from the 12 MHz crystal, TDR is 24 bits wide */
+#define HW_TIMER_CLOCK      1000000U
+#define HW_TIMER_MASK       0x00FFFFFFU
+
+/* Starts the free-running timer and creates the wake-up semaphore */
+extern void hw_timer_init(void);
+
+/* Sleeps the calling thread for us microseconds, returns 0 when not called from a thread or another thread sleeps */
+extern uint32_t hw_timer_sleep_us(uint32_t us);
+
+/* Current timer value in microseconds (wraps after HW_TIMER_MASK) */
+static inline uint32_t hw_timer_now(void)
+{
+    return TIMER0->TDR;
+}
+
+/* Microseconds elapsed since a value returned by hw_timer_now() */
+static inline uint32_t hw_timer_elapsed(uint32_t since)
+{
+    return (TIMER0->TDR - since) & HW_TIMER_MASK;
+}
+
+#endif
@@ -0,0 +1,490 @@
+#include <string.h>
+#include "board_config.h"
+#include "DAP_config.h"
+#include "DAP.h"
+#include "target_flash.h"
+#include "image_stream.h"
+
+/*
+ * Streaming image decoder for file sectors written in any order.
+ *
+ * The image file is decoded strictly in file order. The target is not
+ * touched until a sector that starts an image has been seen: hosts write
+ * metadata and hidden files to the data area as well, and connecting resets
+ * and halts the target. Until then the last few sectors are held in probe
+ * RAM, in the buffer that later collects flash pages. Once the image is
+ * open, a sector that arrives ahead of its turn is parked in target SRAM
+ * and replayed from there when the sectors before it are in. The target is
+ * halted while it is programmed, its SRAM is free for this. Files are
+ * assumed contiguous, which holds on the freshly generated volume.
+ */
+#define SECTOR_SIZE         512U
+
+#define PAGE_WORDS          (TARGET_FLASH_PAGE_SIZE / 4U)
+#define PAGE_COUNT          (TARGET_FLASH_SIZE / TARGET_FLASH_PAGE_SIZE)
+#define NO_PAGE             0xFFFFFFFFU
+
+/* Sector slots in target SRAM */
+#define STAGE_SLOTS         (TARGET_STAGING_SIZE / SECTOR_SIZE)
+#define STAGE_ADDR(slot)    (TARGET_STAGING_START + ((slot) * SECTOR_SIZE))
+#define STAGE_EMPTY         0U          /* Never a data area sector */
+#define STAGE_CHUNK_WORDS   16U
+
+/* Sectors held in probe RAM before an image starts, they share the page buffer */
+#define HOLD_SLOTS          IMAGE_STREAM_HOLD_SECTORS
+#define HOLD_WORDS          (SECTOR_SIZE / 4U)
+
+/* Directory entries remembered until their file starts */
+#define FILE_SLOTS          4U
+
+/* File sectors accepted while the size is unknown, HEX text is up to 4 characters per byte */
+#define BIN_SECTORS_MAX     (TARGET_FLASH_SIZE / SECTOR_SIZE)
+#define HEX_SECTORS_MAX     ((4U * TARGET_FLASH_SIZE) / SECTOR_SIZE)
+
+#define TYPE_BIN            1U
+#define TYPE_HEX            2U
+
+#define NO_ERROR            0U
+
+static struct {
+    uint32_t state;
+    uint32_t type;
+    uint32_t error;
+    uint32_t connected;
+    uint32_t start;         /* First sector of the image file */
+    uint32_t next;          /* Next sector in file order */
+    uint32_t size;          /* File size, 0 while unknown */
+    uint32_t length;        /* File bytes decoded */
+    uint32_t image;         /* Image bytes written */
+} stream;
+
+/* Intel HEX record decoder, fed one character at a time */
+static struct {
+    uint32_t active;        /* Inside a record */
+    uint32_t nibble;        /* High nibble pending */
+    uint32_t value;
+    uint32_t pos;           /* Byte position in the record */
+    uint32_t count;
+    uint32_t offset;
+    uint32_t type;
+    uint32_t sum;
+    uint32_t ext;           /* Extended address data */
+    uint32_t base;
+    uint32_t done;
+} hex;
+
+static union {
+    uint32_t page[PAGE_WORDS];
+    uint32_t hold[HOLD_SLOTS][HOLD_WORDS];
+} probe;
+static uint32_t page_addr = NO_PAGE;
+static uint8_t  page_erased[PAGE_COUNT / 8U];
+
+static uint32_t hold_sector[HOLD_SLOTS];
+static uint32_t hold_evict;
+
+static uint32_t stage_sector[STAGE_SLOTS];
+
+static struct {
+    uint32_t sector;
+    uint32_t size;
+} files[FILE_SLOTS];
+static uint32_t file_next;
+
+static uint32_t get32(const uint8_t *buf)
+{
+    return (uint32_t)buf[0] | ((uint32_t)buf[1] << 8) |
+           ((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+static uint32_t hex_digit(uint8_t c)
+{
+    if ((c >= '0') && (c <= '9'))
+        return c - '0';
+    if ((c >= 'A') && (c <= 'F'))
+        return c - 'A' + 10U;
+    if ((c >= 'a') && (c <= 'f'))
+        return c - 'a' + 10U;
+    return 0xFFU;
+}
+
+/* Connects to the target on first use, a failed connect is not retried until close */
+static uint32_t connect(void)
+{
+    if (!stream.connected && (stream.error == NO_ERROR)) {
+        if (target_flash_init() == 0)
+            stream.connected = 1U;
+        else
+            stream.error = IMAGE_ERROR_CONNECT;
+    }
+    return stream.connected;
+}
+
+/* Programs the buffered page, the first visit of a page erases it */
+static void page_flush(void)
+{
+    uint32_t index;
+
+    if ((page_addr == NO_PAGE) || (stream.error != NO_ERROR))
+        return;
+
+    index = (page_addr - TARGET_FLASH_START) / TARGET_FLASH_PAGE_SIZE;
+    if ((page_erased[index / 8U] & (1U << (index % 8U))) == 0U) {
+        if (target_flash_erase(page_addr) != 0)
+            stream.error = IMAGE_ERROR_FLASH;
+        page_erased[index / 8U] |= (uint8_t)(1U << (index % 8U));
+    }
+    if ((stream.error == NO_ERROR) &&
+        (target_flash_program(page_addr, probe.page, PAGE_WORDS) != 0))
+        stream.error = IMAGE_ERROR_FLASH;
+    page_addr = NO_PAGE;
+}
+
+/* Collects image bytes into flash pages */
+static void image_write(uint32_t addr, const uint8_t *data, uint32_t length)
+{
+    uint32_t page;
+    uint32_t n;
+
+    while ((length != 0U) && (stream.error == NO_ERROR)) {
+        if ((addr < TARGET_FLASH_START) || ((addr - TARGET_FLASH_START) >= TARGET_FLASH_SIZE)) {
+            stream.error = IMAGE_ERROR_RANGE;
+            return;
+        }
+
+        page = addr & ~(TARGET_FLASH_PAGE_SIZE - 1U);
+        if (page != page_addr) {
+            page_flush();
+            page_addr = page;
+            memset(probe.page, 0xFF, sizeof(probe.page));
+        }
+
+        n = page + TARGET_FLASH_PAGE_SIZE - addr;
+        if (n > length)
+            n = length;
+        memcpy((uint8_t *)probe.page + (addr - page), data, n);
+        stream.image += n;
+        addr   += n;
+        data   += n;
+        length -= n;
+    }
+}
+
+/* Handles one byte of a HEX record, the checksum byte ends the record */
+static void hex_byte(uint32_t value)
+{
+    uint8_t data;
+
+    hex.sum += value;
+    switch (hex.pos) {
+        case 0U: hex.count = value; break;
+        case 1U: hex.offset = value << 8; break;
+        case 2U: hex.offset |= value; hex.ext = 0U; break;
+        case 3U: hex.type = value; break;
+        default:
+            if (hex.pos - 4U < hex.count) {
+                if (hex.type == 0x00U) {
+                    data = (uint8_t)value;
+                    image_write(hex.base + ((hex.offset + hex.pos - 4U) & 0xFFFFU), &data, 1U);
+                } else {
+                    hex.ext = (hex.ext << 8) | value;
+                }
+                break;
+            }
+
+            hex.active = 0U;
+            if ((hex.sum & 0xFFU) != 0U) {
+                stream.error = IMAGE_ERROR_HEX;
+            } else if (hex.type == 0x01U) {
+                hex.done = 1U;
+            } else if (hex.type == 0x02U) {
+                hex.base = hex.ext << 4;
+            } else if (hex.type == 0x04U) {
+                hex.base = hex.ext << 16;
+            }
+            break;
+    }
+    hex.pos++;
+}
+
+/* Records may span sectors, the decoder state carries over */
+static void hex_parse(const uint8_t *data, uint32_t length)
+{
+    uint32_t digit;
+    uint8_t c;
+
+    for (; length && !hex.done && (stream.error == NO_ERROR); length--) {
+        c = *data++;
+        if (!hex.active) {
+            if (c == ':') {
+                hex.active = 1U;
+                hex.nibble = 0U;
+                hex.pos = 0U;
+                hex.sum = 0U;
+            } else if ((c != '\r') && (c != '\n')) {
+                stream.error = IMAGE_ERROR_HEX;
+            }
+            continue;
+        }
+
+        digit = hex_digit(c);
+        if (digit > 0x0FU) {
+            stream.error = IMAGE_ERROR_HEX;
+            break;
+        }
+        hex.value = (hex.value << 4) | digit;
+        hex.nibble ^= 1U;
+        if (!hex.nibble)
+            hex_byte(hex.value & 0xFFU);
+    }
+}
+
+/*
+ * A binary image starts with a vector table: stack in SRAM, Thumb reset
+ * handler in flash. A HEX file starts with the header of a record.
+ */
+static uint32_t image_type(const uint8_t *buf)
+{
+    uint32_t sp = get32(&buf[0]);
+    uint32_t reset = get32(&buf[4]);
+    uint32_t n;
+
+    if (buf[0] == ':') {
+        for (n = 1U; n < 9U; n++) {
+            if (hex_digit(buf[n]) > 0x0FU)
+                return 0U;
+        }
+        return TYPE_HEX;
+    }
+    if (((sp & 0xFFF00000U) == 0x20000000U) && (reset & 1U) &&
+        (reset >= TARGET_FLASH_START) && ((reset - TARGET_FLASH_START) < TARGET_FLASH_SIZE))
+        return TYPE_BIN;
+    return 0U;
+}
+
+/* One past the last sector that can belong to the image file */
+static uint32_t file_end(void)
+{
+    if (stream.size != 0U)
+        return stream.start + ((stream.size + SECTOR_SIZE - 1U) / SECTOR_SIZE);
+    return stream.start + ((stream.type == TYPE_HEX) ? HEX_SECTORS_MAX : BIN_SECTORS_MAX);
+}
+
+static void check_complete(void)
+{
+    if ((stream.error != NO_ERROR) || hex.done ||
+        ((stream.size != 0U) && (stream.length >= stream.size)))
+        stream.state = IMAGE_STREAM_COMPLETE;
+}
+
+/* Decodes the next part of the file, the sector padding past the file size is dropped */
+static void feed(const uint8_t *data, uint32_t length)
+{
+    if ((stream.size != 0U) && (stream.length + length > stream.size))
+        length = stream.size - stream.length;
+
+    if (stream.error == NO_ERROR) {
+        if (stream.type == TYPE_HEX)
+            hex_parse(data, length);
+        else
+            image_write(TARGET_FLASH_START + stream.length, data, length);
+    }
+    stream.length += length;
+}
+
+/* Feeds parked sectors that are next in file order */
+static void drain(void)
+{
+    uint32_t chunk[STAGE_CHUNK_WORDS];
+    uint32_t slot;
+    uint32_t n;
+
+    while (stream.state == IMAGE_STREAM_OPEN) {
+        for (slot = 0U; (slot < STAGE_SLOTS) && (stage_sector[slot] != stream.next); slot++);
+        if (slot == STAGE_SLOTS)
+            break;
+
+        stage_sector[slot] = STAGE_EMPTY;
+        for (n = 0U; n < SECTOR_SIZE; n += sizeof(chunk)) {
+            if (Target_ReadMem(STAGE_ADDR(slot) + n, chunk, STAGE_CHUNK_WORDS) != DAP_TRANSFER_OK)
+                stream.error = IMAGE_ERROR_CONNECT;
+            feed((const uint8_t *)chunk, sizeof(chunk));
+        }
+        stream.next++;
+        check_complete();
+    }
+}
+
+/* Holds a sector in probe RAM until an image starts, the oldest one makes room */
+static void hold(uint32_t sector, const uint8_t *buf)
+{
+    uint32_t slot;
+
+    for (slot = 0U; (slot < HOLD_SLOTS) && (hold_sector[slot] != sector); slot++);
+    if (slot == HOLD_SLOTS) {
+        for (slot = 0U; (slot < HOLD_SLOTS) && (hold_sector[slot] != STAGE_EMPTY); slot++);
+    }
+    if (slot == HOLD_SLOTS) {
+        slot = hold_evict;
+        hold_evict = (hold_evict + 1U) % HOLD_SLOTS;
+    }
+    memcpy(probe.hold[slot], buf, SECTOR_SIZE);
+    hold_sector[slot] = sector;
+}
+
+/* Parks a sector of the open image in target SRAM, running out of slots fails the image */
+static void stage(uint32_t sector, const uint8_t *buf)
+{
+    uint32_t slot;
+
+    for (slot = 0U; (slot < STAGE_SLOTS) && (stage_sector[slot] != STAGE_EMPTY); slot++);
+    if (slot == STAGE_SLOTS) {
+        stream.error = IMAGE_ERROR_ORDER;
+        stream.state = IMAGE_STREAM_COMPLETE;
+        return;
+    }
+
+    if (!connect())
+        return;
+    stage_sector[slot] = STAGE_EMPTY;
+    if (Target_WriteMem(STAGE_ADDR(slot), (const uint32_t *)buf, SECTOR_SIZE / 4U) == DAP_TRANSFER_OK)
+        stage_sector[slot] = sector;
+}
+
+static void stream_open(uint32_t sector, uint32_t type)
+{
+    uint32_t n;
+
+    memset(&hex, 0, sizeof(hex));
+    memset(page_erased, 0, sizeof(page_erased));
+    page_addr = NO_PAGE;
+
+    stream.state  = IMAGE_STREAM_OPEN;
+    stream.type   = type;
+    stream.start  = sector;
+    stream.next   = sector;
+    stream.size   = 0U;
+    stream.length = 0U;
+    stream.image  = 0U;
+    for (n = 0U; n < FILE_SLOTS; n++) {
+        if ((files[n].sector == sector) && (files[n].size != 0U))
+            stream.size = files[n].size;
+    }
+    (void)connect();
+
+    /* Held sectors of the image move to target SRAM before the page buffer is used, others are dropped */
+    for (n = 0U; n < HOLD_SLOTS; n++) {
+        if ((hold_sector[n] > sector) && (hold_sector[n] < file_end()) && (stream.error == NO_ERROR))
+            stage(hold_sector[n], (const uint8_t *)probe.hold[n]);
+        hold_sector[n] = STAGE_EMPTY;
+    }
+}
+
+/**
+ * @brief Take one data area sector written by the host.
+ *
+ * A sector that starts a cluster and looks like a vector table or a HEX
+ * record opens the image and connects to the target. Sectors of the image
+ * are decoded in file order; earlier sectors are held in probe RAM and
+ * later out of order ones parked in target SRAM, in case they turn out to
+ * belong to the image. The buffer must be word aligned.
+ */
+void image_stream_sector(uint32_t sector, const uint8_t *buf, uint32_t cluster_start)
+{
+    uint32_t type;
+
+    switch (stream.state) {
+        case IMAGE_STREAM_IDLE:
+        case IMAGE_STREAM_STAGING:
+            type = cluster_start ? image_type(buf) : 0U;
+            if (type == 0U) {
+                hold(sector, buf);
+                stream.state = IMAGE_STREAM_STAGING;
+                return;
+            }
+            stream_open(sector, type);
+            break;
+
+        case IMAGE_STREAM_OPEN:
+            if ((sector < stream.next) || (sector >= file_end()))
+                return;
+            if (sector != stream.next) {
+                stage(sector, buf);
+                return;
+            }
+            break;
+
+        default:
+            return;
+    }
+
+    feed(buf, SECTOR_SIZE);
+    stream.next++;
+    check_complete();
+    drain();
+}
+
+/**
+ * @brief Take the size of a file from its directory entry.
+ *
+ * Hosts write the entry before, between or after the file data. A size for
+ * a file that has not started yet is remembered for when it does.
+ */
+void image_stream_size(uint32_t sector, uint32_t size)
+{
+    uint32_t end;
+
+    if ((stream.state < IMAGE_STREAM_OPEN) || (sector != stream.start)) {
+        files[file_next].sector = sector;
+        files[file_next].size   = size;
+        file_next = (file_next + 1U) % FILE_SLOTS;
+        return;
+    }
+
+    stream.size = size;
+    if (stream.length > size) {
+        /* Sector padding already buffered past the end of a binary image */
+        end = TARGET_FLASH_START + size;
+        if (stream.type == TYPE_BIN) {
+            if ((page_addr != NO_PAGE) && (end > page_addr) && (end < page_addr + TARGET_FLASH_PAGE_SIZE))
+                memset((uint8_t *)probe.page + (end - page_addr), 0xFF, page_addr + TARGET_FLASH_PAGE_SIZE - end);
+            stream.image -= stream.length - size;
+        }
+        stream.length = size;
+    }
+    if (stream.state == IMAGE_STREAM_OPEN) {
+        check_complete();
+        drain();
+    }
+}
+
+uint32_t image_stream_state(void)
+{
+    return stream.state;
+}
+
+uint32_t image_stream_close(uint32_t *length)
+{
+    uint32_t result = IMAGE_NONE;
+
+    if (stream.state >= IMAGE_STREAM_OPEN) {
+        page_flush();
+        if (stream.error != NO_ERROR)
+            result = stream.error;
+        else if ((stream.type == TYPE_HEX) ? !hex.done :
+                 ((stream.size != 0U) && (stream.length < stream.size)))
+            result = IMAGE_ERROR_INCOMPLETE;
+        else
+            result = IMAGE_OK;
+    }
+    if (stream.connected)
+        target_flash_uninit();
+    *length = stream.image;
+
+    memset(&stream, 0, sizeof(stream));
+    memset(files, 0, sizeof(files));
+    memset(stage_sector, 0, sizeof(stage_sector));
+    memset(hold_sector, 0, sizeof(hold_sector));
+    hold_evict = 0U;
+    return result;
+}
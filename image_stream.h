@@ -0,0 +1,40 @@
+#ifndef _IMAGE_STREAM_H_
+#define _IMAGE_STREAM_H_
+
+#include <stdint.h>
+
+/* Stream state */
+#define IMAGE_STREAM_IDLE       0U      /* Target released */
+#define IMAGE_STREAM_STAGING    1U      /* Holding sectors in probe RAM, no image start seen yet, target untouched */
+#define IMAGE_STREAM_OPEN       2U
+#define IMAGE_STREAM_COMPLETE   3U      /* Image decoded or failed, waiting for close */
+
+/* Sectors written before the image starts that are kept for it */
+#define IMAGE_STREAM_HOLD_SECTORS   2U
+
+/* Result of a closed stream */
+#define IMAGE_NONE              0U      /* No image was started */
+#define IMAGE_OK                1U
+#define IMAGE_ERROR_CONNECT     2U
+#define IMAGE_ERROR_FLASH       3U
+#define IMAGE_ERROR_RANGE       4U
+#define IMAGE_ERROR_HEX         5U
+#define IMAGE_ERROR_ORDER       6U
+#define IMAGE_ERROR_INCOMPLETE  7U
+
+/*
+ * Feeds one 512-byte data area sector, sector numbers order the file.
+ * cluster_start is non-zero for the first sector of a cluster, only those
+ * can start an image.
+ */
+extern void image_stream_sector(uint32_t sector, const uint8_t *buf, uint32_t cluster_start);
+
+/* Size of the file starting at sector, from its directory entry */
+extern void image_stream_size(uint32_t sector, uint32_t size);
+
+extern uint32_t image_stream_state(void);
+
+/* Programs what is buffered and releases the target, returns the result and the image bytes */
+extern uint32_t image_stream_close(uint32_t *length);
+
+#endif
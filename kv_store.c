@@ -0,0 +1,578 @@
+#include <string.h>
+#include "NUC100Series.h"
+#include "board_config.h"
+#include "kv_store.h"
+
+#define PAGE_SIZE           FMC_FLASH_PAGE_SIZE
+#define PAGE_COUNT          (DATA_FLASH_SIZE / FMC_FLASH_PAGE_SIZE)
+
+/*
+ * Page header: sequence number and the magic that marks the page as in use.
+ * The magic is programmed first, a page whose header write was cut short
+ * after it still shows that it belongs to the store.
+ */
+#define PAGE_MAGIC          0x3153564BU     /* "KVS1" */
+#define PAGE_HEADER_SIZE    8U
+
+/*
+ * Record: key, length[7:0] | crc[31:8], value padded to whole words.
+ * The length word is programmed first and the key last, so a record whose
+ * key is still erased has not been committed and is skipped. A record with
+ * key KV_KEY_ERASE names a page, by number, that is erased next.
+ */
+#define RECORD_HEADER_SIZE  8U
+#define RECORD_SIZE(len)    (RECORD_HEADER_SIZE + (((len) + 3U) & ~3U))
+#define LENGTH_MASK         0x000000FFU
+#define CRC_MASK            0xFFFFFF00U
+#define LENGTH_DELETED      0U
+
+#define ERASED              0xFFFFFFFFU
+
+/* CONFIG0 bit, 0 = data flash enabled at the CONFIG1 address */
+#define CONFIG0_DFEN        (1U << 0)
+
+/* page_seq of a page that holds data of something else, never written or erased */
+#define PAGE_FOREIGN        0xFFFFFFFFU
+
+/* Room kept at the end of the active page for the erase record claiming the next page */
+#define CLAIM_SIZE          RECORD_SIZE(4U)
+
+/* Erased pages kept in reserve for compaction */
+#define SPARE_PAGES         2U
+
+/* Hash slots of the RAM index, kept larger than KV_KEY_MAX */
+#define INDEX_SIZE          32U
+#define SLOT_FREE           0U
+#define SLOT_USED           1U
+#define SLOT_DELETED        2U
+
+typedef struct {
+    uint32_t key;
+    uint16_t offset;        /* Record offset in the data flash */
+    uint16_t state;
+} kv_slot_t;
+
+static kv_slot_t kv_index[INDEX_SIZE];
+static uint32_t  key_count;
+static uint32_t  page_seq[PAGE_COUNT];      /* 0 = page erased, PAGE_FOREIGN = not ours */
+static uint32_t  next_seq;
+static uint32_t  active_page;
+static uint32_t  write_offset;              /* Offset of the next record */
+static uint32_t  erase_pages;               /* Pages named by erase records, bit per page */
+
+/**
+ * @brief Address the data flash is read at, the host test maps it elsewhere.
+ *
+ * FMC calls always take the DATA_FLASH_BASE address.
+ */
+__WEAK uintptr_t kv_flash_base(void)
+{
+    return DATA_FLASH_BASE;
+}
+
+static uint32_t flash_word(uint32_t offset)
+{
+    return *(volatile const uint32_t *)(kv_flash_base() + offset);
+}
+
+static const uint8_t *flash_bytes(uint32_t offset)
+{
+    return (const uint8_t *)(kv_flash_base() + offset);
+}
+
+static int32_t flash_write(uint32_t offset, uint32_t word)
+{
+    return FMC_Write(DATA_FLASH_BASE + offset, word);
+}
+
+static uint32_t crc32_update(uint32_t crc, const uint8_t *data, uint32_t length)
+{
+    uint32_t n;
+
+    while (length--) {
+        crc ^= *data++;
+        for (n = 0U; n < 8U; n++)
+            crc = (crc & 1U) ? ((crc >> 1) ^ 0xEDB88320U) : (crc >> 1);
+    }
+    return crc;
+}
+
+/* Upper 24 bits of the CRC-32 over key, length and value */
+static uint32_t record_crc(uint32_t key, uint32_t length, const uint8_t *value)
+{
+    uint8_t header[5];
+
+    header[0] = (uint8_t)key;
+    header[1] = (uint8_t)(key >> 8);
+    header[2] = (uint8_t)(key >> 16);
+    header[3] = (uint8_t)(key >> 24);
+    header[4] = (uint8_t)length;
+
+    return ~crc32_update(crc32_update(0xFFFFFFFFU, header, 5U), value, length) & CRC_MASK;
+}
+
+/* RAM index, open addressing with linear probing */
+
+static kv_slot_t *index_find(uint32_t key)
+{
+    kv_slot_t *slot;
+    uint32_t i;
+    uint32_t n;
+
+    i = (key * 0x9E3779B1U) >> 27;
+    for (n = 0U; n < INDEX_SIZE; n++) {
+        slot = &kv_index[(i + n) % INDEX_SIZE];
+        if (slot->state == SLOT_FREE)
+            return NULL;
+        if ((slot->state == SLOT_USED) && (slot->key == key))
+            return slot;
+    }
+    return NULL;
+}
+
+static int32_t index_put(uint32_t key, uint32_t offset)
+{
+    kv_slot_t *slot;
+    uint32_t i;
+    uint32_t n;
+
+    slot = index_find(key);
+    if (slot != NULL) {
+        slot->offset = (uint16_t)offset;
+        return 0;
+    }
+    if (key_count >= KV_KEY_MAX)
+        return -1;
+
+    i = (key * 0x9E3779B1U) >> 27;
+    for (n = 0U; n < INDEX_SIZE; n++) {
+        slot = &kv_index[(i + n) % INDEX_SIZE];
+        if (slot->state != SLOT_USED) {
+            slot->key = key;
+            slot->offset = (uint16_t)offset;
+            slot->state = SLOT_USED;
+            key_count++;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static void index_remove(uint32_t key)
+{
+    kv_slot_t *slot;
+
+    slot = index_find(key);
+    if (slot != NULL) {
+        slot->state = SLOT_DELETED;
+        key_count--;
+    }
+}
+
+/* Pages */
+
+static uint32_t page_end(uint32_t page)
+{
+    return (page + 1U) * PAGE_SIZE;
+}
+
+static uint32_t page_is_erased(uint32_t page)
+{
+    uint32_t offset;
+
+    for (offset = page * PAGE_SIZE; offset < page_end(page); offset += 4U) {
+        if (flash_word(offset) != ERASED)
+            return 0U;
+    }
+    return 1U;
+}
+
+static uint32_t page_erased_count(void)
+{
+    uint32_t count;
+    uint32_t page;
+
+    count = 0U;
+    for (page = 0U; page < PAGE_COUNT; page++) {
+        if (page_seq[page] == 0U)
+            count++;
+    }
+    return count;
+}
+
+/* Whether size bytes fit into the active page, leaving the claim room */
+static uint32_t page_fits(uint32_t size)
+{
+    return ((write_offset + size + CLAIM_SIZE) <= page_end(active_page)) ? 1U : 0U;
+}
+
+/* Oldest page in use, PAGE_COUNT when there is none */
+static uint32_t page_oldest(uint32_t after_seq)
+{
+    uint32_t oldest;
+    uint32_t page;
+
+    oldest = PAGE_COUNT;
+    for (page = 0U; page < PAGE_COUNT; page++) {
+        if ((page_seq[page] > after_seq) && (page_seq[page] != PAGE_FOREIGN) &&
+            ((oldest == PAGE_COUNT) || (page_seq[page] < page_seq[oldest])))
+            oldest = page;
+    }
+    return oldest;
+}
+
+static int32_t record_append(uint32_t key, const uint8_t *value, uint32_t length);
+
+/*
+ * Starts a new active page on an erased page. An erase record in the old
+ * active page claims it first: should the header write be cut short before
+ * the magic is complete, the page is still known to belong to the store.
+ */
+static int32_t page_next(void)
+{
+    uint32_t page;
+    uint32_t offset;
+
+    for (page = 0U; page < PAGE_COUNT; page++) {
+        if (page_seq[page] == 0U)
+            break;
+    }
+    if (page == PAGE_COUNT)
+        return -1;
+
+    if (active_page != PAGE_COUNT)
+        (void)record_append(KV_KEY_ERASE, (const uint8_t *)&page, 4U);
+
+    offset = page * PAGE_SIZE;
+    if ((flash_write(offset + 4U, PAGE_MAGIC) != 0) ||
+        (flash_write(offset, next_seq) != 0))
+        return -1;
+
+    page_seq[page] = next_seq++;
+    active_page = page;
+    write_offset = offset + PAGE_HEADER_SIZE;
+    return 0;
+}
+
+/* Replays the committed records of a page into the index, returns the end of the log */
+static uint32_t page_scan(uint32_t page)
+{
+    uint32_t offset;
+    uint32_t info;
+    uint32_t length;
+    uint32_t key;
+
+    offset = (page * PAGE_SIZE) + PAGE_HEADER_SIZE;
+    while ((offset + RECORD_HEADER_SIZE) <= page_end(page)) {
+        info = flash_word(offset + 4U);
+        if (info == ERASED)
+            break;
+        length = info & LENGTH_MASK;
+        if ((length > KV_VALUE_MAX) || ((offset + RECORD_SIZE(length)) > page_end(page)))
+            return page_end(page);
+
+        key = flash_word(offset);
+        if ((key != ERASED) &&
+            (record_crc(key, length, flash_bytes(offset + RECORD_HEADER_SIZE)) == (info & CRC_MASK))) {
+            if (key == KV_KEY_ERASE) {
+                if (flash_word(offset + RECORD_HEADER_SIZE) < PAGE_COUNT)
+                    erase_pages |= 1U << flash_word(offset + RECORD_HEADER_SIZE);
+            } else if (length == LENGTH_DELETED) {
+                index_remove(key);
+            } else {
+                (void)index_put(key, offset);
+            }
+        }
+        offset += RECORD_SIZE(length);
+    }
+    return offset;
+}
+
+/* Records */
+
+static int32_t record_append(uint32_t key, const uint8_t *value, uint32_t length)
+{
+    uint32_t offset;
+    uint32_t word;
+    uint32_t n;
+    int32_t err;
+
+    offset = write_offset;
+    if ((offset + RECORD_SIZE(length)) > page_end(active_page))
+        return -1;
+    write_offset += RECORD_SIZE(length);
+
+    word = length | record_crc(key, length, value);
+    err = flash_write(offset + 4U, word);
+    for (n = 0U; (n < length) && (err == 0); n += 4U) {
+        word = ERASED;
+        memcpy(&word, &value[n], ((length - n) < 4U) ? (length - n) : 4U);
+        err = flash_write(offset + RECORD_HEADER_SIZE + n, word);
+    }
+    if (err == 0)
+        err = flash_write(offset, key);
+    if (err != 0)
+        return -1;
+
+    if (key == KV_KEY_ERASE)
+        return 0;
+    if (length == LENGTH_DELETED)
+        index_remove(key);
+    else
+        (void)index_put(key, offset);
+    return 0;
+}
+
+/*
+ * Logs an erase record for the page, then erases it. Should the erase be cut
+ * short, the record still proves the page belongs to the store.
+ */
+static int32_t page_erase(uint32_t page)
+{
+    if (active_page != PAGE_COUNT) {
+        if (!page_fits(RECORD_SIZE(4U)) && (page_next() != 0))
+            return -1;
+        if (record_append(KV_KEY_ERASE, (const uint8_t *)&page, 4U) != 0)
+            return -1;
+    }
+    if (FMC_Erase(DATA_FLASH_BASE + (page * PAGE_SIZE)) != 0)
+        return -1;
+    page_seq[page] = 0U;
+    return 0;
+}
+
+/*
+ * Copies the live records of a page to the active page and erases it.
+ * Records that do not fit spill over to a new page.
+ */
+static int32_t page_compact(uint32_t page)
+{
+    uint8_t value[KV_VALUE_MAX];
+    uint32_t length;
+    uint32_t n;
+
+    for (n = 0U; n < INDEX_SIZE; n++) {
+        if ((kv_index[n].state != SLOT_USED) ||
+            ((kv_index[n].offset / PAGE_SIZE) != page))
+            continue;
+        length = flash_word(kv_index[n].offset + 4U) & LENGTH_MASK;
+        if (!page_fits(RECORD_SIZE(length)) && (page_next() != 0))
+            return -1;
+        memcpy(value, flash_bytes(kv_index[n].offset + RECORD_HEADER_SIZE), length);
+        if (record_append(kv_index[n].key, value, length) != 0)
+            return -1;
+    }
+
+    return page_erase(page);
+}
+
+/*
+ * Compacts the oldest pages until SPARE_PAGES pages are erased. The spare
+ * pages leave room for compaction to complete after a power loss, even
+ * when torn records have used up part of the active page.
+ */
+static int32_t page_collect(void)
+{
+    uint32_t page;
+    uint32_t n;
+
+    for (n = 0U; (n < PAGE_COUNT) && (page_erased_count() < SPARE_PAGES); n++) {
+        page = page_oldest(0U);
+        if (page == active_page)
+            break;
+        if (page_compact(page) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+/* Opens new pages until size bytes fit into the active page */
+static int32_t make_room(uint32_t size)
+{
+    while (!page_fits(size)) {
+        if ((page_next() != 0) || (page_collect() != 0))
+            return -1;
+    }
+    return 0;
+}
+
+/* Page of the store that holds nothing but its header */
+static uint32_t page_is_opened(uint32_t page)
+{
+    uint32_t offset;
+
+    if (flash_word((page * PAGE_SIZE) + 4U) != PAGE_MAGIC)
+        return 0U;
+    for (offset = (page * PAGE_SIZE) + PAGE_HEADER_SIZE; offset < page_end(page); offset += 4U) {
+        if (flash_word(offset) != ERASED)
+            return 0U;
+    }
+    return 1U;
+}
+
+/**
+ * @brief Build the RAM index from the data flash log.
+ *
+ * The store stays disabled unless CONFIG0 enables the data flash at
+ * DATA_FLASH_BASE, otherwise the pages would be part of the APROM image.
+ * The pages in use are replayed oldest first so that the latest record of
+ * each key wins. Of the other pages only those the store can prove its own
+ * are erased: pages named by an erase record and pages with the magic whose
+ * sequence number write was cut short. A cut short sequence number reads
+ * back with extra bits set, so a page holding nothing but its header only
+ * counts when its sequence number follows that of the newest page. Any
+ * other data is left alone and its page is not used.
+ */
+void kv_init(void)
+{
+    uint32_t config;
+    uint32_t torn;
+    uint32_t page;
+    uint32_t seq;
+
+    memset(kv_index, 0, sizeof(kv_index));
+    key_count = 0U;
+    next_seq = 1U;
+    active_page = PAGE_COUNT;
+
+    FMC_Open();
+
+    (void)FMC_ReadConfig(&config, 1U);
+    if (((config & CONFIG0_DFEN) != 0U) || (FMC_ReadDataFlashBaseAddr() != DATA_FLASH_BASE)) {
+        FMC_Close();
+        return;
+    }
+
+    for (page = 0U; page < PAGE_COUNT; page++) {
+        seq = flash_word(page * PAGE_SIZE);
+        if ((flash_word((page * PAGE_SIZE) + 4U) == PAGE_MAGIC) && (seq != ERASED) && (seq != 0U) &&
+            !page_is_opened(page)) {
+            page_seq[page] = seq;
+            if (seq >= next_seq)
+                next_seq = seq + 1U;
+        } else if (page_is_erased(page)) {
+            page_seq[page] = 0U;
+        } else {
+            page_seq[page] = PAGE_FOREIGN;
+        }
+    }
+
+    /* Page opened last, before any record went into it */
+    torn = 0U;
+    for (page = 0U; page < PAGE_COUNT; page++) {
+        if ((page_seq[page] == PAGE_FOREIGN) && page_is_opened(page)) {
+            if (flash_word(page * PAGE_SIZE) == next_seq)
+                page_seq[page] = next_seq++;
+            else
+                torn |= 1U << page;
+        }
+    }
+
+    erase_pages = 0U;
+    seq = 0U;
+    for (;;) {
+        page = page_oldest(seq);
+        if (page == PAGE_COUNT)
+            break;
+        active_page = page;
+        write_offset = page_scan(page);
+        seq = page_seq[page];
+    }
+
+    /* Pages torn by a power loss during an erase or a page header write */
+    for (page = 0U; page < PAGE_COUNT; page++) {
+        if ((page_seq[page] == PAGE_FOREIGN) &&
+            (((erase_pages | torn) & (1U << page)) != 0U))
+            (void)page_erase(page);
+    }
+
+    if (active_page == PAGE_COUNT)
+        (void)page_next();
+
+    /* Finishes a compaction interrupted by a power loss */
+    if (active_page != PAGE_COUNT)
+        (void)page_collect();
+
+    FMC_Close();
+}
+
+/**
+ * @brief Read the value of a key.
+ *
+ * The RAM index gives the record offset, the value is copied straight
+ * from the memory mapped data flash.
+ *
+ * @return Length of the stored value (may be larger than size), -1 when
+ *         the key does not exist.
+ */
+int32_t kv_get(uint32_t key, void *value, uint32_t size)
+{
+    kv_slot_t *slot;
+    uint32_t length;
+
+    slot = index_find(key);
+    if (slot == NULL)
+        return -1;
+
+    length = flash_word(slot->offset + 4U) & LENGTH_MASK;
+    memcpy(value, flash_bytes(slot->offset + RECORD_HEADER_SIZE), (length < size) ? length : size);
+    return (int32_t)length;
+}
+
+/**
+ * @brief Store a value for a key.
+ *
+ * The record is appended to the log, the previous value stays in flash
+ * until its page is compacted. Writing an unchanged value does not touch
+ * the flash.
+ *
+ * @return 0 on success, -1 on invalid arguments, full index, flash error or
+ *         when the data flash is not enabled.
+ */
+int32_t kv_set(uint32_t key, const void *value, uint32_t length)
+{
+    kv_slot_t *slot;
+    int32_t err;
+
+    if ((key == KV_KEY_INVALID) || (key == KV_KEY_ERASE) ||
+        (length == 0U) || (length > KV_VALUE_MAX) || (active_page == PAGE_COUNT))
+        return -1;
+
+    slot = index_find(key);
+    if (slot != NULL) {
+        if (((flash_word(slot->offset + 4U) & LENGTH_MASK) == length) &&
+            (memcmp(flash_bytes(slot->offset + RECORD_HEADER_SIZE), value, length) == 0))
+            return 0;
+    } else if (key_count >= KV_KEY_MAX) {
+        return -1;
+    }
+
+    FMC_Open();
+    err = make_room(RECORD_SIZE(length));
+    if (err == 0)
+        err = record_append(key, (const uint8_t *)value, length);
+    FMC_Close();
+
+    return err;
+}
+
+/**
+ * @brief Remove a key by appending a deletion record.
+ *
+ * @return 0 on success (also when the key does not exist), -1 on flash error.
+ */
+int32_t kv_delete(uint32_t key)
+{
+    int32_t err;
+
+    if (index_find(key) == NULL)
+        return 0;
+
+    FMC_Open();
+    err = make_room(RECORD_SIZE(LENGTH_DELETED));
+    if (err == 0)
+        err = record_append(key, NULL, LENGTH_DELETED);
+    FMC_Close();
+
+    return err;
+}
@@ -0,0 +1,29 @@
+#ifndef _KV_STORE_H_
+#define _KV_STORE_H_
+
+#include <stdint.h>
+
+/* Largest value in bytes and number of keys kept in the RAM index */
+#define KV_VALUE_MAX        48U
+#define KV_KEY_MAX          24U
+
+/* Keys reserved for erased flash and for the store itself, must not be used */
+#define KV_KEY_INVALID      0xFFFFFFFFU
+#define KV_KEY_ERASE        0xFFFFFFFEU
+
+/* Address the data flash is read at, DATA_FLASH_BASE unless overridden */
+extern uintptr_t kv_flash_base(void);
+
+/* Scans the data flash log and builds the RAM index, call once at boot */
+extern void kv_init(void);
+
+/* Copies up to size bytes of the value, returns the value length or -1 */
+extern int32_t kv_get(uint32_t key, void *value, uint32_t size);
+
+/* Appends a new value for the key, returns 0 or -1 on error */
+extern int32_t kv_set(uint32_t key, const void *value, uint32_t length);
+
+/* Removes the key, returns 0 or -1 on error */
+extern int32_t kv_delete(uint32_t key);
+
+#endif
@@ -0,0 +1,331 @@
+#include <string.h>
+#include "NUC100Series.h"
+#include "IO_Config.h"
+#include "ldrom.h"
+
+#define PLL_CLOCK           48000000U
+
+#define PAGE_WORDS          (FMC_FLASH_PAGE_SIZE / 4U)
+
+#define STATE_IDLE          0U      /* OUT packets are commands */
+#define STATE_DATA          1U      /* OUT packets are image data */
+#define STATE_PROGRAM       2U      /* All data received, last pages still programming */
+
+/*
+ * Two page buffers: USB fills one while the main loop programs the other.
+ * page_len is the number of image bytes in a filled buffer, 0 when free.
+ */
+static uint32_t page_buf[2][PAGE_WORDS];
+static volatile uint32_t page_len[2];
+static uint32_t fill_buf;
+static uint32_t fill_len;
+static uint32_t prog_buf;
+
+static uint8_t command[LDROM_PACKET_SIZE];
+static volatile uint32_t command_len;
+static volatile uint32_t out_held;          /* OUT endpoint NAKs until released */
+
+static volatile uint32_t state;
+static uint32_t image_size;
+static uint32_t image_crc;
+static uint32_t received;
+static uint32_t programmed;
+static uint32_t crc;
+static uint32_t error;
+
+static void sys_init(void)
+{
+    /* HCLK from the 12 MHz crystal through the PLL, USB clock is PLL / 1 */
+    CLK->PWRCON |= CLK_PWRCON_XTL12M_EN_Msk;
+    while (!(CLK->CLKSTATUS & CLK_CLKSTATUS_XTL12M_STB_Msk));
+
+    CLK->PLLCON = CLK_PLLCON_48MHz_HXT;
+    while (!(CLK->CLKSTATUS & CLK_CLKSTATUS_PLL_STB_Msk));
+    CLK->CLKSEL0 = (CLK->CLKSEL0 & ~CLK_CLKSEL0_HCLK_S_Msk) | CLK_CLKSEL0_HCLK_S_PLL;
+
+    PllClock        = PLL_CLOCK;
+    SystemCoreClock = PLL_CLOCK;
+    CyclesPerUs     = PLL_CLOCK / 1000000U;
+
+    CLK->APBCLK |= CLK_APBCLK_USBD_EN_Msk;
+    CLK->CLKDIV = (CLK->CLKDIV & ~CLK_CLKDIV_USB_N_Msk) | CLK_CLKDIV_USB(1);
+}
+
+static uint32_t crc32_word(uint32_t value, uint32_t word, uint32_t bytes)
+{
+    uint32_t n;
+
+    while (bytes--) {
+        value ^= word & 0xFFU;
+        word >>= 8;
+        for (n = 0U; n < 8U; n++)
+            value = (value & 1U) ? ((value >> 1) ^ 0xEDB88320U) : (value >> 1);
+    }
+    return value;
+}
+
+/* An image is valid once its marker is complete and the vector table looks sane */
+static uint32_t image_valid(void)
+{
+    uint32_t size;
+    uint32_t sp;
+    uint32_t reset;
+
+    if (FMC_Read(LDROM_MARKER_ADDR + 8U) != LDROM_MARKER_MAGIC)
+        return 0U;
+
+    size  = FMC_Read(LDROM_MARKER_ADDR);
+    sp    = FMC_Read(FMC_APROM_BASE);
+    reset = FMC_Read(FMC_APROM_BASE + 4U);
+
+    return ((size != 0U) && (size <= LDROM_IMAGE_MAX) &&
+            ((sp & 0xFFFF0000U) == 0x20000000U) && (reset < size)) ? 1U : 0U;
+}
+
+/* BS selects APROM, the CPU reset restarts from there */
+static void boot_aprom(void)
+{
+    FMC_SET_APROM_BOOT();
+    SYS_ResetCPU();
+    while (1);
+}
+
+/**
+ * @brief Accept a bulk OUT packet, runs in the USB interrupt.
+ *
+ * Image data is copied into the fill buffer. When the buffer holds a page
+ * it is handed to the main loop and filling continues in the other buffer,
+ * so the next page arrives while the previous one is programmed. The
+ * endpoint NAKs while both buffers are in use or a command is pending.
+ *
+ * @return 1 to accept the next packet, 0 to hold the endpoint.
+ */
+uint32_t ldrom_receive(const uint8_t *data, uint32_t length)
+{
+    uint32_t n;
+
+    if (state != STATE_DATA) {
+        memcpy(command, data, length);
+        command_len = length;
+        out_held = 1U;
+        return 0U;
+    }
+
+    n = image_size - received;
+    if (length < n)
+        n = length;
+    memcpy((uint8_t *)page_buf[fill_buf] + fill_len, data, n);
+    fill_len += n;
+    received += n;
+
+    if ((fill_len == FMC_FLASH_PAGE_SIZE) || (received == image_size)) {
+        page_len[fill_buf] = fill_len;
+        fill_buf ^= 1U;
+        fill_len = 0U;
+
+        if (received == image_size)
+            state = STATE_PROGRAM;
+        if ((state != STATE_DATA) || (page_len[fill_buf] != 0U)) {
+            out_held = 1U;
+            return 0U;
+        }
+    }
+    return 1U;
+}
+
+static void release_out(void)
+{
+    __disable_irq();
+    if (out_held && (command_len == 0U) && (state != STATE_PROGRAM) &&
+        (page_len[fill_buf] == 0U)) {
+        out_held = 0U;
+        usb_out_arm();
+    }
+    __enable_irq();
+}
+
+static void send(const uint8_t *data, uint32_t length)
+{
+    while (usb_in_busy());
+    usb_send(data, length);
+}
+
+static void put_word(uint8_t *buf, uint32_t value)
+{
+    buf[0] = (uint8_t)value;
+    buf[1] = (uint8_t)(value >> 8);
+    buf[2] = (uint8_t)(value >> 16);
+    buf[3] = (uint8_t)(value >> 24);
+}
+
+static uint32_t get_word(const uint8_t *buf)
+{
+    return (uint32_t)buf[0] | ((uint32_t)buf[1] << 8) |
+           ((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+/*
+ * Programs one page buffer at the next APROM page. The page is read back
+ * through ISP, compared and added to the image CRC, so the CRC covers what
+ * actually is in flash.
+ */
+static void program_page(uint32_t buf)
+{
+    uint32_t addr = FMC_APROM_BASE + programmed;
+    uint32_t length = page_len[buf];
+    uint32_t word;
+    uint32_t n;
+
+    memset((uint8_t *)page_buf[buf] + length, 0xFF, FMC_FLASH_PAGE_SIZE - length);
+
+    if (FMC_Erase(addr) != 0)
+        error = LDROM_ERROR_FLASH;
+    for (n = 0U; (n < PAGE_WORDS) && (error == LDROM_OK); n++) {
+        if (FMC_Write(addr + (n * 4U), page_buf[buf][n]) != 0)
+            error = LDROM_ERROR_FLASH;
+    }
+    for (n = 0U; (n * 4U < length) && (error == LDROM_OK); n++) {
+        word = FMC_Read(addr + (n * 4U));
+        if (word != page_buf[buf][n])
+            error = LDROM_ERROR_FLASH;
+        crc = crc32_word(crc, word, ((length - (n * 4U)) < 4U) ? (length - (n * 4U)) : 4U);
+    }
+
+    programmed += length;
+    page_len[buf] = 0U;
+}
+
+/* Completes the update: programs the marker when the CRC matches and reports */
+static void finish(void)
+{
+    uint8_t response[10];
+
+    crc = ~crc;
+    if ((error == LDROM_OK) && (crc != image_crc))
+        error = LDROM_ERROR_CRC;
+    if ((error == LDROM_OK) &&
+        ((FMC_Write(LDROM_MARKER_ADDR, image_size) != 0) ||
+         (FMC_Write(LDROM_MARKER_ADDR + 4U, crc) != 0) ||
+         (FMC_Write(LDROM_MARKER_ADDR + 8U, LDROM_MARKER_MAGIC) != 0)))
+        error = LDROM_ERROR_FLASH;
+
+    response[0] = LDROM_CMD_START;
+    response[1] = (uint8_t)error;
+    put_word(&response[2], programmed);
+    put_word(&response[6], crc);
+    send(response, sizeof(response));
+
+    state = STATE_IDLE;
+}
+
+static void process_command(void)
+{
+    uint8_t response[11];
+    uint32_t length = 2U;
+
+    response[0] = command[0];
+    response[1] = LDROM_OK;
+
+    switch (command[0]) {
+        case LDROM_CMD_INFO:
+            response[2] = (uint8_t)LDROM_VERSION;
+            response[3] = (uint8_t)(LDROM_VERSION >> 8);
+            response[4] = (uint8_t)FMC_FLASH_PAGE_SIZE;
+            response[5] = (uint8_t)(FMC_FLASH_PAGE_SIZE >> 8);
+            put_word(&response[6], LDROM_IMAGE_MAX);
+            response[10] = (uint8_t)image_valid();
+            length = 11U;
+            break;
+
+        case LDROM_CMD_START:
+            image_size = get_word(&command[1]);
+            image_crc  = get_word(&command[5]);
+            if ((command_len < 9U) || (image_size == 0U) || (image_size > LDROM_IMAGE_MAX)) {
+                response[1] = LDROM_ERROR_SIZE;
+                break;
+            }
+            if (FMC_Erase(LDROM_MARKER_ADDR) != 0) {
+                response[1] = LDROM_ERROR_FLASH;
+                break;
+            }
+            received = 0U;
+            programmed = 0U;
+            fill_buf = 0U;
+            fill_len = 0U;
+            prog_buf = 0U;
+            crc = 0xFFFFFFFFU;
+            error = LDROM_OK;
+            state = STATE_DATA;
+            break;
+
+        case LDROM_CMD_STATUS:
+            response[2] = (uint8_t)state;
+            put_word(&response[3], received);
+            put_word(&response[7], programmed);
+            length = 11U;
+            break;
+
+        case LDROM_CMD_BOOT:
+            if (!image_valid()) {
+                response[1] = LDROM_ERROR_IMAGE;
+                break;
+            }
+            send(response, length);
+            while (usb_in_busy());
+            usb_detach();
+            CLK_SysTickDelay(100000);
+            boot_aprom();
+            break;
+
+        default:
+            response[1] = LDROM_ERROR;
+            break;
+    }
+
+    send(response, length);
+}
+
+/**
+ * @brief LDROM entry, CONFIG0 selects boot from LDROM.
+ *
+ * Starts the APROM image right away unless the DAP button (PB14, active
+ * low) is held or no valid image is present. Otherwise runs the update
+ * loop: commands and filled page buffers are handled here, USB reception
+ * runs in the interrupt.
+ */
+int main(void)
+{
+    SYS_UnlockReg();
+    FMC_ENABLE_ISP();
+
+    if ((OFF_BTN_IO != 0U) && image_valid())
+        boot_aprom();
+
+    sys_init();
+    usb_init();
+
+    while (1) {
+        if (command_len != 0U) {
+            process_command();
+            command_len = 0U;
+            release_out();
+        }
+
+        if (page_len[prog_buf] != 0U) {
+            program_page(prog_buf);
+            prog_buf ^= 1U;
+            if ((state == STATE_PROGRAM) && (programmed == received))
+                finish();
+            release_out();
+        }
+    }
+}
+
+/* A fault restarts the bootloader, BS still selects LDROM */
+uint32_t ProcessHardFault(uint32_t lr, uint32_t msp, uint32_t psp)
+{
+    (void)msp;
+    (void)psp;
+    SYS_ResetCPU();
+    return lr;
+}
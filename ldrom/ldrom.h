@@ -0,0 +1,63 @@
+#ifndef _LDROM_H_
+#define _LDROM_H_
+
+#include <stdint.h>
+#include "NUC100Series.h"
+#include "board_config.h"
+
+/*
+ * LDROM firmware update protocol.
+ *
+ * The bootloader enumerates as a vendor specific interface with one bulk
+ * OUT and one bulk IN endpoint of 64 bytes. Every command is a single OUT
+ * packet answered by a single IN packet starting with the command byte and
+ * a status byte. After LDROM_CMD_START the next image size bytes on the OUT
+ * endpoint are raw image data, programmed to APROM while they arrive; the
+ * result of the update is reported with an LDROM_CMD_START packet once the
+ * last page has been programmed and verified.
+ *
+ * MS OS 2.0 descriptors bind WinUSB on Windows, so no driver package is
+ * needed. utils/ldrom_update.py is the host side.
+ */
+
+#define LDROM_USB_VID           0x0416U
+#define LDROM_USB_PID           0xDF11U
+#define LDROM_PACKET_SIZE       64U
+
+#define LDROM_VERSION           0x0100U
+
+/* Commands */
+#define LDROM_CMD_INFO          0x01U   /* -> version(2), page size(2), image max(4), image valid(1) */
+#define LDROM_CMD_START         0x02U   /* size(4), crc32(4) -> ; then image data, then size(4), crc32(4) */
+#define LDROM_CMD_STATUS        0x03U   /* -> state(1), received(4), programmed(4) */
+#define LDROM_CMD_BOOT          0x04U   /* -> ; starts the APROM image when it is valid */
+
+/* Status */
+#define LDROM_OK                0x00U
+#define LDROM_ERROR             0xFFU
+#define LDROM_ERROR_SIZE        0x01U
+#define LDROM_ERROR_FLASH       0x02U
+#define LDROM_ERROR_CRC         0x03U
+#define LDROM_ERROR_IMAGE       0x04U
+
+/*
+ * The APROM page below the data flash keeps the image marker: size, CRC-32
+ * and magic. It is erased when an update starts and the magic is programmed
+ * only after the whole image has been verified, so an interrupted update
+ * stays in LDROM. Images end below the marker, gcc_arm.ld uses the same limit.
+ */
+#define LDROM_IMAGE_MAX         (DATA_FLASH_BASE - FMC_FLASH_PAGE_SIZE)
+#define LDROM_MARKER_ADDR       LDROM_IMAGE_MAX
+#define LDROM_MARKER_MAGIC      0x4D52444CU     /* "LDRM" */
+
+/* USB layer, ldrom_usb.c */
+extern void     usb_init(void);
+extern void     usb_out_arm(void);
+extern uint32_t usb_in_busy(void);
+extern void     usb_send(const uint8_t *data, uint32_t length);
+extern void     usb_detach(void);
+
+/* Called from the USB interrupt with each bulk OUT packet, returns 0 to NAK further packets */
+extern uint32_t ldrom_receive(const uint8_t *data, uint32_t length);
+
+#endif
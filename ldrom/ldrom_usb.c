@@ -0,0 +1,255 @@
+#include "NUC100Series.h"
+#include "ldrom.h"
+
+/* EP0/EP1 are the control IN/OUT pair, EP2 is bulk IN 0x81, EP3 bulk OUT 0x02 */
+#define EP_BULK_IN_NUM      1U
+#define EP_BULK_OUT_NUM     2U
+
+#define SETUP_BUF_BASE      0U
+#define SETUP_BUF_LEN       8U
+#define EP0_BUF_BASE        (SETUP_BUF_BASE + SETUP_BUF_LEN)
+#define EP1_BUF_BASE        (EP0_BUF_BASE + LDROM_PACKET_SIZE)
+#define EP2_BUF_BASE        (EP1_BUF_BASE + LDROM_PACKET_SIZE)
+#define EP3_BUF_BASE        (EP2_BUF_BASE + LDROM_PACKET_SIZE)
+
+#define CONFIG_DESC_LEN     (LEN_CONFIG + LEN_INTERFACE + (2U * LEN_ENDPOINT))
+
+/*
+ * Windows binds WinUSB through the MS OS 2.0 descriptors, as for the
+ * application: the BOS platform capability names the vendor request that
+ * returns the descriptor set, which holds the WINUSB compatible ID.
+ */
+#define DESC_BOS            0x0FU
+#define BOS_DESC_LEN        (5U + 28U)
+#define MS_OS_20_DESC_LEN   (10U + 20U)
+#define MS_OS_20_VENDOR     0x01U
+#define MS_OS_20_INDEX      0x07U
+
+/* usbd.c keeps the setup packet of the request being processed */
+extern uint8_t g_usbd_SetupPacket[8];
+
+static const uint8_t device_desc[LEN_DEVICE] = {
+    LEN_DEVICE, DESC_DEVICE,
+    0x10, 0x02,                                     /* bcdUSB 2.10 for BOS */
+    0x00, 0x00, 0x00,                               /* Class per interface */
+    LDROM_PACKET_SIZE,
+    LDROM_USB_VID & 0xFFU, LDROM_USB_VID >> 8,
+    LDROM_USB_PID & 0xFFU, LDROM_USB_PID >> 8,
+    LDROM_VERSION & 0xFFU, LDROM_VERSION >> 8,
+    0x01, 0x02, 0x00,                               /* Manufacturer, product, no serial */
+    0x01
+};
+
+static const uint8_t config_desc[CONFIG_DESC_LEN] = {
+    LEN_CONFIG, DESC_CONFIG,
+    CONFIG_DESC_LEN & 0xFFU, CONFIG_DESC_LEN >> 8,
+    0x01, 0x01, 0x00,
+    0x80,                                           /* Bus powered */
+    50,                                             /* 100 mA */
+
+    LEN_INTERFACE, DESC_INTERFACE,
+    0x00, 0x00, 0x02,
+    0xFF, 0x00, 0x00,                               /* Vendor specific */
+    0x00,
+
+    LEN_ENDPOINT, DESC_ENDPOINT,
+    EP_INPUT | EP_BULK_IN_NUM, EP_BULK,
+    LDROM_PACKET_SIZE, 0x00, 0x00,
+
+    LEN_ENDPOINT, DESC_ENDPOINT,
+    EP_OUTPUT | EP_BULK_OUT_NUM, EP_BULK,
+    LDROM_PACKET_SIZE, 0x00, 0x00
+};
+
+static const uint8_t bos_desc[BOS_DESC_LEN] = {
+    5, DESC_BOS, BOS_DESC_LEN, 0x00, 1,
+
+    28, 0x10, 0x05, 0x00,                           /* Platform capability */
+    0xDF, 0x60, 0xDD, 0xD8, 0x89, 0x45, 0xC7, 0x4C, /* MS OS 2.0 UUID */
+    0x9C, 0xD2, 0x65, 0x9D, 0x9E, 0x64, 0x8A, 0x9F,
+    0x00, 0x00, 0x03, 0x06,                         /* Windows 8.1 */
+    MS_OS_20_DESC_LEN, 0x00, MS_OS_20_VENDOR, 0x00
+};
+
+static const uint8_t ms_os_20_desc[MS_OS_20_DESC_LEN] = {
+    0x0A, 0x00, 0x00, 0x00,                         /* Set header */
+    0x00, 0x00, 0x03, 0x06,
+    MS_OS_20_DESC_LEN, 0x00,
+
+    0x14, 0x00, 0x03, 0x00,                         /* Compatible ID */
+    'W', 'I', 'N', 'U', 'S', 'B', 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+static const uint8_t lang_desc[4] = { 4, DESC_STRING, 0x09, 0x04 };
+
+static const uint8_t vendor_desc[14] = {
+    14, DESC_STRING,
+    'U', 0, 'W', 0, 'i', 0, 'n', 0, 'g', 0, 's', 0
+};
+
+static const uint8_t product_desc[34] = {
+    34, DESC_STRING,
+    'C', 0, 'M', 0, 'S', 0, 'I', 0, 'S', 0, '-', 0, 'D', 0, 'A', 0, 'P', 0, ' ', 0,
+    'U', 0, 'p', 0, 'd', 0, 'a', 0, 't', 0, 'e', 0
+};
+
+static const uint8_t *string_desc[] = { lang_desc, vendor_desc, product_desc, NULL };
+
+static const S_USBD_INFO_T usb_info = {
+    device_desc, config_desc, string_desc, NULL
+};
+
+static volatile uint8_t in_busy;
+
+static void usb_set_config(void)
+{
+    in_busy = 0U;
+    USBD_SET_DATA0(EP2);
+    USBD_SET_DATA0(EP3);
+    usb_out_arm();
+}
+
+/* Answers a control IN request with a descriptor, cut to wLength */
+static void usb_ctrl_in(const uint8_t *desc, uint32_t length)
+{
+    uint32_t wlength = g_usbd_SetupPacket[6] | ((uint32_t)g_usbd_SetupPacket[7] << 8);
+
+    USBD_PrepareCtrlIn((uint8_t *)desc, (length < wlength) ? length : wlength);
+    USBD_PrepareCtrlOut(0, 0);
+}
+
+/* The MS OS 2.0 descriptor set request, other vendor requests stall */
+static void usb_vendor_request(void)
+{
+    if ((g_usbd_SetupPacket[0] == 0xC0U) && (g_usbd_SetupPacket[1] == MS_OS_20_VENDOR) &&
+        (g_usbd_SetupPacket[4] == MS_OS_20_INDEX) && (g_usbd_SetupPacket[5] == 0U)) {
+        usb_ctrl_in(ms_os_20_desc, sizeof(ms_os_20_desc));
+    } else {
+        USBD_SET_EP_STALL(EP0);
+        USBD_SET_EP_STALL(EP1);
+    }
+}
+
+/* Setup packet, the BSP stalls GET_DESCRIPTOR of the BOS descriptor */
+static void usb_setup(void)
+{
+    USBD_MemCopy(g_usbd_SetupPacket, (uint8_t *)USBD_BUF_BASE, 8);
+    if ((g_usbd_SetupPacket[0] == 0x80U) && (g_usbd_SetupPacket[1] == GET_DESCRIPTOR) &&
+        (g_usbd_SetupPacket[3] == DESC_BOS)) {
+        usb_ctrl_in(bos_desc, sizeof(bos_desc));
+    } else {
+        USBD_ProcessSetupPacket();
+    }
+}
+
+/**
+ * @brief Start the USB device with the bulk endpoint pair.
+ *
+ * Uses the BSP USBD driver for the control endpoint. The CPU must run from
+ * the 48 MHz PLL with the USB clock enabled.
+ */
+void usb_init(void)
+{
+    USBD_Open(&usb_info, NULL, NULL);
+    USBD_SetConfigCallback(usb_set_config);
+    USBD_SetVendorRequest(usb_vendor_request);
+
+    USBD->STBUFSEG = SETUP_BUF_BASE;
+    USBD_CONFIG_EP(EP0, USBD_CFG_CSTALL | USBD_CFG_EPMODE_IN | 0U);
+    USBD_SET_EP_BUF_ADDR(EP0, EP0_BUF_BASE);
+    USBD_CONFIG_EP(EP1, USBD_CFG_CSTALL | USBD_CFG_EPMODE_OUT | 0U);
+    USBD_SET_EP_BUF_ADDR(EP1, EP1_BUF_BASE);
+    USBD_CONFIG_EP(EP2, USBD_CFG_EPMODE_IN | EP_BULK_IN_NUM);
+    USBD_SET_EP_BUF_ADDR(EP2, EP2_BUF_BASE);
+    USBD_CONFIG_EP(EP3, USBD_CFG_EPMODE_OUT | EP_BULK_OUT_NUM);
+    USBD_SET_EP_BUF_ADDR(EP3, EP3_BUF_BASE);
+
+    USBD_Start();
+    NVIC_EnableIRQ(USBD_IRQn);
+}
+
+/* Accepts the next bulk OUT packet */
+void usb_out_arm(void)
+{
+    USBD_SET_PAYLOAD_LEN(EP3, LDROM_PACKET_SIZE);
+}
+
+uint32_t usb_in_busy(void)
+{
+    return in_busy;
+}
+
+/* Queues one bulk IN packet, the previous one must have been sent */
+void usb_send(const uint8_t *data, uint32_t length)
+{
+    in_busy = 1U;
+    USBD_MemCopy((uint8_t *)(USBD_BUF_BASE + EP2_BUF_BASE), (uint8_t *)data, (int32_t)length);
+    USBD_SET_PAYLOAD_LEN(EP2, length);
+}
+
+/* Drops off the bus so the host enumerates the application afterwards */
+void usb_detach(void)
+{
+    NVIC_DisableIRQ(USBD_IRQn);
+    USBD_SET_SE0();
+}
+
+void USBD_IRQHandler(void)
+{
+    uint8_t packet[LDROM_PACKET_SIZE];
+    uint32_t status = USBD_GET_INT_FLAG();
+    uint32_t state = USBD_GET_BUS_STATE();
+    uint32_t length;
+
+    if (status & USBD_INTSTS_FLDET) {
+        USBD_CLR_INT_FLAG(USBD_INTSTS_FLDET);
+        if (USBD_IS_ATTACHED())
+            USBD_ENABLE_USB();
+        else
+            USBD_DISABLE_USB();
+    }
+
+    if (status & USBD_INTSTS_BUS) {
+        USBD_CLR_INT_FLAG(USBD_INTSTS_BUS);
+        if (state & USBD_STATE_USBRST) {
+            USBD_ENABLE_USB();
+            USBD_SwReset();
+        }
+        if (state & USBD_STATE_SUSPEND)
+            USBD_DISABLE_PHY();
+        if (state & USBD_STATE_RESUME)
+            USBD_ENABLE_USB();
+    }
+
+    if (status & USBD_INTSTS_USB) {
+        if (status & USBD_INTSTS_SETUP) {
+            USBD_CLR_INT_FLAG(USBD_INTSTS_SETUP);
+            USBD_STOP_TRANSACTION(EP0);
+            USBD_STOP_TRANSACTION(EP1);
+            usb_setup();
+        }
+        if (status & USBD_INTSTS_EP0) {
+            USBD_CLR_INT_FLAG(USBD_INTSTS_EP0);
+            USBD_CtrlIn();
+        }
+        if (status & USBD_INTSTS_EP1) {
+            USBD_CLR_INT_FLAG(USBD_INTSTS_EP1);
+            USBD_CtrlOut();
+        }
+        if (status & USBD_INTSTS_EP2) {
+            USBD_CLR_INT_FLAG(USBD_INTSTS_EP2);
+            in_busy = 0U;
+        }
+        if (status & USBD_INTSTS_EP3) {
+            USBD_CLR_INT_FLAG(USBD_INTSTS_EP3);
+            length = USBD_GET_PAYLOAD_LEN(EP3);
+            USBD_MemCopy(packet, (uint8_t *)(USBD_BUF_BASE + EP3_BUF_BASE), (int32_t)length);
+            if (ldrom_receive(packet, length))
+                usb_out_arm();
+        }
+    }
+
+    if (status & USBD_INTSTS_WAKEUP)
+        USBD_CLR_INT_FLAG(USBD_INTSTS_WAKEUP);
+}
@@ -1,7 +1,13 @@
 
 #include <stdint.h>
 #include "NUC100Series.h"
+#include "gdb_server.h"
 #include "get_serial.h"
+#include "hw_timer.h"
+#include "kv_store.h"
+#include "msc_disk.h"
+#include "rtt_bridge.h"
+#include "semihost.h"
 #include "DAP_config.h"
 #include "DAP.h"
 #include "IO_Config.h"
@@ -14,10 +20,30 @@
 
 int main(void);
 
+#define USB_STACK_SIZE  1024U
+
+/* The byte pool holds the USB thread stack and the command buffers, ThreadX adds 8 bytes per block and 16 per pool */
+#define POOL_SIZE       (USB_STACK_SIZE + (2U * DAP_PACKET_SIZE) + (4U * 8U))
+
 TX_THREAD   threadUSB;
-static uint8_t memory_area[4 * 1024];
-static uint8_t TxDataBuffer[CFG_TUD_HID_EP_BUFSIZE];
-static uint8_t RxDataBuffer[CFG_TUD_HID_EP_BUFSIZE];
+static uint8_t memory_area[POOL_SIZE];
+static uint8_t *TxDataBuffer;
+static uint8_t *RxDataBuffer;
+
+#if (BOARD_DEBUG_PROTOCOL == PROTO_DAP_V2)
+/* Commands in flight on the bulk interface: DAP_PACKET_COUNT announced to the host plus a held one */
+#define BULK_COMMANDS   (DAP_PACKET_COUNT + 1U)
+
+/* Bulk commands in the vendor receive FIFO, one per transfer */
+static struct {
+    uint16_t length[BULK_COMMANDS];
+    uint8_t head;
+    uint8_t count;
+    uint16_t received;      /* Bytes of the command being received */
+    uint8_t held;           /* Command at head is in RxDataBuffer, not processed yet */
+    uint32_t since;         /* Timer value when it was moved there */
+} bulk;
+#endif
 
 static __INLINE void SYS_Init(void)
 {
@@ -67,11 +93,12 @@ static __INLINE void SYS_Init(void)
     SystemCoreClock = PLL_CLOCK / 1;        // HCLK
     CyclesPerUs     = PLL_CLOCK / 1000000;  // For CLK_SysTickDelay()
 
-    /* Enable UART0 and USBD module clock */
-    CLK->APBCLK |= CLK_APBCLK_USBD_EN_Msk | CLK_APBCLK_UART0_EN_Msk;
+    /* Enable UART0, USBD and TMR0 module clock */
+    CLK->APBCLK |= CLK_APBCLK_USBD_EN_Msk | CLK_APBCLK_UART0_EN_Msk | CLK_APBCLK_TMR0_EN_Msk;
 
     /* Select module clock source */
     CLK_SetModuleClock(UART0_MODULE, CLK_CLKSEL1_UART_S_HXT, CLK_CLKDIV_UART(1));
+    CLK_SetModuleClock(TMR0_MODULE, CLK_CLKSEL1_TMR0_S_HXT, 0);
     CLK_SetModuleClock(USBD_MODULE, 0, CLK_CLKDIV_USB(1));
 
 
@@ -106,19 +133,116 @@ static __INLINE void UART0_Init(void)
     UART0->IER = UART_IER_TOUT_IEN_Msk | UART_IER_RDA_IEN_Msk;
 }
 
+/* Earlier of two poll times, 0 meaning none */
+static uint32_t next_wait(uint32_t wait, uint32_t task_wait)
+{
+    if ((task_wait != 0U) && ((wait == 0U) || (task_wait < wait)))
+        return task_wait;
+    return wait;
+}
+
+#if (BOARD_DEBUG_PROTOCOL == PROTO_DAP_V2)
+/* A short packet or a full DAP packet ends the transfer and so the command */
+void tud_vendor_rx_cb(uint8_t itf, uint8_t const *buffer, uint16_t bufsize)
+{
+    (void)itf;
+    (void)buffer;
+
+    bulk.received += bufsize;
+    if ((bufsize < CFG_TUD_VENDOR_EPSIZE) || (bulk.received >= DAP_PACKET_SIZE)) {
+        if (bulk.count < BULK_COMMANDS) {
+            bulk.length[(bulk.head + bulk.count) % BULK_COMMANDS] = bulk.received;
+            bulk.count++;
+        } else {
+            /* Host exceeded DAP_PACKET_COUNT, the command runs together with the last one */
+            bulk.length[(bulk.head + bulk.count - 1U) % BULK_COMMANDS] += bulk.received;
+        }
+        bulk.received = 0U;
+    }
+}
+
+/* Configured (again), the vendor FIFOs start empty */
+void tud_mount_cb(void)
+{
+    bulk.count = 0U;
+    bulk.received = 0U;
+    bulk.held = 0U;
+}
+
+/*
+ * Processes the queued bulk commands in order, each once the transmit FIFO
+ * has room for the largest response. An Event Read at the end of the queue
+ * is held until the target changes state, it times out or another command
+ * arrives, so the host waits on the bulk IN endpoint instead of polling DHCSR.
+ * Returns us until the held Event Read is due, 0 when none is held.
+ */
+static uint32_t dap_bulk_task(void)
+{
+    uint32_t length;
+    uint32_t start;
+    uint32_t wait;
+
+    while (bulk.count != 0U) {
+        if (tud_vendor_write_available() < DAP_PACKET_SIZE)
+            return 0U;
+        if (!bulk.held) {
+            length = bulk.length[bulk.head];
+            if (tud_vendor_read(RxDataBuffer, length) != length) {
+                /* FIFO cleared by a bus reset */
+                bulk.count = 0U;
+                return 0U;
+            }
+            bulk.held = 1U;
+            bulk.since = hw_timer_now();
+        }
+        if (bulk.count == 1U) {
+            wait = DAP_EventWait(RxDataBuffer, hw_timer_elapsed(bulk.since));
+            if (wait != 0U)
+                return wait;
+        }
+        bulk.held = 0U;
+        bulk.head = (uint8_t)((bulk.head + 1U) % BULK_COMMANDS);
+        bulk.count--;
+
+        start = hw_timer_now();
+        length = DAP_ProcessCommand(RxDataBuffer, TxDataBuffer);
+        DAP_CaptureCommand(RxDataBuffer, TxDataBuffer, length, start);
+        length &= 0xFFFFU;
+        tud_vendor_write(TxDataBuffer, length);
+        tud_vendor_write_flush();
+    }
+    return 0U;
+}
+#endif
+
 void usb_thread(ULONG thread_input)
 {
+    uint32_t wait;
+
     (void)thread_input;
     do {
         tud_task();
+        msc_disk_task();
+        wait = gdb_server_task();
+        wait = next_wait(wait, rtt_bridge_task());
+        wait = next_wait(wait, semihost_task());
+        wait = next_wait(wait, DAP_SampleTask());
+        wait = next_wait(wait, DAP_EventTask());
+#if (BOARD_DEBUG_PROTOCOL == PROTO_DAP_V2)
+        wait = next_wait(wait, dap_bulk_task());
+#endif
         if (tud_ready())
             LED_CONNECTED_OUT(1);
         else
             LED_CONNECTED_OUT(0);
 
         // If suspended or disconnected, delay for 1ms (20 ticks)
-        if (tud_suspended() || !tud_connected() || !tud_task_event_ready())
-            tx_thread_sleep(1);
+        // Polls, samples and held commands due before the next tick wake up on the hardware timer
+        if (tud_suspended() || !tud_connected() || !tud_task_event_ready()) {
+            if ((wait == 0U) || (wait >= (1000000U / TX_TIMER_TICKS_PER_SECOND)) ||
+                !hw_timer_sleep_us(wait))
+                tx_thread_sleep(1);
+        }
     } while (1);
 }
 
@@ -127,12 +251,16 @@ void    tx_application_define(void *first_unused_memory)
 {
     TX_BYTE_POOL    byte_pool;
     CHAR    *pointer = TX_NULL;
+    hw_timer_init();
+    kv_init();
     DAP_Setup();
 
-    tx_byte_pool_create(&byte_pool, "byte pool", memory_area, 4 * 1024);
-    tx_byte_allocate(&byte_pool, (VOID **) &pointer, 1024, TX_NO_WAIT);
+    tx_byte_pool_create(&byte_pool, "byte pool", memory_area, POOL_SIZE);
+    tx_byte_allocate(&byte_pool, (VOID **) &TxDataBuffer, DAP_PACKET_SIZE, TX_NO_WAIT);
+    tx_byte_allocate(&byte_pool, (VOID **) &RxDataBuffer, DAP_PACKET_SIZE, TX_NO_WAIT);
+    tx_byte_allocate(&byte_pool, (VOID **) &pointer, USB_STACK_SIZE, TX_NO_WAIT);
     tx_thread_create(&threadUSB, "ThreadUSB", usb_thread, 0,
-        pointer, 1024,
+        pointer, USB_STACK_SIZE,
         1, 1, TX_NO_TIME_SLICE, TX_AUTO_START);
 
     while (1) {
@@ -142,9 +270,17 @@ void    tx_application_define(void *first_unused_memory)
 int main(void) {
     /* Unlock protected registers */
     SYS_UnlockReg();
+
+    /* DAP button held at reset: restart in the LDROM firmware updater */
+    if (OFF_BTN_IO == 0U) {
+        FMC_SET_LDROM_BOOT();
+        SYS_ResetCPU();
+    }
+
     SYS_Init();
     UART0_Init();
     usb_serial_init();
+    msc_disk_init();
     tusb_init();
 
     tx_kernel_enter();
@@ -167,13 +303,16 @@ uint16_t tud_hid_get_report_cb(uint8_t itf, uint8_t report_id, hid_report_type_t
 void tud_hid_set_report_cb(uint8_t itf, uint8_t report_id, hid_report_type_t report_type, uint8_t const* RxDataBuffer, uint16_t bufsize)
 {
   uint32_t response_size = TU_MIN(CFG_TUD_HID_EP_BUFSIZE, bufsize);
+  uint32_t start = hw_timer_now();
+  uint32_t length;
 
   // This doesn't use multiple report and report ID
   (void) itf;
   (void) report_id;
   (void) report_type;
 
-  DAP_ProcessCommand(RxDataBuffer, TxDataBuffer);
+  length = DAP_ProcessCommand(RxDataBuffer, TxDataBuffer);
+  DAP_CaptureCommand(RxDataBuffer, TxDataBuffer, length, start);
 
   tud_hid_report(0, TxDataBuffer, response_size);
 }
@@ -0,0 +1,417 @@
+#include <string.h>
+#include "NUC100Series.h"
+#include "IO_Config.h"
+#include "board_config.h"
+#include "get_serial.h"
+#include "image_stream.h"
+#include "msc_disk.h"
+#include "tx_api.h"
+#include "tusb.h"
+
+/*
+ * Virtual FAT16 volume. Nothing of it is stored: boot sector, FAT, root
+ * directory and the status files are generated from the layout below when
+ * the host reads them. Sectors the host writes into the data area go to the
+ * image stream, which decodes image files and programs the target flash.
+ */
+#define SECTOR_SIZE         512U
+#define CLUSTER_SECTORS     8U
+#define CLUSTER_COUNT       4200U       /* At least 4085 clusters make it FAT16 */
+#define RESERVED_SECTORS    1U
+#define FAT_COUNT           2U
+#define FAT_SECTORS         ((((CLUSTER_COUNT + 2U) * 2U) + SECTOR_SIZE - 1U) / SECTOR_SIZE)
+#define ROOT_ENTRIES        64U
+#define ROOT_SECTORS        ((ROOT_ENTRIES * 32U) / SECTOR_SIZE)
+
+#define FAT_START           RESERVED_SECTORS
+#define ROOT_START          (FAT_START + (FAT_COUNT * FAT_SECTORS))
+#define DATA_START          (ROOT_START + ROOT_SECTORS)
+#define SECTOR_COUNT        (DATA_START + (CLUSTER_COUNT * CLUSTER_SECTORS))
+
+#define VOLUME_LABEL        "CMSIS-DAP  "
+#define VOLUME_ID           0x44415021U
+#define FILE_DATE           ((uint16_t)(((2024U - 1980U) << 9) | (1U << 5) | 1U))
+
+#define DIR_ATTR_READ_ONLY  0x01U
+#define DIR_ATTR_VOLUME_ID  0x08U
+#define DIR_ATTR_DIRECTORY  0x10U
+#define DIR_ATTR_LFN        0x0FU
+#define DIR_ENTRY_DELETED   0xE5U
+
+/* Ticks without writes that end a transfer, and before the drive is remounted */
+#define STREAM_TIMEOUT      (2U * TX_TIMER_TICKS_PER_SECOND)
+#define EJECT_DELAY         (TX_TIMER_TICKS_PER_SECOND / 2U)
+#define EJECT_TIME          TX_TIMER_TICKS_PER_SECOND
+
+#define DISK_READY          0U
+#define DISK_EJECT_PENDING  1U          /* Programming done, waiting for the host to go quiet */
+#define DISK_EJECTED        2U
+#define DISK_CHANGED        3U          /* Back, next TEST UNIT READY reports the change */
+
+/* Indexed by the image stream result */
+static const char *const result_text[] = {
+    "No image programmed",
+    "Image programmed",
+    "Target not connected",
+    "Target flash erase, program or verify failed",
+    "Image outside of the target flash",
+    "Invalid HEX record",
+    "Image sectors written too far out of order",
+    "Image file incomplete"
+};
+
+typedef struct {
+    char name[11];
+    /* Writes the file contents, 0 hides the file */
+    uint32_t (*content)(char *buf);
+} disk_file_t;
+
+static uint32_t details_content(char *buf);
+static uint32_t fail_content(char *buf);
+
+/* Generated files, file n occupies cluster n + 2 */
+static const disk_file_t disk_files[] = {
+    { "DETAILS TXT", details_content },
+    { "FAIL    TXT", fail_content },
+};
+#define FILE_COUNT          (sizeof(disk_files) / sizeof(disk_files[0]))
+#define FILE_SECTORS        (FILE_COUNT * CLUSTER_SECTORS)
+
+static uint32_t msc_enabled;
+static uint32_t disk_state;
+static uint32_t disk_tick;
+
+static uint32_t write_tick;
+
+static uint32_t last_result;
+static uint32_t last_length;
+
+static void put16(uint8_t *buf, uint32_t value)
+{
+    buf[0] = (uint8_t)value;
+    buf[1] = (uint8_t)(value >> 8);
+}
+
+static void put32(uint8_t *buf, uint32_t value)
+{
+    put16(buf, value);
+    put16(buf + 2, value >> 16);
+}
+
+static uint32_t get16(const uint8_t *buf)
+{
+    return (uint32_t)buf[0] | ((uint32_t)buf[1] << 8);
+}
+
+static uint32_t get32(const uint8_t *buf)
+{
+    return get16(buf) | (get16(buf + 2) << 16);
+}
+
+static char *put_text(char *buf, const char *text)
+{
+    while (*text)
+        *buf++ = *text++;
+    return buf;
+}
+
+static char *put_hex(char *buf, uint32_t value)
+{
+    uint32_t n;
+
+    *buf++ = '0';
+    *buf++ = 'x';
+    for (n = 0U; n < 8U; n++, value <<= 4)
+        *buf++ = "0123456789ABCDEF"[value >> 28];
+    return buf;
+}
+
+static char *put_dec(char *buf, uint32_t value)
+{
+    char digits[10];
+    uint32_t n = 0U;
+
+    do {
+        digits[n++] = (char)('0' + (value % 10U));
+        value /= 10U;
+    } while (value != 0U);
+    while (n != 0U)
+        *buf++ = digits[--n];
+    return buf;
+}
+
+static uint32_t details_content(char *buf)
+{
+    char *p = buf;
+
+    p = put_text(p, USB_VENDOR_STRING " " USB_PRODUCT_STRING "\r\nSerial: ");
+    p = put_text(p, usb_serial);
+    p = put_text(p, "\r\nTarget flash: ");
+    p = put_hex(p, TARGET_FLASH_START);
+    p = put_text(p, ", ");
+    p = put_dec(p, TARGET_FLASH_SIZE);
+    p = put_text(p, " bytes, ");
+    p = put_dec(p, TARGET_FLASH_PAGE_SIZE);
+    p = put_text(p, " byte pages\r\nLast transfer: ");
+    p = put_text(p, result_text[last_result]);
+    if (last_result == IMAGE_OK) {
+        p = put_text(p, ", ");
+        p = put_dec(p, last_length);
+        p = put_text(p, " bytes");
+    }
+    p = put_text(p, "\r\n");
+    return (uint32_t)(p - buf);
+}
+
+static uint32_t fail_content(char *buf)
+{
+    char *p = buf;
+
+    if (last_result <= IMAGE_OK)
+        return 0U;
+    p = put_text(p, result_text[last_result]);
+    p = put_text(p, "\r\n");
+    return (uint32_t)(p - buf);
+}
+
+static void boot_sector(uint8_t *buf)
+{
+    static const uint8_t jump[3] = { 0xEB, 0x3C, 0x90 };
+
+    memcpy(&buf[0], jump, 3);
+    memcpy(&buf[3], "MSWIN4.1", 8);
+    put16(&buf[11], SECTOR_SIZE);
+    buf[13] = CLUSTER_SECTORS;
+    put16(&buf[14], RESERVED_SECTORS);
+    buf[16] = FAT_COUNT;
+    put16(&buf[17], ROOT_ENTRIES);
+    put16(&buf[19], SECTOR_COUNT);
+    buf[21] = 0xF8;                             /* Fixed disk */
+    put16(&buf[22], FAT_SECTORS);
+    put16(&buf[24], 63U);                       /* Sectors per track */
+    put16(&buf[26], 255U);                      /* Heads */
+    buf[36] = 0x80;                             /* Drive number */
+    buf[38] = 0x29;                             /* Extended boot signature */
+    put32(&buf[39], VOLUME_ID);
+    memcpy(&buf[43], VOLUME_LABEL, 11);
+    memcpy(&buf[54], "FAT16   ", 8);
+    buf[510] = 0x55;
+    buf[511] = 0xAA;
+}
+
+/* Sizes of the generated files, the sector buffer is used for their contents */
+static void file_sizes(uint8_t *buf, uint32_t *sizes)
+{
+    uint32_t n;
+
+    for (n = 0U; n < FILE_COUNT; n++)
+        sizes[n] = disk_files[n].content((char *)buf);
+    memset(buf, 0, SECTOR_SIZE);
+}
+
+/* sector is relative to the start of one FAT copy */
+static void fat_sector(uint8_t *buf, uint32_t sector)
+{
+    uint32_t sizes[FILE_COUNT];
+    uint32_t n;
+
+    if (sector != 0U)
+        return;
+    file_sizes(buf, sizes);
+    put16(&buf[0], 0xFFF8U);
+    put16(&buf[2], 0xFFFFU);
+    /* Clusters of hidden files are marked bad, so the host never allocates them */
+    for (n = 0U; n < FILE_COUNT; n++)
+        put16(&buf[(n + 2U) * 2U], (sizes[n] != 0U) ? 0xFFFFU : 0xFFF7U);
+}
+
+static void root_sector(uint8_t *buf, uint32_t sector)
+{
+    uint32_t sizes[FILE_COUNT];
+    uint8_t *entry;
+    uint32_t n;
+
+    if (sector != 0U)
+        return;
+    file_sizes(buf, sizes);
+
+    entry = buf;
+    memcpy(entry, VOLUME_LABEL, 11);
+    entry[11] = DIR_ATTR_VOLUME_ID;
+    put16(&entry[24], FILE_DATE);
+
+    for (n = 0U; n < FILE_COUNT; n++) {
+        if (sizes[n] == 0U)
+            continue;
+        entry += 32;
+        memcpy(entry, disk_files[n].name, 11);
+        entry[11] = DIR_ATTR_READ_ONLY;
+        put16(&entry[16], FILE_DATE);           /* Creation */
+        put16(&entry[18], FILE_DATE);           /* Access */
+        put16(&entry[24], FILE_DATE);           /* Write */
+        put16(&entry[26], n + 2U);
+        put32(&entry[28], sizes[n]);
+    }
+}
+
+static void read_sector(uint32_t lba, uint8_t *buf)
+{
+    uint32_t file;
+
+    memset(buf, 0, SECTOR_SIZE);
+    if (lba == 0U) {
+        boot_sector(buf);
+    } else if (lba < ROOT_START) {
+        fat_sector(buf, (lba - FAT_START) % FAT_SECTORS);
+    } else if (lba < DATA_START) {
+        root_sector(buf, lba - ROOT_START);
+    } else if (lba < DATA_START + FILE_SECTORS) {
+        file = (lba - DATA_START) / CLUSTER_SECTORS;
+        if (((lba - DATA_START) % CLUSTER_SECTORS) == 0U)
+            (void)disk_files[file].content((char *)buf);
+    }
+}
+
+/* Records the result of a closed image and remounts, so the host sees the status files */
+static void stream_close(void)
+{
+    uint32_t result = image_stream_close(&last_length);
+
+    if (result != IMAGE_NONE) {
+        last_result = result;
+        disk_state = DISK_EJECT_PENDING;
+    }
+}
+
+/* Passes the file sizes in a root directory sector to the image stream */
+static void root_write(const uint8_t *buf)
+{
+    const uint8_t *entry;
+    uint32_t cluster;
+
+    for (entry = buf; entry < buf + SECTOR_SIZE; entry += 32) {
+        if ((entry[0] == 0x00U) || (entry[0] == DIR_ENTRY_DELETED) ||
+            (entry[11] == DIR_ATTR_LFN) ||
+            (entry[11] & (DIR_ATTR_VOLUME_ID | DIR_ATTR_DIRECTORY)))
+            continue;
+        cluster = get16(&entry[26]);
+        if ((cluster >= FILE_COUNT + 2U) && (cluster < CLUSTER_COUNT + 2U) && (get32(&entry[28]) != 0U))
+            image_stream_size(DATA_START + ((cluster - 2U) * CLUSTER_SECTORS), get32(&entry[28]));
+    }
+}
+
+static void write_sector(uint32_t lba, const uint8_t *buf)
+{
+    if ((lba >= ROOT_START) && (lba < DATA_START))
+        root_write(buf);
+    else if (lba >= DATA_START + FILE_SECTORS)
+        image_stream_sector(lba, buf, ((lba - DATA_START) % CLUSTER_SECTORS) == 0U);
+
+    write_tick = tx_time_get();
+    if (image_stream_state() == IMAGE_STREAM_COMPLETE)
+        stream_close();
+}
+
+/**
+ * @brief Sample the MSC enable strap.
+ *
+ * PA1 pulled low selects the USB configuration with the drag-and-drop
+ * drive in place of the CDC UART. The pin is read once, the configuration
+ * cannot change while enumerated.
+ */
+void msc_disk_init(void)
+{
+    msc_enabled = (MSC_EN_IO == 0U) ? 1U : 0U;
+}
+
+uint32_t msc_disk_enabled(void)
+{
+    return msc_enabled;
+}
+
+/**
+ * @brief End stalled transfers and remount the drive.
+ *
+ * A transfer whose end could not be told from the directory entry or a HEX
+ * end record is finished when the host stops writing. Once programming is
+ * done and the host is quiet the medium is reported removed for a moment,
+ * so the host drops its cached view and reads the new status files.
+ */
+void msc_disk_task(void)
+{
+    ULONG now = tx_time_get();
+
+    if ((image_stream_state() != IMAGE_STREAM_IDLE) && ((now - write_tick) >= STREAM_TIMEOUT))
+        stream_close();
+
+    if ((disk_state == DISK_EJECT_PENDING) && (image_stream_state() == IMAGE_STREAM_IDLE) &&
+        ((now - write_tick) >= EJECT_DELAY)) {
+        disk_state = DISK_EJECTED;
+        disk_tick = now;
+    }
+    if ((disk_state == DISK_EJECTED) && ((now - disk_tick) >= EJECT_TIME))
+        disk_state = DISK_CHANGED;
+}
+
+void tud_msc_inquiry_cb(uint8_t lun, uint8_t vendor_id[8], uint8_t product_id[16], uint8_t product_rev[4])
+{
+    (void)lun;
+    memcpy(vendor_id, "UWings  ", 8);
+    memcpy(product_id, "CMSIS-DAP MSC   ", 16);
+    memcpy(product_rev, "1.0 ", 4);
+}
+
+bool tud_msc_test_unit_ready_cb(uint8_t lun)
+{
+    if (disk_state == DISK_EJECTED)
+        return false;
+    if (disk_state == DISK_CHANGED) {
+        disk_state = DISK_READY;
+        tud_msc_set_sense(lun, SCSI_SENSE_UNIT_ATTENTION, 0x28, 0x00);
+        return false;
+    }
+    return true;
+}
+
+void tud_msc_capacity_cb(uint8_t lun, uint32_t *block_count, uint16_t *block_size)
+{
+    (void)lun;
+    *block_count = SECTOR_COUNT;
+    *block_size  = SECTOR_SIZE;
+}
+
+bool tud_msc_start_stop_cb(uint8_t lun, uint8_t power_condition, bool start, bool load_eject)
+{
+    (void)lun;
+    (void)power_condition;
+    (void)start;
+    (void)load_eject;
+    return true;
+}
+
+int32_t tud_msc_read10_cb(uint8_t lun, uint32_t lba, uint32_t offset, void *buffer, uint32_t bufsize)
+{
+    (void)lun;
+    if ((offset != 0U) || (bufsize < SECTOR_SIZE) || (lba >= SECTOR_COUNT))
+        return -1;
+    read_sector(lba, buffer);
+    return SECTOR_SIZE;
+}
+
+int32_t tud_msc_write10_cb(uint8_t lun, uint32_t lba, uint32_t offset, uint8_t *buffer, uint32_t bufsize)
+{
+    (void)lun;
+    if ((offset != 0U) || (bufsize < SECTOR_SIZE) || (lba >= SECTOR_COUNT))
+        return -1;
+    write_sector(lba, buffer);
+    return SECTOR_SIZE;
+}
+
+int32_t tud_msc_scsi_cb(uint8_t lun, uint8_t const scsi_cmd[16], void *buffer, uint16_t bufsize)
+{
+    (void)scsi_cmd;
+    (void)buffer;
+    (void)bufsize;
+    tud_msc_set_sense(lun, SCSI_SENSE_ILLEGAL_REQUEST, 0x20, 0x00);
+    return -1;
+}
@@ -0,0 +1,15 @@
+#ifndef _MSC_DISK_H_
+#define _MSC_DISK_H_
+
+#include <stdint.h>
+
+/* Samples the MSC enable strap, call before tusb_init() */
+extern void msc_disk_init(void);
+
+/* Returns 1 when the drag-and-drop drive is part of the USB configuration */
+extern uint32_t msc_disk_enabled(void);
+
+/* Ends stalled transfers and remounts the drive after programming, call from the USB thread */
+extern void msc_disk_task(void);
+
+#endif
@@ -0,0 +1,263 @@
+#include <string.h>
+#include "board_config.h"
+#include "DAP_config.h"
+#include "DAP.h"
+#include "tusb.h"
+#include "gdb_server.h"
+#include "rtt_bridge.h"
+
+/*
+ * RTT terminal bridged to the CDC port.
+ *
+ * The SEGGER RTT control block is found by scanning target SRAM for its ID
+ * string. Channel 0 up data is copied to the CDC port and CDC input into
+ * the channel 0 down buffer. Without a host session the bridge connects
+ * the Debug Port once and keeps it while the CDC port is open. During a
+ * host session (DAP_Connect to DAP_Disconnect) it polls between host
+ * commands and leaves SELECT, CSW and TAR as the host set them up. Polls
+ * follow each other at POLL_MIN_US while data moves and back off to
+ * POLL_MAX_US when idle.
+ */
+static const uint8_t rtt_id[16] = "SEGGER RTT";
+
+/* Control block: ID, MaxNumUpBuffers, MaxNumDownBuffers, aUp[], aDown[] */
+#define CB_ID_WORDS         4U
+#define CB_MAX_UP           4U      /* Word index */
+#define CB_UP               24U     /* Byte offset */
+#define CB_BUFFERS_MAX      16U
+
+/* Buffer descriptor: sName, pBuffer, SizeOfBuffer, WrOff, RdOff, Flags */
+#define DESC_SIZE           24U
+#define DESC_BUFFER         1U      /* Word index */
+#define DESC_LENGTH         2U
+#define DESC_WROFF          12U     /* Byte offset */
+#define DESC_RDOFF          16U
+
+#define POLL_MIN_US         500U
+#define POLL_MAX_US         50000U
+#define RESCAN_US           1000000U
+
+#define CHUNK_SIZE          64U     /* Bytes per target access */
+#define CHUNK_WORDS         ((CHUNK_SIZE / 4U) + 1U)
+#define BURST_SIZE          1024U   /* Up bytes moved per poll */
+#define SCAN_SIZE           1024U   /* SRAM scanned per poll */
+
+#define STATE_CLOSED        0U
+#define STATE_SCAN          1U
+#define STATE_ACTIVE        2U
+
+static struct {
+    uint32_t state;
+    uint32_t scan_addr;
+    uint32_t up;            /* Channel 0 up descriptor */
+    uint32_t up_buffer;
+    uint32_t up_size;
+    uint32_t down;          /* Channel 0 down descriptor, 0 when there is none */
+    uint32_t down_buffer;
+    uint32_t down_size;
+    uint32_t interval;
+    uint32_t last;
+} rtt;
+
+/* Word aligned copy of the target memory currently worked on */
+static uint32_t scratch[CHUNK_WORDS];
+
+static uint32_t in_ram(uint32_t addr, uint32_t length)
+{
+    return (addr >= TARGET_RAM_START) && (length != 0U) &&
+           (length <= TARGET_RAM_SIZE) &&
+           ((addr - TARGET_RAM_START) <= (TARGET_RAM_SIZE - length));
+}
+
+/* Reads the words covering length bytes at addr into scratch, returns the first byte or NULL */
+static uint8_t *read_bytes(uint32_t addr, uint32_t length)
+{
+    uint32_t offset = addr & 3U;
+
+    if (Target_ReadMem(addr - offset, scratch, (offset + length + 3U) / 4U) != DAP_TRANSFER_OK)
+        return NULL;
+    return (uint8_t *)scratch + offset;
+}
+
+/* Writes back the words covering length bytes at addr from scratch */
+static uint32_t write_bytes(uint32_t addr, uint32_t length)
+{
+    uint32_t offset = addr & 3U;
+
+    return Target_WriteMem(addr - offset, scratch, (offset + length + 3U) / 4U) == DAP_TRANSFER_OK;
+}
+
+/* Reads a buffer descriptor, returns 1 when its buffer lies in target SRAM */
+static uint32_t read_desc(uint32_t desc, uint32_t *buffer, uint32_t *size)
+{
+    uint32_t words[DESC_SIZE / 4U];
+
+    if (Target_ReadMem(desc, words, DESC_SIZE / 4U) != DAP_TRANSFER_OK)
+        return 0U;
+    *buffer = words[DESC_BUFFER];
+    *size   = words[DESC_LENGTH];
+    return in_ram(*buffer, *size);
+}
+
+/* Checks a control block candidate and takes over its channel 0 */
+static uint32_t attach(uint32_t cb)
+{
+    uint32_t count[2];
+
+    if ((Target_ReadMem(cb + (CB_MAX_UP * 4U), count, 2U) != DAP_TRANSFER_OK) ||
+        (count[0] == 0U) || (count[0] > CB_BUFFERS_MAX) || (count[1] > CB_BUFFERS_MAX))
+        return 0U;
+
+    rtt.up = cb + CB_UP;
+    if (!read_desc(rtt.up, &rtt.up_buffer, &rtt.up_size))
+        return 0U;
+
+    rtt.down = cb + CB_UP + (count[0] * DESC_SIZE);
+    if ((count[1] == 0U) || !read_desc(rtt.down, &rtt.down_buffer, &rtt.down_size))
+        rtt.down = 0U;
+    return 1U;
+}
+
+/* Scans the next part of target SRAM for the control block ID */
+static void scan(void)
+{
+    uint32_t end = TARGET_RAM_START + TARGET_RAM_SIZE;
+    uint32_t limit = rtt.scan_addr + SCAN_SIZE;
+    uint32_t words;
+    uint32_t n;
+
+    rtt.interval = POLL_MIN_US;
+    while (rtt.scan_addr < limit) {
+        words = (end - rtt.scan_addr) / 4U;
+        if (words > CHUNK_WORDS)
+            words = CHUNK_WORDS;
+        if ((words < CB_ID_WORDS) ||
+            (Target_ReadMem(rtt.scan_addr, scratch, words) != DAP_TRANSFER_OK)) {
+            /* Not found, the target may not have set up RTT yet */
+            rtt.scan_addr = TARGET_RAM_START;
+            rtt.interval  = RESCAN_US;
+            return;
+        }
+        for (n = 0U; (n + CB_ID_WORDS) <= words; n++) {
+            if ((memcmp(&scratch[n], rtt_id, sizeof(rtt_id)) == 0) &&
+                attach(rtt.scan_addr + (n * 4U))) {
+                rtt.state = STATE_ACTIVE;
+                return;
+            }
+        }
+        /* Overlap by the ID less one word */
+        rtt.scan_addr += (words - (CB_ID_WORDS - 1U)) * 4U;
+    }
+}
+
+/* Moves data between channel 0 and the CDC port, returns the bytes moved */
+static uint32_t poll(void)
+{
+    uint32_t offset[2];
+    uint32_t moved = 0U;
+    uint32_t wr;
+    uint32_t rd;
+    uint32_t n;
+    uint8_t *data;
+
+    /* Up: target to host */
+    if (Target_ReadMem(rtt.up + DESC_WROFF, offset, 2U) != DAP_TRANSFER_OK)
+        return 0U;
+    wr = offset[0];
+    rd = offset[1];
+    if ((wr >= rtt.up_size) || (rd >= rtt.up_size)) {
+        /* Control block gone, the target has been reset or reprogrammed */
+        rtt.state = STATE_SCAN;
+        rtt.scan_addr = TARGET_RAM_START;
+        return 0U;
+    }
+    while ((rd != wr) && (moved < BURST_SIZE)) {
+        n = (wr > rd) ? (wr - rd) : (rtt.up_size - rd);
+        if (n > CHUNK_SIZE)
+            n = CHUNK_SIZE;
+        if (n > tud_cdc_write_available())
+            n = tud_cdc_write_available();
+        if ((n == 0U) || ((data = read_bytes(rtt.up_buffer + rd, n)) == NULL))
+            break;
+        tud_cdc_write(data, n);
+        rd += n;
+        if (rd == rtt.up_size)
+            rd = 0U;
+        moved += n;
+    }
+    if (moved != 0U) {
+        (void)Target_Write32(rtt.up + DESC_RDOFF, rd);
+        tud_cdc_write_flush();
+    }
+
+    /* Down: host to target, one chunk per poll */
+    if ((rtt.down == 0U) || (tud_cdc_available() == 0U) ||
+        (Target_ReadMem(rtt.down + DESC_WROFF, offset, 2U) != DAP_TRANSFER_OK))
+        return moved;
+    wr = offset[0];
+    rd = offset[1];
+    if ((wr >= rtt.down_size) || (rd >= rtt.down_size))
+        return moved;
+    /* One byte stays free to tell a full buffer from an empty one */
+    n = (rd > wr) ? (rd - wr - 1U) : (rtt.down_size - wr - ((rd == 0U) ? 1U : 0U));
+    if (n > CHUNK_SIZE)
+        n = CHUNK_SIZE;
+    if (n > tud_cdc_available())
+        n = tud_cdc_available();
+    if ((n == 0U) || ((data = read_bytes(rtt.down_buffer + wr, n)) == NULL))
+        return moved;
+    n = tud_cdc_read(data, n);
+    if (write_bytes(rtt.down_buffer + wr, n)) {
+        wr += n;
+        if (wr == rtt.down_size)
+            wr = 0U;
+        (void)Target_Write32(rtt.down + DESC_WROFF, wr);
+    }
+    return moved + n;
+}
+
+/**
+ * @brief Run the RTT bridge when a poll is due.
+ *
+ * The control block is searched for when the CDC port is opened and again
+ * whenever channel 0 stops making sense.
+ *
+ * @return Microseconds until the next poll, 0 when the CDC port is closed.
+ */
+uint32_t rtt_bridge_task(void)
+{
+    Target_Host_t host;
+    uint32_t elapsed;
+
+    if (!tud_cdc_connected() || gdb_server_active()) {
+        if (rtt.state != STATE_CLOSED)
+            Target_Release();
+        rtt.state = STATE_CLOSED;
+        return 0U;
+    }
+    if (rtt.state == STATE_CLOSED) {
+        rtt.state     = STATE_SCAN;
+        rtt.scan_addr = TARGET_RAM_START;
+        rtt.interval  = 0U;
+    }
+
+    elapsed = hw_timer_elapsed(rtt.last);
+    if (elapsed < rtt.interval)
+        return rtt.interval - elapsed;
+    rtt.last = hw_timer_now();
+
+    if (Target_Begin(&host) != DAP_TRANSFER_OK) {
+        rtt.interval = POLL_MAX_US;
+    } else if (rtt.state == STATE_SCAN) {
+        scan();
+    } else if (poll() != 0U) {
+        rtt.interval = POLL_MIN_US;
+    } else {
+        rtt.interval = (rtt.interval < POLL_MIN_US) ? POLL_MIN_US : (rtt.interval * 2U);
+        if (rtt.interval > POLL_MAX_US)
+            rtt.interval = POLL_MAX_US;
+    }
+    Target_End(&host);
+
+    return rtt.interval;
+}
@@ -0,0 +1,13 @@
+#ifndef _RTT_BRIDGE_H_
+#define _RTT_BRIDGE_H_
+
+#include <stdint.h>
+
+/*
+ * Polls RTT channel 0 of the target while the CDC port is open, between
+ * the commands of a host session as well, call from the USB thread.
+ * Returns the microseconds until the next poll is due, 0 when not polling.
+ */
+extern uint32_t rtt_bridge_task(void);
+
+#endif
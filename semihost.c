@@ -0,0 +1,255 @@
+#include "DAP_config.h"
+#include "DAP.h"
+#include "tusb.h"
+#include "gdb_server.h"
+#include "semihost.h"
+
+/*
+ * Semihosting console on the CDC port.
+ *
+ * DHCSR is polled for a core halted on BKPT 0xAB. The operation in R0 and
+ * its parameter in R1 are read, console operations are served from and to
+ * the CDC port and the core is resumed behind the BKPT. Output that does
+ * not fit into the CDC buffer is continued at the next poll with the core
+ * still halted, SYS_READC waits the same way for input. Like the RTT
+ * bridge, the Debug Port is connected once while no host session holds it,
+ * and polled between host commands during a session. A debugger that
+ * serves semihosting itself has to be kept off the CDC port, the probe
+ * answers BKPT 0xAB as soon as the port is open.
+ */
+#define BKPT_SEMIHOST       0xBEABU
+
+#define REG_R0              0U
+#define REG_R1              1U
+#define REG_PC              15U
+
+/* Operations */
+#define SYS_WRITEC          0x03U
+#define SYS_WRITE0          0x04U
+#define SYS_WRITE           0x05U
+#define SYS_READC           0x07U
+
+#define POLL_MIN_US         200U
+#define POLL_MAX_US         20000U
+
+#define CHUNK_SIZE          64U     /* Bytes per target read */
+#define CHUNK_WORDS         ((CHUNK_SIZE / 4U) + 1U)
+#define UNTIL_NUL           0xFFFFFFFFU
+
+static struct {
+    uint32_t open;          /* CDC port open, debugging enabled in the target */
+    uint32_t debugen;       /* C_DEBUGEN set by the probe, cleared again on close */
+    uint32_t op;            /* Operation in progress, 0 when none */
+    uint32_t pc;
+    uint32_t addr;          /* Next byte to write out */
+    uint32_t remaining;     /* Bytes left, UNTIL_NUL for SYS_WRITE0 */
+    uint32_t interval;
+    uint32_t last;
+} sh;
+
+static uint32_t scratch[CHUNK_WORDS];
+
+/* Returns the core to the caller of the BKPT with R0 set to result */
+static uint32_t resume(uint32_t result)
+{
+    if ((Target_WriteCore(REG_R0, result) != DAP_TRANSFER_OK) ||
+        (Target_WriteCore(REG_PC, sh.pc + 2U) != DAP_TRANSFER_OK) ||
+        (Target_Write32(DBG_HCSR, DBGKEY | C_DEBUGEN) != DAP_TRANSFER_OK))
+        return 0U;
+    sh.op = 0U;
+    return 1U;
+}
+
+/* Checks for a semihosting halt and fetches its operation, returns 1 when one started */
+static uint32_t start(void)
+{
+    uint32_t value;
+    uint32_t arg;
+    uint32_t block[3];
+
+    if ((Target_Read32(DBG_HCSR, &value) != DAP_TRANSFER_OK) || ((value & S_HALT) == 0U) ||
+        (Target_ReadCore(REG_PC, &sh.pc) != DAP_TRANSFER_OK) ||
+        (Target_Read32(sh.pc & ~3U, &value) != DAP_TRANSFER_OK))
+        return 0U;
+    if (((value >> ((sh.pc & 2U) * 8U)) & 0xFFFFU) != BKPT_SEMIHOST)
+        return 0U;      /* Halted for some other reason, not ours */
+
+    if ((Target_ReadCore(REG_R0, &sh.op) != DAP_TRANSFER_OK) ||
+        (Target_ReadCore(REG_R1, &arg) != DAP_TRANSFER_OK))
+        return 0U;
+
+    switch (sh.op) {
+    case SYS_WRITEC:
+        sh.addr      = arg;
+        sh.remaining = 1U;
+        break;
+    case SYS_WRITE0:
+        sh.addr      = arg;
+        sh.remaining = UNTIL_NUL;
+        break;
+    case SYS_WRITE:
+        /* Handle, buffer, length, every handle goes to the console */
+        if (Target_ReadMem(arg, block, 3U) != DAP_TRANSFER_OK)
+            return 0U;
+        sh.addr      = block[1];
+        sh.remaining = block[2];
+        break;
+    case SYS_READC:
+        break;
+    default:
+        /* Not a console operation */
+        (void)resume(0xFFFFFFFFU);
+        return 1U;
+    }
+    return 1U;
+}
+
+/* Writes out console data as far as the CDC buffer allows, returns the bytes written */
+static uint32_t output(void)
+{
+    uint32_t written = 0U;
+    uint32_t offset;
+    uint32_t n;
+    uint32_t i;
+    uint8_t *data;
+
+    while (sh.remaining != 0U) {
+        offset = sh.addr & 3U;
+        n = CHUNK_SIZE;
+        if (n > sh.remaining)
+            n = sh.remaining;
+        if (n > tud_cdc_write_available())
+            n = tud_cdc_write_available();
+        if ((n == 0U) ||
+            (Target_ReadMem(sh.addr - offset, scratch, (offset + n + 3U) / 4U) != DAP_TRANSFER_OK))
+            break;
+        data = (uint8_t *)scratch + offset;
+        if (sh.remaining == UNTIL_NUL) {
+            for (i = 0U; (i < n) && (data[i] != 0U); i++) {
+            }
+            if (i < n)
+                sh.remaining = 0U;
+            n = i;
+        } else {
+            sh.remaining -= n;
+        }
+        tud_cdc_write(data, n);
+        sh.addr += n;
+        written += n;
+    }
+    if (written != 0U)
+        tud_cdc_write_flush();
+    return written;
+}
+
+/* Works on the current operation, returns 1 when anything has been done */
+static uint32_t service(void)
+{
+    uint32_t done = 0U;
+
+    if (sh.op == 0U) {
+        if (!start())
+            return 0U;
+        done = 1U;
+    }
+
+    switch (sh.op) {
+    case SYS_WRITEC:
+    case SYS_WRITE0:
+    case SYS_WRITE:
+        if (output() != 0U)
+            done = 1U;
+        if ((sh.remaining == 0U) && resume(0U))
+            return 1U;
+        break;
+    case SYS_READC:
+        if ((tud_cdc_available() != 0U) && resume((uint32_t)tud_cdc_read_char()))
+            return 1U;
+        break;
+    default:
+        break;
+    }
+    return done;
+}
+
+/* Sets C_DEBUGEN unless the target or a debugger has already done so */
+static void enable(void)
+{
+    uint32_t value;
+
+    if (Target_Read32(DBG_HCSR, &value) != DAP_TRANSFER_OK)
+        return;
+    if ((value & C_DEBUGEN) == 0U) {
+        if (Target_Write32(DBG_HCSR, DBGKEY | C_DEBUGEN) != DAP_TRANSFER_OK)
+            return;
+        sh.debugen = 1U;
+    }
+    sh.open = 1U;
+}
+
+/*
+ * Ends semihosting: an operation in progress fails, C_DEBUGEN set by the
+ * probe is cleared again so a later BKPT faults as without a debugger. A
+ * host session keeps C_DEBUGEN, the GDB server gets the target untouched.
+ */
+static void finish(uint32_t touch)
+{
+    Target_Host_t host;
+
+    if (touch && ((sh.op != 0U) || sh.debugen)) {
+        if (Target_Begin(&host) == DAP_TRANSFER_OK) {
+            if (sh.op != 0U)
+                (void)resume(0xFFFFFFFFU);
+            if (sh.debugen && !host.session)
+                (void)Target_Write32(DBG_HCSR, DBGKEY);
+        }
+        Target_End(&host);
+    }
+    Target_Release();
+    sh.open    = 0U;
+    sh.op      = 0U;
+    sh.debugen = 0U;
+}
+
+/**
+ * @brief Serve semihosting halts of the target when a poll is due.
+ *
+ * Opening the CDC port sets C_DEBUGEN in the target, without it a BKPT
+ * escalates to HardFault instead of halting the core. Closing it clears
+ * C_DEBUGEN again.
+ *
+ * @return Microseconds until the next poll, 0 when the CDC port is closed.
+ */
+uint32_t semihost_task(void)
+{
+    Target_Host_t host;
+    uint32_t elapsed;
+
+    if (!tud_cdc_connected() || gdb_server_active()) {
+        if (sh.open)
+            finish(!gdb_server_active());
+        return 0U;
+    }
+
+    elapsed = hw_timer_elapsed(sh.last);
+    if (elapsed < sh.interval)
+        return sh.interval - elapsed;
+    sh.last = hw_timer_now();
+
+    if (Target_Begin(&host) != DAP_TRANSFER_OK) {
+        sh.interval = POLL_MAX_US;
+    } else {
+        if (!sh.open)
+            enable();
+        if (sh.open && service()) {
+            sh.interval = POLL_MIN_US;
+        } else {
+            sh.interval = (sh.interval < POLL_MIN_US) ? POLL_MIN_US : (sh.interval * 2U);
+            if (sh.interval > POLL_MAX_US)
+                sh.interval = POLL_MAX_US;
+        }
+    }
+    Target_End(&host);
+
+    return sh.interval;
+}
@@ -0,0 +1,14 @@
+#ifndef _SEMIHOST_H_
+#define _SEMIHOST_H_
+
+#include <stdint.h>
+
+/*
+ * Services semihosting console calls of the target through the CDC port
+ * while it is open, between the commands of a host session as well, call
+ * from the USB thread. Returns the microseconds until the next poll is due,
+ * 0 when not polling.
+ */
+extern uint32_t semihost_task(void);
+
+#endif
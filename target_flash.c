@@ -0,0 +1,134 @@
+#include "NUC100Series.h"
+#include "board_config.h"
+#include "DAP_config.h"
+#include "DAP.h"
+#include "target_flash.h"
+
+/*
+ * The target is a NuMicro with the same system and flash controller layout
+ * as the probe, so its FMC is driven directly over SWD with the BSP bit
+ * definitions instead of downloading a flash algorithm into target RAM.
+ */
+#define TARGET_REGWRPROT    (GCR_BASE + 0x100U)
+#define TARGET_AHBCLK       (CLK_BASE + 0x04U)
+#define TARGET_ISPCON       (FMC_BASE + 0x00U)
+#define TARGET_ISPADR       (FMC_BASE + 0x04U)
+#define TARGET_ISPTRG       (FMC_BASE + 0x10U)
+
+/* ISP trigger polls, a page erase takes about 20 ms */
+#define ISP_POLLS           20000U
+
+/* Words read back per verify transfer */
+#define VERIFY_WORDS        16U
+
+#define ERASED              0xFFFFFFFFU
+
+/*
+ * Runs one ISP command. ISPADR, ISPDAT, ISPCMD and ISPTRG are consecutive,
+ * so the command is a single four word block write.
+ */
+static int32_t isp_command(uint32_t cmd, uint32_t addr, uint32_t data)
+{
+    uint32_t block[4];
+    uint32_t value;
+    uint32_t n;
+
+    block[0] = addr;
+    block[1] = data;
+    block[2] = cmd;
+    block[3] = FMC_ISPTRG_ISPGO_Msk;
+    if (Target_WriteMem(TARGET_ISPADR, block, 4U) != DAP_TRANSFER_OK)
+        return -1;
+
+    for (n = 0U; n < ISP_POLLS; n++) {
+        if (Target_Read32(TARGET_ISPTRG, &value) != DAP_TRANSFER_OK)
+            return -1;
+        if ((value & FMC_ISPTRG_ISPGO_Msk) == 0U)
+            break;
+    }
+    if (n == ISP_POLLS)
+        return -1;
+
+    /* ISPFF is set on a failed command and cleared by writing one */
+    if (Target_Read32(TARGET_ISPCON, &value) != DAP_TRANSFER_OK)
+        return -1;
+    if (value & FMC_ISPCON_ISPFF_Msk) {
+        (void)Target_Write32(TARGET_ISPCON, value);
+        return -1;
+    }
+    return 0;
+}
+
+int32_t target_flash_init(void)
+{
+    uint32_t value;
+
+    if ((Target_Connect(NULL) != DAP_TRANSFER_OK) ||
+        (Target_ResetHalt() != DAP_TRANSFER_OK))
+        return -1;
+
+    /* Unlock protected registers, enable the ISP clock and APROM updates */
+    if ((Target_Write32(TARGET_REGWRPROT, 0x59U) != DAP_TRANSFER_OK) ||
+        (Target_Write32(TARGET_REGWRPROT, 0x16U) != DAP_TRANSFER_OK) ||
+        (Target_Write32(TARGET_REGWRPROT, 0x88U) != DAP_TRANSFER_OK) ||
+        (Target_Read32(TARGET_AHBCLK, &value) != DAP_TRANSFER_OK) ||
+        (Target_Write32(TARGET_AHBCLK, value | CLK_AHBCLK_ISP_EN_Msk) != DAP_TRANSFER_OK) ||
+        (Target_Read32(TARGET_ISPCON, &value) != DAP_TRANSFER_OK))
+        return -1;
+
+    value |= FMC_ISPCON_ISPEN_Msk | FMC_ISPCON_APUEN_Msk | FMC_ISPCON_ISPFF_Msk;
+    if (Target_Write32(TARGET_ISPCON, value) != DAP_TRANSFER_OK)
+        return -1;
+
+    return 0;
+}
+
+int32_t target_flash_erase(uint32_t addr)
+{
+    return isp_command(FMC_ISPCMD_PAGE_ERASE, addr, 0U);
+}
+
+int32_t target_flash_program(uint32_t addr, const uint32_t *data, uint32_t words)
+{
+    uint32_t readback[VERIFY_WORDS];
+    uint32_t count;
+    uint32_t n;
+
+    /*
+     * Erased words are left alone, padding costs no ISP cycles and words
+     * programmed by an earlier visit of the page are kept.
+     */
+    for (n = 0U; n < words; n++) {
+        if ((data[n] != ERASED) && (isp_command(FMC_ISPCMD_PROGRAM, addr + (n * 4U), data[n]) != 0))
+            return -1;
+    }
+
+    while (words != 0U) {
+        count = (words < VERIFY_WORDS) ? words : VERIFY_WORDS;
+        if (Target_ReadMem(addr, readback, count) != DAP_TRANSFER_OK)
+            return -1;
+        for (n = 0U; n < count; n++) {
+            if ((data[n] != ERASED) && (readback[n] != data[n]))
+                return -1;
+        }
+        addr  += count * 4U;
+        data  += count;
+        words -= count;
+    }
+    return 0;
+}
+
+void target_flash_end(void)
+{
+    uint32_t value;
+
+    if (Target_Read32(TARGET_ISPCON, &value) == DAP_TRANSFER_OK)
+        (void)Target_Write32(TARGET_ISPCON, value & ~(FMC_ISPCON_ISPEN_Msk | FMC_ISPCON_APUEN_Msk));
+}
+
+void target_flash_uninit(void)
+{
+    target_flash_end();
+    (void)Target_ResetRun();
+    Target_Disconnect();
+}
@@ -0,0 +1,21 @@
+#ifndef _TARGET_FLASH_H_
+#define _TARGET_FLASH_H_
+
+#include <stdint.h>
+
+/* Connects, halts the target and enables its flash controller, returns 0 or -1 */
+extern int32_t target_flash_init(void);
+
+/* Erases the flash page at addr, returns 0 or -1 */
+extern int32_t target_flash_erase(uint32_t addr);
+
+/* Programs and verifies the words at addr that are not 0xFFFFFFFF, returns 0 or -1 */
+extern int32_t target_flash_program(uint32_t addr, const uint32_t *data, uint32_t words);
+
+/* Disables the flash controller, the target stays connected and halted */
+extern void target_flash_end(void);
+
+/* Ends programming like target_flash_end, then resets the target into the new image and releases SWD */
+extern void target_flash_uninit(void);
+
+#endif
@@ -0,0 +1,205 @@
+/*
+ * Host benchmark of DAP_Transfer: time per transfer for request mixes a
+ * debugger sends, on a target that answers every transfer at once, so that
+ * only the request decoding and execution in DAP.c is measured.
+ *
+ *   bench_transfer [iterations]
+ *
+ * Host numbers only compare versions of DAP.c with each other, the probe
+ * spends most of a transfer on the wire.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "DAP_config.h"
+#include "DAP.h"
+
+uint32_t test_time_us;
+
+// Target: AP registers of one bank, DP reads return IDCODE
+static uint32_t Ap[4];
+static uint32_t Rdbuff;
+static uint32_t Wire;
+
+uint8_t SWD_Transfer (uint32_t request, uint32_t *data) {
+  uint32_t reg = (request >> 2) & 3U;
+
+  Wire++;
+  if ((request & DAP_TRANSFER_APnDP) != 0U) {
+    if ((request & DAP_TRANSFER_RnW) != 0U) {
+      if (data != NULL) {
+        *data = Rdbuff;
+      }
+      Rdbuff = Ap[reg];
+    } else {
+      Ap[reg] = *data;
+    }
+  } else if ((request & DAP_TRANSFER_RnW) != 0U) {
+    if (data != NULL) {
+      *data = (reg == 3U) ? Rdbuff : 0x0BB11477U;
+    }
+  }
+  return (DAP_TRANSFER_OK);
+}
+
+void SWD_Sequence (uint32_t info, const uint8_t *swdo, uint8_t *swdi) {
+  (void)info; (void)swdo;
+  if (swdi != NULL) {
+    *swdi = 0U;
+  }
+}
+
+void SWJ_Sequence (uint32_t count, const uint8_t *data) {
+  (void)count; (void)data;
+}
+
+void SWD_Idle (uint32_t cycles) {
+  (void)cycles;
+}
+
+void Target_Release (void) {}
+
+void DAP_TuneConnect (void) {}
+void DAP_TuneDisconnect (void) {}
+uint32_t DAP_TuneClock (uint32_t clock) { return (clock); }
+void DAP_TuneTransfer (void) {}
+
+#define RD_DP(a)   (DAP_TRANSFER_RnW | (a))
+#define WR_DP(a)   (a)
+#define RD_AP(a)   (DAP_TRANSFER_RnW | DAP_TRANSFER_APnDP | (a))
+#define WR_AP(a)   (DAP_TRANSFER_APnDP | (a))
+
+typedef struct {
+  uint8_t  data[DAP_PACKET_SIZE];
+  uint32_t length;
+  uint32_t count;
+} Request_t;
+
+static void request_start (Request_t *r) {
+  r->data[0] = ID_DAP_Transfer;
+  r->data[1] = 0U;
+  r->length  = 3U;
+  r->count   = 0U;
+}
+
+static void request_add (Request_t *r, uint32_t request, uint32_t data) {
+  r->data[r->length++] = (uint8_t)request;
+  if ((request & (DAP_TRANSFER_RnW | DAP_TRANSFER_MATCH_VALUE)) != DAP_TRANSFER_RnW) {
+    r->data[r->length++] = (uint8_t) data;
+    r->data[r->length++] = (uint8_t)(data >>  8);
+    r->data[r->length++] = (uint8_t)(data >> 16);
+    r->data[r->length++] = (uint8_t)(data >> 24);
+  }
+  r->data[2] = (uint8_t)++r->count;
+}
+
+// Block read: SELECT, CSW and TAR, then 64 words through DRW
+static void mix_read (Request_t *r) {
+  uint32_t n;
+
+  request_start(r);
+  request_add(r, WR_DP(DP_SELECT), 0U);
+  request_add(r, WR_AP(AP_CSW), 0x23000012U);
+  request_add(r, WR_AP(AP_TAR), 0x20000000U);
+  for (n = 0U; n < 64U; n++) {
+    request_add(r, RD_AP(AP_DRW), 0U);
+  }
+}
+
+// Block write: TAR, then 64 words through DRW
+static void mix_write (Request_t *r) {
+  uint32_t n;
+
+  request_start(r);
+  request_add(r, WR_AP(AP_TAR), 0x20000000U);
+  for (n = 0U; n < 64U; n++) {
+    request_add(r, WR_AP(AP_DRW), n);
+  }
+}
+
+// Core register reads: DCRSR write, DHCSR poll for S_REGRDY, DCRDR read
+static void mix_core (Request_t *r) {
+  uint32_t n;
+
+  request_start(r);
+  request_add(r, WR_DP(DP_RDBUFF) | DAP_TRANSFER_MATCH_MASK, 0U);
+  for (n = 0U; n < 12U; n++) {
+    request_add(r, WR_AP(AP_TAR), DBG_CRSR);
+    request_add(r, WR_AP(AP_DRW), n);
+    request_add(r, WR_AP(AP_TAR), DBG_HCSR);
+    request_add(r, RD_AP(AP_DRW) | DAP_TRANSFER_MATCH_VALUE, 0U);
+    request_add(r, WR_AP(AP_TAR), DBG_CRDR);
+    request_add(r, RD_AP(AP_DRW), 0U);
+  }
+}
+
+// Connect and status polling: DP reads between AP reads
+static void mix_status (Request_t *r) {
+  uint32_t n;
+
+  request_start(r);
+  for (n = 0U; n < 24U; n++) {
+    request_add(r, RD_DP(DP_IDCODE), 0U);
+    request_add(r, RD_DP(DP_CTRL_STAT), 0U);
+    request_add(r, RD_AP(AP_CSW), 0U);
+    request_add(r, RD_AP(AP_DRW), 0U);
+  }
+}
+
+static const struct {
+  const char *name;
+  void (*build) (Request_t *r);
+} Mixes[] = {
+  { "block read",  mix_read   },
+  { "block write", mix_write  },
+  { "core regs",   mix_core   },
+  { "status",      mix_status },
+};
+
+static double now_ns (void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (((double)ts.tv_sec * 1e9) + (double)ts.tv_nsec);
+}
+
+int main (int argc, char **argv) {
+  static uint8_t response[DAP_PACKET_SIZE];
+  Request_t request;
+  uint32_t iterations;
+  uint32_t num;
+  uint32_t i;
+  uint32_t m;
+  double start;
+  double ns;
+
+  iterations = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 0) : 200000U;
+
+  request.data[0] = ID_DAP_Connect;
+  request.data[1] = DAP_PORT_SWD;
+  (void)DAP_ProcessCommand(request.data, response);
+
+  for (m = 0U; m < (sizeof(Mixes) / sizeof(Mixes[0])); m++) {
+    Mixes[m].build(&request);
+    num = DAP_ProcessCommand(request.data, response);
+    if (((num >> 16) != request.length) || (response[1] != request.count) ||
+        (response[2] != DAP_TRANSFER_OK)) {
+      printf("bench_transfer: %s: request not executed\n", Mixes[m].name);
+      return (1);
+    }
+    Wire = 0U;
+    start = now_ns();
+    for (i = 0U; i < iterations; i++) {
+      (void)DAP_ProcessCommand(request.data, response);
+    }
+    ns = now_ns() - start;
+    printf("%-12s %3u transfers %8.1f ns/request %6.2f ns/transfer %5.2f wire/transfer\n",
+           Mixes[m].name, (unsigned)request.count, ns / iterations, ns / ((double)iterations * request.count),
+           (double)Wire / ((double)iterations * request.count));
+  }
+
+  return (0);
+}
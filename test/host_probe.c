@@ -0,0 +1,84 @@
+/*
+ * The DAP engine on the model target as a probe for the host tools: runs
+ * the requests on stdin, each after its length (2 bytes), and writes the
+ * responses to stdout the same way. Commands are processed and captured
+ * like the USB transport of main.c does it, with the host clock as the
+ * microsecond timer. A length of 0 resets the model target and connects.
+ *
+ *   host_probe     for test_script.py, test_replay.py and dap_replay.py --sim
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "DAP_config.h"
+#include "DAP.h"
+#include "target_model.h"
+
+uint32_t test_time_us;
+
+int32_t target_flash_init (void) { return (-1); }
+int32_t target_flash_erase (uint32_t addr) { (void)addr; return (-1); }
+int32_t target_flash_program (uint32_t addr, const uint32_t *data, uint32_t words) { (void)addr; (void)data; (void)words; return (-1); }
+void    target_flash_end (void) {}
+
+static uint8_t  Request [DAP_PACKET_SIZE];
+static uint8_t  Response[DAP_PACKET_SIZE];
+
+static void host_clock (void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  test_time_us = (uint32_t)(((uint64_t)ts.tv_sec * 1000000U) + ((uint64_t)ts.tv_nsec / 1000U));
+}
+
+static void host_connect (void) {
+  uint8_t request[2];
+
+  request[0] = ID_DAP_Connect;
+  request[1] = DAP_PORT_SWD;
+  (void)DAP_ProcessCommand(request, Response);
+}
+
+int main (void) {
+  uint8_t header[2];
+  uint32_t length;
+  uint32_t start;
+  uint32_t num;
+
+  host_clock();
+  DAP_Setup();
+  model_reset();
+  host_connect();
+
+  while (fread(header, 1U, 2U, stdin) == 2U) {
+    length = (uint32_t)header[0] | ((uint32_t)header[1] << 8);
+    if (length > DAP_PACKET_SIZE) {
+      return (1);
+    }
+    if (length == 0U) {
+      model_reset();
+      host_connect();
+      continue;
+    }
+    memset(Request, 0, sizeof(Request));
+    if (fread(Request, 1U, length, stdin) != length) {
+      return (1);
+    }
+
+    host_clock();
+    start = hw_timer_now();
+    num = DAP_ProcessCommand(Request, Response);
+    host_clock();
+    DAP_CaptureCommand(Request, Response, num, start);
+
+    num &= 0xFFFFU;
+    header[0] = (uint8_t)num;
+    header[1] = (uint8_t)(num >> 8);
+    fwrite(header, 1U, 2U, stdout);
+    fwrite(Response, 1U, num, stdout);
+    fflush(stdout);
+  }
+  return (0);
+}
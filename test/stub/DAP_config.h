@@ -0,0 +1,155 @@
+/*
+ * Host stand-in for DAP_config.h: the configuration of the firmware build
+ * without the NUC120 pins. The SWD wire is replaced by the SWD_Transfer,
+ * SWJ_Sequence and SWD_Sequence of the test, the timers by a counter the
+ * test advances.
+ */
+
+#ifndef __DAP_CONFIG_H__
+#define __DAP_CONFIG_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "cmsis_compiler.h"
+#include "hw_timer.h"
+#include "kv_store.h"
+#include "board_config.h"
+#include "target_flash.h"
+
+/* Timer of the test, in us */
+extern uint32_t test_time_us;
+
+#define CPU_CLOCK               48000000U
+#define IO_PORT_WRITE_CYCLES    2U
+#define DAP_RAMFUNC
+
+#define DAP_SWD                 1
+#define DAP_JTAG                0
+#define DAP_JTAG_DEV_CNT        0U
+#define DAP_DEFAULT_PORT        1U
+#define DAP_DEFAULT_SWJ_CLOCK   4000000U
+#define DAP_WAIT_ADAPTIVE       0U
+#define DAP_WAIT_BACKOFF_MAX    256U
+#define DAP_DOWNLOAD_WINDOW     8U
+#define DAP_SAMPLE_BUFFER_SIZE  256U
+#define DAP_ROM_CACHE_SIZE      256U
+#define DAP_SCRIPT_SIZE         256U
+#ifndef DAP_CAPTURE_BUFFER_SIZE
+#define DAP_CAPTURE_BUFFER_SIZE 0U
+#endif
+#define DAP_PACKET_SIZE         512U
+#define DAP_PACKET_COUNT        4U
+
+#define SWO_UART                0
+#define SWO_UART_DRIVER         0
+#define SWO_UART_MAX_BAUDRATE   10000000U
+#define SWO_MANCHESTER          0
+#define SWO_BUFFER_SIZE         4096U
+#define SWO_STREAM              0
+#define TIMESTAMP_CLOCK         0U
+
+#define DAP_UART                0
+#define DAP_UART_DRIVER         0
+#define DAP_UART_RX_BUFFER_SIZE 1024U
+#define DAP_UART_TX_BUFFER_SIZE 1024U
+#define DAP_UART_USB_COM_PORT   0
+
+#define TARGET_FIXED            0
+
+#define TARGET_TUNE_WORDS       2U
+
+#define DAP_SETTING_RESERVED             0x80000000U
+#define DAP_SETTING_SWJ_CLOCK            0x0001U
+#define DAP_SETTING_TARGET_DEVICE_VENDOR 0x0010U
+#define DAP_SETTING_TARGET_DEVICE_NAME   0x0011U
+#define DAP_SETTING_TARGET_BOARD_VENDOR  0x0012U
+#define DAP_SETTING_TARGET_BOARD_NAME    0x0013U
+
+__STATIC_INLINE uint32_t DAP_SETTING_LOAD (uint32_t key, void *value, uint32_t size) {
+  (void)key; (void)value; (void)size;
+  return (0U);
+}
+
+__STATIC_INLINE uint32_t DAP_SETTING_STORE (uint32_t key, const void *value, uint32_t length) {
+  (void)key; (void)value; (void)length;
+  return (0U);
+}
+
+__STATIC_INLINE uint8_t DAP_SETTING_STRING (uint32_t key, char *str) {
+  (void)key; (void)str;
+  return (0U);
+}
+
+__STATIC_INLINE uint8_t DAP_GetVendorString (char *str) { (void)str; return (0U); }
+__STATIC_INLINE uint8_t DAP_GetProductString (char *str) { (void)str; return (0U); }
+__STATIC_INLINE uint8_t DAP_GetSerNumString (char *str) { (void)str; return (0U); }
+__STATIC_INLINE uint8_t DAP_GetTargetDeviceVendorString (char *str) { (void)str; return (0U); }
+__STATIC_INLINE uint8_t DAP_GetTargetDeviceNameString (char *str) { (void)str; return (0U); }
+__STATIC_INLINE uint8_t DAP_GetTargetBoardVendorString (char *str) { (void)str; return (0U); }
+__STATIC_INLINE uint8_t DAP_GetTargetBoardNameString (char *str) { (void)str; return (0U); }
+__STATIC_INLINE uint8_t DAP_GetProductFirmwareVersionString (char *str) { (void)str; return (0U); }
+
+__STATIC_INLINE void PORT_JTAG_SETUP (void) {}
+__STATIC_INLINE void PORT_SWD_SETUP (void) {}
+__STATIC_INLINE void PORT_OFF (void) {}
+
+__STATIC_FORCEINLINE uint32_t PIN_SWCLK_TCK_IN  (void) { return (0U); }
+__STATIC_FORCEINLINE void     PIN_SWCLK_TCK_SET (void) {}
+__STATIC_FORCEINLINE void     PIN_SWCLK_TCK_CLR (void) {}
+__STATIC_FORCEINLINE uint32_t PIN_SWDIO_TMS_IN  (void) { return (1U); }
+__STATIC_FORCEINLINE void     PIN_SWDIO_TMS_SET (void) {}
+__STATIC_FORCEINLINE void     PIN_SWDIO_TMS_CLR (void) {}
+__STATIC_FORCEINLINE uint32_t PIN_SWDIO_IN      (void) { return (1U); }
+__STATIC_FORCEINLINE void     PIN_SWDIO_OUT     (uint32_t bit) { (void)bit; }
+__STATIC_FORCEINLINE void     PIN_SWDIO_OUT_ENABLE  (void) {}
+__STATIC_FORCEINLINE void     PIN_SWDIO_OUT_DISABLE (void) {}
+__STATIC_FORCEINLINE uint32_t PIN_TDI_IN  (void) { return (0U); }
+__STATIC_FORCEINLINE void     PIN_TDI_OUT (uint32_t bit) { (void)bit; }
+__STATIC_FORCEINLINE uint32_t PIN_TDO_IN  (void) { return (0U); }
+__STATIC_FORCEINLINE uint32_t PIN_nTRST_IN   (void) { return (1U); }
+__STATIC_FORCEINLINE void     PIN_nTRST_OUT  (uint32_t bit) { (void)bit; }
+__STATIC_FORCEINLINE uint32_t PIN_nRESET_IN  (void) { return (1U); }
+__STATIC_FORCEINLINE void     PIN_nRESET_OUT (uint32_t bit) { (void)bit; }
+
+__STATIC_INLINE void LED_CONNECTED_OUT (uint32_t bit) { (void)bit; }
+__STATIC_INLINE void LED_RUNNING_OUT (uint32_t bit) { (void)bit; }
+
+__STATIC_INLINE uint32_t TIMESTAMP_GET (void) { return (0U); }
+
+__STATIC_INLINE uint32_t DELAY_TIMER_GET (void) { return (test_time_us); }
+__STATIC_INLINE uint32_t DELAY_TIMER_ELAPSED (uint32_t start) { return (test_time_us - start); }
+
+#define DELAY_YIELD_THRESHOLD   10000U
+__STATIC_INLINE uint32_t DELAY_YIELD (uint32_t delay) { (void)delay; return (0U); }
+
+__STATIC_INLINE uint32_t TARGET_TUNE_LOAD (uint32_t dpidr, uint32_t targetid, uint32_t *data) {
+  (void)dpidr; (void)targetid; (void)data;
+  return (0U);
+}
+
+__STATIC_INLINE uint32_t TARGET_TUNE_SAVE (uint32_t dpidr, uint32_t targetid, const uint32_t *data) {
+  (void)dpidr; (void)targetid; (void)data;
+  return (0U);
+}
+
+/* Target flash of the test, see target_flash.h */
+__STATIC_INLINE uint32_t TARGET_FLASH_INIT (void) {
+  return ((target_flash_init() == 0) ? 1U : 0U);
+}
+
+__STATIC_INLINE uint32_t TARGET_FLASH_ERASE (uint32_t addr) {
+  return ((target_flash_erase(addr) == 0) ? 1U : 0U);
+}
+
+__STATIC_INLINE uint32_t TARGET_FLASH_PROGRAM (uint32_t addr, const uint32_t *data, uint32_t words) {
+  return ((target_flash_program(addr, data, words) == 0) ? 1U : 0U);
+}
+
+__STATIC_INLINE void TARGET_FLASH_END (void) {
+  target_flash_end();
+}
+
+__STATIC_INLINE void DAP_SETUP (void) {}
+__STATIC_INLINE uint8_t RESET_TARGET (void) { return (0U); }
+
+#endif /* __DAP_CONFIG_H__ */
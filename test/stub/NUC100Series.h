@@ -0,0 +1,22 @@
+/*
+ * Host stand-in for the device header: the FMC calls of the data flash
+ * store, implemented by the test on a RAM copy that kv_flash_base() points at.
+ */
+
+#ifndef __NUC100SERIES_H__
+#define __NUC100SERIES_H__
+
+#include <stdint.h>
+
+#include "cmsis_compiler.h"
+
+#define FMC_FLASH_PAGE_SIZE     512
+
+extern void FMC_Open(void);
+extern void FMC_Close(void);
+extern int32_t FMC_Write(uint32_t u32addr, uint32_t u32data);
+extern int32_t FMC_Erase(uint32_t u32addr);
+extern int32_t FMC_ReadConfig(uint32_t *u32Config, uint32_t u32Count);
+extern uint32_t FMC_ReadDataFlashBaseAddr(void);
+
+#endif
@@ -0,0 +1,25 @@
+/*
+ * Host stand-in for the CMSIS compiler header: the compiler macros and the
+ * few intrinsics the DAP sources use.
+ */
+
+#ifndef __CMSIS_COMPILER_H
+#define __CMSIS_COMPILER_H
+
+#include <stdint.h>
+
+#define __STATIC_INLINE         static inline
+#define __STATIC_FORCEINLINE    static inline
+#define __WEAK                  __attribute__((weak))
+#define __INLINE                inline
+#define __NOP()                 ((void)0)
+
+/* DAP.h selects its C delay loop for __CC_ARM, the host build uses it too */
+#define __CC_ARM
+
+static inline uint32_t __get_PRIMASK (void) { return (0U); }
+static inline void __set_PRIMASK (uint32_t primask) { (void)primask; }
+static inline void __disable_irq (void) {}
+static inline void __enable_irq (void) {}
+
+#endif
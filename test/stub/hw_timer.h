@@ -0,0 +1,26 @@
+/*
+ * Host stand-in for hw_timer.h: the free-running microsecond timer is the
+ * counter the test advances.
+ */
+
+#ifndef _HW_TIMER_H_
+#define _HW_TIMER_H_
+
+#include <stdint.h>
+
+#define HW_TIMER_CLOCK      1000000U
+#define HW_TIMER_MASK       0x00FFFFFFU
+
+extern uint32_t test_time_us;
+
+static inline uint32_t hw_timer_now(void)
+{
+    return test_time_us & HW_TIMER_MASK;
+}
+
+static inline uint32_t hw_timer_elapsed(uint32_t since)
+{
+    return (test_time_us - since) & HW_TIMER_MASK;
+}
+
+#endif
@@ -0,0 +1,21 @@
+/*
+ * Host stand-in for tusb.h: the CDC calls of the GDB server, implemented by
+ * the test as the host end of the port.
+ */
+
+#ifndef _TUSB_H_
+#define _TUSB_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+extern bool     tud_cdc_connected(void);
+extern uint32_t tud_cdc_available(void);
+extern uint32_t tud_cdc_read(void *buffer, uint32_t bufsize);
+extern bool     tud_cdc_peek(uint8_t *ui8);
+extern uint32_t tud_cdc_write(void const *buffer, uint32_t bufsize);
+extern uint32_t tud_cdc_write_char(char ch);
+extern uint32_t tud_cdc_write_flush(void);
+extern uint32_t tud_cdc_write_available(void);
+
+#endif
@@ -0,0 +1,246 @@
+/*
+ * Model SWD target, see target_model.h. AP reads are posted like on the
+ * wire: a DRW or banked register read returns the previous AP read and
+ * RDBUFF the last one.
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "DAP_config.h"
+#include "DAP.h"
+#include "target_model.h"
+
+Model_t Model;
+
+static uint32_t get32 (const uint8_t *p) {
+  return ((uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+}
+
+static void put32 (uint8_t *p, uint32_t value) {
+  p[0] = (uint8_t)value;
+  p[1] = (uint8_t)(value >> 8);
+  p[2] = (uint8_t)(value >> 16);
+  p[3] = (uint8_t)(value >> 24);
+}
+
+void model_reset (void) {
+  memset(&Model, 0, sizeof(Model));
+  Model.csw = 0x23000002U;
+}
+
+static uint32_t *model_word (uint32_t address, int create) {
+  uint32_t n;
+
+  for (n = 0U; n < Model.words; n++) {
+    if (Model.address[n] == address) {
+      return (&Model.value[n]);
+    }
+  }
+  if (!create || (Model.words == MODEL_WORDS_MAX)) {
+    return (NULL);
+  }
+  Model.address[Model.words] = address;
+  Model.value[Model.words] = 0U;
+  return (&Model.value[Model.words++]);
+}
+
+uint32_t model_read (uint32_t address) {
+  uint32_t *word;
+  uint32_t value;
+
+  address &= ~3U;
+  if (address < MODEL_FLASH_SIZE) {
+    return (get32(&Model.flash[address]));
+  }
+  if ((address >= MODEL_RAM_BASE) && (address < (MODEL_RAM_BASE + MODEL_RAM_SIZE))) {
+    return (get32(&Model.ram[address - MODEL_RAM_BASE]));
+  }
+  switch (address) {
+    case DBG_HCSR:
+      Model.dhcsr_reads++;
+      if ((Model.dhcsr & S_HALT) == 0U) {
+        Model.sticky |= S_RETIRE_ST;
+      }
+      value = (Model.dhcsr & (S_HALT | 0x0FU)) | S_REGRDY | Model.sticky;
+      Model.sticky = 0U;
+      return (value);
+    case DBG_CRSR:
+      return (Model.dcrsr);
+    case DBG_CRDR:
+      return (Model.dcrdr);
+    case DBG_EMCR:
+      return (Model.demcr);
+  }
+  word = model_word(address, 0);
+  return ((word != NULL) ? *word : 0U);
+}
+
+void model_write (uint32_t address, uint32_t value) {
+  uint32_t *word;
+
+  address &= ~3U;
+  if (address < MODEL_FLASH_SIZE) {
+    put32(&Model.flash[address], value);
+    return;
+  }
+  if ((address >= MODEL_RAM_BASE) && (address < (MODEL_RAM_BASE + MODEL_RAM_SIZE))) {
+    put32(&Model.ram[address - MODEL_RAM_BASE], value);
+    return;
+  }
+  switch (address) {
+    case DBG_HCSR:
+      if ((value & 0xFFFF0000U) != DBGKEY) {
+        return;
+      }
+      if ((value & C_HALT) != 0U) {
+        Model.dhcsr = (value & 0x0FU) | S_HALT;
+      } else if (((value & C_STEP) != 0U) && ((Model.dhcsr & S_HALT) != 0U)) {
+        Model.dhcsr = (value & 0x0FU) | S_HALT;
+        Model.reg[15] += 2U;
+        Model.sticky |= S_RETIRE_ST;
+      } else {
+        Model.dhcsr = value & 0x0FU;
+      }
+      return;
+    case DBG_CRSR:
+      Model.dcrsr = value;
+      if ((value & REGWnR) != 0U) {
+        Model.reg[value & 0x1FU] = Model.dcrdr;
+      } else {
+        Model.dcrdr = Model.reg[value & 0x1FU];
+      }
+      return;
+    case DBG_CRDR:
+      Model.dcrdr = value;
+      return;
+    case DBG_EMCR:
+      Model.demcr = value;
+      return;
+    case NVIC_AIRCR:
+      if (((value & 0xFFFF0000U) == VECTKEY) && ((value & SYSRESETREQ) != 0U)) {
+        Model.resets++;
+        Model.sticky |= S_RESET_ST;
+        Model.reg[15] = get32(&Model.flash[4]) & ~1U;
+        if ((Model.demcr & VC_CORERESET) != 0U) {
+          Model.dhcsr |= S_HALT;
+        }
+      }
+      return;
+  }
+  word = model_word(address, 1);
+  if (word != NULL) {
+    *word = value;
+  }
+}
+
+// AP register read or write, A[7:4] from SELECT
+static uint32_t model_ap (uint32_t reg, uint32_t rnw, uint32_t data) {
+  uint32_t bank = Model.select & 0xF0U;
+  uint32_t value = 0U;
+
+  if (bank == 0x10U) {
+    // Banked data registers at TAR[31:4]
+    if (rnw) {
+      return (model_read((Model.tar & ~0x0FU) | reg));
+    }
+    model_write((Model.tar & ~0x0FU) | reg, data);
+    return (0U);
+  }
+  if (bank == 0xF0U) {
+    return ((reg == 0x0CU) ? 0x04770021U : 0U);
+  }
+  switch (reg) {
+    case AP_CSW:
+      if (rnw) {
+        return (Model.csw);
+      }
+      Model.csw = data;
+      break;
+    case AP_TAR:
+      if (rnw) {
+        return (Model.tar);
+      }
+      Model.tar = data;
+      Model.tar_writes++;
+      break;
+    case AP_DRW:
+      if (rnw) {
+        value = model_read(Model.tar);
+      } else {
+        model_write(Model.tar, data);
+      }
+      if ((Model.csw & 0x30U) == 0x10U) {
+        Model.tar = (Model.tar & ~0x3FFU) | ((Model.tar + 4U) & 0x3FFU);
+      }
+      break;
+  }
+  return (value);
+}
+
+uint8_t SWD_Transfer (uint32_t request, uint32_t *data) {
+  uint32_t reg = request & 0x0CU;
+  uint32_t rnw = request & DAP_TRANSFER_RnW;
+  uint32_t value;
+
+  Model.transfers++;
+  if ((Model.waits != 0U) && (Model.transfers >= Model.wait_from)) {
+    Model.waits--;
+    return (DAP_TRANSFER_WAIT);
+  }
+
+  if ((request & DAP_TRANSFER_APnDP) != 0U) {
+    value = model_ap(reg, rnw, (rnw || (data == NULL)) ? 0U : *data);
+    if (rnw) {
+      if (data != NULL) {
+        *data = Model.rdbuff;
+      }
+      Model.rdbuff = value;
+    }
+    return (DAP_TRANSFER_OK);
+  }
+
+  if (rnw) {
+    switch (reg) {
+      case DP_IDCODE:    value = MODEL_IDCODE; break;
+      case DP_CTRL_STAT: value = Model.ctrl_stat | ((Model.ctrl_stat & (DP_CTRL_CSYSPWRUPREQ | DP_CTRL_CDBGPWRUPREQ)) << 1); break;
+      case DP_RDBUFF:    value = Model.rdbuff; break;
+      default:           value = 0U; break;
+    }
+    if (data != NULL) {
+      *data = value;
+    }
+  } else {
+    switch (reg) {
+      case DP_ABORT:
+        // STKCMPCLR, STKERRCLR, WDERRCLR, ORUNERRCLR
+        Model.ctrl_stat &= ~(((*data & 0x02U) << 3) | ((*data & 0x04U) << 3) |
+                             ((*data & 0x08U) << 4) | ((*data & 0x10U) >> 3));
+        break;
+      case DP_CTRL_STAT: Model.ctrl_stat = *data; break;
+      case DP_SELECT:    Model.select    = *data; break;
+      default:                                    break;
+    }
+  }
+  return (DAP_TRANSFER_OK);
+}
+
+void SWD_Sequence (uint32_t info, const uint8_t *swdo, uint8_t *swdi) {
+  (void)info; (void)swdo;
+  if (swdi != NULL) {
+    *swdi = 0U;
+  }
+}
+
+void SWJ_Sequence (uint32_t count, const uint8_t *data) {
+  (void)count; (void)data;
+  Model.sequences++;
+}
+
+void SWD_Idle (uint32_t cycles) {
+  (void)cycles;
+}
+
+int model_host_intact (uint32_t select, uint32_t csw, uint32_t tar) {
+  return ((Model.select == select) && (Model.csw == csw) && (Model.tar == tar));
+}
@@ -0,0 +1,59 @@
+/*
+ * Model SWD target for the probe side target access: a DP, MEM-AP 0 with
+ * CSW, TAR (auto-increment), DRW and the banked data registers, and a
+ * Cortex-M0 debug core behind it. Replaces SWD_Transfer, SWJ_Sequence,
+ * SWD_Sequence and SWD_Idle of the firmware.
+ */
+
+#ifndef TARGET_MODEL_H
+#define TARGET_MODEL_H
+
+#include <stdint.h>
+
+#define MODEL_IDCODE        0x0BB11477U
+#define MODEL_RAM_BASE      0x20000000U
+#define MODEL_RAM_SIZE      0x4000U
+#define MODEL_FLASH_SIZE    0x10000U
+#define MODEL_WORDS_MAX     256U
+
+typedef struct {
+  /* Debug Port */
+  uint32_t ctrl_stat;
+  uint32_t select;
+  uint32_t rdbuff;
+  /* MEM-AP 0 */
+  uint32_t csw;
+  uint32_t tar;
+  /* Core */
+  uint32_t dhcsr;               /* C_* bits and S_HALT */
+  uint32_t sticky;              /* S_RESET_ST and S_RETIRE_ST, cleared by a DHCSR read */
+  uint32_t dcrsr;
+  uint32_t dcrdr;
+  uint32_t demcr;
+  uint32_t reg[32];
+  uint32_t resets;              /* SYSRESETREQ writes */
+  uint32_t dhcsr_reads;
+  /* Memory */
+  uint8_t  flash[MODEL_FLASH_SIZE];
+  uint8_t  ram[MODEL_RAM_SIZE];
+  uint32_t address[MODEL_WORDS_MAX];  /* Other words, 0 unless set */
+  uint32_t value[MODEL_WORDS_MAX];
+  uint32_t words;
+  /* Wire */
+  uint32_t transfers;
+  uint32_t tar_writes;
+  uint32_t sequences;           /* SWJ sequences: line resets and the JTAG to SWD switch */
+  uint32_t wait_from;           /* Transfers from this one on answer WAIT ... */
+  uint32_t waits;               /* ... this many times */
+} Model_t;
+
+extern Model_t Model;
+
+extern void     model_reset (void);
+extern uint32_t model_read  (uint32_t address);
+extern void     model_write (uint32_t address, uint32_t value);
+
+/* SELECT, CSW and TAR still as the host set them */
+extern int      model_host_intact (uint32_t select, uint32_t csw, uint32_t tar);
+
+#endif /* TARGET_MODEL_H */
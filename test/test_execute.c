@@ -0,0 +1,271 @@
+/*
+ * Vendor commands run by DAP_ExecuteCommand: behind a DAP_Transfer that
+ * takes a growing part of the response, each command has to keep its
+ * response within the packet and report what it actually returned, and
+ * commands that would not get their fixed part are not run.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "DAP_config.h"
+#include "DAP.h"
+#include "target_model.h"
+
+uint32_t test_time_us;
+
+static int failed;
+
+#define CHECK(cond) do { if (!(cond)) { printf("%s:%d: %s\n", __FILE__, __LINE__, #cond); failed++; } } while (0)
+
+#define GUARD           0xA5U
+#define GUARD_SIZE      64U
+#define FILLER_MAX      126U            // IDCODE reads that fit behind the header
+
+// Target flash is not programmed by these tests
+int32_t target_flash_init (void) { return (-1); }
+int32_t target_flash_erase (uint32_t addr) { (void)addr; return (-1); }
+int32_t target_flash_program (uint32_t addr, const uint32_t *data, uint32_t words) { (void)addr; (void)data; (void)words; return (-1); }
+void    target_flash_end (void) {}
+
+static uint8_t  Request [DAP_PACKET_SIZE];
+static uint8_t  Response[DAP_PACKET_SIZE + GUARD_SIZE];
+
+static void put32 (uint8_t *p, uint32_t value) {
+  p[0] = (uint8_t)value;
+  p[1] = (uint8_t)(value >> 8);
+  p[2] = (uint8_t)(value >> 16);
+  p[3] = (uint8_t)(value >> 24);
+}
+
+static uint32_t get16 (const uint8_t *p) {
+  return ((uint32_t)p[0] | ((uint32_t)p[1] << 8));
+}
+
+static uint32_t command (const uint8_t *request) {
+  memset(Response, GUARD, sizeof(Response));
+  return (DAP_ProcessCommand(request, Response));
+}
+
+// Vendor command under test: writes its request, returns its length
+typedef uint32_t (*Build_t) (uint8_t *request);
+
+// Length the response of the command has to have according to its own header
+typedef uint32_t (*Length_t) (const uint8_t *response);
+
+static uint32_t rle_build (uint8_t *request) {
+  request[0] = ID_DAP_ReadRLE;
+  put32(&request[1], MODEL_RAM_BASE);
+  request[5] = 0xFFU;
+  request[6] = 0x00U;
+  return (7U);
+}
+
+static uint32_t rle_length (const uint8_t *response) {
+  // Random RAM does not compress, the response is raw
+  return ((response[4] == 0U) ? (5U + (4U * get16(&response[2]))) : 0U);
+}
+
+static uint32_t scatter_build (uint8_t *request) {
+  uint32_t n;
+
+  request[0] = ID_DAP_ReadScatter;
+  request[1] = 40U;
+  for (n = 0U; n < 40U; n++) {
+    put32(&request[2U + (5U * n)], MODEL_RAM_BASE + (n * 0x40U));
+    request[6U + (5U * n)] = 8U;
+  }
+  return (2U + (5U * 40U));
+}
+
+static uint32_t scatter_length (const uint8_t *response) {
+  return ((response[1] == DAP_OK) ? (3U + (8U * response[2])) : 3U);
+}
+
+static uint32_t core_read_build (uint8_t *request) {
+  request[0] = ID_DAP_CoreRead;
+  put32(&request[1], 0x0001FFFFU);
+  model_write(DBG_HCSR, DBGKEY | C_DEBUGEN | C_HALT);
+  return (5U);
+}
+
+static uint32_t core_read_length (const uint8_t *response) {
+  return ((response[1] == DAP_OK) ? (2U + (4U * 17U)) : 2U);
+}
+
+static uint32_t core_step_build (uint8_t *request) {
+  request[0] = ID_DAP_CoreStep;
+  request[1] = 0U;
+  put32(&request[2], 0x00001FFFU);
+  model_write(DBG_HCSR, DBGKEY | C_DEBUGEN | C_HALT);
+  return (6U);
+}
+
+static uint32_t core_step_length (const uint8_t *response) {
+  return ((response[1] == DAP_OK) ? (2U + 16U + (4U * 13U)) : 2U);
+}
+
+// ROM table at BASE 0 listing 40 components, more than a response holds behind DAP_Transfer
+static uint32_t rom_build (uint8_t *request) {
+  uint32_t n;
+
+  model_write(0xFF0U, 0x0DU);
+  model_write(0xFF4U, 0x10U);
+  model_write(0xFF8U, 0x05U);
+  model_write(0xFFCU, 0xB1U);
+  for (n = 0U; n < 40U; n++) {
+    model_write(n * 4U, (0x10000U + (n * 0x1000U)) | 1U);
+  }
+  request[0] = ID_DAP_RomDiscover;
+  memset(&request[1], 0, 7U);
+  request[2] = 1U;
+  return (8U);
+}
+
+static uint32_t rom_length (const uint8_t *response) {
+  return (6U + (16U * response[5]));
+}
+
+// Sampling 8 words, the buffer holds 7 records of 36 bytes
+static void sample_start (void) {
+  uint8_t request[6U + (8U * 5U)];
+  uint32_t n;
+
+  request[0] = ID_DAP_SampleConfigure;
+  put32(&request[1], 1000U);
+  request[5] = 8U;
+  for (n = 0U; n < 8U; n++) {
+    put32(&request[6U + (5U * n)], MODEL_RAM_BASE + (n * 4U));
+    request[10U + (5U * n)] = 4U;
+  }
+  CHECK(command(request) == (((6U + (8U * 5U)) << 16) | 5U));
+  CHECK(Response[1] == DAP_OK);
+}
+
+static uint32_t sample_build (uint8_t *request) {
+  uint32_t n;
+
+  for (n = 0U; n < 8U; n++) {
+    test_time_us += 1000U;
+    (void)DAP_SampleTask();
+  }
+  request[0] = ID_DAP_SampleRead;
+  return (1U);
+}
+
+static uint32_t sample_length (const uint8_t *response) {
+  return (9U + (36U * response[8]));
+}
+
+static void event_start (void) {
+  uint8_t request[6];
+
+  request[0] = ID_DAP_EventConfigure;
+  put32(&request[1], 1000U);
+  request[5] = 0x03U;
+  CHECK(command(request) == ((6U << 16) | 6U));
+  CHECK(Response[1] == DAP_OK);
+}
+
+static uint32_t event_build (uint8_t *request) {
+  uint32_t n;
+
+  for (n = 0U; n < 8U; n++) {
+    model_write(DBG_HCSR, DBGKEY | C_DEBUGEN | (((n & 1U) == 0U) ? C_HALT : 0U));
+    test_time_us += 1000U;
+    (void)DAP_EventTask();
+  }
+  request[0] = ID_DAP_EventRead;
+  request[1] = 0U;
+  request[2] = 0U;
+  return (3U);
+}
+
+static uint32_t event_length (const uint8_t *response) {
+  return (5U + (9U * response[4]));
+}
+
+// Runs the command behind DAP_Transfer of 0 to FILLER_MAX IDCODE reads
+static void sweep (const char *name, Build_t build, Length_t length) {
+  uint32_t filler;
+  uint32_t request_length;
+  uint32_t offset;
+  uint32_t num;
+  uint32_t n;
+
+  for (filler = 0U; filler <= FILLER_MAX; filler++) {
+    Request[0] = ID_DAP_ExecuteCommands;
+    Request[1] = 2U;
+    Request[2] = ID_DAP_Transfer;
+    Request[3] = 0U;
+    Request[4] = (uint8_t)filler;
+    memset(&Request[5], DAP_TRANSFER_RnW | DP_IDCODE, filler);
+    offset = 5U + filler;
+    request_length = offset + build(&Request[offset]);
+
+    memset(Response, GUARD, sizeof(Response));
+    num = DAP_ExecuteCommand(Request, Response);
+
+    for (n = DAP_PACKET_SIZE; n < sizeof(Response); n++) {
+      if (Response[n] != GUARD) {
+        printf("%s: %u IDCODE reads before, response overruns the packet\n", name, (unsigned)filler);
+        failed++;
+        return;
+      }
+    }
+    CHECK((num & 0xFFFFU) <= DAP_PACKET_SIZE);
+
+    // Where the vendor command response starts
+    offset = 2U + 3U + (4U * filler);
+    if ((DAP_PACKET_SIZE - offset) < 52U) {
+      // Not run: no room for its fixed part
+      CHECK(Response[1] == 1U);
+      CHECK((num >> 16) == (5U + filler));
+      CHECK((num & 0xFFFFU) == offset);
+      continue;
+    }
+    CHECK(Response[1] == 2U);
+    CHECK((num >> 16) == request_length);
+    CHECK(Response[offset] == Request[5U + filler]);
+    CHECK((num & 0xFFFFU) == (offset + length(&Response[offset])));
+    if (filler == 0U) {
+      CHECK(Response[offset + 1U] == DAP_OK);
+    }
+  }
+}
+
+static void host_connect (void) {
+  uint8_t request[2];
+
+  request[0] = ID_DAP_Connect;
+  request[1] = DAP_PORT_SWD;
+  CHECK(command(request) == ((2U << 16) | 2U));
+}
+
+int main (void) {
+  uint32_t n;
+
+  model_reset();
+  for (n = 0U; n < MODEL_RAM_SIZE; n++) {
+    Model.ram[n] = (uint8_t)((n * 2654435761U) >> 13);
+  }
+  DAP_Setup();
+  host_connect();
+
+  sweep("ReadRLE", rle_build, rle_length);
+  sweep("ReadScatter", scatter_build, scatter_length);
+  sweep("CoreRead", core_read_build, core_read_length);
+  sweep("CoreStep", core_step_build, core_step_length);
+  sweep("RomDiscover", rom_build, rom_length);
+  sample_start();
+  sweep("SampleRead", sample_build, sample_length);
+  event_start();
+  sweep("EventRead", event_build, event_length);
+
+  if (failed != 0) {
+    printf("test_execute: %d checks failed\n", failed);
+    return (1);
+  }
+  printf("test_execute: passed\n");
+  return (0);
+}
@@ -0,0 +1,531 @@
+/*
+ * GDB server on a model Cortex-M target: a gdb session is replayed packet by
+ * packet and each reply has to match the recorded one. Packets split over
+ * reads, bad checksums, oversized packets and a terminal opening the port
+ * check the framing of the parser.
+ *
+ *   test_gdb gdb_session.txt
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "DAP_config.h"
+#include "DAP.h"
+#include "tusb.h"
+#include "gdb_server.h"
+
+#define DBG_FSR         0xE000ED30U
+#define FP_CTRL         0xE0002000U
+#define FP_COMP0        0xE0002008U
+#define DWT_CTRL        0xE0001000U
+#define DWT_COMP0       0xE0001020U
+
+#define FP_COMPS        4U
+#define DWT_COMPS       2U
+
+/* Instruction at STORE_PC stores a byte to STORE_ADDR */
+#define STORE_PC        0x120U
+#define STORE_ADDR      0x20000012U
+
+uint32_t test_time_us;
+DAP_Data_t DAP_Data;
+
+/* Model target: 4 KB of flash at 0, 4 KB of SRAM, FPB revision 1 and a DWT */
+static struct {
+    uint8_t  flash[0x1000];
+    uint8_t  ram[0x1000];
+    uint32_t reg[17];
+    uint32_t dhcsr;
+    uint32_t demcr;
+    uint32_t dfsr;
+    uint32_t fp_ctrl;
+    uint32_t fp_comp[FP_COMPS];
+    uint32_t dwt[DWT_COMPS][3];     /* COMP, MASK, FUNCTION */
+    uint32_t halted;
+    uint32_t step;
+    uint32_t connected;
+} core;
+
+static uint8_t *memory(uint32_t addr)
+{
+    if (addr < sizeof(core.flash))
+        return &core.flash[addr];
+    if ((addr >= 0x20000000U) && (addr - 0x20000000U < sizeof(core.ram)))
+        return &core.ram[addr - 0x20000000U];
+    return NULL;
+}
+
+uint32_t Target_Connect(uint32_t *dpidr)
+{
+    (void)dpidr;
+    if (DAP_Data.debug_port != DAP_PORT_DISABLED)
+        return DAP_TRANSFER_ERROR;
+    DAP_Data.debug_port = DAP_PORT_SWD;
+    core.connected = 1U;
+    return DAP_TRANSFER_OK;
+}
+
+void Target_Disconnect(void)
+{
+    DAP_Data.debug_port = DAP_PORT_DISABLED;
+    core.connected = 0U;
+}
+
+/* The RTT bridge and semihosting are not linked, nothing holds the port */
+void Target_Release(void)
+{
+}
+
+uint32_t Target_Read32(uint32_t address, uint32_t *data)
+{
+    uint8_t *p;
+
+    if (!core.connected || (address & 3U))
+        return DAP_TRANSFER_ERROR;
+    if (address == DBG_HCSR) {
+        *data = core.dhcsr | (core.halted ? S_HALT : 0U);
+    } else if (address == DBG_EMCR) {
+        *data = core.demcr;
+    } else if (address == DBG_FSR) {
+        *data = core.dfsr;
+    } else if (address == FP_CTRL) {
+        *data = core.fp_ctrl;
+    } else if (address == DWT_CTRL) {
+        *data = DWT_COMPS << 28;
+    } else if ((address >= FP_COMP0) && (address < FP_COMP0 + (FP_COMPS * 4U))) {
+        *data = core.fp_comp[(address - FP_COMP0) / 4U];
+    } else if ((address >= DWT_COMP0) && (address < DWT_COMP0 + (DWT_COMPS * 16U))) {
+        *data = core.dwt[(address - DWT_COMP0) / 16U][(address & 15U) / 4U];
+        /* Reading FUNCTION clears MATCHED */
+        if ((address & 15U) == 8U)
+            core.dwt[(address - DWT_COMP0) / 16U][2] &= ~(1U << 24);
+    } else {
+        p = memory(address);
+        if (p == NULL)
+            return DAP_TRANSFER_FAULT;
+        memcpy(data, p, 4U);
+    }
+    return DAP_TRANSFER_OK;
+}
+
+uint32_t Target_Write32(uint32_t address, uint32_t data)
+{
+    uint8_t *p;
+
+    if (!core.connected || (address & 3U))
+        return DAP_TRANSFER_ERROR;
+    if (address == DBG_HCSR) {
+        if ((data & 0xFFFF0000U) != DBGKEY)
+            return DAP_TRANSFER_ERROR;
+        core.dhcsr = data & 0xFU;
+        if (data & C_HALT) {
+            core.halted = 1U;
+        } else {
+            core.halted = 0U;
+            core.step = ((data & C_DEBUGEN) && (data & C_STEP)) ? 1U : 0U;
+        }
+    } else if (address == DBG_EMCR) {
+        core.demcr = data;
+    } else if (address == DBG_FSR) {
+        core.dfsr &= ~data;
+    } else if (address == FP_CTRL) {
+        if (data & 2U)
+            core.fp_ctrl = (core.fp_ctrl & ~1U) | (data & 1U);
+    } else if ((address >= FP_COMP0) && (address < FP_COMP0 + (FP_COMPS * 4U))) {
+        core.fp_comp[(address - FP_COMP0) / 4U] = data;
+    } else if ((address >= DWT_COMP0) && (address < DWT_COMP0 + (DWT_COMPS * 16U))) {
+        core.dwt[(address - DWT_COMP0) / 16U][(address & 15U) / 4U] = data;
+    } else {
+        p = memory(address);
+        if (p == NULL)
+            return DAP_TRANSFER_FAULT;
+        memcpy(p, &data, 4U);
+    }
+    return DAP_TRANSFER_OK;
+}
+
+uint32_t Target_ReadMem(uint32_t address, uint32_t *data, uint32_t count)
+{
+    uint32_t result;
+    uint32_t n;
+
+    for (n = 0U; n < count; n++) {
+        result = Target_Read32(address + (n * 4U), &data[n]);
+        if (result != DAP_TRANSFER_OK)
+            return result;
+    }
+    return DAP_TRANSFER_OK;
+}
+
+uint32_t Target_WriteMem(uint32_t address, const uint32_t *data, uint32_t count)
+{
+    uint32_t result;
+    uint32_t n;
+
+    for (n = 0U; n < count; n++) {
+        result = Target_Write32(address + (n * 4U), data[n]);
+        if (result != DAP_TRANSFER_OK)
+            return result;
+    }
+    return DAP_TRANSFER_OK;
+}
+
+uint32_t Target_ReadCore(uint32_t reg, uint32_t *data)
+{
+    if (!core.halted || (reg > 16U))
+        return DAP_TRANSFER_ERROR;
+    *data = core.reg[reg];
+    return DAP_TRANSFER_OK;
+}
+
+uint32_t Target_WriteCore(uint32_t reg, uint32_t data)
+{
+    if (!core.halted || (reg > 16U))
+        return DAP_TRANSFER_ERROR;
+    core.reg[reg] = data;
+    return DAP_TRANSFER_OK;
+}
+
+uint32_t Target_ReadCoreSet(uint32_t mask, uint32_t *data)
+{
+    uint32_t reg;
+
+    for (reg = 0U; mask != 0U; reg++, mask >>= 1) {
+        if ((mask & 1U) && (Target_ReadCore(reg, data++) != DAP_TRANSFER_OK))
+            return DAP_TRANSFER_ERROR;
+    }
+    return DAP_TRANSFER_OK;
+}
+
+uint32_t Target_WriteCoreSet(uint32_t mask, const uint32_t *data)
+{
+    uint32_t reg;
+
+    for (reg = 0U; mask != 0U; reg++, mask >>= 1) {
+        if ((mask & 1U) && (Target_WriteCore(reg, *data++) != DAP_TRANSFER_OK))
+            return DAP_TRANSFER_ERROR;
+    }
+    return DAP_TRANSFER_OK;
+}
+
+uint32_t Target_ResetHalt(void)
+{
+    core.reg[15] = 0x100U;
+    core.halted = 1U;
+    return DAP_TRANSFER_OK;
+}
+
+uint32_t Target_ResetRun(void)
+{
+    core.halted = 0U;
+    return DAP_TRANSFER_OK;
+}
+
+/* Runs one halfword instruction unless halted, FPB and DWT stop the core */
+static void core_run(void)
+{
+    uint32_t comp;
+    uint32_t addr;
+    uint32_t pc;
+    uint32_t n;
+
+    if (core.halted)
+        return;
+    for (n = 0U; n < FP_COMPS; n++) {
+        comp = core.fp_comp[n];
+        addr = (comp & 0x1FFFFFFCU) | ((comp >> 31) ? 2U : 0U);
+        if ((core.fp_ctrl & 1U) && (comp & 1U) && (addr == core.reg[15])) {
+            core.halted = 1U;
+            core.dfsr |= 2U;
+            return;
+        }
+    }
+    pc = core.reg[15];
+    core.reg[15] += 2U;
+    if (pc == STORE_PC) {
+        (*memory(STORE_ADDR))++;
+        for (n = 0U; n < DWT_COMPS; n++) {
+            if ((core.demcr & (1U << 24)) && ((core.dwt[n][2] & 0xFU) >= 6U) &&
+                ((STORE_ADDR >> core.dwt[n][1]) == (core.dwt[n][0] >> core.dwt[n][1]))) {
+                core.dwt[n][2] |= 1U << 24;
+                core.halted = 1U;
+                core.dfsr |= 4U;
+            }
+        }
+    }
+    if (core.step) {
+        core.halted = 1U;
+        core.dfsr |= 1U;
+    }
+}
+
+/* Host end of the CDC port */
+static struct {
+    uint32_t open;
+    uint8_t  in[8192];
+    uint32_t in_length;
+    uint32_t in_pos;
+    uint32_t read_max;              /* Bytes per read, 0 for all */
+    char     out[8192];
+    uint32_t out_length;
+} cdc;
+
+bool tud_cdc_connected(void)
+{
+    return cdc.open != 0U;
+}
+
+uint32_t tud_cdc_available(void)
+{
+    uint32_t n = cdc.in_length - cdc.in_pos;
+
+    return ((cdc.read_max != 0U) && (n > cdc.read_max)) ? cdc.read_max : n;
+}
+
+uint32_t tud_cdc_read(void *buffer, uint32_t bufsize)
+{
+    uint32_t n = tud_cdc_available();
+
+    if (n > bufsize)
+        n = bufsize;
+    memcpy(buffer, &cdc.in[cdc.in_pos], n);
+    cdc.in_pos += n;
+    return n;
+}
+
+bool tud_cdc_peek(uint8_t *ui8)
+{
+    if (cdc.in_pos == cdc.in_length)
+        return false;
+    *ui8 = cdc.in[cdc.in_pos];
+    return true;
+}
+
+uint32_t tud_cdc_write(void const *buffer, uint32_t bufsize)
+{
+    if (cdc.out_length + bufsize >= sizeof(cdc.out))
+        abort();
+    memcpy(&cdc.out[cdc.out_length], buffer, bufsize);
+    cdc.out_length += bufsize;
+    return bufsize;
+}
+
+uint32_t tud_cdc_write_char(char ch)
+{
+    return tud_cdc_write(&ch, 1U);
+}
+
+uint32_t tud_cdc_write_flush(void)
+{
+    return 0U;
+}
+
+uint32_t tud_cdc_write_available(void)
+{
+    return 1024U;
+}
+
+static void host_write(const char *data, uint32_t length)
+{
+    memcpy(&cdc.in[cdc.in_length], data, length);
+    cdc.in_length += length;
+}
+
+/* Frames a payload as gdb does */
+static uint32_t frame(char *out, const char *payload)
+{
+    uint32_t sum = 0U;
+    const char *p;
+
+    for (p = payload; *p != '\0'; p++)
+        sum += (uint8_t)*p;
+    return (uint32_t)sprintf(out, "$%s#%02x", payload, (unsigned)(sum & 0xFFU));
+}
+
+static void host_send(const char *payload)
+{
+    char packet[1024];
+
+    host_write(packet, frame(packet, payload));
+}
+
+/* Polls the server and runs the core until the port has been quiet for a while */
+static void run(void)
+{
+    uint32_t wait;
+    uint32_t n;
+
+    for (n = 0U; n < 200U; n++) {
+        wait = gdb_server_task();
+        test_time_us += (wait != 0U) ? wait : 100U;
+        core_run();
+    }
+}
+
+static void port_open(void)
+{
+    cdc.open = 0U;
+    (void)gdb_server_task();
+    cdc.open = 1U;
+    cdc.in_length = 0U;
+    cdc.in_pos = 0U;
+    cdc.out_length = 0U;
+}
+
+static int output_is(const char *name, const char *expected)
+{
+    cdc.out[cdc.out_length] = '\0';
+    if (strcmp(cdc.out, expected) == 0)
+        return 0;
+    printf("%s\n  got  [%s]\n  want [%s]\n", name, cdc.out, expected);
+    return 1;
+}
+
+/* Replays a session file, returns the number of mismatching replies */
+static int replay(const char *path)
+{
+    char line[1024];
+    char expected[1024];
+    char *reply;
+    uint32_t length;
+    uint32_t noack = 0U;
+    FILE *f;
+    int failed = 0;
+
+    f = fopen(path, "r");
+    if (f == NULL) {
+        printf("cannot open %s\n", path);
+        return 1;
+    }
+    while (fgets(line, sizeof(line), f) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if ((line[0] == '\0') || (line[0] == '#'))
+            continue;
+        reply = strstr(line, " -> ");
+        if (reply == NULL) {
+            printf("%s: malformed line [%s]\n", path, line);
+            failed++;
+            continue;
+        }
+        *reply = '\0';
+        reply += 4;
+
+        cdc.out_length = 0U;
+        if (strcmp(line, "+") == 0)
+            host_write("+", 1U);
+        else if (strcmp(line, "^C") == 0)
+            host_write("\003", 1U);
+        else
+            host_send(line);
+        run();
+
+        length = 0U;
+        if (!noack && (line[0] != '+') && (line[0] != '^'))
+            expected[length++] = '+';
+        if (strcmp(reply, "!") != 0)
+            length += frame(&expected[length], reply);
+        expected[length] = '\0';
+        failed += output_is(line, expected);
+
+        if (strcmp(line, "QStartNoAckMode") == 0)
+            noack = 1U;
+    }
+    fclose(f);
+    return failed;
+}
+
+/* Framing: split packets, bad checksums, oversized packets, a terminal on the port */
+static int framing(void)
+{
+    char packet[64];
+    char big[400];
+    uint32_t length;
+    int failed = 0;
+
+    /* A packet read a byte at a time */
+    port_open();
+    length = frame(packet, "qAttached");
+    host_write("+", 1U);
+    host_write(packet, length);
+    cdc.read_max = 1U;
+    run();
+    cdc.read_max = 0U;
+    failed += output_is("split packet", "+$1#31");
+
+    /* A bad checksum is answered with a NAK, the retransmission with the reply */
+    cdc.out_length = 0U;
+    length = frame(packet, "qAttached");
+    packet[length - 1] ^= 1;
+    host_write(packet, length);
+    run();
+    failed += output_is("bad checksum", "-");
+    cdc.out_length = 0U;
+    host_send("qAttached");
+    run();
+    failed += output_is("retransmission", "+$1#31");
+
+    /* A packet larger than the buffer is dropped, the next one is served */
+    cdc.out_length = 0U;
+    memset(big, 'a', sizeof(big));
+    big[0] = '$';
+    host_write(big, sizeof(big));
+    host_send("qAttached");
+    run();
+    failed += output_is("oversized packet", "+$1#31");
+
+    /* An interrupt while halted is dropped, the packet after it is served */
+    cdc.out_length = 0U;
+    host_write("\003", 1U);
+    host_send("qAttached");
+    run();
+    failed += output_is("interrupt while halted", "+$1#31");
+
+    /* A terminal leaves the port alone until it closes */
+    port_open();
+    host_write("help\r\n", 6U);
+    run();
+    if (gdb_server_active() || (cdc.in_pos != 0U)) {
+        printf("terminal taken for a debugger\n");
+        failed++;
+    }
+    port_open();
+    host_write("+", 1U);
+    run();
+    if (!gdb_server_active()) {
+        printf("debugger not detected after the terminal closed\n");
+        failed++;
+    }
+    return failed;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t n;
+    int failed;
+
+    if (argc < 2) {
+        printf("usage: test_gdb gdb_session.txt\n");
+        return 2;
+    }
+
+    for (n = 0U; n < sizeof(core.flash); n++)
+        core.flash[n] = (uint8_t)(n * 7U);
+    core.reg[13] = 0x20000800U;
+    core.reg[15] = 0x110U;
+    core.reg[16] = 0x01000000U;
+    core.fp_ctrl = FP_COMPS << 4;
+    core.halted = 1U;
+
+    port_open();
+    failed = replay(argv[1]);
+    failed += framing();
+
+    if (failed != 0) {
+        printf("test_gdb: %d checks failed\n", failed);
+        return 1;
+    }
+    printf("test_gdb: passed\n");
+    return 0;
+}
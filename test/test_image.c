@@ -0,0 +1,439 @@
+/*
+ * Image stream on a model target: binary and Intel HEX image files written
+ * in the sector orders of the Linux, Windows and macOS FAT drivers and in
+ * shuffled orders have to end up in the target flash as the file describes,
+ * each flash page erased once, with the parking slots in target SRAM as the
+ * only buffer for sectors that come early once the image has started. The
+ * target is not connected for sectors that do not start an image.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "DAP_config.h"
+#include "DAP.h"
+#include "board_config.h"
+#include "target_flash.h"
+#include "image_stream.h"
+
+#define SECTOR_SIZE         512U
+#define CLUSTER_SECTORS     8U
+#define DATA_START          100U        /* First data area sector */
+#define FILE_START          (DATA_START + (3U * CLUSTER_SECTORS))
+#define FILE_SECTORS_MAX    96U
+
+/* Model target: flash and the SRAM that holds parked sectors */
+static uint8_t  target_flash[TARGET_FLASH_SIZE];
+static uint32_t target_sram[TARGET_STAGING_SIZE / 4U];
+static uint8_t  page_erases[TARGET_FLASH_SIZE / TARGET_FLASH_PAGE_SIZE];
+static uint32_t target_open;
+static uint32_t target_inits;
+
+int32_t target_flash_init(void)
+{
+    target_open = 1U;
+    target_inits++;
+    return 0;
+}
+
+int32_t target_flash_erase(uint32_t addr)
+{
+    if (!target_open || ((addr % TARGET_FLASH_PAGE_SIZE) != 0U) || (addr >= TARGET_FLASH_SIZE))
+        return -1;
+    memset(&target_flash[addr], 0xFF, TARGET_FLASH_PAGE_SIZE);
+    page_erases[addr / TARGET_FLASH_PAGE_SIZE]++;
+    return 0;
+}
+
+int32_t target_flash_program(uint32_t addr, const uint32_t *data, uint32_t words)
+{
+    uint32_t n;
+
+    if (!target_open || (addr + (words * 4U) > TARGET_FLASH_SIZE))
+        return -1;
+    for (n = 0U; n < words * 4U; n++)
+        target_flash[addr + n] &= ((const uint8_t *)data)[n];
+    return 0;
+}
+
+void target_flash_uninit(void)
+{
+    target_open = 0U;
+}
+
+static uint32_t *sram_word(uint32_t address, uint32_t count)
+{
+    if ((address < TARGET_STAGING_START) ||
+        ((address - TARGET_STAGING_START) + (count * 4U) > TARGET_STAGING_SIZE))
+        return NULL;
+    return &target_sram[(address - TARGET_STAGING_START) / 4U];
+}
+
+uint32_t Target_ReadMem(uint32_t address, uint32_t *data, uint32_t count)
+{
+    uint32_t *p = sram_word(address, count);
+
+    if (!target_open || (p == NULL))
+        return DAP_TRANSFER_ERROR;
+    memcpy(data, p, count * 4U);
+    return DAP_TRANSFER_OK;
+}
+
+uint32_t Target_WriteMem(uint32_t address, const uint32_t *data, uint32_t count)
+{
+    uint32_t *p = sram_word(address, count);
+
+    if (!target_open || (p == NULL))
+        return DAP_TRANSFER_ERROR;
+    memcpy(p, data, count * 4U);
+    return DAP_TRANSFER_OK;
+}
+
+/* Image and the file written for it */
+static uint8_t  image[16384];
+static uint32_t image_addr;
+static uint32_t image_length;
+static uint8_t  file[FILE_SECTORS_MAX * SECTOR_SIZE];
+static uint32_t file_length;
+static uint32_t rnd_state;
+
+static uint32_t rnd(void)
+{
+    rnd_state ^= rnd_state << 13;
+    rnd_state ^= rnd_state >> 17;
+    rnd_state ^= rnd_state << 5;
+    return rnd_state;
+}
+
+/* Binary image: vector table with stack in SRAM and a Thumb reset handler */
+static void make_bin(uint32_t length)
+{
+    uint32_t n;
+
+    for (n = 0U; n < length; n++)
+        image[n] = (uint8_t)rnd();
+    image[0] = 0x00U; image[1] = 0x10U; image[2] = 0x00U; image[3] = 0x20U;
+    image[4] = 0xC1U; image[5] = 0x00U; image[6] = 0x00U; image[7] = 0x00U;
+    image_addr = TARGET_FLASH_START;
+    image_length = length;
+    memcpy(file, image, length);
+    file_length = length;
+}
+
+static void hex_record(uint32_t type, uint32_t offset, const uint8_t *data, uint32_t count)
+{
+    uint32_t sum = count + (offset >> 8) + (offset & 0xFFU) + type;
+    uint32_t n;
+
+    file_length += (uint32_t)sprintf((char *)&file[file_length], ":%02X%04X%02X",
+                                     (unsigned)count, (unsigned)(offset & 0xFFFFU), (unsigned)type);
+    for (n = 0U; n < count; n++) {
+        file_length += (uint32_t)sprintf((char *)&file[file_length], "%02X", data[n]);
+        sum += data[n];
+    }
+    file_length += (uint32_t)sprintf((char *)&file[file_length], "%02X\r\n", (unsigned)((0U - sum) & 0xFFU));
+}
+
+/* HEX image at addr with 16 byte records, extended linear address records at 64K boundaries */
+static void make_hex(uint32_t addr, uint32_t length)
+{
+    uint8_t ext[2];
+    uint32_t upper = 0xFFFFFFFFU;
+    uint32_t count;
+    uint32_t n;
+
+    for (n = 0U; n < length; n++)
+        image[n] = (uint8_t)rnd();
+    image_addr = addr;
+    image_length = length;
+    file_length = 0U;
+    for (n = 0U; n < length; n += count) {
+        if (((addr + n) >> 16) != upper) {
+            upper = (addr + n) >> 16;
+            ext[0] = (uint8_t)(upper >> 8);
+            ext[1] = (uint8_t)upper;
+            hex_record(0x04U, 0U, ext, 2U);
+        }
+        count = 16U - ((addr + n) % 16U);
+        if (count > length - n)
+            count = length - n;
+        hex_record(0x00U, addr + n, &image[n], count);
+    }
+    hex_record(0x01U, 0U, NULL, 0U);
+}
+
+/* Write orders: sectors of the file as index, SIZE_ENTRY for the directory entry */
+#define SIZE_ENTRY          0xFFFFFFFFU
+#define SIZE_ZERO           0xFFFFFFFEU
+
+static uint32_t order[FILE_SECTORS_MAX + 2U];
+static uint32_t order_count;
+
+static uint32_t file_sectors(void)
+{
+    return (file_length + SECTOR_SIZE - 1U) / SECTOR_SIZE;
+}
+
+static void order_data(void)
+{
+    uint32_t n;
+
+    for (n = 0U; n < file_sectors(); n++)
+        order[order_count++] = n;
+}
+
+/* Linux: data, then the directory entry */
+static void order_linux(void)
+{
+    order_count = 0U;
+    order_data();
+    order[order_count++] = SIZE_ENTRY;
+}
+
+/* Windows: entry with size 0, data, entry with the size */
+static void order_windows(void)
+{
+    order_count = 0U;
+    order[order_count++] = SIZE_ZERO;
+    order_data();
+    order[order_count++] = SIZE_ENTRY;
+}
+
+/* macOS: entry with the size, data, entry again */
+static void order_macos(void)
+{
+    order_count = 0U;
+    order[order_count++] = SIZE_ENTRY;
+    order_data();
+    order[order_count++] = SIZE_ENTRY;
+}
+
+/* Sectors after the first shuffled within blocks of 16, the entry last */
+static void order_shuffle(void)
+{
+    uint32_t block;
+    uint32_t n;
+    uint32_t k;
+    uint32_t t;
+
+    order_linux();
+    for (block = 0U; block < order_count - 1U; block += 16U) {
+        for (n = 15U; n > 0U; n--) {
+            if (block + n >= order_count - 1U)
+                continue;
+            k = rnd() % (n + 1U);
+            if (block + k == 0U)
+                k = n;
+            t = order[block + n];
+            order[block + n] = order[block + k];
+            order[block + k] = t;
+        }
+    }
+}
+
+/* Each second cluster written before the one ahead of it, after the first */
+static void order_cluster_swap(void)
+{
+    uint32_t sectors = file_sectors();
+    uint32_t c;
+    uint32_t n;
+
+    order_count = 0U;
+    for (n = 0U; n < CLUSTER_SECTORS; n++)
+        order[order_count++] = n;
+    for (c = 1U; c * CLUSTER_SECTORS < sectors; c += 2U) {
+        for (n = (c + 1U) * CLUSTER_SECTORS; (n < (c + 2U) * CLUSTER_SECTORS) && (n < sectors); n++)
+            order[order_count++] = n;
+        for (n = c * CLUSTER_SECTORS; (n < (c + 1U) * CLUSTER_SECTORS) && (n < sectors); n++)
+            order[order_count++] = n;
+    }
+    order[order_count++] = SIZE_ENTRY;
+}
+
+/* As many sectors as the probe holds written before the first one */
+static void order_early(void)
+{
+    uint32_t n;
+
+    order_count = 0U;
+    for (n = 1U; n <= IMAGE_STREAM_HOLD_SECTORS; n++)
+        order[order_count++] = n;
+    order[order_count++] = 0U;
+    for (; n < file_sectors(); n++)
+        order[order_count++] = n;
+    order[order_count++] = SIZE_ENTRY;
+}
+
+static uint32_t replay(uint32_t *length)
+{
+    uint32_t buf[SECTOR_SIZE / 4U];
+    uint32_t sector;
+    uint32_t n;
+
+    memset(target_flash, 0xA5, sizeof(target_flash));
+    memset(page_erases, 0, sizeof(page_erases));
+
+    /* A FAT sector written before the file lands in the data area as well */
+    memset(buf, 0, sizeof(buf));
+    target_inits = 0U;
+    image_stream_sector(DATA_START + 1U, (const uint8_t *)buf, 0U);
+    if (target_inits != 0U)
+        return IMAGE_ERROR_CONNECT;
+
+    for (n = 0U; n < order_count; n++) {
+        if (order[n] == SIZE_ENTRY) {
+            image_stream_size(FILE_START, file_length);
+        } else if (order[n] == SIZE_ZERO) {
+            image_stream_size(FILE_START, 0U);
+        } else {
+            sector = FILE_START + order[n];
+            memset(buf, 0, sizeof(buf));
+            memcpy(buf, &file[order[n] * SECTOR_SIZE],
+                   (file_length - (order[n] * SECTOR_SIZE) < SECTOR_SIZE) ?
+                   file_length - (order[n] * SECTOR_SIZE) : SECTOR_SIZE);
+            image_stream_sector(sector, (const uint8_t *)buf, ((sector - DATA_START) % CLUSTER_SECTORS) == 0U);
+        }
+    }
+    return image_stream_close(length);
+}
+
+/* The image in flash, pages it does not touch left alone, each page erased once */
+static int flash_is_image(void)
+{
+    uint32_t first = image_addr / TARGET_FLASH_PAGE_SIZE;
+    uint32_t last = (image_addr + image_length - 1U) / TARGET_FLASH_PAGE_SIZE;
+    uint32_t n;
+
+    if (memcmp(&target_flash[image_addr], image, image_length) != 0)
+        return 0;
+    for (n = first * TARGET_FLASH_PAGE_SIZE; n < image_addr; n++) {
+        if (target_flash[n] != 0xFFU)
+            return 0;
+    }
+    for (n = image_addr + image_length; n < (last + 1U) * TARGET_FLASH_PAGE_SIZE; n++) {
+        if (target_flash[n] != 0xFFU)
+            return 0;
+    }
+    for (n = 0U; n < TARGET_FLASH_SIZE / TARGET_FLASH_PAGE_SIZE; n++) {
+        if (page_erases[n] != (((n >= first) && (n <= last)) ? 1U : 0U))
+            return 0;
+    }
+    return (target_flash[(last + 1U) * TARGET_FLASH_PAGE_SIZE] == 0xA5U);
+}
+
+static int run(const char *name, void (*make_order)(void), uint32_t expected)
+{
+    uint32_t result;
+    uint32_t length;
+
+    make_order();
+    result = replay(&length);
+    if (result != expected) {
+        printf("%s: result %u, expected %u\n", name, (unsigned)result, (unsigned)expected);
+        return 1;
+    }
+    if ((expected == IMAGE_OK) && ((length != image_length) || !flash_is_image())) {
+        printf("%s: flash does not hold the image (%u of %u bytes)\n", name,
+               (unsigned)length, (unsigned)image_length);
+        return 1;
+    }
+    if (target_open) {
+        printf("%s: target not released\n", name);
+        return 1;
+    }
+    return 0;
+}
+
+/* Sectors more than the parking slots ahead of the next one fail the image */
+static void order_too_far(void)
+{
+    uint32_t n;
+
+    order_count = 0U;
+    order[order_count++] = SIZE_ENTRY;
+    order[order_count++] = 0U;
+    for (n = 2U; n < file_sectors(); n++)
+        order[order_count++] = n;
+    order[order_count++] = 1U;
+}
+
+/*
+ * Metadata and hidden files: sectors that start no image, cluster starts
+ * included, leave the target alone until the stream times out
+ */
+static int metadata(void)
+{
+    uint32_t buf[SECTOR_SIZE / 4U];
+    uint32_t length;
+    uint32_t n;
+
+    target_inits = 0U;
+    for (n = 0U; n < 3U * CLUSTER_SECTORS; n++) {
+        memset(buf, (int)n, sizeof(buf));
+        image_stream_sector(FILE_START + n, (const uint8_t *)buf, (n % CLUSTER_SECTORS) == 0U);
+    }
+    if ((image_stream_state() != IMAGE_STREAM_STAGING) ||
+        (image_stream_close(&length) != IMAGE_NONE) || (target_inits != 0U)) {
+        printf("metadata: target connected\n");
+        return 1;
+    }
+    return 0;
+}
+
+static void order_truncated(void)
+{
+    order_linux();
+    order[order_count - 2U] = SIZE_ENTRY;
+    order_count--;
+}
+
+int main(void)
+{
+    static const struct {
+        const char *name;
+        void (*make_order)(void);
+    } orders[] = {
+        { "linux",        order_linux },
+        { "windows",      order_windows },
+        { "macos",        order_macos },
+        { "shuffle",      order_shuffle },
+        { "cluster swap", order_cluster_swap },
+        { "early",        order_early },
+    };
+    char name[64];
+    uint32_t n;
+    int failed = 0;
+
+    rnd_state = 0x2545F491U;
+    for (n = 0U; n < sizeof(orders) / sizeof(orders[0]); n++) {
+        /* Binary, the last sector padded */
+        make_bin(sizeof(image) - 300U);
+        snprintf(name, sizeof(name), "bin %s", orders[n].name);
+        failed += run(name, orders[n].make_order, IMAGE_OK);
+
+        /* HEX across a 64K boundary, records split over sectors */
+        make_hex(0x10000U - 0x800U, 4000U);
+        snprintf(name, sizeof(name), "hex %s", orders[n].name);
+        failed += run(name, orders[n].make_order, IMAGE_OK);
+    }
+
+    failed += metadata();
+
+    make_bin(sizeof(image));
+    failed += run("bin too far ahead", order_too_far, IMAGE_ERROR_ORDER);
+    failed += run("bin truncated", order_truncated, IMAGE_ERROR_INCOMPLETE);
+
+    make_hex(0x2000U, 2000U);
+    file[100] ^= 0x01U;
+    failed += run("hex checksum", order_linux, IMAGE_ERROR_HEX);
+
+    make_hex(TARGET_FLASH_SIZE - 64U, 128U);
+    failed += run("hex range", order_linux, IMAGE_ERROR_RANGE);
+
+    if (failed != 0) {
+        printf("test_image: %d cases failed\n", failed);
+        return 1;
+    }
+    printf("test_image: passed\n");
+    return 0;
+}
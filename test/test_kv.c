@@ -0,0 +1,263 @@
+/*
+ * Key/value store on a simulated data flash with power loss: writes and
+ * erases are cut off at random points, partly done, and kv_init() has to
+ * find either the old or the new value of the key in flight and every
+ * other key unchanged. Pages torn by the power loss must return to the
+ * store, a page of foreign data must survive untouched and the store must
+ * stay off when CONFIG0 does not enable the data flash.
+ */
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "NUC100Series.h"
+#include "board_config.h"
+#include "kv_store.h"
+
+#define PAGE_WORDS      (FMC_FLASH_PAGE_SIZE / 4)
+#define PAGE_COUNT      (DATA_FLASH_SIZE / FMC_FLASH_PAGE_SIZE)
+#define FOREIGN_PAGE    (PAGE_COUNT - 1)
+#define OPS             20000
+#define PAGE_MAGIC      0x3153564BU     /* Page header magic of kv_store.c */
+
+static uint32_t flash[DATA_FLASH_SIZE / 4];
+static uint32_t config0;
+static uint32_t dfbadr;
+static long budget;             /* flash operations until power loss, -1 for none */
+static long flash_ops;
+static jmp_buf power_loss;
+static uint32_t rnd_state;
+
+static uint32_t rnd(void)
+{
+    rnd_state ^= rnd_state << 13;
+    rnd_state ^= rnd_state >> 17;
+    rnd_state ^= rnd_state << 5;
+    return rnd_state;
+}
+
+uintptr_t kv_flash_base(void)
+{
+    return (uintptr_t)flash;
+}
+
+void FMC_Open(void)
+{
+}
+
+void FMC_Close(void)
+{
+}
+
+int32_t FMC_ReadConfig(uint32_t *u32Config, uint32_t u32Count)
+{
+    (void)u32Count;
+    u32Config[0] = config0;
+    return 0;
+}
+
+uint32_t FMC_ReadDataFlashBaseAddr(void)
+{
+    return dfbadr;
+}
+
+/* Counts down the budget, the last operation is cut off halfway */
+static int power_fails(void)
+{
+    flash_ops++;
+    if (budget < 0)
+        return 0;
+    return (budget-- == 0);
+}
+
+int32_t FMC_Write(uint32_t u32addr, uint32_t u32data)
+{
+    uint32_t *word = &flash[(u32addr - DATA_FLASH_BASE) / 4U];
+
+    if (power_fails()) {
+        *word &= u32data | rnd();
+        longjmp(power_loss, 1);
+    }
+    *word &= u32data;
+    return 0;
+}
+
+int32_t FMC_Erase(uint32_t u32addr)
+{
+    uint32_t *page = &flash[(u32addr - DATA_FLASH_BASE) / 4U];
+    uint32_t n;
+
+    if (power_fails()) {
+        for (n = 0U; n < PAGE_WORDS; n++) {
+            if (rnd() & 1U)
+                page[n] = 0xFFFFFFFFU;
+        }
+        longjmp(power_loss, 1);
+    }
+    memset(page, 0xFF, FMC_FLASH_PAGE_SIZE);
+    return 0;
+}
+
+/* Values the store must return, and the values before the operation in flight */
+static uint8_t model[KV_KEY_MAX][KV_VALUE_MAX];
+static int32_t model_length[KV_KEY_MAX];
+static uint8_t before[KV_KEY_MAX][KV_VALUE_MAX];
+static int32_t before_length[KV_KEY_MAX];
+
+static int value_is(uint32_t key, const uint8_t *value, int32_t length)
+{
+    uint8_t buf[KV_VALUE_MAX];
+    int32_t got = kv_get(key + 1U, buf, sizeof(buf));
+
+    if (length == 0)
+        return (got == -1);
+    return ((got == length) && (memcmp(buf, value, (size_t)length) == 0));
+}
+
+static int check(uint32_t in_flight, long op)
+{
+    uint32_t key;
+
+    for (key = 0U; key < KV_KEY_MAX; key++) {
+        if (value_is(key, model[key], model_length[key]))
+            continue;
+        if ((key == in_flight) && value_is(key, before[key], before_length[key]))
+            continue;
+        printf("op %ld: key %u lost\n", op, (unsigned)(key + 1U));
+        return 1;
+    }
+    return 0;
+}
+
+static void flash_reset(void)
+{
+    memset(flash, 0xFF, DATA_FLASH_SIZE);
+    config0 = 0xFFFFFFFEU;
+    dfbadr = DATA_FLASH_BASE;
+    budget = -1;
+    flash_ops = 0;
+}
+
+/* Without DFEN or with CONFIG1 elsewhere the pages belong to the APROM image */
+static int test_disabled(void)
+{
+    static const uint8_t value[4] = { 1, 2, 3, 4 };
+    int failed = 0;
+
+    flash_reset();
+    config0 = 0xFFFFFFFFU;
+    kv_init();
+    if ((kv_set(1U, value, sizeof(value)) != -1) || (flash_ops != 0)) {
+        printf("store used with DFEN set\n");
+        failed++;
+    }
+
+    flash_reset();
+    dfbadr = DATA_FLASH_BASE - FMC_FLASH_PAGE_SIZE;
+    kv_init();
+    if ((kv_set(1U, value, sizeof(value)) != -1) || (flash_ops != 0)) {
+        printf("store used with DFBADR %08X\n", (unsigned)dfbadr);
+        failed++;
+    }
+    return failed;
+}
+
+static int test_power_loss(uint32_t seed)
+{
+    static uint32_t foreign[PAGE_WORDS];
+    uint8_t value[KV_VALUE_MAX];
+    volatile uint32_t key;      /* read after the longjmp */
+    uint32_t length;
+    uint32_t n;
+    int32_t err;
+    long op;
+
+    flash_reset();
+    rnd_state = seed;
+    memset(model_length, 0, sizeof(model_length));
+
+    /* A single word where a page header would have its sequence number */
+    flash[FOREIGN_PAGE * PAGE_WORDS + 0U] = 0x12345678U;
+    memcpy(foreign, &flash[FOREIGN_PAGE * PAGE_WORDS], sizeof(foreign));
+
+    kv_init();
+    for (op = 0; op < OPS; op++) {
+        key = rnd() % KV_KEY_MAX;
+        length = 1U + (rnd() % KV_VALUE_MAX);
+        for (n = 0U; n < length; n++)
+            value[n] = (uint8_t)rnd();
+        memcpy(before, model, sizeof(model));
+        memcpy(before_length, model_length, sizeof(model_length));
+        budget = ((op % 7) == 0) ? (long)(rnd() % 12U) : -1;
+
+        if (setjmp(power_loss) == 0) {
+            if ((rnd() % 10U) == 0U) {
+                err = kv_delete(key + 1U);
+                model_length[key] = 0;
+            } else {
+                err = kv_set(key + 1U, value, length);
+                memcpy(model[key], value, length);
+                model_length[key] = (int32_t)length;
+            }
+            budget = -1;
+            if (err != 0) {
+                printf("op %ld: key %u not stored\n", op, (unsigned)(key + 1U));
+                return 1;
+            }
+            if (check(KV_KEY_MAX, op) != 0)
+                return 1;
+        } else {
+            budget = -1;
+            kv_init();
+            if (check(key, op) != 0)
+                return 1;
+            /* The key in flight keeps whichever value survived */
+            model_length[key] = kv_get(key + 1U, model[key], KV_VALUE_MAX);
+            if (model_length[key] < 0)
+                model_length[key] = 0;
+        }
+
+        if ((op % 1000) == 0) {
+            kv_init();
+            if (check(KV_KEY_MAX, op) != 0)
+                return 1;
+        }
+    }
+
+    /* Pages torn by power loss went back to the store */
+    for (n = 0U; n < FOREIGN_PAGE; n++) {
+        if ((flash[n * PAGE_WORDS + 1U] != PAGE_MAGIC) && (flash[n * PAGE_WORDS + 1U] != 0xFFFFFFFFU)) {
+            printf("page %u lost to the store\n", (unsigned)n);
+            return 1;
+        }
+    }
+
+    if (memcmp(foreign, &flash[FOREIGN_PAGE * PAGE_WORDS], sizeof(foreign)) != 0) {
+        printf("foreign page changed\n");
+        return 1;
+    }
+    return 0;
+}
+
+int main(void)
+{
+    uint32_t seed;
+    int failed;
+
+    failed = test_disabled();
+    for (seed = 1U; seed <= 3U; seed++) {
+        if (test_power_loss(seed * 2654435761U) != 0) {
+            printf("seed %u failed\n", (unsigned)seed);
+            failed++;
+        }
+    }
+
+    if (failed != 0) {
+        printf("test_kv: failed\n");
+        return 1;
+    }
+    printf("test_kv: passed\n");
+    return 0;
+}
@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+"""Capture and replay of a debugger session on host_probe with utils/dap_replay.py.
+
+A session recorded on the model target and replayed on a fresh one has to give
+the same responses. With target memory changed before the replay, exactly the
+commands that read it have to show up as changed. The session is larger than
+the capture buffer, so recording and replay drain the buffer in between.
+
+    test_replay.py path/to/host_probe
+"""
+import os
+import struct
+import sys
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'utils'))
+from dap_read import ID_DAP_READ_RLE, ID_DAP_TRANSFER, HostProbe  # noqa: E402
+from dap_replay import CAPTURE_STATUS, HEADER, Record, control, replay  # noqa: E402
+
+ID_DAP_INFO = 0x00
+ID_DAP_TRANSFER_CONFIGURE = 0x04
+ID_DAP_TRANSFER_BLOCK = 0x06
+ID_DAP_SWJ_CLOCK = 0x11
+
+DP_SELECT = 0x08
+AP_CSW = 0x01
+AP_TAR = 0x05
+AP_DRW_WRITE = 0x0D
+AP_DRW_READ = 0x0F
+
+RAM_BASE = 0x20000000
+BLOCKS_BASE = 0x20001000
+BLOCKS = 8
+
+
+def transfer(*writes):
+    """DAP_Transfer of register writes."""
+    return (struct.pack('<BBB', ID_DAP_TRANSFER, 0, len(writes)) +
+            b''.join(struct.pack('<BI', request, value) for request, value in writes))
+
+
+def session():
+    """Set up, then block writes and reads, and ReadRLE of zeroed RAM below the blocks."""
+    requests = [bytes([ID_DAP_INFO, 0xFF]),
+                struct.pack('<BI', ID_DAP_SWJ_CLOCK, 4000000),
+                struct.pack('<BBHH', ID_DAP_TRANSFER_CONFIGURE, 0, 100, 0),
+                transfer((0x00, 0x1E), (0x04, 0x50000000), (DP_SELECT, 0), (AP_CSW, 0x23000012))]
+    for n in range(BLOCKS):
+        address = BLOCKS_BASE + 0x100 * n
+        requests.append(transfer((AP_TAR, address)))
+        requests.append(struct.pack('<BBHB', ID_DAP_TRANSFER_BLOCK, 0, 64, AP_DRW_WRITE) +
+                        b''.join(struct.pack('<I', (n << 16) | k) for k in range(64)))
+        requests.append(transfer((AP_TAR, address)))
+        requests.append(struct.pack('<BBHB', ID_DAP_TRANSFER_BLOCK, 0, 64, AP_DRW_READ))
+        requests.append(struct.pack('<BIH', ID_DAP_READ_RLE, RAM_BASE, 0x100))
+    return requests
+
+
+def main():
+    failed = 0
+    requests = session()
+
+    sim = HostProbe(sys.argv[1])
+    _, _, size, _ = control(sim, CAPTURE_STATUS)
+    if sum(HEADER.size + len(request) for request in requests) <= size:
+        print('session fits the capture buffer of %d bytes' % size)
+        failed += 1
+    recorded, _, _ = replay(sim, [Record(0, 0, request, 0, 0) for request in requests], size)
+    if [record.request for record in recorded] != requests:
+        print('recorded %d of %d requests' % (len(recorded), len(requests)))
+        failed += 1
+    # Block reads return ID, count, ACK and 64 words
+    if [record.response_length for record in recorded if record.request[:1] == bytes([ID_DAP_TRANSFER_BLOCK]) and
+            record.request[4] == AP_DRW_READ] != [4 + 256] * BLOCKS:
+        print('block reads failed on the model target')
+        failed += 1
+    sim.close()
+
+    # Fresh target: same responses
+    sim = HostProbe(sys.argv[1])
+    replayed, changed, _ = replay(sim, recorded, size)
+    if changed or len(replayed) != len(recorded):
+        print('replay: %d of %d records, %d responses changed' % (len(replayed), len(recorded), len(changed)))
+        failed += 1
+    sim.close()
+
+    # RAM read by ReadRLE changed: only the ReadRLE responses differ
+    sim = HostProbe(sys.argv[1])
+    sim.command(transfer((DP_SELECT, 0), (AP_CSW, 0x23000012), (AP_TAR, RAM_BASE + 0x40),
+                         (AP_DRW_WRITE, 0x12345678)))
+    _, changed, _ = replay(sim, recorded, size)
+    if [recorded[n].request[0] for n in changed] != [ID_DAP_READ_RLE] * BLOCKS:
+        print('changed target: records %s changed' % changed)
+        failed += 1
+    if sim.close() != 0:
+        failed += 1
+
+    print('test_replay.py: %s' % ('failed' if failed else 'passed'))
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,284 @@
+/*
+ * ReadRLE round trip: memory images read through DAP_ReadRLE and decoded
+ * again have to come back unchanged, every response has to fit the packet,
+ * and responses without runs have to be raw.
+ *
+ *   test_rle            round trip of the built-in images
+ *   test_rle - < image  writes the responses for the image to stdout, each
+ *                       after its length (2 bytes), for test_rle.py
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "DAP_config.h"
+#include "DAP.h"
+
+#define MEMORY_SIZE     0x80000U
+#define GUARD           0xEEU
+
+DAP_Data_t DAP_Data;
+
+static uint8_t  memory[MEMORY_SIZE];
+static uint32_t memory_size;
+static uint32_t rnd_state;
+static const uint8_t *response_end;
+
+/* Space left in the packet, DAP_ProcessCommand keeps it for the firmware */
+uint32_t DAP_ResponseSpace(const uint8_t *response)
+{
+    return (uint32_t)(response_end - response);
+}
+
+uint32_t Target_ReadMem(uint32_t address, uint32_t *data, uint32_t count)
+{
+    if ((address + (count * 4U)) > memory_size)
+        return DAP_TRANSFER_ERROR;
+    memcpy(data, &memory[address], count * 4U);
+    return DAP_TRANSFER_OK;
+}
+
+static uint32_t rnd(void)
+{
+    rnd_state ^= rnd_state << 13;
+    rnd_state ^= rnd_state >> 17;
+    rnd_state ^= rnd_state << 5;
+    return rnd_state;
+}
+
+static void put32(uint8_t *data, uint32_t value)
+{
+    data[0] = (uint8_t)value;
+    data[1] = (uint8_t)(value >> 8);
+    data[2] = (uint8_t)(value >> 16);
+    data[3] = (uint8_t)(value >> 24);
+}
+
+/* Reads words at address, returns the response length, the response has a guard byte past the packet */
+static uint32_t read_rle(uint8_t *response, uint32_t address, uint32_t words)
+{
+    uint8_t request[6];
+    uint32_t num;
+
+    put32(request, address);
+    request[4] = (uint8_t)words;
+    request[5] = (uint8_t)(words >> 8);
+    memset(response, GUARD, DAP_PACKET_SIZE);
+    response_end = response + DAP_PACKET_SIZE - 1U;
+    num = DAP_ReadRLE(request, response);
+    if (((num >> 16) != 6U) || ((num & 0xFFFFU) > (DAP_PACKET_SIZE - 1U)) ||
+        (response[DAP_PACKET_SIZE - 1U] != GUARD)) {
+        printf("response of %u bytes overruns the packet\n", (unsigned)(num & 0xFFFFU));
+        exit(1);
+    }
+    return num & 0xFFFFU;
+}
+
+/* Decoder of utils/dap_read.py, returns the decoded bytes or 0 on a malformed response */
+static uint32_t decode(const uint8_t *response, uint32_t length, uint8_t *out, uint32_t *runs)
+{
+    uint32_t words = (uint32_t)response[1] | ((uint32_t)response[2] << 8);
+    uint32_t pos = 4U;
+    uint32_t size = 0U;
+    uint32_t count;
+    uint32_t n;
+
+    *runs = 0U;
+    if (response[3] == 0U) {
+        if (length != 4U + (words * 4U))
+            return 0U;
+        memcpy(out, &response[4], words * 4U);
+        return words * 4U;
+    }
+    while (size < (words * 4U)) {
+        if (pos >= length)
+            return 0U;
+        count = (response[pos] & 0x7FU) + 1U;
+        if ((response[pos] & 0x80U) != 0U) {
+            if (pos + 5U > length)
+                return 0U;
+            for (n = 0U; n < count; n++)
+                memcpy(&out[size + (n * 4U)], &response[pos + 1U], 4U);
+            pos += 5U;
+            (*runs)++;
+        } else {
+            if (pos + 1U + (count * 4U) > length)
+                return 0U;
+            memcpy(&out[size], &response[pos + 1U], count * 4U);
+            pos += 1U + (count * 4U);
+        }
+        size += count * 4U;
+    }
+    return ((size == (words * 4U)) && (pos == length)) ? size : 0U;
+}
+
+/* Reads the memory back through ReadRLE, returns the number of responses or 0 on a mismatch */
+static uint32_t round_trip(const char *name)
+{
+    static uint8_t out[MEMORY_SIZE];
+    uint8_t response[DAP_PACKET_SIZE];
+    uint32_t address = 0U;
+    uint32_t responses = 0U;
+    uint32_t words;
+    uint32_t length;
+    uint32_t size;
+    uint32_t runs;
+
+    while (address < memory_size) {
+        words = (memory_size - address) / 4U;
+        if (words > 0xFFFFU)
+            words = 0xFFFFU;
+        length = read_rle(response, address, words);
+        size = decode(response, length, &out[address], &runs);
+        if ((response[0] != DAP_OK) || (size == 0U)) {
+            printf("%s: bad response at %08X\n", name, (unsigned)address);
+            return 0U;
+        }
+        if ((response[3] != 0U) && (runs == 0U)) {
+            printf("%s: RLE response without runs at %08X\n", name, (unsigned)address);
+            return 0U;
+        }
+        address += size;
+        responses++;
+    }
+    if (memcmp(out, memory, memory_size) != 0) {
+        printf("%s: data differs\n", name);
+        return 0U;
+    }
+    return responses;
+}
+
+/* Words repeated in runs around the token limit of 128 */
+static void make_runs(void)
+{
+    static const uint32_t lengths[] = { 1U, 2U, 3U, 127U, 128U, 129U, 130U, 256U, 1U };
+    uint32_t value;
+    uint32_t count;
+    uint32_t n = 0U;
+
+    while (n < memory_size) {
+        count = lengths[rnd() % (sizeof(lengths) / sizeof(lengths[0]))];
+        value = rnd();
+        if ((rnd() % 3U) == 0U)
+            value = 0xFFFFFFFFU;
+        for (; (count != 0U) && (n < memory_size); count--, n += 4U)
+            put32(&memory[n], value);
+    }
+}
+
+static int run_all(void)
+{
+    uint8_t response[DAP_PACKET_SIZE];
+    uint32_t raw;
+    uint32_t responses;
+    uint32_t n;
+    int failed = 0;
+
+    /* Erased 512 KB: a handful of responses instead of one per 508 bytes */
+    memory_size = MEMORY_SIZE;
+    memset(memory, 0xFF, memory_size);
+    raw = (memory_size + 507U) / 508U;
+    responses = round_trip("erased");
+    if ((responses == 0U) || (responses * 64U > raw)) {
+        printf("erased: %u responses\n", (unsigned)responses);
+        failed++;
+    }
+
+    /*
+     * Random data does not pay off and goes raw, 126 words a response: the
+     * packet less command ID, header and the token a run would need
+     */
+    memory_size = 0x10000U;
+    for (n = 0U; n < memory_size; n++)
+        memory[n] = (uint8_t)rnd();
+    raw = (memory_size + 503U) / 504U;
+    responses = round_trip("random");
+    if ((responses == 0U) || (responses > raw)) {
+        printf("random: %u responses, %u raw\n", (unsigned)responses, (unsigned)raw);
+        failed++;
+    }
+
+    /* Firmware with a zeroed block, erased flash after it */
+    memory_size = MEMORY_SIZE;
+    memset(memory, 0xFF, memory_size);
+    for (n = 0U; n < 0xB000U; n++)
+        memory[n] = ((n >= 0x6000U) && (n < 0x8000U)) ? 0U : (uint8_t)rnd();
+    failed += (round_trip("firmware") == 0U);
+
+    make_runs();
+    failed += (round_trip("runs") == 0U);
+
+    /* Runs of two words, each pair repeats once */
+    memory_size = 0x4000U;
+    for (n = 0U; n < memory_size; n += 4U)
+        put32(&memory[n], n / 8U);
+    failed += (round_trip("pairs") == 0U);
+
+    /* Unaligned address, no SWD port */
+    read_rle(response, 2U, 4U);
+    if ((response[0] != DAP_ERROR) || (response[1] != 0U) || (response[2] != 0U)) {
+        printf("unaligned address read\n");
+        failed++;
+    }
+    DAP_Data.debug_port = DAP_PORT_DISABLED;
+    read_rle(response, 0U, 4U);
+    if ((response[0] != DAP_ERROR) || (response[1] != 0U) || (response[2] != 0U)) {
+        printf("read without SWD port\n");
+        failed++;
+    }
+    DAP_Data.debug_port = DAP_PORT_SWD;
+
+    /* A failing target read ends the response with the words read before */
+    memory_size = 0x100U;
+    memset(memory, 0, memory_size);
+    read_rle(response, 0U, 0x100U);
+    if ((response[0] != DAP_ERROR) || (response[1] != 0x40U) || (response[2] != 0U)) {
+        printf("read past the target memory\n");
+        failed++;
+    }
+    return failed;
+}
+
+/* Responses for an image on stdin */
+static int dump(void)
+{
+    uint8_t response[DAP_PACKET_SIZE];
+    uint32_t address = 0U;
+    uint32_t words;
+    uint32_t length;
+    uint8_t header[2];
+
+    memory_size = (uint32_t)fread(memory, 1U, sizeof(memory), stdin) & ~3U;
+    while (address < memory_size) {
+        words = (memory_size - address) / 4U;
+        if (words > 0xFFFFU)
+            words = 0xFFFFU;
+        length = read_rle(response, address, words);
+        words = (uint32_t)response[1] | ((uint32_t)response[2] << 8);
+        if ((response[0] != DAP_OK) || (words == 0U))
+            return 1;
+        header[0] = (uint8_t)length;
+        header[1] = (uint8_t)(length >> 8);
+        fwrite(header, 1U, 2U, stdout);
+        fwrite(response, 1U, length, stdout);
+        address += words * 4U;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    DAP_Data.debug_port = DAP_PORT_SWD;
+    rnd_state = 0x9E3779B9U;
+
+    if ((argc > 1) && (strcmp(argv[1], "-") == 0))
+        return dump();
+
+    if (run_all() != 0) {
+        printf("test_rle: failed\n");
+        return 1;
+    }
+    printf("test_rle: passed\n");
+    return 0;
+}
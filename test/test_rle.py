@@ -0,0 +1,49 @@
+#!/usr/bin/env python3
+"""ReadRLE responses of the firmware encoder decoded by utils/dap_read.py.
+
+    test_rle.py path/to/test_rle
+"""
+import os
+import random
+import struct
+import subprocess
+import sys
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'utils'))
+from dap_read import DAP_OK, decode  # noqa: E402
+
+
+def images():
+    rnd = random.Random(1)
+    yield 'erased', b'\xff' * 0x80000
+    yield 'random', bytes(rnd.getrandbits(8) for _ in range(0x4000))
+    fw = bytes(rnd.getrandbits(8) for _ in range(0x6000)) + bytes(0x2000)
+    yield 'firmware', fw + b'\xff' * (0x20000 - len(fw))
+    words = []
+    while len(words) < 0x8000:
+        words += [rnd.choice([0, 0xFFFFFFFF, rnd.getrandbits(32)])] * rnd.choice([1, 2, 3, 127, 128, 129, 256])
+    yield 'runs', struct.pack('<%dI' % 0x8000, *words[:0x8000])
+
+
+def main():
+    failed = 0
+    for name, image in images():
+        out = subprocess.run([sys.argv[1], '-'], input=image, stdout=subprocess.PIPE, check=True).stdout
+        data = bytearray()
+        pos = 0
+        while pos < len(out):
+            length, = struct.unpack('<H', out[pos:pos + 2])
+            status, words, chunk = decode(out[pos + 2:pos + 2 + length])
+            if status != DAP_OK or words == 0:
+                break
+            data += chunk
+            pos += 2 + length
+        if data != image:
+            print('%s: decoded data differs' % name)
+            failed += 1
+    print('test_rle.py: %s' % ('failed' if failed else 'passed'))
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,173 @@
+/*
+ * Debug sequence scripts on a model target: ScriptLoad and ScriptRun have
+ * to stay within the request they were given, also behind other commands
+ * of DAP_ExecuteCommands. test_script.py compares the runs with the
+ * interpreter of utils/dap_script.py through host_probe.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "DAP_config.h"
+#include "DAP.h"
+#include "target_model.h"
+
+uint32_t test_time_us;
+
+static int failed;
+
+#define CHECK(cond) do { if (!(cond)) { printf("%s:%d: %s\n", __FILE__, __LINE__, #cond); failed++; } } while (0)
+
+// Script Run response of DAP_ProcessCommand: ID, status, stop reason, exit code,
+// pc (2 bytes), steps (4 bytes), r0..r7 (4 bytes each)
+#define RUN_RESPONSE    (1U + 9U + (4U * 8U))
+#define STOP_EXIT       0U
+#define STOP_REQUEST    6U
+
+int32_t target_flash_init (void) { return (-1); }
+int32_t target_flash_erase (uint32_t addr) { (void)addr; return (-1); }
+int32_t target_flash_program (uint32_t addr, const uint32_t *data, uint32_t words) { (void)addr; (void)data; (void)words; return (-1); }
+void    target_flash_end (void) {}
+
+static uint8_t  Request [DAP_PACKET_SIZE];
+static uint8_t  Response[DAP_PACKET_SIZE];
+
+static void put16 (uint8_t *p, uint32_t value) {
+  p[0] = (uint8_t)value;
+  p[1] = (uint8_t)(value >> 8);
+}
+
+static void put32 (uint8_t *p, uint32_t value) {
+  p[0] = (uint8_t)value;
+  p[1] = (uint8_t)(value >> 8);
+  p[2] = (uint8_t)(value >> 16);
+  p[3] = (uint8_t)(value >> 24);
+}
+
+static uint32_t get32 (const uint8_t *p) {
+  return ((uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+}
+
+static void host_connect (void) {
+  uint8_t request[2];
+
+  request[0] = ID_DAP_Connect;
+  request[1] = DAP_PORT_SWD;
+  (void)DAP_ProcessCommand(request, Response);
+}
+
+// Script Load request at request, returns its length
+static uint32_t script_load (uint8_t *request, uint32_t offset, const uint8_t *code, uint32_t count) {
+  request[0] = ID_DAP_ScriptLoad;
+  put16(&request[1], offset);
+  put16(&request[3], count);
+  if (code != NULL) {
+    memcpy(&request[5], code, count);
+  }
+  return (5U + count);
+}
+
+// Script Run request at request, returns its length
+static uint32_t script_run (uint8_t *request, uint32_t budget, const uint32_t *args, uint32_t count) {
+  uint32_t n;
+
+  request[0] = ID_DAP_ScriptRun;
+  put32(&request[1], budget);
+  request[5] = (uint8_t)count;
+  for (n = 0U; n < count; n++) {
+    put32(&request[6U + (4U * n)], args[n]);
+  }
+  return (6U + (4U * count));
+}
+
+// Store an argument in RAM and read it back
+static void test_run (void) {
+  static const uint8_t code[] = {
+    0x18U, 0x02U, 0x10U, 0x00U, 0x00U, 0x20U,   // movi r2, 0x20000010
+    0x25U, 0x02U,                               // wr32 r0, [r2]
+    0x24U, 0x32U,                               // rd32 r3, [r2]
+    0x00U, 0x07U                                // exit 7
+  };
+  uint32_t args[1] = { 0x12345678U };
+  uint32_t length;
+
+  model_reset();
+  host_connect();
+  length = script_load(Request, 0U, code, sizeof(code));
+  CHECK(DAP_ProcessCommand(Request, Response) == ((length << 16) | 4U));
+  CHECK((Response[1] == DAP_OK) && (Response[2] == 0xFFU) && (Response[3] == 0xFFU));
+
+  length = script_run(Request, 0U, args, 1U);
+  CHECK(DAP_ProcessCommand(Request, Response) == ((length << 16) | RUN_RESPONSE));
+  CHECK((Response[1] == DAP_OK) && (Response[2] == STOP_EXIT) && (Response[3] == 7U));
+  CHECK(get32(&Response[6]) == 4U);
+  CHECK(get32(&Response[10U + (4U * 3U)]) == 0x12345678U);
+  CHECK(model_read(MODEL_RAM_BASE + 0x10U) == 0x12345678U);
+}
+
+// More arguments than registers: refused, the request ends after the count
+static void test_run_count (void) {
+  uint32_t args[9] = { 1U, 2U, 3U, 4U, 5U, 6U, 7U, 8U, 9U };
+  uint32_t n;
+
+  (void)script_run(Request, 0U, args, 9U);
+  CHECK(DAP_ProcessCommand(Request, Response) == ((6U << 16) | RUN_RESPONSE));
+  CHECK((Response[1] == DAP_ERROR) && (Response[2] == STOP_REQUEST));
+  for (n = 0U; n < 8U; n++) {
+    CHECK(get32(&Response[10U + (4U * n)]) == 0U);
+  }
+
+  (void)script_run(Request, 0U, args, 8U);
+  CHECK(DAP_ProcessCommand(Request, Response) == (((6U + 32U) << 16) | RUN_RESPONSE));
+  CHECK(Response[2] != STOP_REQUEST);
+}
+
+// Loads and runs whose data run past the end of the packet are refused
+static void test_packet_end (void) {
+  uint32_t length;
+  uint32_t count;
+  uint32_t num;
+
+  // 508 bytes of script data do not fit behind the ID and the header
+  (void)script_load(Request, 0U, NULL, 508U);
+  CHECK(DAP_ProcessCommand(Request, Response) == ((5U << 16) | 4U));
+  CHECK(Response[1] == DAP_ERROR);
+
+  // A load that fills the packet, then a run of 4 arguments with room for 3
+  count = DAP_PACKET_SIZE - 2U - 5U - 6U - 12U;
+  Request[0] = ID_DAP_ExecuteCommands;
+  Request[1] = 2U;
+  memset(&Request[2], 0, DAP_PACKET_SIZE - 2U);
+  length = 2U + script_load(&Request[2], 0U, NULL, count);
+  (void)script_run(&Request[length], 0U, NULL, 0U);
+  Request[length + 5U] = 4U;
+  num = DAP_ExecuteCommand(Request, Response);
+  CHECK(Response[1] == 2U);
+  CHECK((num >> 16) == (length + 6U));
+  CHECK((num & 0xFFFFU) == (2U + 4U + RUN_RESPONSE));
+  CHECK((Response[2U + 4U + 1U] == DAP_ERROR) && (Response[2U + 4U + 2U] == STOP_REQUEST));
+
+  // A load whose data run past the packet
+  Request[0] = ID_DAP_ExecuteCommands;
+  Request[1] = 1U;
+  (void)script_load(&Request[2], 0U, NULL, DAP_PACKET_SIZE - 2U - 5U + 1U);
+  num = DAP_ExecuteCommand(Request, Response);
+  CHECK(Response[1] == 1U);
+  CHECK(num == (((2U + 5U) << 16) | (2U + 4U)));
+  CHECK(Response[3] == DAP_ERROR);
+}
+
+int main (void) {
+
+  DAP_Setup();
+  test_run();
+  test_run_count();
+  test_packet_end();
+
+  if (failed != 0) {
+    printf("test_script: %d checks failed\n", failed);
+    return (1);
+  }
+  printf("test_script: passed\n");
+  return (0);
+}
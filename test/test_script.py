@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+"""Scripts run by the firmware interpreter compared with utils/dap_script.py.
+
+Random bytecode has to be accepted or rejected at the same offset by both
+verifiers, and random valid scripts have to stop for the same reason with
+the same pc, steps and registers. Memory accesses go to the model target RAM,
+which both sides start with zeroed.
+
+    test_script.py path/to/host_probe
+"""
+import os
+import random
+import struct
+import sys
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'utils'))
+from dap_read import HostProbe  # noqa: E402
+from dap_script import ID_DAP_SCRIPT_LOAD, LENGTHS, REGS, VALID, load, run, simulate, verify  # noqa: E402
+
+RAM_BASE = 0x20000000
+RAM_MASK = 0x3FFC
+
+
+def random_code(rnd):
+    """Instructions with random operands, now and then an invalid opcode or a cut off end."""
+    code = bytearray()
+    for _ in range(rnd.randint(1, 12)):
+        op = rnd.choice(list(LENGTHS)) if rnd.random() < 0.9 else rnd.randrange(256)
+        code.append(op)
+        code += bytes(rnd.randrange(256) if rnd.random() < 0.5 else rnd.randrange(4)
+                      for _ in range(LENGTHS.get(op, 1) - 1))
+    if rnd.random() < 0.5:
+        code += bytes([rnd.choice([0x00, 0x01]), rnd.randrange(256)]) + bytes(rnd.randrange(2))
+    return bytes(code[:rnd.randint(1, len(code))] if rnd.random() < 0.2 else code)
+
+
+def random_script(rnd):
+    """A valid script of ALU, memory, branch and pin instructions."""
+    def reg():
+        return rnd.randrange(REGS)
+
+    def imm():
+        return rnd.choice([0, 1, 2, 31, 32, 33, 0xFFFFFFFF, 0x80000000, rnd.getrandbits(32), rnd.randrange(16)])
+
+    units = []
+    for _ in range(rnd.randint(1, 16)):
+        kind = rnd.randrange(8)
+        if kind == 0:
+            units.append([bytes([0x10 + rnd.randrange(8), reg() << 4 | reg()])])
+        elif kind == 1:
+            units.append([struct.pack('<BBI', 0x18 + rnd.randrange(8), reg(), imm())])
+        elif kind == 2:
+            # Address within the model RAM, then the access
+            a = reg()
+            units.append([struct.pack('<BBI', 0x1B, a, RAM_MASK), struct.pack('<BBI', 0x1C, a, RAM_BASE),
+                          bytes([rnd.choice([0x24, 0x25]), reg() << 4 | a])])
+        elif kind in (3, 4):
+            units.append([(0x30 + rnd.randrange(4), reg() << 4 | reg(), rnd.randrange(17))])
+        elif kind == 5:
+            units.append([(0x34, reg() << 4, rnd.randrange(17))])
+        elif kind == 6:
+            units.append([rnd.choice([bytes([0x02, rnd.randrange(3), 0]), bytes([0x03]),
+                                      bytes([0x04, rnd.randrange(2)])])])
+        else:
+            units.append([bytes([0x00, rnd.randrange(256)]) if rnd.random() < 0.5 else (0x01, None, rnd.randrange(17))])
+    units.append([bytes([0x00, rnd.randrange(256)]) if rnd.random() < 0.7 else (0x01, None, rnd.randrange(17))])
+
+    # Jumps land on the start of a unit
+    starts, pc = [], 0
+    for unit in units:
+        starts.append(pc)
+        pc += sum(LENGTHS[part[0]] for part in unit)
+    code = bytearray()
+    for unit in units:
+        for part in unit:
+            if isinstance(part, tuple):
+                op, operand, index = part
+                nxt = len(code) + LENGTHS[op]
+                offset = starts[index % len(starts)] - nxt
+                code += bytes([op] if operand is None else [op, operand]) + struct.pack('<h', offset)
+            else:
+                code += part
+    return bytes(code)
+
+
+def main():
+    rnd = random.Random(1)
+    sim = HostProbe(sys.argv[1])
+    failed = 0
+
+    for _ in range(3000):
+        code = random_code(rnd)
+        resp = sim.command(struct.pack('<BHH', ID_DAP_SCRIPT_LOAD, 0, len(code)) + code)
+        result = resp[2] | resp[3] << 8
+        if result != verify(code):
+            print('verify %s: firmware %d, dap_script.py %d' % (code.hex(), result, verify(code)))
+            failed += 1
+
+    for _ in range(1500):
+        code = random_script(rnd)
+        if verify(code) != VALID:
+            print('script %s: generated script does not verify' % code.hex())
+            failed += 1
+            continue
+        args = [rnd.getrandbits(32) for _ in range(rnd.choice([0, 1, 2, 4, 8, 8, 9]))]
+        budget = rnd.randint(1, 2000)
+        sim.reset()
+        load(sim, code)
+        probe = run(sim, args, budget)
+        host = simulate(code, args, budget)
+        if tuple(probe) != tuple(host):
+            print('script %s args %s budget %d:\n  firmware %s\n  dap_script.py %s' %
+                  (code.hex(), args, budget, probe, host))
+            failed += 1
+
+    if sim.close() != 0:
+        failed += 1
+    print('test_script.py: %s' % ('failed' if failed else 'passed'))
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,425 @@
+/*
+ * Probe side target accesses between host commands on a model target: a
+ * host that set up SELECT, CSW and TAR of AP 0 with DAP_Transfer and
+ * caches them has to find them unchanged after each vendor command.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "DAP_config.h"
+#include "DAP.h"
+#include "target_model.h"
+
+uint32_t test_time_us;
+
+static int failed;
+
+#define CHECK(cond) do { if (!(cond)) { printf("%s:%d: %s\n", __FILE__, __LINE__, #cond); failed++; } } while (0)
+
+// Host set up: AP 0 bank 0, 16-bit accesses without auto-increment
+#define HOST_SELECT     0x00000000U
+#define HOST_CSW        0x23000001U
+#define HOST_TAR        0x20001000U
+
+int32_t target_flash_init (void) { return (-1); }
+int32_t target_flash_erase (uint32_t addr) { (void)addr; return (-1); }
+int32_t target_flash_program (uint32_t addr, const uint32_t *data, uint32_t words) { (void)addr; (void)data; (void)words; return (-1); }
+void    target_flash_end (void) {}
+
+static uint8_t  Response[DAP_PACKET_SIZE];
+
+static void put32 (uint8_t *p, uint32_t value) {
+  p[0] = (uint8_t)value;
+  p[1] = (uint8_t)(value >> 8);
+  p[2] = (uint8_t)(value >> 16);
+  p[3] = (uint8_t)(value >> 24);
+}
+
+static uint32_t get32 (const uint8_t *p) {
+  return ((uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+}
+
+static uint32_t command (const uint8_t *request) {
+  memset(Response, 0, sizeof(Response));
+  return (DAP_ProcessCommand(request, Response));
+}
+
+// Set up SELECT, CSW and TAR with DAP_Transfer as a debugger does
+static void host_setup (uint32_t select) {
+  uint8_t request[3U + (3U * 5U)];
+
+  request[0] = ID_DAP_Transfer;
+  request[1] = 0U;
+  request[2] = 3U;
+  request[3] = DP_SELECT;
+  put32(&request[4], select);
+  request[8] = DAP_TRANSFER_APnDP | AP_CSW;
+  put32(&request[9], HOST_CSW);
+  request[13] = DAP_TRANSFER_APnDP | AP_TAR;
+  put32(&request[14], HOST_TAR);
+  if (select != HOST_SELECT) {
+    // CSW and TAR of bank 0 first, then the bank the host works in
+    request[3] = DP_SELECT;
+    put32(&request[4], HOST_SELECT);
+    CHECK((command(request) & 0xFFFFU) == 3U);
+    request[2] = 1U;
+    put32(&request[4], select);
+  }
+  CHECK((command(request) & 0xFFFFU) == 3U);
+  CHECK(Response[2] == DAP_TRANSFER_OK);
+}
+
+// The host reads DRW through its cached TAR
+static void host_check (const char *name, uint32_t select) {
+  uint8_t request[4];
+
+  if (!model_host_intact(select, HOST_CSW, HOST_TAR)) {
+    printf("%s: SELECT %08X CSW %08X TAR %08X\n", name,
+           (unsigned)Model.select, (unsigned)Model.csw, (unsigned)Model.tar);
+    failed++;
+  }
+  model_write(HOST_TAR, 0x5A5A1234U);
+  if (select == HOST_SELECT) {
+    request[0] = ID_DAP_Transfer;
+    request[1] = 0U;
+    request[2] = 1U;
+    request[3] = DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | AP_DRW;
+    CHECK((command(request) & 0xFFFFU) == 7U);
+    CHECK(get32(&Response[3]) == 0x5A5A1234U);
+  }
+}
+
+static void test_core (void) {
+  uint8_t request[1U + 4U + (4U * 2U)];
+  uint32_t select;
+
+  for (select = HOST_SELECT; select <= 0xF0U; select += 0xF0U) {
+    model_write(DBG_HCSR, DBGKEY | C_DEBUGEN | C_HALT);
+    Model.reg[0] = 0x11111111U;
+    Model.reg[15] = 0x00000100U;
+
+    host_setup(select);
+    request[0] = ID_DAP_CoreRead;
+    put32(&request[1], 0x00008001U);
+    CHECK(command(request) == ((5U << 16) | 10U));
+    CHECK(Response[1] == DAP_OK);
+    CHECK(get32(&Response[2]) == 0x11111111U);
+    CHECK(get32(&Response[6]) == 0x00000100U);
+    host_check("Core Read", select);
+
+    host_setup(select);
+    request[0] = ID_DAP_CoreWrite;
+    put32(&request[1], 0x00000003U);
+    put32(&request[5], 0xAAAAAAAAU);
+    put32(&request[9], 0xBBBBBBBBU);
+    CHECK(command(request) == ((13U << 16) | 2U));
+    CHECK(Response[1] == DAP_OK);
+    CHECK((Model.reg[0] == 0xAAAAAAAAU) && (Model.reg[1] == 0xBBBBBBBBU));
+    host_check("Core Write", select);
+
+    host_setup(select);
+    request[0] = ID_DAP_CoreStep;
+    request[1] = 1U;
+    put32(&request[2], 0U);
+    CHECK(command(request) == ((6U << 16) | 18U));
+    CHECK(Response[1] == DAP_OK);
+    CHECK(get32(&Response[6]) == 0x00000102U);
+    host_check("Core Step", select);
+
+    // Core running: fails, the host set up is still restored
+    model_write(DBG_HCSR, DBGKEY | C_DEBUGEN);
+    host_setup(select);
+    request[0] = ID_DAP_CoreRead;
+    put32(&request[1], 0x00000001U);
+    CHECK(command(request) == ((5U << 16) | 2U));
+    CHECK(Response[1] == DAP_ERROR);
+    host_check("Core Read running", select);
+  }
+}
+
+// Entries in request order: overlapping, unaligned, across a TAR block, far away
+static const struct {
+  uint32_t address;
+  uint8_t  size;
+} ScatterEntries[] = {
+  { 0x20000002U, 3U },
+  { 0x20000000U, 8U },
+  { 0x200003FCU, 8U },
+  { 0x20000409U, 2U },
+  { 0x20002000U, 4U },
+};
+
+#define SCATTER_COUNT   (sizeof(ScatterEntries) / sizeof(ScatterEntries[0]))
+
+static void test_scatter (void) {
+  uint8_t request[2U + (5U * SCATTER_COUNT)];
+  uint32_t offset;
+  uint32_t n;
+
+  for (n = 0U; n < MODEL_RAM_SIZE; n++) {
+    Model.ram[n] = (uint8_t)(n ^ (n >> 8));
+  }
+  request[0] = ID_DAP_ReadScatter;
+  request[1] = (uint8_t)SCATTER_COUNT;
+  offset = 0U;
+  for (n = 0U; n < SCATTER_COUNT; n++) {
+    put32(&request[2U + (5U * n)], ScatterEntries[n].address);
+    request[6U + (5U * n)] = ScatterEntries[n].size;
+    offset += ScatterEntries[n].size;
+  }
+
+  host_setup(HOST_SELECT);
+  Model.tar_writes = 0U;
+  CHECK(command(request) == (((2U + (5U * SCATTER_COUNT)) << 16) | (3U + offset)));
+  CHECK(Response[1] == DAP_OK);
+  CHECK(Response[2] == SCATTER_COUNT);
+  offset = 3U;
+  for (n = 0U; n < SCATTER_COUNT; n++) {
+    CHECK(memcmp(&Response[offset], &Model.ram[ScatterEntries[n].address - MODEL_RAM_BASE], ScatterEntries[n].size) == 0);
+    offset += ScatterEntries[n].size;
+  }
+  // One TAR write per burst and TAR block, one to restore the host TAR
+  CHECK(Model.tar_writes == 5U);
+  host_check("Read Scatter", HOST_SELECT);
+
+  // A read that runs out of WAIT retries still restores
+  host_setup(0xF0U);
+  Model.wait_from = Model.transfers + 12U;
+  Model.waits = DAP_Data.transfer.retry_count + 1U;
+  CHECK(command(request) == (((2U + (5U * SCATTER_COUNT)) << 16) | 3U));
+  CHECK(Response[1] == DAP_ERROR);
+  host_check("Read Scatter failing", 0xF0U);
+}
+
+// Sampling between host commands
+static void test_sample (void) {
+  uint8_t request[6U + (2U * 5U)];
+  uint32_t n;
+
+  request[0] = ID_DAP_SampleConfigure;
+  put32(&request[1], 1000U);
+  request[5] = 2U;
+  put32(&request[6], MODEL_RAM_BASE + 0x10U);
+  request[10] = 4U;
+  put32(&request[11], MODEL_RAM_BASE + 0x802U);
+  request[15] = 2U;
+  CHECK(command(request) == ((16U << 16) | 5U));
+  CHECK(Response[1] == DAP_OK);
+
+  for (n = 0U; n < 3U; n++) {
+    host_setup((n == 1U) ? 0xF0U : HOST_SELECT);
+    put32(&Model.ram[0x10U], 0x1000U + n);
+    CHECK(DAP_SampleTask() == 1000U);
+    test_time_us += 1000U;
+    host_check("Sample", (n == 1U) ? 0xF0U : HOST_SELECT);
+  }
+
+  request[0] = ID_DAP_SampleRead;
+  CHECK(command(request) == ((1U << 16) | (9U + (3U * 10U))));
+  CHECK(Response[1] == DAP_OK);
+  // Nothing dropped, missed or failed
+  CHECK((get32(&Response[2]) == 0U) && (Response[6] == 0U) && (Response[7] == 0U));
+  CHECK(Response[8] == 3U);
+  for (n = 0U; n < 3U; n++) {
+    CHECK(get32(&Response[9U + (10U * n) + 4U]) == (0x1000U + n));
+  }
+
+  request[0] = ID_DAP_SampleConfigure;
+  put32(&request[1], 0U);
+  request[5] = 0U;
+  CHECK(command(request) == ((6U << 16) | 5U));
+}
+
+// Host DHCSR read through DRW (bank 0) or BD0 (bank 1)
+static uint32_t host_dhcsr (uint32_t bank) {
+  uint8_t request[3U + (4U * 5U) + 1U];
+
+  request[0] = ID_DAP_Transfer;
+  request[1] = 0U;
+  request[2] = 5U;
+  request[3] = DP_SELECT;
+  put32(&request[4], HOST_SELECT);
+  request[8] = DAP_TRANSFER_APnDP | AP_CSW;
+  put32(&request[9], 0x23000002U);
+  request[13] = DAP_TRANSFER_APnDP | AP_TAR;
+  put32(&request[14], DBG_HCSR);
+  request[18] = DP_SELECT;
+  put32(&request[19], bank);
+  request[23] = DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | ((bank != 0U) ? 0x00U : AP_DRW);
+  CHECK((command(request) & 0xFFFFU) == 7U);
+  CHECK(Response[1] == 5U);
+  return (get32(&Response[3]));
+}
+
+// A reset seen by the event poll still shows in the next host DHCSR read
+static void test_sticky (void) {
+  uint8_t request[6];
+  uint32_t bank;
+
+  model_write(DBG_HCSR, DBGKEY | C_DEBUGEN | C_HALT);
+  request[0] = ID_DAP_EventConfigure;
+  put32(&request[1], 1000U);
+  request[5] = 0x0FU;
+  CHECK(command(request) == ((6U << 16) | 6U));
+  CHECK(Response[1] == DAP_OK);
+  (void)host_dhcsr(0U);
+
+  for (bank = 0U; bank <= 0x10U; bank += 0x10U) {
+    host_setup(HOST_SELECT);
+    model_write(NVIC_AIRCR, VECTKEY | SYSRESETREQ);
+    test_time_us += 1000U;
+    CHECK(DAP_EventTask() == 1000U);
+    CHECK(Model.sticky == 0U);
+    host_check("Event", HOST_SELECT);
+    CHECK((host_dhcsr(bank) & S_RESET_ST) != 0U);
+    CHECK((host_dhcsr(bank) & S_RESET_ST) == 0U);
+  }
+
+  put32(&request[1], 0U);
+  CHECK(command(request) == ((6U << 16) | 6U));
+  host_setup(HOST_SELECT);
+}
+
+// Probe side polls, in a host session and on a port the probe connected
+static void test_begin (void) {
+  Target_Host_t host;
+  uint32_t sequences;
+  uint32_t value;
+  uint8_t request[2];
+
+  host_setup(0xF0U);
+  CHECK(Target_Begin(&host) == DAP_TRANSFER_OK);
+  CHECK(Target_Read32(MODEL_RAM_BASE, &value) == DAP_TRANSFER_OK);
+  Target_End(&host);
+  host_check("Begin session", 0xF0U);
+
+  // Sticky error of the host: left alone for the host to see
+  Model.ctrl_stat |= 0x20U;
+  Model.transfers = 0U;
+  CHECK(Target_Begin(&host) != DAP_TRANSFER_OK);
+  Target_End(&host);
+  CHECK((Model.transfers == 1U) && ((Model.ctrl_stat & 0x20U) != 0U));
+  Model.ctrl_stat &= ~0x20U;
+  host_check("Begin sticky", 0xF0U);
+
+  // No host session: connected once, kept until released
+  request[0] = ID_DAP_Disconnect;
+  CHECK(command(request) == ((1U << 16) | 2U));
+  sequences = Model.sequences;
+  CHECK(Target_Begin(&host) == DAP_TRANSFER_OK);
+  Target_End(&host);
+  CHECK(Model.sequences != sequences);
+  sequences = Model.sequences;
+  CHECK(Target_Begin(&host) == DAP_TRANSFER_OK);
+  CHECK(Target_Read32(MODEL_RAM_BASE, &value) == DAP_TRANSFER_OK);
+  Target_End(&host);
+  CHECK(Model.sequences == sequences);
+  CHECK(DAP_Data.debug_port == DAP_PORT_SWD);
+
+  // A host connect takes the port over, polls save and restore again
+  request[0] = ID_DAP_Connect;
+  request[1] = DAP_PORT_SWD;
+  CHECK(command(request) == ((2U << 16) | 2U));
+  host_setup(HOST_SELECT);
+  CHECK(Target_Begin(&host) == DAP_TRANSFER_OK);
+  CHECK(Target_Write32(MODEL_RAM_BASE, 0U) == DAP_TRANSFER_OK);
+  Target_End(&host);
+  host_check("Begin after connect", HOST_SELECT);
+
+  // Released by the probe: a host session stays
+  Target_Release();
+  CHECK(DAP_Data.debug_port == DAP_PORT_SWD);
+}
+
+// Rom Discover request of AP 0: ROM tables followed, entries per table, first record
+static uint32_t rom_discover (uint32_t depth, uint32_t entries, uint32_t first) {
+  uint8_t request[8];
+
+  request[0] = ID_DAP_RomDiscover;
+  request[1] = 0U;
+  request[2] = (uint8_t)depth;
+  request[3] = (uint8_t)entries;
+  request[4] = (uint8_t)(entries >> 8);
+  request[5] = (uint8_t)first;
+  request[6] = (uint8_t)(first >> 8);
+  request[7] = 0U;
+  return (command(request));
+}
+
+// Component address of record n: the ROM table at 0, then ROM_COMPONENTS components
+#define ROM_COMPONENTS  40U
+#define ROM_RECORDS     ((DAP_PACKET_SIZE - 6U) / 16U)
+
+static uint32_t rom_address (uint32_t n) {
+  return ((n == 0U) ? 0U : (0x10000U + ((n - 1U) * 0x1000U)));
+}
+
+// Lists longer than the cache are passed on page by page while walking
+static void test_rom (void) {
+  uint32_t first;
+  uint32_t num;
+  uint32_t n;
+
+  // Class 1 ROM table at BASE 0, components without readable IDs
+  model_write(0xFF0U, 0x0DU);
+  model_write(0xFF4U, 0x10U);
+  model_write(0xFF8U, 0x05U);
+  model_write(0xFFCU, 0xB1U);
+  for (n = 0U; n < ROM_COMPONENTS; n++) {
+    model_write(n * 4U, rom_address(n + 1U) | 1U);
+  }
+
+  for (first = 0U; first <= (ROM_COMPONENTS + 1U); first += ROM_RECORDS) {
+    num = rom_discover(8U, 0U, first);
+    n = ((ROM_COMPONENTS + 1U - first) < ROM_RECORDS) ? (ROM_COMPONENTS + 1U - first) : ROM_RECORDS;
+    CHECK(num == ((8U << 16) | (6U + (16U * n))));
+    CHECK(Response[1] == DAP_OK);
+    CHECK(Response[2] == 0x04U);                // Cached in part, walked
+    CHECK((Response[3] | (Response[4] << 8)) == (ROM_COMPONENTS + 1U));
+    CHECK(Response[5] == n);
+    for (n = 0U; n < Response[5]; n++) {
+      CHECK(get32(&Response[6U + (16U * n)]) == rom_address(first + n));
+      CHECK(Response[6U + (16U * n) + 10U] == ((first + n) == 0U ? 0U : 1U));
+    }
+  }
+
+  // A short list is cached whole
+  CHECK(rom_discover(8U, 8U, 0U) == ((8U << 16) | (6U + (16U * 9U))));
+  CHECK(Response[2] == 0x00U);
+  CHECK(rom_discover(8U, 8U, 4U) == ((8U << 16) | (6U + (16U * 5U))));
+  CHECK(Response[2] == 0x01U);
+  CHECK(get32(&Response[6]) == rom_address(4U));
+}
+
+int main (void) {
+  uint8_t request[8];
+
+  model_reset();
+  DAP_Setup();
+  request[0] = ID_DAP_Connect;
+  request[1] = DAP_PORT_SWD;
+  CHECK(command(request) == ((2U << 16) | 2U));
+
+  // Debug and system power-up
+  request[0] = ID_DAP_Transfer;
+  request[1] = 0U;
+  request[2] = 1U;
+  request[3] = DP_CTRL_STAT;
+  put32(&request[4], DP_CTRL_CSYSPWRUPREQ | DP_CTRL_CDBGPWRUPREQ);
+  CHECK(command(request) == ((8U << 16) | 3U));
+
+  test_core();
+  test_scatter();
+  test_sample();
+  test_sticky();
+  test_begin();
+  test_rom();
+
+  if (failed != 0) {
+    printf("test_target: %d checks failed\n", failed);
+    return (1);
+  }
+  printf("test_target: passed\n");
+  return (0);
+}
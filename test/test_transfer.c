@@ -0,0 +1,554 @@
+/*
+ * DAP_Transfer on a model SWD target: the op table decoded from a request
+ * has to put the same transfers on the wire and the same data into the
+ * response as the request describes, including posted AP reads, the RDBUFF
+ * flush and write check, value match and requests that do not fit a packet
+ * or what is left of it, and FAULT recovery of DAP_TransferBlock.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "DAP_config.h"
+#include "DAP.h"
+
+uint32_t test_time_us;
+
+static int failed;
+
+#define CHECK(cond) do { if (!(cond)) { printf("%s:%d: %s\n", __FILE__, __LINE__, #cond); failed++; } } while (0)
+
+// Model target: DP IDCODE, CTRL/STAT, SELECT and RDBUFF, one bank of AP registers
+#define TARGET_IDCODE   0x0BB11477U
+
+static struct {
+  uint32_t ctrl_stat;
+  uint32_t select;
+  uint32_t rdbuff;
+  uint32_t ap[4];
+  uint32_t ap3_reads;           // AP register 3 counts its own reads
+  uint32_t waits;               // WAIT responses before the next transfer is accepted
+  uint32_t fault_at;            // wire transfer answered with FAULT, 0 for none
+  uint8_t  wire[256];           // requests on the wire
+  uint32_t wire_count;
+} Target;
+
+uint8_t SWD_Transfer (uint32_t request, uint32_t *data) {
+  uint32_t reg = (request >> 2) & 3U;
+
+  if (Target.wire_count < sizeof(Target.wire)) {
+    Target.wire[Target.wire_count] = (uint8_t)(request & 0x0FU);
+  }
+  Target.wire_count++;
+  if (Target.fault_at == Target.wire_count) {
+    return (DAP_TRANSFER_FAULT);
+  }
+  if (Target.waits != 0U) {
+    Target.waits--;
+    return (DAP_TRANSFER_WAIT);
+  }
+
+  if ((request & DAP_TRANSFER_APnDP) != 0U) {
+    if ((request & DAP_TRANSFER_RnW) != 0U) {
+      // Return the previous AP read, post this one
+      if (data != NULL) {
+        *data = Target.rdbuff;
+      }
+      if (reg == 3U) {
+        Target.ap[3] = ++Target.ap3_reads;
+      }
+      Target.rdbuff = Target.ap[reg];
+    } else {
+      Target.ap[reg] = *data;
+    }
+    return (DAP_TRANSFER_OK);
+  }
+
+  if ((request & DAP_TRANSFER_RnW) != 0U) {
+    switch (reg) {
+      case 0U: *data = TARGET_IDCODE;    break;
+      case 1U: *data = Target.ctrl_stat; break;
+      case 2U: *data = 0U;               break;
+      case 3U: if (data != NULL) { *data = Target.rdbuff; } break;
+    }
+  } else {
+    switch (reg) {
+      case 1U: Target.ctrl_stat = *data; break;
+      case 2U: Target.select    = *data; break;
+      default:                           break;
+    }
+  }
+  return (DAP_TRANSFER_OK);
+}
+
+void SWD_Sequence (uint32_t info, const uint8_t *swdo, uint8_t *swdi) {
+  (void)info; (void)swdo;
+  if (swdi != NULL) {
+    *swdi = 0U;
+  }
+}
+
+void SWJ_Sequence (uint32_t count, const uint8_t *data) {
+  (void)count; (void)data;
+}
+
+void SWD_Idle (uint32_t cycles) {
+  (void)cycles;
+}
+
+// Probe side target access is not linked
+void Target_Release (void) {}
+
+// Target tuning is not linked, nothing is stored
+void DAP_TuneConnect (void) {}
+void DAP_TuneDisconnect (void) {}
+uint32_t DAP_TuneClock (uint32_t clock) { return (clock); }
+void DAP_TuneTransfer (void) {}
+
+
+static uint8_t  Request [DAP_PACKET_SIZE];
+static uint8_t  Response[DAP_PACKET_SIZE];
+static uint32_t RequestLength;
+
+static void target_reset (void) {
+  memset(&Target, 0, sizeof(Target));
+  Target.ap[0] = 0x11111111U;
+  Target.ap[1] = 0x22222222U;
+  Target.ap[2] = 0x33333333U;
+}
+
+static void request_start (uint32_t count) {
+  Request[0] = ID_DAP_Transfer;
+  Request[1] = 0U;
+  Request[2] = (uint8_t)count;
+  RequestLength = 3U;
+}
+
+static void request_add (uint32_t request) {
+  Request[RequestLength++] = (uint8_t)request;
+}
+
+static void request_add_data (uint32_t request, uint32_t data) {
+  request_add(request);
+  Request[RequestLength++] = (uint8_t) data;
+  Request[RequestLength++] = (uint8_t)(data >>  8);
+  Request[RequestLength++] = (uint8_t)(data >> 16);
+  Request[RequestLength++] = (uint8_t)(data >> 24);
+}
+
+static uint32_t response_word (uint32_t n) {
+  const uint8_t *p = &Response[3U + (4U * n)];
+  return ((uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+}
+
+// Process the request, returns the response length, checks the request length
+static uint32_t transfer (void) {
+  uint32_t num;
+
+  memset(Response, 0xA5, sizeof(Response));
+  num = DAP_ProcessCommand(Request, Response);
+  CHECK((num >> 16) == RequestLength);
+  CHECK(Response[0] == ID_DAP_Transfer);
+  return (num & 0xFFFFU);
+}
+
+static int wire_is (const uint8_t *expected, uint32_t count) {
+  return ((Target.wire_count == count) && (memcmp(Target.wire, expected, count) == 0));
+}
+
+#define RD_DP(a)   (DAP_TRANSFER_RnW | (a))
+#define WR_DP(a)   (a)
+#define RD_AP(a)   (DAP_TRANSFER_RnW | DAP_TRANSFER_APnDP | (a))
+#define WR_AP(a)   (DAP_TRANSFER_APnDP | (a))
+#define RDBUFF     RD_DP(DP_RDBUFF)
+
+// AP reads in a row are posted, the data of the last one comes from RDBUFF
+static void test_posted_reads (void) {
+  static const uint8_t wire[] = { RD_DP(DP_IDCODE), RD_AP(0x0), RD_AP(0x4), RD_AP(0x8), RDBUFF };
+
+  target_reset();
+  request_start(4U);
+  request_add(RD_DP(DP_IDCODE));
+  request_add(RD_AP(0x0));
+  request_add(RD_AP(0x4));
+  request_add(RD_AP(0x8));
+  CHECK(transfer() == 3U + 16U);
+  CHECK(Response[1] == 4U);
+  CHECK(Response[2] == DAP_TRANSFER_OK);
+  CHECK(response_word(0U) == TARGET_IDCODE);
+  CHECK(response_word(1U) == 0x11111111U);
+  CHECK(response_word(2U) == 0x22222222U);
+  CHECK(response_word(3U) == 0x33333333U);
+  CHECK(wire_is(wire, sizeof(wire)));
+}
+
+// A DP read or a write after a posted AP read flushes it through RDBUFF first
+static void test_flush (void) {
+  static const uint8_t wire[] = { RD_AP(0x4), RDBUFF, RD_DP(DP_CTRL_STAT), RD_AP(0x8), RDBUFF, WR_AP(0x0), RDBUFF };
+
+  target_reset();
+  Target.ctrl_stat = 0xF0000000U;
+  request_start(4U);
+  request_add(RD_AP(0x4));
+  request_add(RD_DP(DP_CTRL_STAT));
+  request_add(RD_AP(0x8));
+  request_add_data(WR_AP(0x0), 0xCAFEF00DU);
+  CHECK(transfer() == 3U + 12U);
+  CHECK(Response[1] == 4U);
+  CHECK(Response[2] == DAP_TRANSFER_OK);
+  CHECK(response_word(0U) == 0x22222222U);
+  CHECK(response_word(1U) == 0xF0000000U);
+  CHECK(response_word(2U) == 0x33333333U);
+  CHECK(Target.ap[0] == 0xCAFEF00DU);
+  CHECK(wire_is(wire, sizeof(wire)));
+}
+
+// Writes are checked with an RDBUFF read after the last one only
+static void test_write_check (void) {
+  static const uint8_t wire[] = { WR_DP(DP_SELECT), WR_AP(0x4), WR_AP(0xC), RDBUFF };
+
+  target_reset();
+  request_start(3U);
+  request_add_data(WR_DP(DP_SELECT), 0x01000000U);
+  request_add_data(WR_AP(0x4), 0x12345678U);
+  request_add_data(WR_AP(0xC), 0x9ABCDEF0U);
+  CHECK(transfer() == 3U);
+  CHECK(Response[1] == 3U);
+  CHECK(Response[2] == DAP_TRANSFER_OK);
+  CHECK(Target.select == 0x01000000U);
+  CHECK(Target.ap[1] == 0x12345678U);
+  CHECK(Target.ap[3] == 0x9ABCDEF0U);
+  CHECK(wire_is(wire, sizeof(wire)));
+
+  // A read after the last write needs no check
+  target_reset();
+  request_start(2U);
+  request_add_data(WR_AP(0x4), 0x12345678U);
+  request_add(RD_DP(DP_IDCODE));
+  CHECK(transfer() == 3U + 4U);
+  CHECK(Response[2] == DAP_TRANSFER_OK);
+  CHECK(Target.wire_count == 2U);
+}
+
+// Value match reads until the masked value matches or match retry runs out
+static void test_match (void) {
+  uint8_t cmd[6];
+  uint8_t rsp[2];
+
+  // Retry 0, match retry 10
+  cmd[0] = ID_DAP_TransferConfigure;
+  cmd[1] = 0U;
+  cmd[2] = 0U; cmd[3] = 0U;
+  cmd[4] = 10U; cmd[5] = 0U;
+  CHECK(DAP_ProcessCommand(cmd, rsp) == ((6U << 16) | 2U));
+
+  // AP register 3 counts its reads: posted read, then reads returning 1 to 5
+  target_reset();
+  request_start(3U);
+  request_add(RD_AP(0x0));
+  request_add_data(WR_DP(DP_RDBUFF) | DAP_TRANSFER_MATCH_MASK, 0x000000FFU);
+  request_add_data(RD_AP(0xC) | DAP_TRANSFER_MATCH_VALUE, 5U);
+  CHECK(transfer() == 3U + 4U);
+  CHECK(Response[1] == 3U);
+  CHECK(Response[2] == DAP_TRANSFER_OK);
+  CHECK(response_word(0U) == 0x11111111U);
+  CHECK(Target.wire_count == 2U + 6U);
+
+  // The mask leaves the upper bits out, a value that never matches ends with MISMATCH
+  target_reset();
+  Target.ctrl_stat = 0xA0000001U;
+  request_start(2U);
+  request_add_data(WR_DP(DP_RDBUFF) | DAP_TRANSFER_MATCH_MASK, 0x0000000FU);
+  request_add_data(RD_DP(DP_CTRL_STAT) | DAP_TRANSFER_MATCH_VALUE, 1U);
+  CHECK(transfer() == 3U);
+  CHECK(Response[1] == 2U);
+  CHECK(Response[2] == DAP_TRANSFER_OK);
+  CHECK(Target.wire_count == 1U);
+
+  target_reset();
+  request_start(1U);
+  request_add_data(RD_DP(DP_CTRL_STAT) | DAP_TRANSFER_MATCH_VALUE, 2U);
+  CHECK(transfer() == 3U);
+  CHECK(Response[1] == 0U);
+  CHECK(Response[2] == (DAP_TRANSFER_OK | DAP_TRANSFER_MISMATCH));
+  CHECK(Target.wire_count == 11U);
+}
+
+// WAIT is retried up to the retry count, FAULT ends the request
+static void test_wait_fault (void) {
+  uint8_t cmd[6];
+  uint8_t rsp[2];
+
+  cmd[0] = ID_DAP_TransferConfigure;
+  cmd[1] = 0U;
+  cmd[2] = 3U; cmd[3] = 0U;
+  cmd[4] = 0U; cmd[5] = 0U;
+  CHECK(DAP_ProcessCommand(cmd, rsp) == ((6U << 16) | 2U));
+
+  target_reset();
+  Target.waits = 3U;
+  request_start(1U);
+  request_add(RD_DP(DP_IDCODE));
+  CHECK(transfer() == 3U + 4U);
+  CHECK(Response[1] == 1U);
+  CHECK(Response[2] == DAP_TRANSFER_OK);
+  CHECK(response_word(0U) == TARGET_IDCODE);
+  CHECK(Target.wire_count == 4U);
+
+  target_reset();
+  Target.waits = 4U;
+  request_start(1U);
+  request_add(RD_DP(DP_IDCODE));
+  CHECK(transfer() == 3U);
+  CHECK(Response[1] == 0U);
+  CHECK(Response[2] == DAP_TRANSFER_WAIT);
+
+  // FAULT on the third AP read: two transfers done, one word of data
+  target_reset();
+  Target.fault_at = 3U;
+  request_start(4U);
+  request_add(RD_AP(0x0));
+  request_add(RD_AP(0x4));
+  request_add(RD_AP(0x8));
+  request_add(RD_AP(0x0));
+  CHECK(transfer() == 3U + 4U);
+  CHECK(Response[1] == 2U);
+  CHECK(Response[2] == DAP_TRANSFER_FAULT);
+  CHECK(response_word(0U) == 0x11111111U);
+  CHECK(Target.wire_count == 3U);
+}
+
+static void wait_configure (uint32_t adaptive) {
+  uint8_t request[3];
+  uint8_t response;
+
+  request[0] = (uint8_t)adaptive;
+  request[1] = 16U;
+  request[2] = 0U;
+  CHECK(DAP_WaitConfigure(request, &response) == ((3U << 16) | 1U));
+  CHECK(response == DAP_OK);
+}
+
+// WAIT statistics of the first tracked AP: transfers, waits, timeouts; cleared after reading
+static void wait_statistics (uint32_t *statistics) {
+  uint8_t request = 0x01U;
+  uint8_t response[1U + (4U * 14U)];
+
+  CHECK(DAP_WaitStatistics(&request, response) == ((1U << 16) | sizeof(response)));
+  CHECK(response[1] == 1U);
+  statistics[0] = (uint32_t)response[5] | ((uint32_t)response[6] << 8) |
+                  ((uint32_t)response[7] << 16) | ((uint32_t)response[8] << 24);
+  statistics[1] = (uint32_t)response[9] | ((uint32_t)response[10] << 8) |
+                  ((uint32_t)response[11] << 16) | ((uint32_t)response[12] << 24);
+  statistics[2] = (uint32_t)response[13] | ((uint32_t)response[14] << 8);
+}
+
+// WAIT statistics are kept with adaptive WAIT handling off and on
+static void test_wait_statistics (void) {
+  uint32_t statistics[3];
+  uint32_t adaptive;
+
+  for (adaptive = 0U; adaptive <= 1U; adaptive++) {
+    wait_configure(adaptive);
+    wait_statistics(statistics);
+    target_reset();
+    request_start(1U);
+    request_add_data(WR_DP(DP_SELECT), 0U);
+    CHECK(transfer() == 3U);
+    Target.waits = 2U;
+    request_start(3U);
+    request_add(RD_AP(0x0));
+    request_add(RD_DP(DP_IDCODE));
+    request_add(RD_AP(0x4));
+    CHECK(transfer() == 3U + 12U);
+    CHECK(Response[1] == 3U);
+    wait_statistics(statistics);
+    CHECK((statistics[0] == 2U) && (statistics[1] == 2U) && (statistics[2] == 0U));
+
+    // Out of retries
+    target_reset();
+    Target.waits = 100U;
+    request_start(1U);
+    request_add(RD_AP(0x0));
+    CHECK(transfer() == 3U);
+    CHECK(Response[2] == DAP_TRANSFER_WAIT);
+    wait_statistics(statistics);
+    CHECK((statistics[0] == 1U) && (statistics[1] == 4U) && (statistics[2] == 1U));
+  }
+  wait_configure(0U);
+}
+
+// Requests whose data or response do not fit a packet are refused before any transfer
+static void test_packet_size (void) {
+  uint32_t n;
+
+  // 128 AP reads respond with 512 bytes of data, the packet holds 509
+  target_reset();
+  request_start(128U);
+  for (n = 0U; n < 128U; n++) {
+    request_add(RD_AP(0x0));
+  }
+  RequestLength = 3U + 127U;    // the request length covers the transfers that fit
+  CHECK(transfer() == 3U);
+  CHECK(Response[1] == 0U);
+  CHECK(Response[2] == DAP_TRANSFER_ERROR);
+  CHECK(Target.wire_count == 0U);
+
+  // 127 fit
+  target_reset();
+  request_start(127U);
+  for (n = 0U; n < 127U; n++) {
+    request_add(RD_AP(0x0));
+  }
+  CHECK(transfer() == 3U + (127U * 4U));
+  CHECK(Response[1] == 127U);
+  CHECK(Response[2] == DAP_TRANSFER_OK);
+  CHECK(Target.wire_count == 128U);
+
+  // 102 writes need 510 bytes of request data, the data of the last one is cut off
+  target_reset();
+  request_start(102U);
+  for (n = 0U; n < 101U; n++) {
+    request_add_data(WR_AP(0x4), n + 1U);
+  }
+  Request[RequestLength] = WR_AP(0x4);
+  CHECK(transfer() == 3U);
+  CHECK(Response[1] == 0U);
+  CHECK(Response[2] == DAP_TRANSFER_ERROR);
+  CHECK(Target.wire_count == 0U);
+  CHECK(Target.ap[1] == 0x22222222U);
+}
+
+// Transfer Block of count AP DRW reads, returns the response length
+static uint32_t block_read (uint32_t count) {
+  uint32_t num;
+
+  Request[0] = ID_DAP_TransferBlock;
+  Request[1] = 0U;
+  Request[2] = (uint8_t)count;
+  Request[3] = (uint8_t)(count >> 8);
+  Request[4] = RD_AP(AP_DRW);
+  memset(Response, 0xA5, sizeof(Response));
+  num = DAP_ProcessCommand(Request, Response);
+  CHECK((num >> 16) == 5U);
+  return (num & 0xFFFFU);
+}
+
+static uint32_t fault_configure (uint32_t mode, uint32_t retry) {
+  uint8_t request[2];
+  uint8_t response;
+
+  request[0] = (uint8_t)mode;
+  request[1] = (uint8_t)retry;
+  CHECK(DAP_TransferFaultConfigure(request, &response) == ((2U << 16) | 1U));
+  return (response);
+}
+
+// FAULT status: count, first and last word index, CTRL/STAT
+static void fault_status (uint32_t *status) {
+  uint8_t response[10];
+
+  CHECK(DAP_TransferFaultStatus(response) == 10U);
+  status[0] = (uint32_t)response[0] | ((uint32_t)response[1] << 8);
+  status[1] = (uint32_t)response[2] | ((uint32_t)response[3] << 8);
+  status[2] = (uint32_t)response[4] | ((uint32_t)response[5] << 8);
+  status[3] = (uint32_t)response[6] | ((uint32_t)response[7] << 8) |
+              ((uint32_t)response[8] << 16) | ((uint32_t)response[9] << 24);
+}
+
+// FAULT recovery skips a faulting word; turned off, the status of the last block is gone
+static void test_fault_recovery (void) {
+  uint32_t status[4];
+
+  CHECK(fault_configure(DAP_FAULT_RECOVERY_SKIP, 0U) == DAP_OK);
+  target_reset();
+  Target.ap[0] = 0x23000012U;   // CSW: 32-bit, auto-increment single
+  Target.ap[1] = 0x20000000U;   // TAR
+  Target.ctrl_stat = 0x20U;
+  // CSW and TAR read for the recovery, post, word 0, then word 1 faults
+  Target.fault_at = 3U + 3U;
+  CHECK(block_read(8U) == 4U + (8U * 4U));
+  CHECK((Response[1] | (Response[2] << 8)) == 8U);
+  CHECK(Response[3] == DAP_TRANSFER_OK);
+  CHECK(memcmp(&Response[4U + 4U], "\0\0\0\0", 4U) == 0);     // skipped word 1
+  fault_status(status);
+  CHECK((status[0] == 1U) && (status[1] == 1U) && (status[2] == 1U) && (status[3] == 0x20U));
+
+  CHECK(fault_configure(DAP_FAULT_RECOVERY_OFF, 0U) == DAP_OK);
+  fault_status(status);
+  CHECK((status[0] == 0U) && (status[1] == 0U) && (status[2] == 0U) && (status[3] == 0U));
+
+  // Without recovery a FAULT ends the block and is not reported
+  target_reset();
+  Target.fault_at = 3U;
+  CHECK(block_read(8U) == 4U + 4U);
+  CHECK(Response[3] == DAP_TRANSFER_FAULT);
+  fault_status(status);
+  CHECK(status[0] == 0U);
+}
+
+// Behind another command of DAP_ExecuteCommands the response space left bounds the transfers
+static void test_execute_space (void) {
+  static uint8_t response[DAP_PACKET_SIZE + 64U];
+  uint32_t length;
+  uint32_t num;
+  uint32_t n;
+
+  target_reset();
+  Request[0] = ID_DAP_ExecuteCommands;
+  Request[1] = 2U;
+  length = 2U;
+  // 100 IDCODE reads leave room for the data of 26 reads behind them
+  Request[length++] = ID_DAP_Transfer;
+  Request[length++] = 0U;
+  Request[length++] = 100U;
+  for (n = 0U; n < 100U; n++) {
+    Request[length++] = RD_DP(DP_IDCODE);
+  }
+  // 27 fit into a packet of their own, not behind
+  Request[length++] = ID_DAP_Transfer;
+  Request[length++] = 0U;
+  Request[length++] = 27U;
+  for (n = 0U; n < 27U; n++) {
+    Request[length++] = RD_DP(DP_IDCODE);
+  }
+
+  memset(response, 0xA5, sizeof(response));
+  num = DAP_ExecuteCommand(Request, response);
+  CHECK((num >> 16) == (length - 1U));   // the request length covers the transfers that fit
+  CHECK((num & 0xFFFFU) == (2U + 3U + 400U + 3U));
+  CHECK(response[1] == 2U);
+  CHECK(response[5 + 400 + 1] == 0U);
+  CHECK(response[5 + 400 + 2] == DAP_TRANSFER_ERROR);
+  CHECK(Target.wire_count == 100U);
+  for (n = DAP_PACKET_SIZE; n < sizeof(response); n++) {
+    CHECK(response[n] == 0xA5U);
+  }
+}
+
+int main (void) {
+  uint8_t cmd[2];
+  uint8_t rsp[2];
+
+  cmd[0] = ID_DAP_Connect;
+  cmd[1] = DAP_PORT_SWD;
+  CHECK(DAP_ProcessCommand(cmd, rsp) == ((2U << 16) | 2U));
+  CHECK(rsp[1] == DAP_PORT_SWD);
+
+  test_posted_reads();
+  test_flush();
+  test_write_check();
+  test_match();
+  test_wait_fault();
+  test_wait_statistics();
+  test_packet_size();
+  test_execute_space();
+  test_fault_recovery();
+
+  if (failed != 0) {
+    printf("test_transfer: %d checks failed\n", failed);
+    return (1);
+  }
+  printf("test_transfer: passed\n");
+  return (0);
+}
@@ -0,0 +1,55 @@
+#include "kv_store.h"
+#include "tune_store.h"
+
+/* Tuning records use keys with bit 31 set, settings keys stay below */
+#define TUNE_KEY_FLAG           0x80000000U
+
+/* Record value: both keys, then the data words */
+#define RECORD_WORDS            (2U + TUNE_STORE_DATA_WORDS)
+
+static uint32_t tune_key(uint32_t key0, uint32_t key1)
+{
+    return TUNE_KEY_FLAG | ((key0 ^ (key1 * 0x9E3779B1U)) & ~TUNE_KEY_FLAG);
+}
+
+/**
+ * @brief Look up the tuning data stored for a target.
+ *
+ * The store key is a hash of both keys, the full keys are kept in the
+ * value and compared so a hash collision is never matched.
+ *
+ * @return 1 when data has been copied, 0 when no record matches.
+ */
+uint32_t tune_store_find(uint32_t key0, uint32_t key1, uint32_t *data)
+{
+    uint32_t record[RECORD_WORDS];
+    uint32_t n;
+
+    if ((kv_get(tune_key(key0, key1), record, sizeof(record)) != (int32_t)sizeof(record)) ||
+        (record[0] != key0) || (record[1] != key1))
+        return 0U;
+
+    for (n = 0U; n < TUNE_STORE_DATA_WORDS; n++)
+        data[n] = record[2U + n];
+    return 1U;
+}
+
+/**
+ * @brief Store the tuning data of a target in the key/value store.
+ *
+ * A target whose hash collides with another one replaces its record.
+ *
+ * @return 1 on success, 0 when the store is full or on flash error.
+ */
+uint32_t tune_store_save(uint32_t key0, uint32_t key1, const uint32_t *data)
+{
+    uint32_t record[RECORD_WORDS];
+    uint32_t n;
+
+    record[0] = key0;
+    record[1] = key1;
+    for (n = 0U; n < TUNE_STORE_DATA_WORDS; n++)
+        record[2U + n] = data[n];
+
+    return (kv_set(tune_key(key0, key1), record, sizeof(record)) == 0) ? 1U : 0U;
+}
@@ -0,0 +1,15 @@
+#ifndef _TUNE_STORE_H_
+#define _TUNE_STORE_H_
+
+#include <stdint.h>
+
+/* Tuning data words stored per target */
+#define TUNE_STORE_DATA_WORDS   2U
+
+/* Copies the latest data stored for the key, returns 0 when there is none */
+extern uint32_t tune_store_find(uint32_t key0, uint32_t key1, uint32_t *data);
+
+/* Stores data for the key, returns 0 when the store is full or on flash error */
+extern uint32_t tune_store_save(uint32_t key0, uint32_t key1, const uint32_t *data);
+
+#endif
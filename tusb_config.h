@@ -64,7 +64,7 @@
 //------------- CLASS -------------//
 #define CFG_TUD_HID             1
 #define CFG_TUD_CDC             1
-#define CFG_TUD_MSC             0
+#define CFG_TUD_MSC             1
 #define CFG_TUD_MIDI            0
 #define CFG_TUD_VENDOR          1
 
@@ -81,6 +81,9 @@
 #define CFG_TUD_VENDOR_RX_BUFSIZE 1024
 #define CFG_TUD_VENDOR_TX_BUFSIZE 1024
 
+/* One sector per transfer, the MSC drive generates and consumes whole sectors */
+#define CFG_TUD_MSC_EP_BUFSIZE 512
+
 #ifdef __cplusplus
  }
 #endif
@@ -28,6 +28,7 @@
 #include "tusb.h"
 #include "get_serial.h"
 #include "board_config.h"
+#include "msc_disk.h"
 
 //--------------------------------------------------------------------+
 // Device Descriptors
@@ -74,18 +75,31 @@ enum
   ITF_NUM_TOTAL
 };
 
+// MSC strap: the drag-and-drop drive takes the place of the CDC UART
+enum
+{
+  ITF_NUM_MSC_PROBE,
+  ITF_NUM_MSC,
+  ITF_NUM_MSC_TOTAL
+};
+
 #define CDC_NOTIFICATION_EP_NUM 0x81
 #define CDC_DATA_OUT_EP_NUM 0x02
 #define CDC_DATA_IN_EP_NUM 0x83
 #define DAP_OUT_EP_NUM 0x04
 #define DAP_IN_EP_NUM 0x85
+#define MSC_OUT_EP_NUM 0x02
+#define MSC_IN_EP_NUM 0x83
 
 #if (BOARD_DEBUG_PROTOCOL == PROTO_DAP_V1)
-#define CONFIG_TOTAL_LEN  (TUD_CONFIG_DESC_LEN + TUD_CDC_DESC_LEN + TUD_HID_INOUT_DESC_LEN)
+#define PROBE_DESC_LEN  TUD_HID_INOUT_DESC_LEN
 #else
-#define CONFIG_TOTAL_LEN  (TUD_CONFIG_DESC_LEN + TUD_CDC_DESC_LEN + TUD_VENDOR_DESC_LEN)
+#define PROBE_DESC_LEN  TUD_VENDOR_DESC_LEN
 #endif
 
+#define CONFIG_TOTAL_LEN      (TUD_CONFIG_DESC_LEN + TUD_CDC_DESC_LEN + PROBE_DESC_LEN)
+#define CONFIG_MSC_TOTAL_LEN  (TUD_CONFIG_DESC_LEN + PROBE_DESC_LEN + TUD_MSC_DESC_LEN)
+
 static uint8_t const desc_hid_report[] =
 {
   TUD_HID_REPORT_DESC_GENERIC_INOUT(CFG_TUD_HID_EP_BUFSIZE)
@@ -97,30 +111,47 @@ uint8_t const * tud_hid_descriptor_report_cb(uint8_t itf)
   return desc_hid_report;
 }
 
-uint8_t desc_configuration[] =
-{
-  TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL, 0, CONFIG_TOTAL_LEN, 0, 100),
-  // Interface 0
 #if (BOARD_DEBUG_PROTOCOL == PROTO_DAP_V1)
-  // HID (named interface)
-  TUD_HID_INOUT_DESCRIPTOR(ITF_NUM_PROBE, 4, HID_ITF_PROTOCOL_NONE, sizeof(desc_hid_report), DAP_OUT_EP_NUM, DAP_IN_EP_NUM, CFG_TUD_HID_EP_BUFSIZE, 1),
+// HID (named interface)
+#define PROBE_DESCRIPTOR(_itfnum) \
+  TUD_HID_INOUT_DESCRIPTOR(_itfnum, 4, HID_ITF_PROTOCOL_NONE, sizeof(desc_hid_report), DAP_OUT_EP_NUM, DAP_IN_EP_NUM, CFG_TUD_HID_EP_BUFSIZE, 1)
 #elif (BOARD_DEBUG_PROTOCOL == PROTO_DAP_V2)
-  // Bulk (named interface)
-  TUD_VENDOR_DESCRIPTOR(ITF_NUM_PROBE, 5, DAP_OUT_EP_NUM, DAP_IN_EP_NUM, 64),
+// Bulk (named interface)
+#define PROBE_DESCRIPTOR(_itfnum) \
+  TUD_VENDOR_DESCRIPTOR(_itfnum, 5, DAP_OUT_EP_NUM, DAP_IN_EP_NUM, 64)
 #elif (BOARD_DEBUG_PROTOCOL == PROTO_OPENOCD_CUSTOM)
-  // Bulk
-  TUD_VENDOR_DESCRIPTOR(ITF_NUM_PROBE, 0, DAP_OUT_EP_NUM, DAP_IN_EP_NUM, 64),
+// Bulk
+#define PROBE_DESCRIPTOR(_itfnum) \
+  TUD_VENDOR_DESCRIPTOR(_itfnum, 0, DAP_OUT_EP_NUM, DAP_IN_EP_NUM, 64)
 #endif
+
+uint8_t desc_configuration[] =
+{
+  TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL, 0, CONFIG_TOTAL_LEN, 0, 100),
+  // Interface 0
+  PROBE_DESCRIPTOR(ITF_NUM_PROBE),
   // Interface 1 + 2
   TUD_CDC_DESCRIPTOR(ITF_NUM_CDC_COM, 6, CDC_NOTIFICATION_EP_NUM, 64, CDC_DATA_OUT_EP_NUM, CDC_DATA_IN_EP_NUM, 64),
 };
 
+// Four endpoints are left besides the control pair, not enough for probe, CDC and MSC at once
+static uint8_t const desc_configuration_msc[] =
+{
+  TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_MSC_TOTAL, 0, CONFIG_MSC_TOTAL_LEN, 0, 100),
+  // Interface 0
+  PROBE_DESCRIPTOR(ITF_NUM_MSC_PROBE),
+  // Interface 1
+  TUD_MSC_DESCRIPTOR(ITF_NUM_MSC, 7, MSC_OUT_EP_NUM, MSC_IN_EP_NUM, 64),
+};
+
 // Invoked when received GET CONFIGURATION DESCRIPTOR
 // Application return pointer to descriptor
 // Descriptor contents must exist long enough for transfer to complete
 uint8_t const * tud_descriptor_configuration_cb(uint8_t index)
 {
   (void) index; // for multiple configurations
+  if (msc_disk_enabled())
+    return desc_configuration_msc;
   /* Hack in CAP_BREAK support */
   desc_configuration[CONFIG_TOTAL_LEN - TUD_CDC_DESC_LEN + 8 + 9 + 5 + 5 + 4 - 1] = 0x6;
   return desc_configuration;
@@ -140,6 +171,7 @@ char const* string_desc_arr [] =
   "CMSIS-DAP v1 Interface",		// 4: Interface descriptor for HID transport
   "CMSIS-DAP v2 Interface",		// 5: Interface descriptor for Bulk transport
   "CDC-ACM UART Interface",		// 6: Interface descriptor for CDC
+  "CMSIS-DAP MSC",			// 7: Interface descriptor for MSC
 };
 
 static uint16_t _desc_str[32];
@@ -0,0 +1,54 @@
+#!/usr/bin/env python3
+"""SWCLK actually generated by the probe, read with the CMSIS-DAP vendor
+command SWJ_ClockInfo.
+
+The probe times SWCLK against its delay timer at startup, so the clock it
+reports is measured, not derived from the cycle counts in DAP_config.h.
+Comparing two firmware builds, for example one with the bit-bang loops in
+SRAM and one with DAP_RAMFUNC defined as __attribute__((noinline)) so they
+stay in flash, shows what the placement gains.
+
+    dap_clock.py                          requested and generated clock per step
+    dap_clock.py 1000000 4000000 12000000 only these clocks
+
+SWJ_ClockInfo response, after the command ID:
+    calibrated (1 = measured), generated clock in Hz (4 bytes), fast clock,
+    clock delay (4 bytes)
+"""
+import argparse
+import struct
+import sys
+
+from dap_read import DAP_OK, Probe
+
+ID_DAP_SWJ_CLOCK = 0x11
+ID_DAP_SWJ_CLOCK_INFO = 0x85
+
+CLOCKS = [100000, 250000, 500000, 1000000, 2000000, 4000000, 6000000, 8000000, 12000000, 24000000]
+
+
+def clock_info(probe, clock):
+    """Requests a clock, returns (calibrated, generated clock, fast, delay)."""
+    if probe.command(struct.pack('<BI', ID_DAP_SWJ_CLOCK, clock))[1] != DAP_OK:
+        raise SystemExit('SWJ_Clock %d Hz failed' % clock)
+    return struct.unpack('<BIBI', probe.command([ID_DAP_SWJ_CLOCK_INFO])[1:11])
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('clock', type=int, nargs='*', help='requested clocks in Hz')
+    args = parser.parse_args()
+    probe = Probe()
+    calibrated = True
+    print('%12s %12s %5s %6s' % ('requested', 'generated', 'fast', 'delay'))
+    for clock in args.clock or CLOCKS:
+        cal, generated, fast, delay = clock_info(probe, clock)
+        calibrated = calibrated and cal
+        print('%12d %12d %5d %6d' % (clock, generated, fast, delay))
+    if not calibrated:
+        print('clock calibration failed, generated clocks are computed', file=sys.stderr)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
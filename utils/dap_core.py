@@ -0,0 +1,117 @@
+#!/usr/bin/env python3
+"""Core registers and single steps through the CMSIS-DAP vendor commands
+CoreRead, CoreWrite and CoreStep.
+
+The probe polls S_REGRDY itself, a register set costs one round trip instead
+of a DCRSR write, DHCSR poll and DCRDR read per register.
+
+    dap_core.py regs                          print r0-r12, sp, lr, pc, xpsr
+    dap_core.py write pc=0x100 r0=1           write registers
+    dap_core.py step --count 10 r0 r1         step, print pc, xpsr, sp, r0, r1
+
+The core has to be halted. Register masks select DCRSR selectors, bit n
+selecting selector n, values follow in selector order.
+
+CoreRead request: register mask (4 bytes)
+CoreRead response: status, register values
+CoreWrite request: register mask (4 bytes), register values
+CoreWrite response: status
+CoreStep request: flags (bit 0: interrupts masked), register mask (4 bytes)
+CoreStep response: status, DHCSR, PC, xPSR, SP, register values
+"""
+import argparse
+import struct
+import sys
+
+from dap_read import DAP_OK, Probe
+
+ID_DAP_CORE_READ = 0x94
+ID_DAP_CORE_WRITE = 0x95
+ID_DAP_CORE_STEP = 0x96
+
+NAMES = ['r%d' % n for n in range(13)] + ['sp', 'lr', 'pc', 'xpsr', 'msp', 'psp']
+SELECTORS = {name: n for n, name in enumerate(NAMES)}
+SELECTORS['special'] = 20
+STEP_MASKINTS = 0x01
+
+
+def selectors(mask):
+    return [n for n in range(32) if mask & (1 << n)]
+
+
+def name(selector):
+    return NAMES[selector] if selector < len(NAMES) else 'reg%d' % selector
+
+
+def register_mask(names):
+    mask = 0
+    for reg in names:
+        if reg not in SELECTORS:
+            raise SystemExit('unknown register %s' % reg)
+        mask |= 1 << SELECTORS[reg]
+    return mask
+
+
+def read(probe, mask):
+    resp = probe.command(struct.pack('<BI', ID_DAP_CORE_READ, mask))
+    if resp[1] != DAP_OK:
+        raise SystemExit('CoreRead failed, core halted?')
+    return dict(zip(selectors(mask), struct.unpack('<%dI' % len(selectors(mask)), resp[2:2 + 4 * len(selectors(mask))])))
+
+
+def write(probe, values):
+    mask = 0
+    for selector in values:
+        mask |= 1 << selector
+    data = b''.join(struct.pack('<I', values[n]) for n in selectors(mask))
+    if probe.command(struct.pack('<BI', ID_DAP_CORE_WRITE, mask) + data)[1] != DAP_OK:
+        raise SystemExit('CoreWrite failed, core halted?')
+
+
+def step(probe, mask, maskints):
+    """Steps once, returns (dhcsr, pc, xpsr, sp, {selector: value})."""
+    resp = probe.command(struct.pack('<BBI', ID_DAP_CORE_STEP, STEP_MASKINTS if maskints else 0, mask))
+    if resp[1] != DAP_OK:
+        raise SystemExit('CoreStep failed, core halted?')
+    dhcsr, pc, xpsr, sp = struct.unpack('<4I', resp[2:18])
+    count = len(selectors(mask))
+    values = dict(zip(selectors(mask), struct.unpack('<%dI' % count, resp[18:18 + 4 * count])))
+    return dhcsr, pc, xpsr, sp, values
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    sub = parser.add_subparsers(dest='cmd', required=True)
+    regs = sub.add_parser('regs')
+    regs.add_argument('names', nargs='*')
+    wr = sub.add_parser('write')
+    wr.add_argument('assignments', nargs='+', metavar='reg=value')
+    st = sub.add_parser('step')
+    st.add_argument('names', nargs='*')
+    st.add_argument('--count', type=int, default=1)
+    st.add_argument('--interrupts', action='store_true', help='step with interrupts enabled')
+    args = parser.parse_args()
+    probe = Probe()
+    probe.connect()
+    if args.cmd == 'regs':
+        values = read(probe, register_mask(args.names or NAMES[:17]))
+        for selector, value in values.items():
+            print('%-5s %08X' % (name(selector), value))
+    elif args.cmd == 'write':
+        values = {}
+        for assignment in args.assignments:
+            reg, _, value = assignment.partition('=')
+            if reg not in SELECTORS:
+                raise SystemExit('unknown register %s' % reg)
+            values[SELECTORS[reg]] = int(value, 0)
+        write(probe, values)
+    else:
+        mask = register_mask(args.names)
+        for _ in range(args.count):
+            _, pc, xpsr, sp, values = step(probe, mask, not args.interrupts)
+            print('pc %08X xpsr %08X sp %08X' % (pc, xpsr, sp) +
+                  ''.join(' %s %08X' % (name(n), v) for n, v in values.items()))
+
+
+if __name__ == '__main__':
+    sys.exit(main())
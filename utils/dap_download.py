@@ -0,0 +1,215 @@
+#!/usr/bin/env python3
+"""Compressed downloads through the CMSIS-DAP vendor commands DownloadOpen/Data/Close.
+
+The probe decodes heatshrink streams (window 2^w, lookahead 2^l) and writes the
+output to target memory or flash, so firmware images that are mostly zeros and
+padding cross the full-speed USB link in far fewer packets.
+
+    dap_download.py bench image.bin            compression ratio per window/lookahead
+    dap_download.py bench image.bin --probe    plus decode speed measured on the probe
+    dap_download.py flash image.bin            program the target flash, it stays halted
+    dap_download.py write image.bin 0x20000000 write target RAM
+"""
+import argparse
+import struct
+import sys
+import time
+
+from dap_read import DAP_OK, Probe
+
+ID_DAP_DOWNLOAD_OPEN = 0x8B
+ID_DAP_DOWNLOAD_DATA = 0x8C
+ID_DAP_DOWNLOAD_CLOSE = 0x8D
+
+MODE_MEMORY = 0
+MODE_FLASH = 1
+MODE_DISCARD = 2
+MODE_RAW = 0x80
+
+MIN_MATCH = 3
+CHAIN_DEPTH = 64
+
+
+def encode(data, window_bits, count_bits):
+    """Greedy heatshrink encoder, compatible with heatshrink -e -w window_bits -l count_bits."""
+    window = 1 << window_bits
+    count_max = 1 << count_bits
+    backref_bits = 1 + window_bits + count_bits
+    out = bytearray()
+    acc = 0
+    nbits = 0
+    chains = {}
+    pos = 0
+    size = len(data)
+
+    def put(value, bits):
+        nonlocal acc, nbits
+        acc = (acc << bits) | value
+        nbits += bits
+        while nbits >= 8:
+            nbits -= 8
+            out.append((acc >> nbits) & 0xFF)
+
+    def insert(p):
+        if p + MIN_MATCH <= size:
+            chains.setdefault(data[p:p + MIN_MATCH], []).append(p)
+
+    while pos < size:
+        best_len = 0
+        best_off = 0
+        limit = min(count_max, size - pos)
+        chain = chains.get(data[pos:pos + MIN_MATCH]) if limit >= MIN_MATCH else None
+        if chain:
+            while chain and chain[0] < pos - window:
+                chain.pop(0)
+            for cand in reversed(chain[-CHAIN_DEPTH:]):
+                n = MIN_MATCH
+                while n < limit and data[cand + n] == data[pos + n]:
+                    n += 1
+                if n > best_len:
+                    best_len = n
+                    best_off = pos - cand
+                    if n == limit:
+                        break
+        if best_len * 9 > backref_bits:
+            put(0, 1)
+            put(best_off - 1, window_bits)
+            put(best_len - 1, count_bits)
+            for p in range(pos, pos + best_len):
+                insert(p)
+            pos += best_len
+        else:
+            put(0x100 | data[pos], 9)
+            insert(pos)
+            pos += 1
+
+    if nbits:
+        put(0, 8 - nbits)
+    return bytes(out)
+
+
+def decode(stream, window_bits, count_bits):
+    """Reference decoder, the same algorithm as DAP_download.c."""
+    mask = (1 << window_bits) - 1
+    window = bytearray(mask + 1)
+    head = 0
+    out = bytearray()
+    acc = 0
+    nbits = 0
+    for byte in stream:
+        acc = ((acc << 8) | byte) & 0xFFFFFFFF
+        nbits += 8
+        while nbits:
+            if (acc >> (nbits - 1)) & 1:
+                if nbits < 9:
+                    break
+                nbits -= 9
+                offset = 0
+                count = 1
+                literal = (acc >> nbits) & 0xFF
+            else:
+                if nbits < 1 + window_bits + count_bits:
+                    break
+                nbits -= 1 + window_bits + count_bits
+                ref = acc >> nbits
+                offset = ((ref >> count_bits) & mask) + 1
+                count = (ref & ((1 << count_bits) - 1)) + 1
+            for _ in range(count):
+                value = window[(head - offset) & mask] if offset else literal
+                window[head] = value
+                head = (head + 1) & mask
+                out.append(value)
+    return bytes(out)
+
+
+def data_ok(resp):
+    if resp[1] != DAP_OK:
+        raise SystemExit('DownloadData failed after %d bytes' % struct.unpack('<I', resp[2:6])[0])
+
+
+def download(probe, mode, address, payload, window_bits=0, count_bits=0, pipeline=4):
+    """Runs one download, returns (bytes output, decode us, write us, wall s)."""
+    start = time.perf_counter()
+    resp = probe.command(struct.pack('<BBIBB', ID_DAP_DOWNLOAD_OPEN, mode, address, window_bits, count_bits))
+    if resp[1] != DAP_OK:
+        raise SystemExit('DownloadOpen failed, probe window is at most %d bits' % resp[2])
+    chunk = probe.packet_size - 3
+    pending = 0
+    for off in range(0, len(payload), chunk):
+        part = payload[off:off + chunk]
+        probe.send(struct.pack('<BH', ID_DAP_DOWNLOAD_DATA, len(part)) + part)
+        pending += 1
+        if pending == pipeline:
+            data_ok(probe.receive())
+            pending -= 1
+    for _ in range(pending):
+        data_ok(probe.receive())
+    resp = probe.command([ID_DAP_DOWNLOAD_CLOSE])
+    wall = time.perf_counter() - start
+    status, total, decode_us, write_us = struct.unpack('<xBIII', resp[:14])
+    if status != DAP_OK:
+        raise SystemExit('download failed after %d bytes' % total)
+    return total, decode_us, write_us, wall
+
+
+def bench(args):
+    data = open(args.image, 'rb').read()
+    zeros = data.count(0) + data.count(0xFF)
+    print('%s: %d bytes, %.0f%% 0x00/0xFF' % (args.image, len(data), 100.0 * zeros / max(len(data), 1)))
+    probe = Probe() if args.probe else None
+    max_window = None
+    if probe:
+        total, decode_us, _, raw_wall = download(probe, MODE_DISCARD | MODE_RAW, 0, data)
+        print('raw: %d bytes in %.3f s, %.1f KB/s over USB' % (total, raw_wall, len(data) / raw_wall / 1024))
+        resp = probe.command(struct.pack('<BBIBB', ID_DAP_DOWNLOAD_OPEN, MODE_DISCARD, 0, 4, 3))
+        max_window = resp[2]
+        probe.command([ID_DAP_DOWNLOAD_CLOSE])
+
+    print(' w  l  compressed  ratio  encode s' + ('  decode us  decode MB/s  wall s  speedup' if probe else ''))
+    for window_bits in range(args.min_window, args.max_window + 1):
+        for count_bits in range(3, min(window_bits, 9)):
+            t = time.perf_counter()
+            packed = encode(data, window_bits, count_bits)
+            enc = time.perf_counter() - t
+            if decode(packed, window_bits, count_bits)[:len(data)] != data:
+                raise SystemExit('round trip failed for w=%d l=%d' % (window_bits, count_bits))
+            line = '%2d %2d  %10d  %5.2f  %8.2f' % (window_bits, count_bits, len(packed),
+                                                   len(data) / max(len(packed), 1), enc)
+            if probe and window_bits <= max_window:
+                total, decode_us, _, wall = download(probe, MODE_DISCARD, 0, packed, window_bits, count_bits)
+                line += '  %9d  %11.2f  %6.3f  %6.2fx' % (decode_us, total / max(decode_us, 1), wall, raw_wall / wall)
+            print(line)
+
+
+def program(args, mode, address):
+    data = open(args.image, 'rb').read()
+    packed = encode(data, args.window, args.lookahead)
+    probe = Probe()
+    total, decode_us, write_us, wall = download(probe, mode, address, packed, args.window, args.lookahead)
+    print('%d bytes as %d (%.2fx) in %.2f s, decode %.3f s, target writes %.2f s' %
+          (total, len(packed), len(data) / len(packed), wall, decode_us / 1e6, write_us / 1e6))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    sub = parser.add_subparsers(dest='cmd', required=True)
+    p = sub.add_parser('bench', help='compression ratio and probe decode speed')
+    p.add_argument('image')
+    p.add_argument('--probe', action='store_true', help='measure decode speed on a connected probe')
+    p.add_argument('--min-window', type=int, default=6)
+    p.add_argument('--max-window', type=int, default=12)
+    for name in ('flash', 'write'):
+        p = sub.add_parser(name)
+        p.add_argument('image')
+        p.add_argument('address', nargs='?', default='0', help='target address')
+        p.add_argument('-w', '--window', type=int, default=8)
+        p.add_argument('-l', '--lookahead', type=int, default=4)
+    args = parser.parse_args()
+    if args.cmd == 'bench':
+        bench(args)
+    else:
+        program(args, MODE_FLASH if args.cmd == 'flash' else MODE_MEMORY, int(args.address, 0))
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,87 @@
+#!/usr/bin/env python3
+"""Target halt, reset and lockup events through the CMSIS-DAP vendor commands
+EventConfigure and EventRead.
+
+The probe polls DHCSR itself, the host waits for a state change with one
+EventRead that the probe holds until an event is queued or the timeout
+passes, instead of polling DHCSR over USB while the target runs.
+
+    dap_events.py --period 1000                print events until interrupted
+    dap_events.py --events halt --count 1      wait for the next halt
+
+EventConfigure request, after the command ID:
+    period in us (4 bytes, 0 stops), event mask
+EventConfigure response: status, DHCSR (4 bytes)
+EventRead request: timeout in ms (2 bytes, at most 10000)
+EventRead response: status, events lost (2 bytes), number of records,
+    records: time in us (4 bytes), DHCSR (4 bytes), events
+"""
+import argparse
+import struct
+import sys
+
+from dap_read import DAP_OK, Probe
+
+ID_DAP_EVENT_CONFIGURE = 0x92
+ID_DAP_EVENT_READ = 0x93
+
+EVENTS = {'halt': 0x01, 'run': 0x02, 'reset': 0x04, 'lockup': 0x08}
+TIMEOUT_MAX = 10000
+
+
+def decode_read(response):
+    """Splits an EventRead response (without command ID) into (status, lost, records)."""
+    status, lost, count = struct.unpack('<BHB', response[:4])
+    records = [struct.unpack('<IIB', response[4 + n * 9:13 + n * 9]) for n in range(count)]
+    return status, lost, records
+
+
+def names(events):
+    return ','.join(name for name, bit in EVENTS.items() if events & bit)
+
+
+def mask(text):
+    bits = 0
+    for name in text.split(','):
+        if name not in EVENTS:
+            raise argparse.ArgumentTypeError('unknown event %s' % name)
+        bits |= EVENTS[name]
+    return bits
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('--period', type=int, default=1000, help='DHCSR poll period in us')
+    parser.add_argument('--events', type=mask, default=0x0F, help='comma separated: ' + ','.join(EVENTS))
+    parser.add_argument('--timeout', type=int, default=TIMEOUT_MAX, help='ms an EventRead is held')
+    parser.add_argument('--count', type=int, default=0, help='events, 0 runs until interrupted')
+    args = parser.parse_args()
+    probe = Probe()
+    probe.connect()
+    resp = probe.command(struct.pack('<BIB', ID_DAP_EVENT_CONFIGURE, args.period, args.events))
+    if resp[1] != DAP_OK:
+        raise SystemExit('EventConfigure failed')
+    print('DHCSR %08X' % struct.unpack('<I', resp[2:6])[0], file=sys.stderr)
+
+    request = struct.pack('<BH', ID_DAP_EVENT_READ, min(args.timeout, TIMEOUT_MAX))
+    events = 0
+    try:
+        while args.count == 0 or events < args.count:
+            # The response comes when the probe answers the held command
+            probe.ep_out.write(request)
+            status, lost, records = decode_read(bytes(probe.ep_in.read(512, timeout=args.timeout + 1000))[1:])
+            if status != DAP_OK:
+                raise SystemExit('event polling stopped')
+            if lost:
+                print('%d events lost' % lost, file=sys.stderr)
+            for time_us, dhcsr, bits in records:
+                print('%10.6f DHCSR %08X %s' % (time_us / 1e6, dhcsr, names(bits)))
+            events += len(records)
+            sys.stdout.flush()
+    except KeyboardInterrupt:
+        pass
+    probe.command(struct.pack('<BIB', ID_DAP_EVENT_CONFIGURE, 0, 0))
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,173 @@
+#!/usr/bin/env python3
+"""Memory dumps through the CMSIS-DAP vendor command ReadRLE.
+
+The probe sends repeated words as runs, so erased flash and zeroed RAM cost a
+few bytes per packet instead of four bytes per word.
+
+    dap_read.py 0x00000000 0x80000 flash.bin     dump 512 KB from MEM-AP 0
+
+Response format, after the command ID:
+    status, words read (2 bytes), format, data
+    format 0: the words, little endian
+    format 1: tokens 0nnnnnnn followed by n + 1 words,
+                     1nnnnnnn followed by one word repeated n + 1 times
+"""
+import argparse
+import struct
+import sys
+import time
+
+ID_DAP_CONNECT = 0x02
+ID_DAP_TRANSFER = 0x05
+ID_DAP_SWJ_SEQUENCE = 0x12
+ID_DAP_READ_RLE = 0x8E
+
+FORMAT_RAW = 0
+FORMAT_RLE = 1
+
+DP_ABORT = 0x00
+DP_CTRL_STAT = 0x04
+DP_POWERUP = 0x50000000
+DP_ABORT_CLEAR = 0x1E
+
+DAP_OK = 0
+DAP_TRANSFER_OK = 1
+WORDS_MAX = 0xFFFF
+
+
+def decode(response):
+    """Decodes a ReadRLE response (without command ID) into (status, words, data)."""
+    status, words, fmt = struct.unpack('<BHB', response[:4])
+    body = response[4:]
+    if fmt == FORMAT_RAW:
+        data = bytes(body[:words * 4])
+    elif fmt == FORMAT_RLE:
+        out = bytearray()
+        pos = 0
+        while len(out) < words * 4:
+            token = body[pos]
+            count = (token & 0x7F) + 1
+            if token & 0x80:
+                out += bytes(body[pos + 1:pos + 5]) * count
+                pos += 5
+            else:
+                out += body[pos + 1:pos + 1 + count * 4]
+                pos += 1 + count * 4
+        data = bytes(out)
+    else:
+        raise ValueError('unknown format %d' % fmt)
+    if len(data) != words * 4:
+        raise ValueError('response holds %d bytes for %d words' % (len(data), words))
+    return status, words, data
+
+
+class Probe:
+    """CMSIS-DAP v2 bulk interface, found by its interface string."""
+
+    def __init__(self):
+        import usb.core
+        import usb.util
+        for dev in usb.core.find(find_all=True):
+            try:
+                cfg = dev.get_active_configuration()
+            except usb.core.USBError:
+                continue
+            for intf in cfg:
+                if intf.bInterfaceClass != 0xFF or not intf.iInterface:
+                    continue
+                try:
+                    name = usb.util.get_string(dev, intf.iInterface)
+                except (usb.core.USBError, ValueError):
+                    continue
+                if name and 'CMSIS-DAP' in name:
+                    eps = list(intf)
+                    self.ep_out = next(e for e in eps if usb.util.endpoint_direction(e.bEndpointAddress) == usb.util.ENDPOINT_OUT)
+                    self.ep_in = next(e for e in eps if usb.util.endpoint_direction(e.bEndpointAddress) == usb.util.ENDPOINT_IN)
+                    usb.util.claim_interface(dev, intf)
+                    return
+        raise SystemExit('no CMSIS-DAP v2 probe found')
+
+    packet_size = 512
+
+    def send(self, data):
+        self.ep_out.write(bytes(data))
+
+    def receive(self):
+        return bytes(self.ep_in.read(self.packet_size, timeout=5000))
+
+    def command(self, data):
+        self.send(data)
+        return self.receive()
+
+    def connect(self):
+        """SWD connect and debug power-up, as a debugger does before memory access."""
+        if self.command([ID_DAP_CONNECT, 1])[1] != 1:
+            raise SystemExit('DAP_Connect failed')
+        self.command([ID_DAP_SWJ_SEQUENCE, 56] + [0xFF] * 7)
+        self.command([ID_DAP_SWJ_SEQUENCE, 16, 0x9E, 0xE7])
+        self.command([ID_DAP_SWJ_SEQUENCE, 56] + [0xFF] * 7)
+        self.command([ID_DAP_SWJ_SEQUENCE, 8, 0x00])
+        # Read DPIDR, clear sticky errors, request debug and system power
+        resp = self.command(struct.pack('<BBBB', ID_DAP_TRANSFER, 0, 3, 0x02) +
+                            struct.pack('<BI', DP_ABORT, DP_ABORT_CLEAR) +
+                            struct.pack('<BI', DP_CTRL_STAT, DP_POWERUP))
+        if resp[1] != 3 or resp[2] != DAP_TRANSFER_OK:
+            raise SystemExit('no target response')
+
+    def read(self, address, size):
+        data = bytearray()
+        while len(data) < size:
+            words = min((size - len(data) + 3) // 4, WORDS_MAX)
+            resp = self.command(struct.pack('<BIH', ID_DAP_READ_RLE, address + len(data), words))
+            status, count, chunk = decode(resp[1:])
+            if status != DAP_OK or count == 0:
+                raise SystemExit('read failed at 0x%08X' % (address + len(data) + len(chunk)))
+            data += chunk
+        return bytes(data[:size])
+
+
+class HostProbe(Probe):
+    """The firmware built for the host on a model target, test/host_probe from the
+    host tests build. Requests and responses go through its stdin and stdout, each
+    after its length (2 bytes)."""
+
+    def __init__(self, path):
+        import subprocess
+        self.proc = subprocess.Popen([path], stdin=subprocess.PIPE, stdout=subprocess.PIPE)
+
+    def send(self, data):
+        self.proc.stdin.write(struct.pack('<H', len(data)) + bytes(data))
+        self.proc.stdin.flush()
+
+    def receive(self):
+        length, = struct.unpack('<H', self.proc.stdout.read(2))
+        return self.proc.stdout.read(length)
+
+    def reset(self):
+        """Resets the model target and connects again."""
+        self.proc.stdin.write(b'\0\0')
+
+    def close(self):
+        self.proc.stdin.close()
+        return self.proc.wait()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('address', type=lambda x: int(x, 0))
+    parser.add_argument('size', type=lambda x: int(x, 0))
+    parser.add_argument('output')
+    args = parser.parse_args()
+    if args.address & 3:
+        raise SystemExit('address has to be word aligned')
+    probe = Probe()
+    probe.connect()
+    start = time.perf_counter()
+    data = probe.read(args.address, args.size)
+    elapsed = time.perf_counter() - start
+    open(args.output, 'wb').write(data)
+    print('%d bytes in %.2f s, %.1f KB/s' % (len(data), elapsed, len(data) / elapsed / 1024))
+
+
+if __name__ == '__main__':
+    sys.exit(main())
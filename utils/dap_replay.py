@@ -0,0 +1,198 @@
+#!/usr/bin/env python3
+"""Capture and replay of CMSIS-DAP command streams through the vendor
+commands CaptureControl and CaptureRead.
+
+The probe records every command it processes with its processing time and
+the CRC-32 of its response. A captured debugger session replayed against a
+probe and target in the same state shows changed responses and the time
+each command type takes, which makes a repeatable throughput benchmark.
+
+    dap_replay.py start                     start capturing, then run the debugger
+    dap_replay.py save session.cap          stop and drain into a file
+    dap_replay.py show session.cap          list the records
+    dap_replay.py replay session.cap        send the commands again and compare
+    dap_replay.py replay session.cap --sim build-test/host_probe
+                                            replay on the firmware built for the
+                                            host with a model target
+
+The debugger and this tool cannot share the probe, so the session has to
+end before save. Records that do not fit into the probe buffer are dropped
+and reported; drain long sessions in parts or raise DAP_CAPTURE_BUFFER_SIZE.
+Capture is left out of the default build (DAP_CAPTURE_BUFFER_SIZE 0), set a
+buffer size in DAP_config.h to use this tool on the probe. host_probe of the
+host tests build (test/CMakeLists.txt) has a capture buffer; replayed there,
+a session shows what a firmware change does to the processing time of each
+command without a probe, and responses that changed against the model target.
+
+CaptureControl request: mode (0 = stop, 1 = start, 2 = status only)
+CaptureControl response: status, records since the start (2 bytes), bytes
+    queued (2 bytes), buffer size (2 bytes), records dropped (2 bytes)
+CaptureRead response: status (DAP_ERROR when stopped), dropped (2 bytes),
+    number of bytes (2 bytes), bytes of the record stream
+Record: time in us since the start (4 bytes), processing time in us
+    (2 bytes), request length (2 bytes), response length (2 bytes), response
+    CRC-32 (4 bytes), request
+"""
+import argparse
+import collections
+import struct
+import sys
+import time
+import zlib
+
+from dap_read import DAP_OK, HostProbe, Probe
+
+ID_DAP_CAPTURE_CONTROL = 0x9A
+ID_DAP_CAPTURE_READ = 0x9B
+
+CAPTURE_STOP = 0
+CAPTURE_START = 1
+CAPTURE_STATUS = 2
+
+MAGIC = b'DAPCAP1\n'
+HEADER = struct.Struct('<IHHHI')
+
+Record = collections.namedtuple('Record', 'time duration request response_length crc')
+
+NAMES = {0x00: 'Info', 0x01: 'HostStatus', 0x02: 'Connect', 0x03: 'Disconnect',
+         0x04: 'TransferConfigure', 0x05: 'Transfer', 0x06: 'TransferBlock', 0x07: 'TransferAbort',
+         0x08: 'WriteABORT', 0x09: 'Delay', 0x0A: 'ResetTarget', 0x10: 'SWJ_Pins',
+         0x11: 'SWJ_Clock', 0x12: 'SWJ_Sequence', 0x13: 'SWD_Configure', 0x1D: 'SWD_Sequence',
+         0x14: 'JTAG_Sequence', 0x15: 'JTAG_Configure', 0x16: 'JTAG_IDCODE', 0x7F: 'ExecuteCommands'}
+
+
+def control(probe, mode):
+    """Returns (records, queued bytes, buffer size, dropped)."""
+    resp = probe.command([ID_DAP_CAPTURE_CONTROL, mode])
+    if resp[1] != DAP_OK:
+        raise SystemExit('CaptureControl failed, is DAP_CAPTURE_BUFFER_SIZE set in the firmware?')
+    return struct.unpack('<4H', resp[2:10])
+
+
+def drain(probe):
+    """Reads the queued record stream, returns (bytes, dropped)."""
+    stream = bytearray()
+    dropped = 0
+    while True:
+        resp = probe.command([ID_DAP_CAPTURE_READ])
+        lost, count = struct.unpack('<HH', resp[2:6])
+        dropped += lost
+        stream += resp[6:6 + count]
+        if count == 0:
+            return bytes(stream), dropped
+
+
+def parse(stream):
+    """Splits a record stream into records."""
+    records = []
+    pos = 0
+    while pos + HEADER.size <= len(stream):
+        when, duration, length, response_length, crc = HEADER.unpack_from(stream, pos)
+        pos += HEADER.size
+        if pos + length > len(stream):
+            raise ValueError('record stream ends inside a record')
+        records.append(Record(when, duration, stream[pos:pos + length], response_length, crc))
+        pos += length
+    if pos != len(stream):
+        raise ValueError('record stream ends inside a record header')
+    return records
+
+
+def load(path):
+    with open(path, 'rb') as f:
+        data = f.read()
+    if not data.startswith(MAGIC):
+        raise SystemExit('%s is not a capture file' % path)
+    return parse(data[len(MAGIC):])
+
+
+def name(request):
+    command = request[0] if request else 0xFF
+    return NAMES.get(command, 'Vendor 0x%02X' % command if command >= 0x80 else '0x%02X' % command)
+
+
+def replay(probe, records, size):
+    """Sends the requests again while capturing, returns (replayed records, changed, seconds)."""
+    control(probe, CAPTURE_START)
+    replayed = []
+    changed = []
+    pending = 0
+    start = time.perf_counter()
+    for n, record in enumerate(records):
+        if pending + HEADER.size + len(record.request) > size:
+            replayed += parse(drain(probe)[0])
+            pending = 0
+        resp = probe.command(record.request)
+        if len(resp) != record.response_length or zlib.crc32(resp) != record.crc:
+            changed.append(n)
+        pending += HEADER.size + len(record.request)
+    elapsed = time.perf_counter() - start
+    control(probe, CAPTURE_STOP)
+    replayed += parse(drain(probe)[0])
+    return replayed, changed, elapsed
+
+
+def summary(records):
+    """Count and processing time in us per command."""
+    table = collections.OrderedDict()
+    for record in records:
+        count, total = table.get(name(record.request), (0, 0))
+        table[name(record.request)] = (count + 1, total + record.duration)
+    return table
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('cmd', choices=['start', 'status', 'save', 'show', 'replay'])
+    parser.add_argument('file', nargs='?')
+    parser.add_argument('--repeat', type=int, default=1, help='replay runs')
+    parser.add_argument('--sim', metavar='host_probe', help='replay on the host build of the firmware')
+    args = parser.parse_args()
+    if args.cmd in ('save', 'show', 'replay') and not args.file:
+        raise SystemExit('%s needs a capture file' % args.cmd)
+    if args.sim and args.cmd != 'replay':
+        raise SystemExit('--sim only replays, capture on the probe')
+
+    if args.cmd == 'show':
+        records = load(args.file)
+        for record in records:
+            print('%10d us %5d us  %-18s %4d -> %4d bytes  crc %08X' %
+                  (record.time, record.duration, name(record.request), len(record.request),
+                   record.response_length, record.crc))
+        print('%d records' % len(records), file=sys.stderr)
+        return 0
+
+    probe = HostProbe(args.sim) if args.sim else Probe()
+    if args.cmd == 'start':
+        _, _, size, _ = control(probe, CAPTURE_START)
+        print('capturing into %d bytes' % size, file=sys.stderr)
+    elif args.cmd == 'status':
+        records, queued, size, dropped = control(probe, CAPTURE_STATUS)
+        print('%d records, %d of %d bytes queued, %d dropped' % (records, queued, size, dropped))
+    elif args.cmd == 'save':
+        control(probe, CAPTURE_STOP)
+        stream, dropped = drain(probe)
+        with open(args.file, 'wb') as f:
+            f.write(MAGIC + stream)
+        print('%d records saved, %d dropped' % (len(parse(stream)), dropped), file=sys.stderr)
+        if dropped:
+            print('the capture has gaps, replay results are not comparable', file=sys.stderr)
+    else:
+        records = load(args.file)
+        _, _, size, _ = control(probe, CAPTURE_STATUS)
+        original = summary(records)
+        span = (records[-1].time + records[-1].duration - records[0].time) if records else 0
+        for run in range(args.repeat):
+            replayed, changed, elapsed = replay(probe, records, size)
+            print('run %d: %d commands in %.1f ms (captured session %.1f ms), %d responses changed' %
+                  (run + 1, len(records), elapsed * 1000, span / 1000, len(changed)))
+            for n in changed[:10]:
+                print('  record %d: %s' % (n, name(records[n].request)))
+            print('  %-18s %6s %12s %12s' % ('command', 'count', 'captured us', 'replayed us'))
+            for command, (count, total) in summary(replayed).items():
+                print('  %-18s %6d %12d %12d' % (command, count, original.get(command, (0, 0))[1], total))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
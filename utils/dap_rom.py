@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+"""ROM table discovery through the CMSIS-DAP vendor command RomDiscover.
+
+The probe walks the ROM tables of a MEM-AP itself and caches the component
+list by DPIDR, AP IDR and BASE, so a reconnect to the same target only costs
+the three register reads. The default cache holds the first 14 components of
+one list; the pages behind them are walked again, limit the walk with --depth
+and --entries or raise DAP_ROM_CACHE_SIZE in the firmware. A walk stops at
+1024 components and is reported truncated.
+
+    dap_rom.py                          components of AP 0
+    dap_rom.py --ap 1 --depth 2         AP 1, two levels of ROM tables
+    dap_rom.py --refresh                walk again, ignore the cache
+
+Request, after the command ID:
+    AP number, ROM tables followed at most, entries per table at most
+    (2 bytes, 0 = all), first record (2 bytes), flags (bit 0: walk again)
+Response, after the command ID:
+    status, flags (bit 0: cached, bit 1: truncated, bit 2: cached in part),
+    number of components (2 bytes), number of records, records: address
+    (4 bytes), PIDR0..PIDR4, class, depth, DEVTYPE, DEVARCH (4 bytes)
+"""
+import argparse
+import struct
+import sys
+import time
+
+from dap_read import DAP_OK, Probe
+
+ID_DAP_ROM_DISCOVER = 0x97
+
+FLAG_REFRESH = 0x01
+FLAG_CACHED = 0x01
+FLAG_TRUNCATED = 0x02
+FLAG_PARTIAL = 0x04
+
+RECORD_SIZE = 16
+CLASS_NAMES = {0x1: 'ROM table', 0x9: 'CoreSight', 0xE: 'generic IP', 0xF: 'PrimeCell', 0xFF: 'not readable'}
+
+
+def decode_record(data):
+    """Splits a component record into a dict."""
+    address, pidr, cls, depth, devtype, devarch = struct.unpack('<I5sBBBI', data)
+    part = pidr[0] | (pidr[1] & 0x0F) << 8
+    designer = (pidr[1] >> 4) | (pidr[2] & 0x07) << 4 | (pidr[4] & 0x0F) << 7
+    return {'address': address, 'class': cls, 'depth': depth, 'part': part,
+            'designer': designer, 'devtype': devtype, 'devarch': devarch}
+
+
+def discover(probe, ap, depth, entries, refresh):
+    """Reads the component list page by page, returns (flags, components)."""
+    components = []
+    flags = 0
+    total = None
+    while total is None or len(components) < total:
+        resp = probe.command(struct.pack('<BBBHHB', ID_DAP_ROM_DISCOVER, ap, depth, entries,
+                                         len(components), FLAG_REFRESH if refresh and total is None else 0))
+        status, page_flags, count, records = struct.unpack('<BBHB', resp[1:6])
+        if status != DAP_OK:
+            raise SystemExit('RomDiscover failed on AP %d' % ap)
+        if total is None:
+            flags = page_flags
+        total = count
+        if records == 0:
+            break
+        for n in range(records):
+            components.append(decode_record(resp[6 + n * RECORD_SIZE:6 + (n + 1) * RECORD_SIZE]))
+    return flags, components
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('--ap', type=int, default=0, help='AP number')
+    parser.add_argument('--depth', type=int, default=8, help='ROM tables followed at most')
+    parser.add_argument('--entries', type=int, default=0, help='entries per table at most, 0 = all')
+    parser.add_argument('--refresh', action='store_true', help='walk again, ignore the cache')
+    args = parser.parse_args()
+    probe = Probe()
+    probe.connect()
+    start = time.perf_counter()
+    flags, components = discover(probe, args.ap, args.depth, args.entries, args.refresh)
+    elapsed = time.perf_counter() - start
+    for c in components:
+        print('%s%08X  %-12s part 0x%03X designer 0x%03X devtype 0x%02X devarch 0x%08X' %
+              ('  ' * c['depth'], c['address'], CLASS_NAMES.get(c['class'], 'class 0x%X' % c['class']),
+               c['part'], c['designer'], c['devtype'], c['devarch']))
+    print('%d components in %.1f ms%s%s%s' % (len(components), elapsed * 1000,
+                                              ', cached' if flags & FLAG_CACHED else '',
+                                              ', truncated' if flags & FLAG_TRUNCATED else '',
+                                              ', cached in part' if flags & FLAG_PARTIAL else ''),
+          file=sys.stderr)
+
+
+if __name__ == '__main__':
+    sys.exit(main())
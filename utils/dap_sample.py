@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+"""Periodic sampling of target variables through the CMSIS-DAP vendor commands
+SampleConfigure and SampleRead.
+
+The probe samples on its own timer into a ring buffer, the host only drains
+the records, so the sample rate does not depend on USB round trips.
+
+    dap_sample.py --period 1000 --time 10 0x20000010:4 0x20000104:2 > samples.csv
+
+Prints one CSV line per record: time in us, then the values. Samples lost to
+a full ring buffer (dropped), to a late probe (missed) or to target access
+errors (failed) are reported on stderr.
+
+SampleConfigure request, after the command ID:
+    period in us (4 bytes, 0 stops), number of entries,
+    entries: address (4 bytes), size in bytes
+SampleConfigure response: status, record size, records buffered (2 bytes)
+SampleRead response: status, dropped, missed, failed (2 bytes each),
+    number of records, records: time in us (4 bytes), data
+"""
+import argparse
+import struct
+import sys
+import time
+
+from dap_read import DAP_OK, Probe
+from dap_watch import entry
+
+ID_DAP_SAMPLE_CONFIGURE = 0x90
+ID_DAP_SAMPLE_READ = 0x91
+
+ENTRIES_MAX = 16
+
+
+def encode_configure(period, entries):
+    return struct.pack('<BIB', ID_DAP_SAMPLE_CONFIGURE, period, len(entries)) + \
+        b''.join(struct.pack('<IB', address, size) for address, size in entries)
+
+
+def decode_read(response, entries):
+    """Splits a SampleRead response (without command ID) into (status, lost, records)."""
+    status, dropped, missed, failed, count = struct.unpack('<BHHHB', response[:8])
+    record = 4 + sum(size for _, size in entries)
+    records = []
+    for n in range(count):
+        data = response[8 + n * record:8 + (n + 1) * record]
+        values = [struct.unpack('<I', data[:4])[0]]
+        pos = 4
+        for _, size in entries:
+            values.append(int.from_bytes(data[pos:pos + size], 'little'))
+            pos += size
+        records.append(values)
+    return status, (dropped, missed, failed), records
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('entries', nargs='+', type=entry, metavar='address:size')
+    parser.add_argument('--period', type=int, default=1000, help='sample period in us')
+    parser.add_argument('--time', type=float, default=0.0, help='seconds, 0 runs until interrupted')
+    args = parser.parse_args()
+    if len(args.entries) > ENTRIES_MAX:
+        raise SystemExit('at most %d entries' % ENTRIES_MAX)
+    probe = Probe()
+    probe.connect()
+    resp = probe.command(encode_configure(args.period, args.entries))
+    if resp[1] != DAP_OK:
+        raise SystemExit('SampleConfigure failed')
+    print('record %d bytes, %d records buffered' % (resp[2], resp[3] | resp[4] << 8), file=sys.stderr)
+
+    lost = [0, 0, 0]
+    samples = 0
+    start = time.perf_counter()
+    try:
+        while args.time == 0 or time.perf_counter() - start < args.time:
+            status, counters, records = decode_read(probe.command([ID_DAP_SAMPLE_READ])[1:], args.entries)
+            for n, value in enumerate(counters):
+                lost[n] += value
+            for values in records:
+                print(','.join(str(v) for v in values))
+            samples += len(records)
+            if status != DAP_OK:
+                break
+    except KeyboardInterrupt:
+        pass
+    probe.command(encode_configure(0, []))
+    elapsed = time.perf_counter() - start
+    print('%d samples in %.2f s, dropped %d, missed %d, failed %d' %
+          (samples, elapsed, lost[0], lost[1], lost[2]), file=sys.stderr)
+
+
+if __name__ == '__main__':
+    sys.exit(main())
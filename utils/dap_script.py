@@ -0,0 +1,345 @@
+#!/usr/bin/env python3
+"""Debug sequence scripts run on the probe through the CMSIS-DAP vendor
+commands ScriptLoad and ScriptRun.
+
+A script of read-compare-branch-write steps runs in one round trip instead of
+one per step. The probe verifies the bytecode when it is loaded and limits
+every run to a step budget and one second.
+
+    dap_script.py asm unlock.s                       print the bytecode
+    dap_script.py sim unlock.s --mem 0x40001000=1    run on the host model
+    dap_script.py run unlock.s 0x20000000 16         run on the probe, r0, r1 set
+
+Assembly, one instruction per line, ';' starts a comment:
+    label:                      .equ NAME value
+    exit imm8                   jmp label               delay us
+    linereset                   reset 0|1               (nRESET level)
+    mov|add|sub|and|or|xor|lsl|lsr rd, rs
+    movi|addi|subi|andi|ori|xori|lsli|lsri rd, imm32
+    dpr rd, A    dpw rs, A      apr rd, A    apw rs, A  (A: 0x0, 0x4, 0x8, 0xC)
+    rd32 rd, [ra]               wr32 rs, [ra]           (MEM-AP 0)
+    jeq|jne|jlo|jhs ra, rb, label                       (jlo/jhs unsigned)
+    loop rc, label              (rc = rc - 1, jump while not 0)
+The last instruction has to be exit or jmp.
+
+ScriptLoad request: offset (2 bytes), number of bytes (2 bytes), bytes
+ScriptLoad response: status, offset of the first invalid instruction
+    (2 bytes, 0xFFFF when the script verifies)
+ScriptRun request: step budget (4 bytes, 0 = maximum), number of
+    arguments (up to 8), arguments (4 bytes each) for r0 onwards
+ScriptRun response: status, stop reason, exit code or ACK, pc (2 bytes),
+    steps (4 bytes), r0..r7 (4 bytes each)
+"""
+import argparse
+import struct
+import sys
+
+from dap_read import DAP_OK, Probe
+
+ID_DAP_SCRIPT_LOAD = 0x98
+ID_DAP_SCRIPT_RUN = 0x99
+
+SCRIPT_SIZE = 256
+LOAD_CHUNK = 500
+REGS = 8
+VALID = 0xFFFF
+STEPS_MAX = 1000000
+
+ALU = ['mov', 'add', 'sub', 'and', 'or', 'xor', 'lsl', 'lsr']
+OPS = {'exit': 0x00, 'jmp': 0x01, 'delay': 0x02, 'linereset': 0x03, 'reset': 0x04,
+       'dpr': 0x20, 'dpw': 0x21, 'apr': 0x22, 'apw': 0x23, 'rd32': 0x24, 'wr32': 0x25,
+       'jeq': 0x30, 'jne': 0x31, 'jlo': 0x32, 'jhs': 0x33, 'loop': 0x34}
+OPS.update({name: 0x10 + n for n, name in enumerate(ALU)})
+OPS.update({name + 'i': 0x18 + n for n, name in enumerate(ALU)})
+LENGTHS = {0x00: 2, 0x01: 3, 0x02: 3, 0x03: 1, 0x04: 2, 0x34: 4}
+LENGTHS.update({op: 2 for op in range(0x10, 0x18)})
+LENGTHS.update({op: 6 for op in range(0x18, 0x20)})
+LENGTHS.update({op: 2 for op in range(0x20, 0x26)})
+LENGTHS.update({op: 4 for op in range(0x30, 0x34)})
+OPERANDS = {0x00: 1, 0x01: 1, 0x02: 1, 0x03: 0, 0x04: 1, 0x30: 3, 0x31: 3, 0x32: 3, 0x33: 3}
+
+STOP_REASONS = ['exit', 'no verified script', 'step budget used up', 'time limit',
+                'target access failed', 'transfer abort', 'more than 8 arguments']
+
+
+class AsmError(Exception):
+    pass
+
+
+def assemble(text):
+    """Assembles script text into bytecode."""
+    lines = []
+    equ = {}
+    for number, line in enumerate(text.splitlines(), 1):
+        line = line.split(';')[0].strip()
+        if ':' in line:
+            label, _, line = line.partition(':')
+            lines.append((number, label.strip() + ':'))
+            line = line.strip()
+        if line.startswith('.equ'):
+            _, name, value = line.split(None, 2)
+            equ[name] = int(value, 0)
+        elif line:
+            lines.append((number, line))
+
+    def value(text, number):
+        text = text.strip()
+        if text in equ:
+            return equ[text]
+        try:
+            return int(text, 0)
+        except ValueError:
+            raise AsmError('line %d: bad value %s' % (number, text)) from None
+
+    def reg(text, number):
+        text = text.strip().strip('[]').strip()
+        if len(text) != 2 or text[0] != 'r' or not text[1].isdigit() or int(text[1]) >= REGS:
+            raise AsmError('line %d: bad register %s' % (number, text))
+        return int(text[1])
+
+    labels = {}
+    for final in (False, True):
+        code = bytearray()
+        for number, line in lines:
+            if line.endswith(':'):
+                labels[line[:-1]] = len(code)
+                continue
+            mnemonic, _, rest = line.partition(' ')
+            mnemonic = mnemonic.lower()
+            args = [a for a in rest.split(',')] if rest.strip() else []
+            if mnemonic not in OPS:
+                raise AsmError('line %d: unknown instruction %s' % (number, mnemonic))
+            op = OPS[mnemonic]
+            end = len(code) + LENGTHS[op]
+
+            def offset(label):
+                if label.strip() not in labels:
+                    if final:
+                        raise AsmError('line %d: unknown label %s' % (number, label.strip()))
+                    return 0
+                return labels[label.strip()] - end
+
+            expect = OPERANDS.get(op, 2)
+            if len(args) != expect:
+                raise AsmError('line %d: %s takes %d operands' % (number, mnemonic, expect))
+            if op in (0x00, 0x04):
+                code += bytes([op, value(args[0], number) & 0xFF])
+            elif op in (0x01, 0x02):
+                code += struct.pack('<BH' if op == 0x02 else '<Bh', op,
+                                    value(args[0], number) if op == 0x02 else offset(args[0]))
+            elif op == 0x03:
+                code.append(op)
+            elif op < 0x18:
+                code += bytes([op, reg(args[0], number) << 4 | reg(args[1], number)])
+            elif op < 0x20:
+                code += struct.pack('<BBI', op, reg(args[0], number), value(args[1], number) & 0xFFFFFFFF)
+            elif op < 0x24:
+                a = value(args[1], number)
+                if a not in (0x0, 0x4, 0x8, 0xC):
+                    raise AsmError('line %d: bad register address %s' % (number, args[1].strip()))
+                code += bytes([op, reg(args[0], number) << 4 | a >> 2])
+            elif op < 0x30:
+                code += bytes([op, reg(args[0], number) << 4 | reg(args[1], number)])
+            elif op == 0x34:
+                code += struct.pack('<BBh', op, reg(args[0], number) << 4, offset(args[1]))
+            else:
+                code += struct.pack('<BBh', op, reg(args[0], number) << 4 | reg(args[1], number), offset(args[2]))
+    if len(code) > SCRIPT_SIZE:
+        raise AsmError('script takes %d bytes, the slot holds %d' % (len(code), SCRIPT_SIZE))
+    return bytes(code)
+
+
+def verify(code):
+    """Same checks as the probe: returns the offset of the first invalid instruction or VALID."""
+    starts = set()
+    pc = last = 0
+    if not code:
+        return 0
+    while pc < len(code):
+        op = code[pc]
+        length = LENGTHS.get(op, 0)
+        if length == 0 or pc + length > len(code):
+            return pc
+        hi, lo = (code[pc + 1] >> 4, code[pc + 1] & 0x0F) if length > 1 else (0, 0)
+        if op == 0x04:
+            ok = code[pc + 1] <= 1
+        elif 0x18 <= op < 0x20:
+            ok = code[pc + 1] < REGS
+        elif 0x20 <= op < 0x24:
+            ok = hi < REGS and lo < 4
+        elif op == 0x34:
+            ok = hi < REGS and lo == 0
+        elif 0x10 <= op < 0x18 or op in (0x24, 0x25) or 0x30 <= op < 0x34:
+            ok = hi < REGS and lo < REGS
+        else:
+            ok = True
+        if not ok:
+            return pc
+        starts.add(pc)
+        last = pc
+        pc += length
+    if code[last] not in (0x00, 0x01):
+        return last
+    for pc in sorted(starts):
+        if code[pc] == 0x01 or 0x30 <= code[pc] <= 0x34:
+            if target(code, pc) not in starts:
+                return pc
+    return VALID
+
+
+def target(code, pc):
+    length = LENGTHS[code[pc]]
+    return pc + length + struct.unpack('<h', code[pc + length - 2:pc + length])[0]
+
+
+class Model:
+    """Host model of the target for sim: DP, AP and memory words, 0 when not set."""
+
+    def __init__(self, mem=None):
+        self.dp = {}
+        self.ap = {}
+        self.mem = dict(mem or {})
+        self.log = []
+
+    def access(self, op, a, value=None):
+        bank = self.dp.get(0x8, 0) & 0xFF0000F0
+        if op == 'dpr':
+            value = self.dp.get(a, 0)
+        elif op == 'dpw':
+            self.dp[a] = value
+        elif op == 'apr':
+            value = self.ap.get((bank, a), 0)
+        elif op == 'apw':
+            self.ap[(bank, a)] = value
+        elif op == 'rd32':
+            value = self.mem.get(a, 0)
+        else:
+            self.mem[a] = value
+        self.log.append((op, a, value))
+        return value
+
+
+def simulate(code, args=(), budget=0, model=None):
+    """Runs a script like the probe does, returns (reason, exit code, pc, steps, registers)."""
+    model = model or Model()
+    budget = budget if 0 < budget <= STEPS_MAX else STEPS_MAX
+    regs = [0] * REGS
+    if len(args) > REGS:
+        return 6, 0, 0, 0, regs
+    for n, arg in enumerate(args):
+        regs[n] = arg & 0xFFFFFFFF
+    if verify(code) != VALID:
+        return 1, 0, 0, 0, regs
+    pc = steps = 0
+    while True:
+        if steps == budget:
+            return 2, 0, pc, steps, regs
+        steps += 1
+        op = code[pc]
+        b = code[pc + 1] if LENGTHS[op] > 1 else 0
+        d, s = b >> 4, b & 0x0F
+        nxt = pc + LENGTHS[op]
+        if op == 0x00:
+            return 0, b, pc, steps, regs
+        if op == 0x01:
+            pc = target(code, pc)
+            continue
+        if 0x10 <= op < 0x20:
+            if op >= 0x18:
+                d, operand = b, struct.unpack('<I', code[pc + 2:pc + 6])[0]
+            else:
+                operand = regs[s]
+            a, alu = regs[d], op & 7
+            regs[d] = [operand, a + operand, a - operand, a & operand, a | operand, a ^ operand,
+                       a << operand if operand < 32 else 0, a >> operand if operand < 32 else 0][alu] & 0xFFFFFFFF
+        elif op in (0x20, 0x22):
+            regs[d] = model.access('dpr' if op == 0x20 else 'apr', s << 2)
+        elif op in (0x21, 0x23):
+            model.access('dpw' if op == 0x21 else 'apw', s << 2, regs[d])
+        elif op == 0x24:
+            regs[d] = model.access('rd32', regs[s])
+        elif op == 0x25:
+            model.access('wr32', regs[s], regs[d])
+        elif 0x30 <= op <= 0x34:
+            if op == 0x34:
+                regs[d] = (regs[d] - 1) & 0xFFFFFFFF
+            taken = [regs[d] == regs[s], regs[d] != regs[s], regs[d] < regs[s], regs[d] >= regs[s],
+                     regs[d] != 0][op - 0x30]
+            if taken:
+                nxt = target(code, pc)
+        pc = nxt
+
+
+def load(probe, code):
+    result = VALID
+    for offset in range(0, max(len(code), 1), LOAD_CHUNK):
+        chunk = code[offset:offset + LOAD_CHUNK]
+        resp = probe.command(struct.pack('<BHH', ID_DAP_SCRIPT_LOAD, offset, len(chunk)) + chunk)
+        if resp[1] != DAP_OK:
+            raise SystemExit('ScriptLoad failed')
+        result = resp[2] | resp[3] << 8
+    if result != VALID:
+        raise SystemExit('probe rejected the instruction at offset %d' % result)
+
+
+def run(probe, args, budget=0):
+    """Runs the loaded script, returns (reason, exit code, pc, steps, registers)."""
+    resp = probe.command(struct.pack('<BIB', ID_DAP_SCRIPT_RUN, budget, len(args)) +
+                         b''.join(struct.pack('<I', a & 0xFFFFFFFF) for a in args))
+    reason, code, pc, steps = struct.unpack('<BBHI', resp[2:10])
+    return reason, code, pc, steps, list(struct.unpack('<8I', resp[10:42]))
+
+
+def report(reason, code, pc, steps, regs):
+    if reason == 0:
+        print('exit %d after %d steps' % (code, steps))
+    elif reason == 4:
+        print('%s at pc %d, ACK %d' % (STOP_REASONS[reason], pc, code))
+    else:
+        print('%s at pc %d' % (STOP_REASONS[reason] if reason < len(STOP_REASONS) else 'stop %d' % reason, pc))
+    print(' '.join('r%d=%08X' % (n, v) for n, v in enumerate(regs)))
+    return 0 if reason == 0 else 1
+
+
+def word(text):
+    address, _, value = text.partition('=')
+    return int(address, 0), int(value or '0', 0)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('cmd', choices=['asm', 'sim', 'run'])
+    parser.add_argument('script')
+    parser.add_argument('args', nargs='*', type=lambda v: int(v, 0), help='r0 onwards')
+    parser.add_argument('--budget', type=int, default=0, help='steps, 0 = maximum')
+    parser.add_argument('--mem', type=word, action='append', default=[], metavar='address=value',
+                        help='memory word of the sim model')
+    args = parser.parse_args()
+    with open(args.script) as f:
+        try:
+            code = assemble(f.read())
+        except AsmError as e:
+            raise SystemExit(str(e))
+    if len(args.args) > REGS:
+        raise SystemExit('scripts take up to %d arguments' % REGS)
+    result = verify(code)
+    if result != VALID:
+        raise SystemExit('invalid instruction at offset %d' % result)
+    if args.cmd == 'asm':
+        print(code.hex(' '))
+        print('%d bytes' % len(code), file=sys.stderr)
+        return 0
+    if args.cmd == 'sim':
+        model = Model(dict(args.mem))
+        status = report(*simulate(code, args.args, args.budget, model))
+        for op, a, value in model.log:
+            print('  %-4s %08X %08X' % (op, a, value), file=sys.stderr)
+        return status
+    probe = Probe()
+    probe.connect()
+    load(probe, code)
+    return report(*run(probe, args.args, args.budget))
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,52 @@
+#!/usr/bin/env python3
+"""Target tuning through the CMSIS-DAP vendor command TargetTune.
+
+TargetTune searches the highest reliable SWJ clock and the lowest idle cycle
+count for the connected target and stores them in the probe, keyed by DPIDR
+and TARGETID. The probe applies them again whenever a debugger connects to
+the same target: the SWJ clock the debugger asks for is not set higher, idle
+cycles and turnaround not lower.
+
+    dap_tune.py 0x20000000                       tune with reads of target SRAM
+    dap_tune.py 0x0 --min 1000000 --max 24000000
+
+Request: AP number, test address (4 bytes), lowest and highest SWJ clock in
+    Hz (4 bytes each)
+Response: status, DPIDR (4 bytes), TARGETID (4 bytes), SWJ clock in Hz
+    (4 bytes), idle cycles, turnaround
+"""
+import argparse
+import struct
+import sys
+
+from dap_read import DAP_OK, Probe
+
+ID_DAP_TARGET_TUNE = 0x88
+
+
+def decode(response):
+    """Splits a response (without command ID) into (status, dpidr, targetid, clock, idle, turnaround)."""
+    return struct.unpack('<BIIIBB', response[:15])
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('address', nargs='?', type=lambda x: int(x, 0), default=0x20000000,
+                        help='test block of 256 bytes, read only')
+    parser.add_argument('--ap', type=int, default=0)
+    parser.add_argument('--min', type=int, default=1000000, help='lowest SWJ clock in Hz')
+    parser.add_argument('--max', type=int, default=24000000, help='highest SWJ clock in Hz')
+    args = parser.parse_args()
+    probe = Probe()
+    probe.connect()
+    resp = probe.command(struct.pack('<BBIII', ID_DAP_TARGET_TUNE, args.ap, args.address, args.min, args.max))
+    status, dpidr, targetid, clock, idle, turnaround = decode(resp[1:])
+    print('DPIDR %08X TARGETID %08X' % (dpidr, targetid))
+    if status != DAP_OK:
+        raise SystemExit('tuning failed, nothing stored')
+    print('SWJ clock %d Hz, %d idle cycles, turnaround %d' % (clock, idle, turnaround))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,78 @@
+#!/usr/bin/env python3
+"""Live watch of target variables through the CMSIS-DAP vendor command ReadScatter.
+
+All variables are read with one command per poll, the probe sorts them by
+address and reads neighbouring ones in one burst.
+
+    dap_watch.py 0x20000010:4 0x20000104:2 0x20000200:1     print at 50 Hz
+    dap_watch.py --rate 10 --count 100 0x20000010:4          100 samples at 10 Hz
+
+Request, after the command ID:
+    number of entries, entries: address (4 bytes), size in bytes
+Response, after the command ID:
+    status, number of entries read, data of the entries in request order
+"""
+import argparse
+import struct
+import sys
+import time
+
+from dap_read import DAP_OK, Probe
+
+ID_DAP_READ_SCATTER = 0x8F
+
+ENTRIES_MAX = 64
+
+
+def encode(entries):
+    """Encodes (address, size) entries into a ReadScatter request."""
+    return struct.pack('<BB', ID_DAP_READ_SCATTER, len(entries)) + \
+        b''.join(struct.pack('<IB', address, size) for address, size in entries)
+
+
+def decode(response, entries):
+    """Splits a ReadScatter response (without command ID) into one value per entry."""
+    status, count = response[0], response[1]
+    if status != DAP_OK or count != len(entries):
+        raise ValueError('read failed')
+    values = []
+    pos = 2
+    for _, size in entries:
+        values.append(int.from_bytes(response[pos:pos + size], 'little'))
+        pos += size
+    return values
+
+
+def entry(text):
+    address, _, size = text.partition(':')
+    return int(address, 0), int(size or '4', 0)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('entries', nargs='+', type=entry, metavar='address:size')
+    parser.add_argument('--rate', type=float, default=50.0, help='polls per second')
+    parser.add_argument('--count', type=int, default=0, help='polls, 0 runs until interrupted')
+    args = parser.parse_args()
+    if len(args.entries) > ENTRIES_MAX:
+        raise SystemExit('at most %d entries' % ENTRIES_MAX)
+    probe = Probe()
+    probe.connect()
+    request = encode(args.entries)
+    period = 1.0 / args.rate
+    polls = 0
+    start = time.perf_counter()
+    try:
+        while args.count == 0 or polls < args.count:
+            values = decode(probe.command(request)[1:], args.entries)
+            print(' '.join('%0*X' % (size * 2, value) for (_, size), value in zip(args.entries, values)))
+            polls += 1
+            time.sleep(max(0.0, start + polls * period - time.perf_counter()))
+    except KeyboardInterrupt:
+        pass
+    elapsed = time.perf_counter() - start
+    print('%d polls in %.2f s, %.1f Hz' % (polls, elapsed, polls / elapsed), file=sys.stderr)
+
+
+if __name__ == '__main__':
+    sys.exit(main())
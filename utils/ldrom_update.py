@@ -0,0 +1,116 @@
+#!/usr/bin/env python3
+"""Firmware update through the LDROM bootloader.
+
+The bootloader enumerates as 0416:DF11 when the DAP button is held at reset
+or APROM holds no valid image. It programs the image while it arrives and
+verifies it against the CRC-32 sent with START, see ldrom/ldrom.h.
+
+    ldrom_update.py info                         bootloader version and image state
+    ldrom_update.py flash DAP_NCU120.bin         program and start the image
+    ldrom_update.py flash DAP_NCU120.bin --stay  program, stay in the bootloader
+    ldrom_update.py boot                         start the image in APROM
+"""
+import argparse
+import struct
+import sys
+import time
+import zlib
+
+LDROM_VID = 0x0416
+LDROM_PID = 0xDF11
+PACKET_SIZE = 64
+
+CMD_INFO = 0x01
+CMD_START = 0x02
+CMD_STATUS = 0x03
+CMD_BOOT = 0x04
+
+LDROM_OK = 0x00
+ERRORS = {0x01: 'image size', 0x02: 'flash erase, program or verify', 0x03: 'CRC mismatch',
+          0x04: 'no valid image', 0xFF: 'unknown command'}
+
+
+class Bootloader:
+    """Bulk endpoint pair of the LDROM bootloader."""
+
+    def __init__(self, wait):
+        import usb.core
+        import usb.util
+        deadline = time.monotonic() + wait
+        while True:
+            dev = usb.core.find(idVendor=LDROM_VID, idProduct=LDROM_PID)
+            if dev is not None:
+                break
+            if time.monotonic() >= deadline:
+                raise SystemExit('no LDROM bootloader found, hold the DAP button while plugging in the probe')
+            time.sleep(0.2)
+        dev.set_configuration()
+        intf = dev.get_active_configuration()[(0, 0)]
+        eps = list(intf)
+        self.ep_out = next(e for e in eps if usb.util.endpoint_direction(e.bEndpointAddress) == usb.util.ENDPOINT_OUT)
+        self.ep_in = next(e for e in eps if usb.util.endpoint_direction(e.bEndpointAddress) == usb.util.ENDPOINT_IN)
+        usb.util.claim_interface(dev, intf)
+
+    def command(self, data, timeout=2000):
+        self.ep_out.write(bytes(data), timeout=timeout)
+        return self.receive(timeout)
+
+    def receive(self, timeout):
+        resp = bytes(self.ep_in.read(PACKET_SIZE, timeout=timeout))
+        if resp[1] != LDROM_OK:
+            raise SystemExit('command 0x%02X failed: %s' % (resp[0], ERRORS.get(resp[1], resp[1])))
+        return resp
+
+    def info(self):
+        """Returns (version, page size, image max, image valid)."""
+        return struct.unpack('<HHIB', self.command([CMD_INFO])[2:11])
+
+
+def info(boot, args):
+    version, page, image_max, valid = boot.info()
+    print('LDROM %d.%02d, %d byte pages, images up to %d bytes, APROM image %s' %
+          (version >> 8, version & 0xFF, page, image_max, 'valid' if valid else 'not valid'))
+
+
+def flash(boot, args):
+    data = open(args.image, 'rb').read()
+    _, page, image_max, _ = boot.info()
+    if not data or len(data) > image_max:
+        raise SystemExit('%s: %d bytes, the bootloader takes 1 to %d' % (args.image, len(data), image_max))
+    crc = zlib.crc32(data)
+    start = time.perf_counter()
+    boot.command(struct.pack('<BII', CMD_START, len(data), crc))
+    # The bootloader NAKs while both page buffers are programming
+    boot.ep_out.write(data, timeout=10000 + len(data) // page * 100)
+    resp = boot.receive(10000)
+    programmed, result = struct.unpack('<II', resp[2:10])
+    wall = time.perf_counter() - start
+    if programmed != len(data) or result != crc:
+        raise SystemExit('programmed %d bytes with CRC %08X, expected %d bytes with %08X' %
+                         (programmed, result, len(data), crc))
+    print('%d bytes in %.2f s, %.1f KB/s, CRC %08X' % (len(data), wall, len(data) / wall / 1024, crc))
+    if not args.stay:
+        boot.command([CMD_BOOT])
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('--wait', type=float, default=0, help='seconds to wait for the bootloader')
+    sub = parser.add_subparsers(dest='cmd', required=True)
+    sub.add_parser('info', help='bootloader version and image state')
+    p = sub.add_parser('flash', help='program an image')
+    p.add_argument('image', help='raw binary linked for APROM')
+    p.add_argument('--stay', action='store_true', help='do not start the image afterwards')
+    sub.add_parser('boot', help='start the image in APROM')
+    args = parser.parse_args()
+    boot = Bootloader(args.wait)
+    if args.cmd == 'info':
+        info(boot, args)
+    elif args.cmd == 'flash':
+        flash(boot, args)
+    else:
+        boot.command([CMD_BOOT])
+
+
+if __name__ == '__main__':
+    sys.exit(main())